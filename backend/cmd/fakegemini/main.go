@@ -0,0 +1,269 @@
+// Command fakegemini is a stand-in for the Gemini API for load tests and benchmarks. It answers
+// generateContent and streamGenerateContent with recorded responses, round-robin, after a latency drawn
+// from a log-normal distribution, so the backend can be driven at volume without quota or cost.
+//
+// Point the backend at it with GEMINI_BASE_URL=http://<addr>. Context caching, embeddings, batch jobs
+// and file uploads are not implemented (404); keep GEMINI_CONTEXT_CACHE, ENABLE_EMBEDDINGS and
+// SUMMARY_BATCH_MODE off.
+//
+//	go run ./cmd/fakegemini -responses cmd/fakegemini/testdata/responses.json -latency 1.5s
+package main
+
+import (
+	"encoding/json"
+	"flag"
+	"fmt"
+	"io"
+	"log/slog"
+	"math"
+	"math/rand"
+	"net/http"
+	"os"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// response is the subset of a GenerateContentResponse the server needs to split a reply into stream
+// chunks; recorded responses are otherwise passed through as recorded.
+type response struct {
+	Candidates    []candidate    `json:"candidates"`
+	UsageMetadata map[string]any `json:"usageMetadata,omitempty"`
+}
+
+type candidate struct {
+	Content      content `json:"content"`
+	FinishReason string  `json:"finishReason,omitempty"`
+}
+
+type content struct {
+	Role  string            `json:"role"`
+	Parts []json.RawMessage `json:"parts"`
+}
+
+var defaultReplies = []string{
+	"Ну, тут я з тобою згоден. Хоча могло бути й гірше.",
+	"Interesting. Tell me more — what happened next?",
+	"Ха, класика. Я б на твоєму місці навіть не починав.",
+}
+
+type server struct {
+	responses   []response
+	next        atomic.Uint64
+	latency     time.Duration
+	sigma       float64
+	chunkWords  int
+	rndMu       sync.Mutex
+	rnd         *rand.Rand
+	requests    atomic.Uint64
+	inFlight    atomic.Int64
+	maxInFlight atomic.Int64
+}
+
+func main() {
+	addr := flag.String("addr", ":8090", "listen address")
+	responsesFile := flag.String("responses", "", "JSON array of recorded GenerateContentResponse objects (default: built-in text replies)")
+	latency := flag.Duration("latency", 1500*time.Millisecond, "median latency of a generate call")
+	sigma := flag.Float64("sigma", 0.5, "log-normal spread of the latency (0 = constant)")
+	chunkWords := flag.Int("chunk-words", 6, "words per chunk when streaming")
+	seed := flag.Int64("seed", 1, "random seed for latencies")
+	flag.Parse()
+
+	slog.SetDefault(slog.New(slog.NewJSONHandler(os.Stdout, nil)))
+
+	responses, err := loadResponses(*responsesFile)
+	if err != nil {
+		slog.Error("load responses", "error", err)
+		os.Exit(1)
+	}
+	s := &server{
+		responses:  responses,
+		latency:    *latency,
+		sigma:      *sigma,
+		chunkWords: max(*chunkWords, 1),
+		rnd:        rand.New(rand.NewSource(*seed)),
+	}
+	go s.report()
+
+	slog.Info("fake gemini listening", "addr", *addr, "responses", len(responses), "latency", latency.String(), "sigma", *sigma)
+	if err := http.ListenAndServe(*addr, s); err != nil {
+		slog.Error("server failed", "error", err)
+		os.Exit(1)
+	}
+}
+
+func loadResponses(path string) ([]response, error) {
+	if path == "" {
+		out := make([]response, len(defaultReplies))
+		for i, text := range defaultReplies {
+			out[i] = textResponse(text, "STOP")
+		}
+		return out, nil
+	}
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	var out []response
+	if err := json.Unmarshal(data, &out); err != nil {
+		return nil, fmt.Errorf("parse %s: %w", path, err)
+	}
+	if len(out) == 0 {
+		return nil, fmt.Errorf("%s: no responses", path)
+	}
+	return out, nil
+}
+
+func textResponse(text, finishReason string) response {
+	part, _ := json.Marshal(map[string]string{"text": text})
+	return response{Candidates: []candidate{{
+		Content:      content{Role: "model", Parts: []json.RawMessage{part}},
+		FinishReason: finishReason,
+	}}}
+}
+
+func (s *server) ServeHTTP(w http.ResponseWriter, r *http.Request) {
+	if r.Method != http.MethodPost {
+		http.NotFound(w, r)
+		return
+	}
+	switch {
+	case strings.HasSuffix(r.URL.Path, ":generateContent"):
+		s.serve(w, r, false)
+	case strings.HasSuffix(r.URL.Path, ":streamGenerateContent"):
+		s.serve(w, r, true)
+	default:
+		http.NotFound(w, r)
+	}
+}
+
+func (s *server) serve(w http.ResponseWriter, r *http.Request, stream bool) {
+	n := s.inFlight.Add(1)
+	defer s.inFlight.Add(-1)
+	for {
+		cur := s.maxInFlight.Load()
+		if n <= cur || s.maxInFlight.CompareAndSwap(cur, n) {
+			break
+		}
+	}
+	s.requests.Add(1)
+
+	body, _ := io.ReadAll(r.Body)
+	resp := s.responses[(s.next.Add(1)-1)%uint64(len(s.responses))]
+	resp.UsageMetadata = usageFor(resp, len(body))
+	delay := s.sampleLatency()
+
+	if !stream {
+		if !sleep(r, delay) {
+			return
+		}
+		w.Header().Set("Content-Type", "application/json")
+		json.NewEncoder(w).Encode(resp)
+		return
+	}
+
+	// Time to first chunk is about a third of the call; the rest is spread over the chunks
+	chunks := s.split(resp)
+	if !sleep(r, delay/3) {
+		return
+	}
+	w.Header().Set("Content-Type", "text/event-stream")
+	flusher, _ := w.(http.Flusher)
+	gap := (delay - delay/3) / time.Duration(len(chunks))
+	for i, c := range chunks {
+		if i > 0 && !sleep(r, gap) {
+			return
+		}
+		data, _ := json.Marshal(c)
+		fmt.Fprintf(w, "data: %s\n\n", data)
+		if flusher != nil {
+			flusher.Flush()
+		}
+	}
+}
+
+// split cuts a text-only reply into chunks of chunkWords words; replies with function calls or other
+// parts are sent as one chunk. Usage and finish reason ride on the last chunk, as Gemini does.
+func (s *server) split(resp response) []response {
+	if len(resp.Candidates) == 0 {
+		return []response{resp}
+	}
+	cand := resp.Candidates[0]
+	var text strings.Builder
+	for _, raw := range cand.Content.Parts {
+		var part map[string]json.RawMessage
+		if json.Unmarshal(raw, &part) != nil || len(part) != 1 || part["text"] == nil {
+			return []response{resp}
+		}
+		var t string
+		json.Unmarshal(part["text"], &t)
+		text.WriteString(t)
+	}
+	words := strings.SplitAfter(text.String(), " ")
+	var chunks []response
+	for i := 0; i < len(words); i += s.chunkWords {
+		end := min(i+s.chunkWords, len(words))
+		chunks = append(chunks, textResponse(strings.Join(words[i:end], ""), ""))
+	}
+	if len(chunks) == 0 {
+		return []response{resp}
+	}
+	last := &chunks[len(chunks)-1]
+	last.Candidates[0].FinishReason = cand.FinishReason
+	last.UsageMetadata = resp.UsageMetadata
+	return chunks
+}
+
+// usageFor keeps recorded usage and otherwise estimates it at about 4 bytes per token.
+func usageFor(resp response, requestBytes int) map[string]any {
+	if resp.UsageMetadata != nil {
+		return resp.UsageMetadata
+	}
+	out := 0
+	if len(resp.Candidates) > 0 {
+		for _, p := range resp.Candidates[0].Content.Parts {
+			out += len(p) / 4
+		}
+	}
+	prompt := requestBytes / 4
+	return map[string]any{
+		"promptTokenCount":     prompt,
+		"candidatesTokenCount": out,
+		"totalTokenCount":      prompt + out,
+	}
+}
+
+func (s *server) sampleLatency() time.Duration {
+	if s.sigma <= 0 {
+		return s.latency
+	}
+	s.rndMu.Lock()
+	z := s.rnd.NormFloat64()
+	s.rndMu.Unlock()
+	return time.Duration(float64(s.latency) * math.Exp(s.sigma*z))
+}
+
+// sleep waits d unless the client goes away first.
+func sleep(r *http.Request, d time.Duration) bool {
+	t := time.NewTimer(d)
+	defer t.Stop()
+	select {
+	case <-t.C:
+		return true
+	case <-r.Context().Done():
+		return false
+	}
+}
+
+func (s *server) report() {
+	var last uint64
+	for range time.Tick(10 * time.Second) {
+		total := s.requests.Load()
+		if total == last {
+			continue
+		}
+		slog.Info("fake gemini stats", "requests", total, "rps", float64(total-last)/10, "in_flight", s.inFlight.Load(), "max_in_flight", s.maxInFlight.Load())
+		last = total
+	}
+}
@@ -0,0 +1,299 @@
+// Command loadgen replays a real chat through the backend at N× speed and reports latency and
+// throughput. The input is a Telegram Desktop chat export (result.json, "Export chat history" in JSON
+// format); every text message is posted to /api/v1/process (or /api/v1/process/stream) at its original
+// offset divided by -speed, as the frontend would post it.
+//
+//	go run ./cmd/loadgen -export result.json -speed 20 -url http://localhost:27710
+//
+// Run it against a backend pointed at cmd/fakegemini (GEMINI_BASE_URL) and with the rate limits raised,
+// or most requests are throttled (204) before they reach the pipeline.
+package main
+
+import (
+	"bytes"
+	"encoding/json"
+	"flag"
+	"fmt"
+	"io"
+	"net/http"
+	"os"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+// export is the subset of a Telegram Desktop JSON export that is replayed.
+type export struct {
+	ID       int64           `json:"id"`
+	Type     string          `json:"type"`
+	Messages []exportMessage `json:"messages"`
+}
+
+type exportMessage struct {
+	ID           int64           `json:"id"`
+	Type         string          `json:"type"`
+	DateUnix     string          `json:"date_unixtime"`
+	From         string          `json:"from"`
+	FromID       string          `json:"from_id"`
+	Text         json.RawMessage `json:"text"`
+	ReplyToMsgID *int64          `json:"reply_to_message_id"`
+}
+
+// replayMessage is one message to send, at offset from the start of the replay.
+type replayMessage struct {
+	offset time.Duration
+	body   map[string]any
+}
+
+type result struct {
+	status  int
+	latency time.Duration
+	err     error
+}
+
+func main() {
+	exportPath := flag.String("export", "", "Telegram Desktop JSON export (result.json)")
+	baseURL := flag.String("url", "http://localhost:27710", "backend base URL")
+	speed := flag.Float64("speed", 10, "replay speed-up (2 = twice as fast as the original chat)")
+	chatID := flag.Int64("chat-id", 0, "chat_id to send as (default: derived from the export)")
+	limit := flag.Int("limit", 0, "replay at most this many messages (0 = all)")
+	maxGap := flag.Duration("max-gap", 30*time.Second, "cap on the (sped-up) pause between messages, so quiet nights do not stall the run")
+	stream := flag.Bool("stream", false, "post to /api/v1/process/stream instead of /api/v1/process")
+	maxInFlight := flag.Int("max-inflight", 512, "requests in flight at once; later messages wait")
+	timeout := flag.Duration("timeout", 2*time.Minute, "per-request timeout")
+	flag.Parse()
+
+	if *exportPath == "" || *speed <= 0 {
+		flag.Usage()
+		os.Exit(2)
+	}
+	data, err := os.ReadFile(*exportPath)
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "read export:", err)
+		os.Exit(1)
+	}
+	var exp export
+	if err := json.Unmarshal(data, &exp); err != nil {
+		fmt.Fprintln(os.Stderr, "parse export:", err)
+		os.Exit(1)
+	}
+	if *chatID == 0 {
+		*chatID = exportChatID(exp)
+	}
+	messages := buildReplay(exp, *chatID, *speed, *maxGap)
+	if *limit > 0 && len(messages) > *limit {
+		messages = messages[:*limit]
+	}
+	if len(messages) == 0 {
+		fmt.Fprintln(os.Stderr, "no text messages in export")
+		os.Exit(1)
+	}
+
+	endpoint := strings.TrimRight(*baseURL, "/") + "/api/v1/process"
+	if *stream {
+		endpoint += "/stream"
+	}
+	span := messages[len(messages)-1].offset
+	fmt.Printf("replaying %d messages of chat %d at %gx (%s) to %s\n", len(messages), *chatID, *speed, span.Round(time.Second), endpoint)
+
+	client := &http.Client{
+		Timeout:   *timeout,
+		Transport: &http.Transport{MaxIdleConnsPerHost: *maxInFlight, MaxConnsPerHost: *maxInFlight},
+	}
+	results, elapsed := run(client, endpoint, messages, *maxInFlight)
+	report(os.Stdout, results, elapsed)
+}
+
+// exportChatID maps the export's chat id to the Bot API chat_id: supergroups and channels get the
+// -100 prefix, basic groups are negative, private chats are the user id.
+func exportChatID(exp export) int64 {
+	switch {
+	case strings.Contains(exp.Type, "supergroup"), strings.Contains(exp.Type, "channel"):
+		id, _ := strconv.ParseInt("-100"+strconv.FormatInt(exp.ID, 10), 10, 64)
+		return id
+	case exp.Type == "private_group":
+		return -exp.ID
+	default:
+		return exp.ID
+	}
+}
+
+// buildReplay turns the export's text messages into requests, oldest first, with their send offsets.
+func buildReplay(exp export, chatID int64, speed float64, maxGap time.Duration) []replayMessage {
+	var out []replayMessage
+	var prev time.Time
+	var offset time.Duration
+	for _, m := range exp.Messages {
+		if m.Type != "message" {
+			continue
+		}
+		text := messageText(m.Text)
+		if text == "" {
+			continue
+		}
+		sec, err := strconv.ParseInt(m.DateUnix, 10, 64)
+		if err != nil {
+			continue
+		}
+		at := time.Unix(sec, 0)
+		if prev.IsZero() {
+			prev = at
+		}
+		gap := time.Duration(float64(at.Sub(prev)) / speed)
+		if gap < 0 {
+			gap = 0
+		}
+		if maxGap > 0 && gap > maxGap {
+			gap = maxGap
+		}
+		offset += gap
+		prev = at
+
+		body := map[string]any{
+			"chat_id":    chatID,
+			"first_name": m.From,
+			"text":       text,
+			"message_id": m.ID,
+		}
+		if m.From == "" {
+			body["first_name"] = m.FromID
+		}
+		if userID, ok := strings.CutPrefix(m.FromID, "user"); ok {
+			if id, err := strconv.ParseInt(userID, 10, 64); err == nil {
+				body["user_id"] = id
+			}
+		}
+		if m.ReplyToMsgID != nil {
+			body["reply_to_message_id"] = *m.ReplyToMsgID
+		}
+		out = append(out, replayMessage{offset: offset, body: body})
+	}
+	return out
+}
+
+// messageText flattens the export's text field: a string, or an array of strings and entity objects.
+func messageText(raw json.RawMessage) string {
+	var s string
+	if json.Unmarshal(raw, &s) == nil {
+		return s
+	}
+	var parts []json.RawMessage
+	if json.Unmarshal(raw, &parts) != nil {
+		return ""
+	}
+	var b strings.Builder
+	for _, p := range parts {
+		var text string
+		if json.Unmarshal(p, &text) == nil {
+			b.WriteString(text)
+			continue
+		}
+		var entity struct {
+			Text string `json:"text"`
+		}
+		if json.Unmarshal(p, &entity) == nil {
+			b.WriteString(entity.Text)
+		}
+	}
+	return b.String()
+}
+
+// run sends every message at its offset and returns the results and the wall time of the run.
+func run(client *http.Client, endpoint string, messages []replayMessage, maxInFlight int) ([]result, time.Duration) {
+	results := make([]result, len(messages))
+	slots := make(chan struct{}, max(maxInFlight, 1))
+	var wg sync.WaitGroup
+	start := time.Now()
+	for i, m := range messages {
+		if wait := time.Until(start.Add(m.offset)); wait > 0 {
+			time.Sleep(wait)
+		}
+		slots <- struct{}{}
+		wg.Add(1)
+		go func(i int, m replayMessage) {
+			defer wg.Done()
+			defer func() { <-slots }()
+			m.body["date"] = time.Now().UTC().Format(time.RFC3339)
+			results[i] = send(client, endpoint, m.body)
+		}(i, m)
+	}
+	wg.Wait()
+	return results, time.Since(start)
+}
+
+func send(client *http.Client, endpoint string, body map[string]any) result {
+	payload, _ := json.Marshal(body)
+	req, _ := http.NewRequest(http.MethodPost, endpoint, bytes.NewReader(payload))
+	req.Header.Set("Content-Type", "application/json")
+	req.Header.Set("X-Request-ID", fmt.Sprintf("loadgen-%v-%d", body["message_id"], time.Now().UnixNano()))
+	start := time.Now()
+	resp, err := client.Do(req)
+	if err != nil {
+		return result{latency: time.Since(start), err: err}
+	}
+	// Latency is to the last byte, so a streamed reply counts in full
+	io.Copy(io.Discard, resp.Body)
+	resp.Body.Close()
+	return result{status: resp.StatusCode, latency: time.Since(start)}
+}
+
+// report prints status counts, throughput and latency percentiles.
+func report(w io.Writer, results []result, elapsed time.Duration) {
+	byStatus := map[string]int{}
+	var all, replied []time.Duration
+	for _, r := range results {
+		key := strconv.Itoa(r.status)
+		if r.err != nil {
+			key = "error"
+		}
+		byStatus[key]++
+		if r.err != nil {
+			continue
+		}
+		all = append(all, r.latency)
+		if r.status == http.StatusOK {
+			replied = append(replied, r.latency)
+		}
+	}
+	keys := make([]string, 0, len(byStatus))
+	for k := range byStatus {
+		keys = append(keys, k)
+	}
+	sort.Strings(keys)
+	fmt.Fprint(w, "status:")
+	for _, k := range keys {
+		fmt.Fprintf(w, " %s=%d", k, byStatus[k])
+	}
+	fmt.Fprintln(w)
+	secs := elapsed.Seconds()
+	fmt.Fprintf(w, "elapsed %s, %.1f req/s, %.1f replies/s\n", elapsed.Round(time.Millisecond), float64(len(results))/secs, float64(len(replied))/secs)
+	fmt.Fprintf(w, "all responses  %s\n", summarize(all))
+	fmt.Fprintf(w, "replies (200)  %s\n", summarize(replied))
+}
+
+// summarize formats count and p50/p90/p99/max of latencies.
+func summarize(latencies []time.Duration) string {
+	if len(latencies) == 0 {
+		return "n=0"
+	}
+	sorted := append([]time.Duration{}, latencies...)
+	sort.Slice(sorted, func(i, j int) bool { return sorted[i] < sorted[j] })
+	return fmt.Sprintf("n=%d p50=%s p90=%s p99=%s max=%s",
+		len(sorted),
+		percentile(sorted, 50).Round(time.Millisecond),
+		percentile(sorted, 90).Round(time.Millisecond),
+		percentile(sorted, 99).Round(time.Millisecond),
+		sorted[len(sorted)-1].Round(time.Millisecond))
+}
+
+// percentile returns the nearest-rank percentile p (0-100) of sorted latencies.
+func percentile(sorted []time.Duration, p float64) time.Duration {
+	if len(sorted) == 0 {
+		return 0
+	}
+	rank := int(float64(len(sorted))*p/100+0.999999) - 1
+	rank = max(0, min(rank, len(sorted)-1))
+	return sorted[rank]
+}
@@ -0,0 +1,49 @@
+package main
+
+import (
+	"encoding/json"
+	"testing"
+	"time"
+)
+
+func TestBuildReplay(t *testing.T) {
+	var exp export
+	err := json.Unmarshal([]byte(`{"id": 1234, "type": "public_supergroup", "messages": [
+		{"id": 1, "type": "message", "date_unixtime": "1000", "from": "Ann", "from_id": "user7", "text": "hi"},
+		{"id": 2, "type": "service", "date_unixtime": "1001", "text": "joined"},
+		{"id": 3, "type": "message", "date_unixtime": "1020", "from": "Bob", "from_id": "user8",
+		 "text": ["see ", {"type": "link", "text": "example.com"}], "reply_to_message_id": 1},
+		{"id": 4, "type": "message", "date_unixtime": "5000", "from": "Ann", "from_id": "user7", "text": ""},
+		{"id": 5, "type": "message", "date_unixtime": "9000", "from": "Ann", "from_id": "user7", "text": "back"}
+	]}`), &exp)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if got := exportChatID(exp); got != -1001234 {
+		t.Errorf("chat id = %d, want -1001234", got)
+	}
+
+	msgs := buildReplay(exp, -1001234, 10, time.Minute)
+	if len(msgs) != 3 {
+		t.Fatalf("got %d messages, want 3", len(msgs))
+	}
+	if msgs[1].body["text"] != "see example.com" || msgs[1].body["user_id"] != int64(8) || msgs[1].body["reply_to_message_id"] != int64(1) {
+		t.Errorf("second message body = %v", msgs[1].body)
+	}
+	// 20s at 10x is 2s; the 8000s gap is capped at a minute
+	if msgs[1].offset != 2*time.Second || msgs[2].offset != 62*time.Second {
+		t.Errorf("offsets = %s, %s", msgs[1].offset, msgs[2].offset)
+	}
+}
+
+func TestPercentile(t *testing.T) {
+	sorted := make([]time.Duration, 100)
+	for i := range sorted {
+		sorted[i] = time.Duration(i+1) * time.Millisecond
+	}
+	for p, want := range map[float64]time.Duration{50: 50 * time.Millisecond, 99: 99 * time.Millisecond, 100: 100 * time.Millisecond} {
+		if got := percentile(sorted, p); got != want {
+			t.Errorf("p%g = %s, want %s", p, got, want)
+		}
+	}
+}
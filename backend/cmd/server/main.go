@@ -15,6 +15,7 @@ import (
 	"github.com/ThatHunky/gryag/backend/internal/handler"
 	"github.com/ThatHunky/gryag/backend/internal/i18n"
 	"github.com/ThatHunky/gryag/backend/internal/llm"
+	"github.com/ThatHunky/gryag/backend/internal/metrics"
 	"github.com/ThatHunky/gryag/backend/internal/middleware"
 	"github.com/ThatHunky/gryag/backend/internal/proactive"
 	"github.com/ThatHunky/gryag/backend/internal/summarizer"
@@ -52,7 +53,13 @@ func main() {
 	slog.Info("i18n loaded", "languages", bundle.Languages())
 
 	// ── PostgreSQL ──────────────────────────────────────────────────────
-	database, err := db.New(cfg.PostgresDSN())
+	database, err := db.New(cfg.PostgresDSN(), db.PoolOptions{
+		MaxOpenConns:       cfg.DBMaxOpenConns,
+		MaxIdleConns:       cfg.DBMaxIdleConns,
+		ConnMaxLifetime:    time.Duration(cfg.DBConnMaxLifetimeMin) * time.Minute,
+		ConnMaxIdleTime:    time.Duration(cfg.DBConnMaxIdleTimeMin) * time.Minute,
+		PreparedStatements: cfg.DBPreparedStatements,
+	})
 	if err != nil {
 		slog.Error("failed to connect to postgres", "error", err)
 		os.Exit(1)
@@ -64,10 +71,34 @@ func main() {
 		slog.Error("failed to run migrations", "error", err)
 		os.Exit(1)
 	}
+	if cfg.EnableEmbeddings {
+		ready, err := database.EmbeddingSchemaReady(context.Background())
+		if err != nil || !ready {
+			// Migration 007 skipped the vector columns: pgvector was not installed when it ran
+			slog.Error("ENABLE_EMBEDDINGS requires the pgvector extension; install it, then run "+
+				"DELETE FROM schema_migrations WHERE version IN ('007_embeddings', '011_embedding_attempts') and restart",
+				"error", err)
+			os.Exit(1)
+		}
+	}
+
+	// ── In-process context cache (recent messages, summaries, facts) ────
+	if cfg.ContextCacheMaxChats > 0 {
+		database.EnableContextCache(cfg.ContextCacheMaxChats, cfg.ImmediateContextSize)
+	}
+
+	// ── Batched message log writer ──────────────────────────────────────
+	if cfg.MessageWriteBatchSize > 0 {
+		database.EnableMessageWriter(cfg.MessageWriteBatchSize, cfg.MessageWriteFlushInterval(), cfg.MessageWriteQueueSize)
+	}
 
-	// ── Message Retention Cleanup ───────────────────────────────────────
-	if _, err := database.PruneOldMessages(context.Background(), cfg.MessageRetentionDays); err != nil {
-		slog.Warn("message retention cleanup failed", "error", err)
+	// ── Message Partitions & Retention (periodic) ───────────────────────
+	go database.RunMessageMaintenance(context.Background(), cfg.MessageRetentionDays, cfg.MessageMaintenanceInterval())
+
+	// ── Media store (generated images, content-addressed) & expiry sweeper ─
+	if cfg.MediaCacheDir != "" {
+		database.EnableMediaStore(cfg.MediaCacheDir, int64(cfg.MediaCacheMemoryMB)<<20)
+		go database.RunMediaSweeper(context.Background(), cfg.MediaSweepInterval(), cfg.MediaSweepBatchSize)
 	}
 
 	// ── Redis ───────────────────────────────────────────────────────────
@@ -88,16 +119,44 @@ func main() {
 	// ── Tool Registry & Executor ────────────────────────────────────────
 	registry := tools.NewRegistry(cfg)
 	executor := tools.NewExecutor(cfg, database, bundle, llmClient)
+	executor.StartSandboxPool()
+	defer executor.Close()
 	slog.Info("tools loaded", "count", registry.Count(), "names", registry.GetToolNames())
 
+	// ── Static prompt prefix (persona + tools), optionally Gemini-cached ─
+	llmClient.SetTools(registry.GetTools(), registry.GetToolDescription())
+	if cfg.GeminiContextCache {
+		go llmClient.RunPrefixCache(context.Background())
+		slog.Info("gemini prefix cache started", "ttl", cfg.GeminiContextCacheTTL())
+	}
+	if cfg.EnableEmbeddings {
+		go llmClient.RunEmbeddingIndexer(context.Background(), database)
+		slog.Info("embedding indexer started", "model", cfg.EmbeddingModel)
+	}
+
 	// ── Request Handler ─────────────────────────────────────────────────
 	h := handler.New(cfg, database, redisCache, llmClient, registry, executor, bundle)
 
 	// ── Rate Limiter Middleware ──────────────────────────────────────────
 	rateLimiter := middleware.NewRateLimiter(redisCache, database, cfg)
 
+	// ── Summarization (optional; 3 AM Kyiv, 7-day every 3 days, 30-day every 12 days) ──
+	// The scheduler stops at shutdown, cancelling a batch job it is waiting on (main waits for that).
+	summarizerCtx, stopSummarizer := context.WithCancel(context.Background())
+	defer stopSummarizer()
+	summarizerDone := make(chan struct{})
+	var summarizerRunner *summarizer.Runner
+	if cfg.EnableSummarization {
+		summarizerRunner = summarizer.NewRunner(database, redisCache, llmClient, cfg)
+		go func() {
+			defer close(summarizerDone)
+			summarizer.Scheduler(summarizerCtx, summarizerRunner, cfg)
+		}()
+		slog.Info("summarization started", "run_hour_kyiv", cfg.SummaryRunHour, "7day_interval_days", cfg.Summary7DayIntervalDays, "30day_interval_days", cfg.Summary30DayIntervalDays, "workers", cfg.SummaryWorkers)
+	}
+
 	// ── Admin Handler ───────────────────────────────────────────────────
-	adminH := handler.NewAdminHandler(cfg, database)
+	adminH := handler.NewAdminHandler(cfg, database, llmClient, executor, summarizerRunner)
 
 	// ── Proactive messaging (optional) ───────────────────────────────────
 	if cfg.EnableProactiveMessaging {
@@ -106,21 +165,38 @@ func main() {
 		slog.Info("proactive messaging started", "active_hours_start", cfg.ProactiveActiveStartHour, "active_hours_end", cfg.ProactiveActiveEndHour)
 	}
 
-	// ── Summarization (optional; 3 AM Kyiv, 7-day every 3 days, 30-day every 12 days) ──
-	if cfg.EnableSummarization {
-		summarizerRunner := summarizer.NewRunner(database, redisCache, llmClient, cfg)
-		go summarizer.Scheduler(context.Background(), summarizerRunner, cfg)
-		slog.Info("summarization started", "run_hour_kyiv", cfg.SummaryRunHour, "7day_interval_days", cfg.Summary7DayIntervalDays, "30day_interval_days", cfg.Summary30DayIntervalDays)
-	}
-
 	// ── HTTP Mux ────────────────────────────────────────────────────────
 	mux := http.NewServeMux()
 	mux.HandleFunc("GET /health", handler.HealthCheck)
-	mux.Handle("POST /api/v1/process", rateLimiter.Middleware(http.HandlerFunc(h.Process)))
-	mux.HandleFunc("POST /api/v1/admin/stats", adminH.Stats)
-	mux.HandleFunc("POST /api/v1/admin/reload_persona", adminH.ReloadPersona)
+	mux.Handle("GET /metrics", metrics.Handler())
+	mux.Handle("POST /api/v1/process", metrics.Instrument("process", rateLimiter.Middleware(http.HandlerFunc(h.Process))))
+	mux.Handle("POST /api/v1/process/stream", metrics.Instrument("process_stream", rateLimiter.Middleware(http.HandlerFunc(h.ProcessStream))))
+	mux.Handle("GET /api/v1/media/{media_id}", metrics.Instrument("media", http.HandlerFunc(h.Media)))
+	mux.Handle("POST /api/v1/admin/stats", metrics.Instrument("admin_stats", http.HandlerFunc(adminH.Stats)))
+	mux.Handle("POST /api/v1/admin/reload_persona", metrics.Instrument("admin_reload_persona", http.HandlerFunc(adminH.ReloadPersona)))
 	if cfg.EnableProactiveMessaging {
-		mux.HandleFunc("GET /api/v1/proactive", h.Proactive)
+		mux.Handle("GET /api/v1/proactive", metrics.Instrument("proactive", http.HandlerFunc(h.Proactive)))
+		mux.HandleFunc("GET /api/v1/proactive/stream", h.ProactiveStream) // long-lived; latency is not meaningful
+	}
+
+	// ── Metrics: queue depths, read at scrape time ──────────────────────
+	metrics.Default.OnScrape(func() {
+		if writerStats, ok := database.MessageWriterStats(); ok {
+			metrics.QueueDepth.With("message_writer").Set(float64(writerStats.Backlog))
+		}
+		metrics.QueueDepth.With("turn_queue").Set(float64(h.TurnQueueDepth()))
+		if cfg.EnableProactiveMessaging {
+			ctx, cancel := context.WithTimeout(context.Background(), time.Second)
+			defer cancel()
+			if n, err := redisCache.ProactiveQueueLen(ctx); err == nil {
+				metrics.QueueDepth.With("proactive").Set(float64(n))
+			}
+		}
+	})
+
+	// ── pprof on a separate admin listener (optional) ───────────────────
+	if cfg.PprofAddr != "" {
+		go servePprof(cfg.PprofAddr)
 	}
 
 	// ── Server with Graceful Shutdown ────────────────────────────────────
@@ -132,6 +208,7 @@ func main() {
 		WriteTimeout: 120 * time.Second,
 		IdleTimeout:  120 * time.Second,
 	}
+	server.RegisterOnShutdown(h.StopProactiveStreams)
 
 	// Start server in a goroutine
 	go func() {
@@ -147,6 +224,7 @@ func main() {
 	signal.Notify(quit, syscall.SIGINT, syscall.SIGTERM)
 	sig := <-quit
 	slog.Info("shutting down", "signal", sig.String())
+	stopSummarizer()
 
 	ctx, cancel := context.WithTimeout(context.Background(), 30*time.Second)
 	defer cancel()
@@ -154,6 +232,17 @@ func main() {
 	if err := server.Shutdown(ctx); err != nil {
 		slog.Error("server forced shutdown", "error", err)
 	}
+	// Requests are done; write the messages still queued before the pool closes.
+	if err := database.CloseMessageWriter(ctx); err != nil {
+		slog.Error("message writer did not drain", "error", err)
+	}
+	if cfg.EnableSummarization {
+		select {
+		case <-summarizerDone:
+		case <-ctx.Done():
+			slog.Error("summarizer did not stop", "error", ctx.Err())
+		}
+	}
 
 	slog.Info("server stopped")
 }
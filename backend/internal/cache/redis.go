@@ -3,9 +3,9 @@ package cache
 import (
 	"context"
 	"encoding/json"
+	"errors"
 	"fmt"
 	"log/slog"
-	"strconv"
 	"time"
 
 	"github.com/redis/go-redis/v9"
@@ -26,6 +26,8 @@ func New(addr, password string) (*Cache, error) {
 		DB:       0,
 	})
 
+	client.AddHook(metricsHook{})
+
 	ctx, cancel := context.WithTimeout(context.Background(), 5*time.Second)
 	defer cancel()
 
@@ -47,95 +49,100 @@ func (c *Cache) Client() *redis.Client {
 	return c.client
 }
 
-// ── Sliding Window Rate Limiter (Section 10) ────────────────────────────
+// ── GCRA Rate Limiter (Section 10) ─────────────────────────────────────
+//
+// Each bucket is one string key holding its theoretical arrival time (TAT, ms) and expiring once the
+// bucket is full again, so memory per key is constant regardless of traffic. A bucket allows `limit`
+// requests per `window` with bursts of up to `limit`.
+
+// gcraLua defines the bucket check used by admitScript. gcra(key, now, limit, period) returns
+// allowed (0/1), the new TAT to store when allowed, remaining, and retry-after in ms when denied.
+const gcraLua = `
+local function gcra(key, now, limit, period)
+	local interval = period / limit
+	local tat = tonumber(redis.call('GET', key) or now)
+	if tat < now then tat = now end
+	local new_tat = tat + interval
+	local allow_at = new_tat - period
+	if now < allow_at then
+		return 0, tat, 0, math.ceil(allow_at - now)
+	end
+	return 1, new_tat, math.floor((period - (new_tat - now)) / interval), 0
+end
+`
+
+// ── Admission (chat + user rate limits in one round-trip) ───────────────
+
+// AdmitStatus is the outcome of Admit.
+type AdmitStatus int
+
+const (
+	AdmitAllowed       AdmitStatus = iota // both limits passed and were consumed
+	AdmitChatThrottled                    // chat limit exceeded; nothing consumed
+	AdmitUserThrottled                    // user limit exceeded; nothing consumed
+)
 
-// RateLimitResult holds the outcome of a rate limit check.
-type RateLimitResult struct {
-	Allowed   bool
-	Remaining int
-	RetryIn   time.Duration
+// AdmitResult holds the outcome of an admission check.
+type AdmitResult struct {
+	Status  AdmitStatus
+	RetryIn time.Duration // for throttled statuses: when the exceeded bucket admits again
 }
 
-// CheckRateLimit implements a sliding window rate limiter using Redis sorted sets.
-// key: the rate limit bucket (e.g., "rl:chat:12345" or "rl:user:67890")
-// limit: max allowed requests in the window
-// window: the sliding window duration
-func (c *Cache) CheckRateLimit(ctx context.Context, key string, limit int, window time.Duration) (*RateLimitResult, error) {
-	now := time.Now()
-	nowMs := now.UnixMilli()
-	windowStartMs := now.Add(-window).UnixMilli()
-
-	// Use a pipeline for atomicity
-	pipe := c.client.Pipeline()
-
-	// Remove expired entries outside the window
-	pipe.ZRemRangeByScore(ctx, key, "-inf", strconv.FormatInt(windowStartMs, 10))
-
-	// Count current entries in the window
-	countCmd := pipe.ZCard(ctx, key)
-
-	// Add the current request
-	pipe.ZAdd(ctx, key, redis.Z{
-		Score:  float64(nowMs),
-		Member: strconv.FormatInt(nowMs, 10),
-	})
-
-	// Set TTL on the key to auto-cleanup
-	pipe.Expire(ctx, key, window+time.Second)
-
-	_, err := pipe.Exec(ctx)
-	if err != nil {
-		return nil, fmt.Errorf("rate limit check: %w", err)
-	}
-
-	count := int(countCmd.Val())
-
-	if count >= limit {
-		// Find the oldest entry to calculate retry time
-		oldest, err := c.client.ZRangeWithScores(ctx, key, 0, 0).Result()
-		if err != nil || len(oldest) == 0 {
-			return &RateLimitResult{Allowed: false, Remaining: 0, RetryIn: window}, nil
-		}
-		oldestMs := int64(oldest[0].Score)
-		retryIn := time.Duration(oldestMs+window.Milliseconds()-nowMs) * time.Millisecond
-		if retryIn < 0 {
-			retryIn = time.Second
-		}
-
-		// Remove the entry we just added since we're denying
-		c.client.ZRem(ctx, key, strconv.FormatInt(nowMs, 10))
-
-		return &RateLimitResult{
-			Allowed:   false,
-			Remaining: 0,
-			RetryIn:   retryIn,
-		}, nil
-	}
+// AdmitRequest describes one incoming message for Admit. UserID nil skips the per-user limit.
+type AdmitRequest struct {
+	ChatID    int64
+	UserID    *int64
+	ChatLimit int // per window; <= 0 = no limit
+	UserLimit int // per window; <= 0 = no limit
+	Window    time.Duration
+}
 
-	return &RateLimitResult{
-		Allowed:   true,
-		Remaining: limit - count - 1,
-	}, nil
+// admitScript: KEYS[1]=chat bucket, KEYS[2]=user bucket (or ""); ARGV=now_ms, chat_limit, user_limit, window_ms.
+// Both buckets are checked before either is consumed. Returns {status, retry_ms} with status as in AdmitStatus.
+var admitScript = redis.NewScript(gcraLua + `
+local now, chat_limit, user_limit, period = tonumber(ARGV[1]), tonumber(ARGV[2]), tonumber(ARGV[3]), tonumber(ARGV[4])
+local ok, remaining, retry, chat_tat, user_tat
+if chat_limit > 0 then
+	ok, chat_tat, remaining, retry = gcra(KEYS[1], now, chat_limit, period)
+	if ok == 0 then return {1, retry} end
+end
+if KEYS[2] ~= '' and user_limit > 0 then
+	ok, user_tat, remaining, retry = gcra(KEYS[2], now, user_limit, period)
+	if ok == 0 then return {2, retry} end
+end
+if chat_tat then redis.call('SET', KEYS[1], chat_tat, 'PX', math.ceil(chat_tat - now) + 1) end
+if user_tat then redis.call('SET', KEYS[2], user_tat, 'PX', math.ceil(user_tat - now) + 1) end
+return {0, 0}
+`)
+
+// Bucket keys carry a "gcra" segment: the sliding-window limiter this replaced kept sorted sets under
+// rl:chat:* and rl:user:*, and GET on those returns WRONGTYPE, which would fail every admission open
+// until they expired.
+func chatBucketKey(chatID int64) string { return fmt.Sprintf("rl:gcra:chat:%d", chatID) }
+
+func userBucketKey(chatID, userID int64) string {
+	return fmt.Sprintf("rl:gcra:user:%d:%d", chatID, userID)
 }
 
-// ── Queue Lock (Exclusive Processing per chat, Section 10) ──────────────
+// Admit checks the chat and user rate limits atomically, in a single round-trip. Per-chat exclusive
+// processing is handled by the backend's in-process turn queue.
+func (c *Cache) Admit(ctx context.Context, req AdmitRequest) (*AdmitResult, error) {
+	userKey := ""
+	if req.UserID != nil {
+		userKey = userBucketKey(req.ChatID, *req.UserID)
+	}
+	keys := []string{chatBucketKey(req.ChatID), userKey}
 
-// AcquireLock attempts to acquire an exclusive processing lock for a chat.
-// Returns true if the lock was acquired, false if another request is already being processed.
-func (c *Cache) AcquireLock(ctx context.Context, chatID int64, ttl time.Duration) (bool, error) {
-	key := fmt.Sprintf("lock:chat:%d", chatID)
-	ok, err := c.client.SetNX(ctx, key, "locked", ttl).Result()
+	res, err := admitScript.Run(ctx, c.client, keys,
+		time.Now().UnixMilli(), req.ChatLimit, req.UserLimit, req.Window.Milliseconds(),
+	).Int64Slice()
 	if err != nil {
-		return false, fmt.Errorf("acquire lock: %w", err)
+		return nil, fmt.Errorf("admit: %w", err)
 	}
-	return ok, nil
-}
-
-// ReleaseLock releases the exclusive processing lock for a chat.
-func (c *Cache) ReleaseLock(ctx context.Context, chatID int64) error {
-	key := fmt.Sprintf("lock:chat:%d", chatID)
-	return c.client.Del(ctx, key).Err()
-
+	if len(res) != 2 {
+		return nil, fmt.Errorf("admit: unexpected script reply %v", res)
+	}
+	return &AdmitResult{Status: AdmitStatus(res[0]), RetryIn: time.Duration(res[1]) * time.Millisecond}, nil
 }
 
 // ── Proactive message queue ─────────────────────────────────────────────
@@ -167,3 +174,57 @@ func (c *Cache) PopProactive(ctx context.Context, timeout time.Duration) (chatID
 	}
 	return item.ChatID, item.Reply, true
 }
+
+// PopProactiveBatch blocks up to timeout for the first item, then takes whatever else is queued behind
+// it, up to max items in all, oldest first. The queue is FIFO (LPUSH, RPOP), so items for one chat come
+// out in the order the runner pushed them. Returns nil with no error when the queue stayed empty.
+func (c *Cache) PopProactiveBatch(ctx context.Context, timeout time.Duration, max int) ([]ProactiveItem, error) {
+	result, err := c.client.BRPop(ctx, timeout, proactiveQueueKey).Result()
+	if errors.Is(err, redis.Nil) {
+		return nil, nil
+	}
+	if err != nil {
+		return nil, err
+	}
+	raw := result[1:]
+	if max > 1 {
+		more, err := c.client.RPopCount(ctx, proactiveQueueKey, max-1).Result()
+		if err != nil && !errors.Is(err, redis.Nil) {
+			slog.Warn("proactive batch pop failed", "error", err)
+		}
+		raw = append(raw, more...)
+	}
+	items := make([]ProactiveItem, 0, len(raw))
+	for _, s := range raw {
+		var item ProactiveItem
+		if err := json.Unmarshal([]byte(s), &item); err != nil {
+			slog.Warn("dropping malformed proactive item", "error", err)
+			continue
+		}
+		items = append(items, item)
+	}
+	return items, nil
+}
+
+// ProactiveQueueLen returns the number of queued proactive messages.
+func (c *Cache) ProactiveQueueLen(ctx context.Context) (int64, error) {
+	return c.client.LLen(ctx, proactiveQueueKey).Result()
+}
+
+// RequeueProactive puts popped items that could not be delivered back at the head of the queue, in
+// their original order, so they are the next ones popped.
+func (c *Cache) RequeueProactive(ctx context.Context, items []ProactiveItem) error {
+	if len(items) == 0 {
+		return nil
+	}
+	// RPUSH appends in argument order and RPOP takes from the tail, so push the oldest last
+	values := make([]any, 0, len(items))
+	for i := len(items) - 1; i >= 0; i-- {
+		b, err := json.Marshal(items[i])
+		if err != nil {
+			return err
+		}
+		values = append(values, string(b))
+	}
+	return c.client.RPush(ctx, proactiveQueueKey, values...).Err()
+}
@@ -9,7 +9,7 @@ import (
 
 // These tests require a running Redis instance.
 // Skip if REDIS_TEST_ADDR is not set (e.g., in CI without Redis).
-func getTestCache(t *testing.T) *Cache {
+func getTestCache(t testing.TB) *Cache {
 	t.Helper()
 	addr := os.Getenv("REDIS_TEST_ADDR")
 	if addr == "" {
@@ -23,90 +23,85 @@ func getTestCache(t *testing.T) *Cache {
 	return c
 }
 
-func TestCheckRateLimit_AllowsUnderLimit(t *testing.T) {
+func TestAdmit_ChecksBothLimitsAtomically(t *testing.T) {
 	c := getTestCache(t)
 	ctx := context.Background()
-	key := "test:rl:under:" + t.Name()
-	defer c.Client().Del(ctx, key)
+	chatID, userID := int64(99998), int64(42)
+	keys := []string{chatBucketKey(99998), userBucketKey(99998, 42)}
+	c.Client().Del(ctx, keys...)
+	defer c.Client().Del(ctx, keys...)
 
-	result, err := c.CheckRateLimit(ctx, key, 5, time.Minute)
-	if err != nil {
-		t.Fatalf("unexpected error: %v", err)
-	}
-	if !result.Allowed {
-		t.Error("expected request to be allowed")
-	}
-	if result.Remaining != 4 {
-		t.Errorf("expected 4 remaining, got %d", result.Remaining)
-	}
-}
-
-func TestCheckRateLimit_BlocksOverLimit(t *testing.T) {
-	c := getTestCache(t)
-	ctx := context.Background()
-	key := "test:rl:over:" + t.Name()
-	defer c.Client().Del(ctx, key)
+	req := AdmitRequest{ChatID: chatID, UserID: &userID, ChatLimit: 10, UserLimit: 2, Window: time.Minute}
 
-	// Fill up the limit
-	for i := 0; i < 3; i++ {
-		result, err := c.CheckRateLimit(ctx, key, 3, time.Minute)
+	for i := 0; i < 2; i++ {
+		res, err := c.Admit(ctx, req)
 		if err != nil {
 			t.Fatalf("request %d: unexpected error: %v", i, err)
 		}
-		if !result.Allowed {
-			t.Fatalf("request %d: expected to be allowed", i)
+		if res.Status != AdmitAllowed {
+			t.Fatalf("request %d: expected AdmitAllowed, got %v", i, res.Status)
 		}
 	}
 
-	// 4th request should be blocked
-	result, err := c.CheckRateLimit(ctx, key, 3, time.Minute)
+	// User limit (2/min) is now exhausted
+	res, err := c.Admit(ctx, req)
 	if err != nil {
 		t.Fatalf("unexpected error: %v", err)
 	}
-	if result.Allowed {
-		t.Error("expected request to be blocked")
+	if res.Status != AdmitUserThrottled || res.RetryIn <= 0 {
+		t.Errorf("expected AdmitUserThrottled with positive RetryIn, got %+v", res)
 	}
-	if result.Remaining != 0 {
-		t.Errorf("expected 0 remaining, got %d", result.Remaining)
+	if ttl := c.Client().PTTL(ctx, userBucketKey(99998, 42)).Val(); ttl <= 0 || ttl > time.Minute+time.Second {
+		t.Errorf("expected bucket key to expire within the window, got ttl %v", ttl)
 	}
-	if result.RetryIn <= 0 {
-		t.Error("expected positive RetryIn")
+
+	// The denied request must not have consumed the chat bucket: 8 more chat requests still fit
+	other := int64(43)
+	defer c.Client().Del(ctx, userBucketKey(99998, 43))
+	for i := 0; i < 8; i++ {
+		res, err := c.Admit(ctx, AdmitRequest{ChatID: chatID, UserID: &other, ChatLimit: 10, UserLimit: 10, Window: time.Minute})
+		if err != nil {
+			t.Fatalf("unexpected error: %v", err)
+		}
+		if res.Status != AdmitAllowed {
+			t.Fatalf("chat request %d: expected AdmitAllowed, got %v", i, res.Status)
+		}
 	}
 }
 
-func TestAcquireLock_ExclusiveProcessing(t *testing.T) {
+func TestAdmit_NonPositiveLimitIsUnlimited(t *testing.T) {
 	c := getTestCache(t)
 	ctx := context.Background()
-	chatID := int64(99999)
-	defer c.Client().Del(ctx, "lock:chat:99999")
+	userID := int64(42)
+	req := AdmitRequest{ChatID: 99997, UserID: &userID, ChatLimit: 0, UserLimit: -1, Window: time.Minute}
+	defer c.Client().Del(ctx, chatBucketKey(req.ChatID), userBucketKey(req.ChatID, userID))
 
-	// First lock should succeed
-	ok, err := c.AcquireLock(ctx, chatID, 30*time.Second)
-	if err != nil {
-		t.Fatalf("unexpected error: %v", err)
-	}
-	if !ok {
-		t.Error("expected lock to be acquired")
+	for i := 0; i < 20; i++ {
+		res, err := c.Admit(ctx, req)
+		if err != nil {
+			t.Fatalf("request %d: unexpected error: %v", i, err)
+		}
+		if res.Status != AdmitAllowed {
+			t.Fatalf("request %d: expected AdmitAllowed, got %v", i, res.Status)
+		}
 	}
+}
 
-	// Second lock should fail (already locked)
-	ok2, err := c.AcquireLock(ctx, chatID, 30*time.Second)
-	if err != nil {
-		t.Fatalf("unexpected error: %v", err)
-	}
-	if ok2 {
-		t.Error("expected lock to be denied (already locked)")
-	}
+// Run with: go test -run '^$' -bench . ./internal/cache (against the bench compose stack's Redis).
+func BenchmarkAdmit(b *testing.B) {
+	c := getTestCache(b)
+	ctx := context.Background()
+	userID := int64(42)
+	req := AdmitRequest{ChatID: -987654321, UserID: &userID, ChatLimit: 1 << 30, UserLimit: 1 << 30, Window: time.Minute}
+	defer c.Client().Del(ctx, chatBucketKey(req.ChatID), userBucketKey(req.ChatID, userID))
 
-	// Release and re-acquire
-	if err := c.ReleaseLock(ctx, chatID); err != nil {
-		t.Fatalf("release error: %v", err)
-	}
-	ok3, err := c.AcquireLock(ctx, chatID, 30*time.Second)
-	if err != nil {
-		t.Fatalf("unexpected error: %v", err)
-	}
-	if !ok3 {
-		t.Error("expected lock to be acquired after release")
-	}
+	b.ResetTimer()
+	b.RunParallel(func(pb *testing.PB) {
+		for pb.Next() {
+			if _, err := c.Admit(ctx, req); err != nil {
+				b.Error(err)
+				return
+			}
+		}
+	})
 }
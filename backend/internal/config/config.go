@@ -5,6 +5,7 @@ import (
 	"os"
 	"strconv"
 	"strings"
+	"time"
 )
 
 // Config holds all application configuration parsed from environment variables.
@@ -17,9 +18,12 @@ type Config struct {
 	// Gemini
 	GeminiAPIKey             string
 	GeminiModel              string
+	GeminiBaseURL            string // API endpoint override (e.g. the fake Gemini server for load tests)
 	GeminiTemperature        float64
 	GeminiRoutingTemperature float64
 	GeminiThinkingBudget     int
+	GeminiContextCache       bool // cache persona + tool declarations as Gemini cached content
+	GeminiContextCacheTTLMin int
 
 	// OpenAI (Optional)
 	OpenAIAPIKey string
@@ -32,6 +36,13 @@ type Config struct {
 	PostgresPassword string
 	PostgresDB       string
 
+	// PostgreSQL connection pool
+	DBMaxOpenConns       int
+	DBMaxIdleConns       int
+	DBConnMaxLifetimeMin int
+	DBConnMaxIdleTimeMin int
+	DBPreparedStatements bool
+
 	// Redis
 	RedisHost     string
 	RedisPort     int
@@ -40,6 +51,7 @@ type Config struct {
 	// Backend Server
 	BackendHost string
 	BackendPort int
+	PprofAddr   string // admin listener for net/http/pprof (empty = off)
 
 	// Feature Toggles
 	EnableSandbox           bool
@@ -54,13 +66,24 @@ type Config struct {
 	RateLimitImagePerDay     int
 	RateLimitSandboxPerDay   int
 
+	// Tool calls of one model turn run concurrently, up to this many at once
+	ToolMaxParallel int
+
+	// Image generation concurrency (process-wide)
+	ImageGenMaxConcurrent   int
+	ImageGenQueueTimeoutSec int
+
 	// Sandbox
 	SandboxTimeoutSeconds int
 	SandboxMaxMemoryMB    int
+	SandboxPoolSize       int // pre-started containers; 0 = one-shot docker run per call
+	SandboxPoolMaxRuns    int // runs per container before it is recycled
+	SandboxPoolWaitMS     int // wait for a free warm container before falling back to one-shot
 
 	// Proactive Messaging (Kyiv time)
 	ProactiveActiveStartHour int // 0-23, inclusive
 	ProactiveActiveEndHour   int // 0-23, exclusive (e.g. 9-22 means 09:00–21:59)
+	ProactiveQuietMin        int // idle minutes before a chat counts as quiet for a proactive turn
 
 	// Summarization (3 AM Kyiv; 7-day every 3 days, 30-day every 12 days)
 	EnableSummarization       bool
@@ -68,17 +91,58 @@ type Config struct {
 	Summary7DayIntervalDays   int
 	Summary30DayIntervalDays  int
 	SummaryMaxMessagesPerWindow int
+	SummaryInputTokenBudget     int // estimated tokens of the chat log per summarization call (0 = unlimited)
+	SummaryWorkers              int // chats summarized concurrently
+	SummaryMaxRPM               int // Gemini requests per minute for summarization (0 = unlimited)
+	SummaryMaxTPM               int // estimated input tokens per minute for summarization (0 = unlimited)
+	SummaryBatchMode            bool // submit summaries as Gemini Batch API jobs
+	SummaryBatchMinChats        int  // smaller runs use the synchronous path
+	SummaryBatchPollSec         int
 
 	// Context Window
 	ImmediateContextSize int
 	MediaBufferMax       int
+	ContextCacheMaxChats int // in-process context cache size (chats); 0 = disabled
+	ContextStageTimeoutMS int // deadline per optional context lookup (facts, summaries); 0 = none
+	PromptLayout          string // "sections" (Section 8 order) or "stable_prefix" (static-to-volatile)
+	ContextTokenBudget    int    // estimated tokens of the dynamic prompt blocks; 0 = unlimited
+
+	// Batched message log writer (0 batch size = synchronous single-row INSERTs)
+	MessageWriteBatchSize int
+	MessageWriteFlushMS   int
+	MessageWriteQueueSize int
+
+	// Per-chat turn queue: messages arriving during a generation are coalesced into one follow-up turn
+	CoalesceDebounceMS int
+	CoalesceMaxWaitMS  int
+	CoalesceMaxBatch   int
+	CoalesceMaxPending int // messages waiting per chat; more are answered at once with 204
+	TurnTimeoutSec     int // bound on one generation turn, independent of the requests waiting for it
+
+	// Semantic memory (pgvector embeddings of user facts and messages)
+	EnableEmbeddings     bool
+	EmbeddingModel       string
+	EmbeddingBatchSize   int
+	EmbeddingPollMS      int
+	UserFactsTopK        int
+	UserFactsTokenBudget int // prompt budget for the user facts block (0 = unlimited)
 
 	// Data Retention
-	MessageRetentionDays int
+	MessageRetentionDays            int
+	MessageMaintenanceIntervalHours int
+
+	// Max attachment size (bytes) accepted from the frontend
+	MediaMaxBytes int
+	// Attachments of at least this size go through the Gemini Files API instead of inline (0 = never)
+	MediaUploadMinBytes   int
+	MediaUploadTimeoutSec int
 
 	// Media cache (generated images for edit by media_id)
-	MediaCacheDir      string
-	MediaCacheTTLHours int
+	MediaCacheDir         string
+	MediaCacheTTLHours    int
+	MediaCacheMemoryMB    int // hot images kept in memory (0 = none)
+	MediaSweepIntervalMin int // how often expired images are deleted (0 = never)
+	MediaSweepBatchSize   int
 
 	// Persona
 	PersonaFile string
@@ -104,9 +168,12 @@ func Load() (*Config, error) {
 		// Gemini
 		GeminiAPIKey:             getEnv("GEMINI_API_KEY", ""),
 		GeminiModel:              getEnv("GEMINI_MODEL", "gemini-2.5-flash"),
+		GeminiBaseURL:            getEnv("GEMINI_BASE_URL", ""),
 		GeminiTemperature:        getEnvFloat("GEMINI_TEMPERATURE", 0.9),
 		GeminiRoutingTemperature: getEnvFloat("GEMINI_ROUTING_TEMPERATURE", 0.0),
 		GeminiThinkingBudget:     getEnvInt("GEMINI_THINKING_BUDGET", 0),
+		GeminiContextCache:       getEnvBool("GEMINI_CONTEXT_CACHE", true),
+		GeminiContextCacheTTLMin: getEnvInt("GEMINI_CONTEXT_CACHE_TTL_MINUTES", 60),
 
 		// OpenAI
 		OpenAIAPIKey: getEnv("OPENAI_API_KEY", ""),
@@ -119,6 +186,12 @@ func Load() (*Config, error) {
 		PostgresPassword: getEnv("POSTGRES_PASSWORD", "changeme_in_production"),
 		PostgresDB:       getEnv("POSTGRES_DB", "gryag"),
 
+		DBMaxOpenConns:       getEnvInt("DB_MAX_OPEN_CONNS", 25),
+		DBMaxIdleConns:       getEnvInt("DB_MAX_IDLE_CONNS", 5),
+		DBConnMaxLifetimeMin: getEnvInt("DB_CONN_MAX_LIFETIME_MINUTES", 5),
+		DBConnMaxIdleTimeMin: getEnvInt("DB_CONN_MAX_IDLE_TIME_MINUTES", 0),
+		DBPreparedStatements: getEnvBool("DB_PREPARED_STATEMENTS", true),
+
 		// Redis
 		RedisHost:     getEnv("REDIS_HOST", "gryag-redis"),
 		RedisPort:     getEnvInt("REDIS_PORT", 6379),
@@ -127,6 +200,7 @@ func Load() (*Config, error) {
 		// Backend Server
 		BackendHost: getEnv("BACKEND_HOST", "0.0.0.0"),
 		BackendPort: getEnvInt("BACKEND_PORT", 27710),
+		PprofAddr:   getEnv("PPROF_ADDR", ""),
 
 		// Feature Toggles
 		EnableSandbox:           getEnvBool("ENABLE_SANDBOX", true),
@@ -141,13 +215,23 @@ func Load() (*Config, error) {
 		RateLimitImagePerDay:     getEnvInt("RATE_LIMIT_IMAGE_PER_DAY", 5),
 		RateLimitSandboxPerDay:   getEnvInt("RATE_LIMIT_SANDBOX_PER_DAY", 20),
 
+		ToolMaxParallel: getEnvInt("TOOL_MAX_PARALLEL", 4),
+
+		// Image generation concurrency
+		ImageGenMaxConcurrent:   getEnvInt("IMAGE_GEN_MAX_CONCURRENT", 2),
+		ImageGenQueueTimeoutSec: getEnvInt("IMAGE_GEN_QUEUE_TIMEOUT_SECONDS", 30),
+
 		// Sandbox
 		SandboxTimeoutSeconds: getEnvInt("SANDBOX_TIMEOUT_SECONDS", 5),
 		SandboxMaxMemoryMB:    getEnvInt("SANDBOX_MAX_MEMORY_MB", 128),
+		SandboxPoolSize:       getEnvInt("SANDBOX_POOL_SIZE", 2),
+		SandboxPoolMaxRuns:    getEnvInt("SANDBOX_POOL_MAX_RUNS", 10),
+		SandboxPoolWaitMS:     getEnvInt("SANDBOX_POOL_WAIT_MS", 2000),
 
 		// Proactive Messaging (active hours in Kyiv time; parsed below)
 		ProactiveActiveStartHour: 9,
 		ProactiveActiveEndHour:   22,
+		ProactiveQuietMin:        getEnvInt("PROACTIVE_QUIET_MIN", 60),
 
 		// Summarization (3 AM Kyiv; 7-day every 3 days, 30-day every 12 days)
 		EnableSummarization:         getEnvBool("ENABLE_SUMMARIZATION", false),
@@ -155,17 +239,54 @@ func Load() (*Config, error) {
 		Summary7DayIntervalDays:     getEnvInt("SUMMARY_7DAY_INTERVAL_DAYS", 3),
 		Summary30DayIntervalDays:    getEnvInt("SUMMARY_30DAY_INTERVAL_DAYS", 12),
 		SummaryMaxMessagesPerWindow: getEnvInt("SUMMARY_MAX_MESSAGES_PER_WINDOW", 2000),
+		SummaryInputTokenBudget:     getEnvInt("SUMMARY_INPUT_TOKEN_BUDGET", 25_000),
+		SummaryWorkers:              getEnvInt("SUMMARY_WORKERS", 4),
+		SummaryMaxRPM:               getEnvInt("SUMMARY_MAX_RPM", 60),
+		SummaryMaxTPM:               getEnvInt("SUMMARY_MAX_TPM", 1_000_000),
+		SummaryBatchMode:            getEnvBool("SUMMARY_BATCH_MODE", false),
+		SummaryBatchMinChats:        getEnvInt("SUMMARY_BATCH_MIN_CHATS", 20),
+		SummaryBatchPollSec:         getEnvInt("SUMMARY_BATCH_POLL_SEC", 60),
 
 		// Context Window
 		ImmediateContextSize: getEnvInt("IMMEDIATE_CONTEXT_SIZE", 50),
 		MediaBufferMax:       getEnvInt("MEDIA_BUFFER_MAX", 10),
+		ContextCacheMaxChats: getEnvInt("CONTEXT_CACHE_MAX_CHATS", 1000),
+		ContextStageTimeoutMS: getEnvInt("CONTEXT_STAGE_TIMEOUT_MS", 1000),
+		PromptLayout:          getEnv("PROMPT_LAYOUT", "sections"),
+		ContextTokenBudget:    getEnvInt("CONTEXT_TOKEN_BUDGET", 32_000),
+
+		MessageWriteBatchSize: getEnvInt("MESSAGE_WRITE_BATCH_SIZE", 100),
+		MessageWriteFlushMS:   getEnvInt("MESSAGE_WRITE_FLUSH_MS", 50),
+		MessageWriteQueueSize: getEnvInt("MESSAGE_WRITE_QUEUE_SIZE", 1000),
+
+		CoalesceDebounceMS: getEnvInt("COALESCE_DEBOUNCE_MS", 1500),
+		CoalesceMaxWaitMS:  getEnvInt("COALESCE_MAX_WAIT_MS", 5000),
+		CoalesceMaxBatch:   getEnvInt("COALESCE_MAX_BATCH", 10),
+		CoalesceMaxPending: getEnvInt("COALESCE_MAX_PENDING", 50),
+		TurnTimeoutSec:     getEnvInt("TURN_TIMEOUT_SEC", 120),
+
+		// Semantic memory
+		EnableEmbeddings:     getEnvBool("ENABLE_EMBEDDINGS", false),
+		EmbeddingModel:       getEnv("EMBEDDING_MODEL", "gemini-embedding-001"),
+		EmbeddingBatchSize:   getEnvInt("EMBEDDING_BATCH_SIZE", 100),
+		EmbeddingPollMS:      getEnvInt("EMBEDDING_POLL_MS", 2000),
+		UserFactsTopK:        getEnvInt("USER_FACTS_TOP_K", 20),
+		UserFactsTokenBudget: getEnvInt("USER_FACTS_TOKEN_BUDGET", 1000),
 
 		// Data Retention
-		MessageRetentionDays: getEnvInt("MESSAGE_RETENTION_DAYS", 90),
+		MessageRetentionDays:            getEnvInt("MESSAGE_RETENTION_DAYS", 90),
+		MessageMaintenanceIntervalHours: getEnvInt("MESSAGE_MAINTENANCE_INTERVAL_HOURS", 24),
+
+		MediaMaxBytes:         getEnvInt("MEDIA_MAX_BYTES", 10*1024*1024),
+		MediaUploadMinBytes:   getEnvInt("MEDIA_UPLOAD_MIN_BYTES", 1024*1024),
+		MediaUploadTimeoutSec: getEnvInt("MEDIA_UPLOAD_TIMEOUT_SEC", 60),
 
 		// Media cache (generated images, TTL for edit by media_id)
-		MediaCacheDir:      getEnv("MEDIA_CACHE_DIR", "/tmp/gryag_media_cache"),
-		MediaCacheTTLHours: getEnvInt("MEDIA_CACHE_TTL_HOURS", 48),
+		MediaCacheDir:         getEnv("MEDIA_CACHE_DIR", "/tmp/gryag_media_cache"),
+		MediaCacheTTLHours:    getEnvInt("MEDIA_CACHE_TTL_HOURS", 48),
+		MediaCacheMemoryMB:    getEnvInt("MEDIA_CACHE_MEMORY_MB", 64),
+		MediaSweepIntervalMin: getEnvInt("MEDIA_SWEEP_INTERVAL_MIN", 30),
+		MediaSweepBatchSize:   getEnvInt("MEDIA_SWEEP_BATCH_SIZE", 500),
 
 		// Persona
 		PersonaFile: getEnv("PERSONA_FILE", "config/persona.txt"),
@@ -189,6 +310,19 @@ func Load() (*Config, error) {
 	return cfg, nil
 }
 
+// ChatAllowed reports whether a chat passes the ALLOWED_CHAT_IDS whitelist (empty = every chat).
+func (c *Config) ChatAllowed(chatID int64) bool {
+	if len(c.AllowedChatIDs) == 0 {
+		return true
+	}
+	for _, id := range c.AllowedChatIDs {
+		if id == chatID {
+			return true
+		}
+	}
+	return false
+}
+
 // PostgresDSN returns the PostgreSQL connection string.
 func (c *Config) PostgresDSN() string {
 	return fmt.Sprintf(
@@ -209,6 +343,105 @@ func (c *Config) ListenAddr() string {
 	return fmt.Sprintf("%s:%d", c.BackendHost, c.BackendPort)
 }
 
+// GeminiContextCacheTTL returns the TTL for the cached persona/tools prefix (minimum 10 minutes).
+func (c *Config) GeminiContextCacheTTL() time.Duration {
+	if c.GeminiContextCacheTTLMin < 10 {
+		return 10 * time.Minute
+	}
+	return time.Duration(c.GeminiContextCacheTTLMin) * time.Minute
+}
+
+// ContextStageTimeout returns the per-stage deadline for optional context lookups (0 = none).
+func (c *Config) ContextStageTimeout() time.Duration {
+	if c.ContextStageTimeoutMS <= 0 {
+		return 0
+	}
+	return time.Duration(c.ContextStageTimeoutMS) * time.Millisecond
+}
+
+// MediaUploadTimeout bounds a Files API upload, including the wait for the file to be processed.
+func (c *Config) MediaUploadTimeout() time.Duration {
+	if c.MediaUploadTimeoutSec <= 0 {
+		return 0
+	}
+	return time.Duration(c.MediaUploadTimeoutSec) * time.Second
+}
+
+// EmbeddingPollInterval is how often the embedding indexer looks for rows to embed.
+func (c *Config) EmbeddingPollInterval() time.Duration {
+	if c.EmbeddingPollMS <= 0 {
+		return 2 * time.Second
+	}
+	return time.Duration(c.EmbeddingPollMS) * time.Millisecond
+}
+
+// SummaryBatchPollInterval is how often a pending summary batch job is polled.
+func (c *Config) SummaryBatchPollInterval() time.Duration {
+	if c.SummaryBatchPollSec <= 0 {
+		return time.Minute
+	}
+	return time.Duration(c.SummaryBatchPollSec) * time.Second
+}
+
+// MessageMaintenanceInterval is how often message partitions are created ahead and expired ones
+// dropped. 0 = only once at startup.
+func (c *Config) MessageMaintenanceInterval() time.Duration {
+	if c.MessageMaintenanceIntervalHours <= 0 {
+		return 0
+	}
+	return time.Duration(c.MessageMaintenanceIntervalHours) * time.Hour
+}
+
+// MediaSweepInterval returns how often expired media_cache rows and files are deleted (0 = never).
+func (c *Config) MediaSweepInterval() time.Duration {
+	if c.MediaSweepIntervalMin <= 0 {
+		return 0
+	}
+	return time.Duration(c.MediaSweepIntervalMin) * time.Minute
+}
+
+// ProactiveQuiet returns the idle time after which a chat counts as quiet for proactive selection.
+func (c *Config) ProactiveQuiet() time.Duration {
+	return time.Duration(c.ProactiveQuietMin) * time.Minute
+}
+
+// MessageWriteFlushInterval is how long the message writer waits for a batch to fill before writing it.
+func (c *Config) MessageWriteFlushInterval() time.Duration {
+	if c.MessageWriteFlushMS <= 0 {
+		return time.Millisecond
+	}
+	return time.Duration(c.MessageWriteFlushMS) * time.Millisecond
+}
+
+// CoalesceDebounce returns how long a chat must stay quiet before a coalesced follow-up turn starts.
+func (c *Config) CoalesceDebounce() time.Duration {
+	if c.CoalesceDebounceMS <= 0 {
+		return 0
+	}
+	return time.Duration(c.CoalesceDebounceMS) * time.Millisecond
+}
+
+// CoalesceMaxWait caps the total debounce wait before a follow-up turn.
+func (c *Config) CoalesceMaxWait() time.Duration {
+	if c.CoalesceMaxWaitMS <= 0 {
+		return 0
+	}
+	return time.Duration(c.CoalesceMaxWaitMS) * time.Millisecond
+}
+
+// TurnTimeout bounds one generation turn (context build, tool loop, storing the reply).
+func (c *Config) TurnTimeout() time.Duration {
+	if c.TurnTimeoutSec <= 0 {
+		return 120 * time.Second
+	}
+	return time.Duration(c.TurnTimeoutSec) * time.Second
+}
+
+// StablePromptLayout reports whether dynamic instructions use the stable-prefix block order.
+func (c *Config) StablePromptLayout() bool {
+	return c.PromptLayout == "stable_prefix"
+}
+
 // --- helpers ---
 
 func getEnv(key, fallback string) string {
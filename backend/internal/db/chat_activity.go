@@ -0,0 +1,77 @@
+package db
+
+import (
+	"context"
+	"fmt"
+	"math"
+	"time"
+)
+
+// ActivityHalfLife is the half-life of chat_activity.activity (see migration 010).
+const ActivityHalfLife = 24 * time.Hour
+
+// chatActivityUpsert folds the rows returned by a messages INSERT (a CTE named "inserted" with chat_id,
+// created_at and is_bot_reply) into chat_activity. It runs in the same statement as the INSERT, so the
+// activity row is updated exactly when the messages are written. The stored activity is decayed from
+// the previous last_message_at to the new one before the new user messages are added.
+const chatActivityUpsert = `
+	INSERT INTO chat_activity AS a (chat_id, last_message_at, activity)
+	SELECT chat_id, MAX(created_at), COUNT(*) FILTER (WHERE NOT is_bot_reply)
+	FROM inserted
+	GROUP BY chat_id
+	ON CONFLICT (chat_id) DO UPDATE SET
+		activity = a.activity * power(0.5, GREATEST(EXTRACT(EPOCH FROM EXCLUDED.last_message_at - a.last_message_at), 0) / 86400.0)
+			+ EXCLUDED.activity,
+		last_message_at = GREATEST(a.last_message_at, EXCLUDED.last_message_at)`
+
+// ChatActivity is one chat_activity row.
+type ChatActivity struct {
+	ChatID        int64
+	LastMessageAt time.Time
+	Activity      float64 // decayed user message count as of LastMessageAt
+}
+
+// ActivityAt returns the decayed user message count as of now: about how many messages the chat had in
+// the day before now.
+func (a ChatActivity) ActivityAt(now time.Time) float64 {
+	idle := now.Sub(a.LastMessageAt)
+	if idle <= 0 {
+		return a.Activity
+	}
+	return a.Activity * math.Exp2(-float64(idle)/float64(ActivityHalfLife))
+}
+
+// GetChatActivity returns the chats with a message since the given duration, most recently active
+// first. It reads one row per chat.
+func (d *DB) GetChatActivity(ctx context.Context, since time.Duration) ([]ChatActivity, error) {
+	const query = `
+		SELECT chat_id, last_message_at, activity
+		FROM chat_activity
+		WHERE last_message_at > $1
+		ORDER BY last_message_at DESC`
+	rows, err := d.queryContext(ctx, query, time.Now().Add(-since))
+	if err != nil {
+		return nil, fmt.Errorf("get chat activity: %w", err)
+	}
+	defer rows.Close()
+	var chats []ChatActivity
+	for rows.Next() {
+		var a ChatActivity
+		if err := rows.Scan(&a.ChatID, &a.LastMessageAt, &a.Activity); err != nil {
+			return nil, fmt.Errorf("scan chat activity: %w", err)
+		}
+		chats = append(chats, a)
+	}
+	if err := rows.Err(); err != nil {
+		return nil, fmt.Errorf("get chat activity: %w", err)
+	}
+	return chats, nil
+}
+
+// pruneChatActivity removes chats with no message since cutoff (their messages are past retention).
+func (d *DB) pruneChatActivity(ctx context.Context, cutoff time.Time) error {
+	if _, err := d.pool.ExecContext(ctx, "DELETE FROM chat_activity WHERE last_message_at < $1", cutoff); err != nil {
+		return fmt.Errorf("prune chat activity: %w", err)
+	}
+	return nil
+}
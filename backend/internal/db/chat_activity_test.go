@@ -0,0 +1,25 @@
+package db
+
+import (
+	"math"
+	"testing"
+	"time"
+)
+
+func TestChatActivity_ActivityAt(t *testing.T) {
+	last := time.Date(2026, 1, 1, 12, 0, 0, 0, time.UTC)
+	a := ChatActivity{ChatID: 1, LastMessageAt: last, Activity: 40}
+
+	if got := a.ActivityAt(last); got != 40 {
+		t.Errorf("at last message: got %v, want 40", got)
+	}
+	if got := a.ActivityAt(last.Add(-time.Hour)); got != 40 {
+		t.Errorf("before last message: got %v, want 40 (no decay)", got)
+	}
+	if got := a.ActivityAt(last.Add(ActivityHalfLife)); math.Abs(got-20) > 1e-9 {
+		t.Errorf("one half-life later: got %v, want 20", got)
+	}
+	if got := a.ActivityAt(last.Add(3 * ActivityHalfLife)); math.Abs(got-5) > 1e-9 {
+		t.Errorf("three half-lives later: got %v, want 5", got)
+	}
+}
@@ -0,0 +1,313 @@
+package db
+
+import (
+	"container/list"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// maxCachedFactUsers bounds how many (chat, user) fact lists are kept per cached chat.
+const maxCachedFactUsers = 256
+
+// ContextCache is a bounded in-process cache of the per-chat data read on every message by
+// llm.NewDynamicInstructions: the recent-message ring, the latest summaries and user facts.
+// Chats are evicted LRU beyond maxChats. Writes through DB update cached chats incrementally, so after
+// the first load a chat's context is served without Postgres round-trips.
+//
+// Each chat entry carries a generation counter per kind of data (messages, summaries, facts), bumped by
+// every write of that kind; a load that raced with a write of the same kind is discarded instead of
+// overwriting newer data. The counters are separate so that, in a busy chat, message inserts do not
+// keep throwing away fact and summary loads.
+type ContextCache struct {
+	mu       sync.Mutex
+	maxChats int
+	ringSize int
+	chats    map[int64]*list.Element
+	lru      *list.List
+
+	messageHits, messageMisses atomic.Uint64
+	factHits, factMisses       atomic.Uint64
+	summaryHits, summaryMisses atomic.Uint64
+}
+
+// cacheKind selects one of a chat entry's generation counters.
+type cacheKind int
+
+const (
+	kindMessages cacheKind = iota
+	kindSummaries
+	kindFacts
+	numCacheKinds
+)
+
+type chatCacheEntry struct {
+	chatID int64
+	gen    [numCacheKinds]uint64
+
+	messagesLoaded bool
+	messages       []Message // oldest first; the latest min(ringSize, total) messages of the chat
+
+	summaries map[string]cachedSummary // summary_type -> latest summary
+	facts     map[int64][]UserFact
+}
+
+// cachedSummary is the latest summary of one type; text is "" and periodEnd zero when none is stored.
+type cachedSummary struct {
+	text      string
+	periodEnd time.Time
+}
+
+// ContextCacheStats is a snapshot of the cache counters (for the admin stats endpoint).
+type ContextCacheStats struct {
+	Chats         int    `json:"chats"`
+	MessageHits   uint64 `json:"message_hits"`
+	MessageMisses uint64 `json:"message_misses"`
+	FactHits      uint64 `json:"fact_hits"`
+	FactMisses    uint64 `json:"fact_misses"`
+	SummaryHits   uint64 `json:"summary_hits"`
+	SummaryMisses uint64 `json:"summary_misses"`
+}
+
+// NewContextCache creates a cache holding up to maxChats chats with ringSize recent messages each.
+func NewContextCache(maxChats, ringSize int) *ContextCache {
+	if maxChats <= 0 {
+		maxChats = 1
+	}
+	if ringSize <= 0 {
+		ringSize = 1
+	}
+	return &ContextCache{
+		maxChats: maxChats,
+		ringSize: ringSize,
+		chats:    make(map[int64]*list.Element),
+		lru:      list.New(),
+	}
+}
+
+// Stats returns the current counters.
+func (c *ContextCache) Stats() ContextCacheStats {
+	c.mu.Lock()
+	chats := len(c.chats)
+	c.mu.Unlock()
+	return ContextCacheStats{
+		Chats:         chats,
+		MessageHits:   c.messageHits.Load(),
+		MessageMisses: c.messageMisses.Load(),
+		FactHits:      c.factHits.Load(),
+		FactMisses:    c.factMisses.Load(),
+		SummaryHits:   c.summaryHits.Load(),
+		SummaryMisses: c.summaryMisses.Load(),
+	}
+}
+
+// entry returns the chat entry, creating it (and evicting the LRU chat) when create is set. Caller holds mu.
+func (c *ContextCache) entry(chatID int64, create bool) *chatCacheEntry {
+	if el, ok := c.chats[chatID]; ok {
+		c.lru.MoveToFront(el)
+		return el.Value.(*chatCacheEntry)
+	}
+	if !create {
+		return nil
+	}
+	e := &chatCacheEntry{chatID: chatID}
+	c.chats[chatID] = c.lru.PushFront(e)
+	for c.lru.Len() > c.maxChats {
+		oldest := c.lru.Back()
+		c.lru.Remove(oldest)
+		delete(c.chats, oldest.Value.(*chatCacheEntry).chatID)
+	}
+	return e
+}
+
+// generation returns the chat's current write generation for kind, to be passed back to the matching
+// store* call after a load.
+func (c *ContextCache) generation(chatID int64, kind cacheKind) uint64 {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.entry(chatID, true).gen[kind]
+}
+
+// recentMessages returns the last limit messages (oldest first) if the chat's ring is loaded and covers limit.
+func (c *ContextCache) recentMessages(chatID int64, limit int) ([]Message, bool) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(chatID, false)
+	if e == nil || !e.messagesLoaded || limit > c.ringSize {
+		c.messageMisses.Add(1)
+		return nil, false
+	}
+	c.messageHits.Add(1)
+	start := len(e.messages) - limit
+	if start < 0 {
+		start = 0
+	}
+	out := make([]Message, len(e.messages)-start)
+	copy(out, e.messages[start:])
+	return out, true
+}
+
+// storeMessages installs a freshly loaded ring (oldest first) unless a write happened since gen.
+func (c *ContextCache) storeMessages(chatID int64, gen uint64, messages []Message) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(chatID, true)
+	if e.gen[kindMessages] != gen {
+		return
+	}
+	if len(messages) > c.ringSize {
+		messages = messages[len(messages)-c.ringSize:]
+	}
+	e.messages = make([]Message, len(messages), c.ringSize)
+	copy(e.messages, messages)
+	e.messagesLoaded = true
+}
+
+// appendMessage records a newly inserted message in a loaded ring.
+func (c *ContextCache) appendMessage(msg Message) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(msg.ChatID, false)
+	if e == nil {
+		return
+	}
+	e.gen[kindMessages]++
+	if !e.messagesLoaded {
+		return
+	}
+	if len(e.messages) >= c.ringSize {
+		copy(e.messages, e.messages[1:])
+		e.messages = e.messages[:len(e.messages)-1]
+	}
+	e.messages = append(e.messages, msg)
+}
+
+// latestSummary returns the cached latest summary text for the type.
+func (c *ContextCache) latestSummary(chatID int64, summaryType string) (string, bool) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(chatID, false)
+	if e == nil || e.summaries == nil {
+		c.summaryMisses.Add(1)
+		return "", false
+	}
+	cached, ok := e.summaries[summaryType]
+	if !ok {
+		c.summaryMisses.Add(1)
+		return "", false
+	}
+	c.summaryHits.Add(1)
+	return cached.text, true
+}
+
+// storeSummary caches the latest summary of a type freshly loaded from Postgres, unless a summary was
+// written since gen.
+func (c *ContextCache) storeSummary(chatID int64, gen uint64, summaryType, text string, periodEnd time.Time) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(chatID, true)
+	if e.gen[kindSummaries] != gen {
+		return
+	}
+	if e.summaries == nil {
+		e.summaries = make(map[string]cachedSummary)
+	}
+	e.summaries[summaryType] = cachedSummary{text: text, periodEnd: periodEnd}
+}
+
+// addSummary records a newly inserted summary. It replaces the cached one only when it is at least as
+// recent (by period end), as GetLatestSummary orders; a backfill or a late batch result for an older
+// window leaves the current summary in place. When the type is not cached nothing is stored, since a
+// newer row may exist in Postgres.
+func (c *ContextCache) addSummary(chatID int64, summaryType, text string, periodEnd time.Time) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(chatID, false)
+	if e == nil {
+		return
+	}
+	e.gen[kindSummaries]++
+	cached, ok := e.summaries[summaryType]
+	if !ok || periodEnd.Before(cached.periodEnd) {
+		return
+	}
+	e.summaries[summaryType] = cachedSummary{text: text, periodEnd: periodEnd}
+}
+
+// userFacts returns the cached facts for a user in a chat.
+func (c *ContextCache) userFacts(chatID, userID int64) ([]UserFact, bool) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(chatID, false)
+	if e == nil {
+		c.factMisses.Add(1)
+		return nil, false
+	}
+	facts, ok := e.facts[userID]
+	if !ok {
+		c.factMisses.Add(1)
+		return nil, false
+	}
+	c.factHits.Add(1)
+	out := make([]UserFact, len(facts))
+	copy(out, facts)
+	return out, true
+}
+
+// storeUserFacts caches a freshly loaded fact list unless a write happened since gen.
+func (c *ContextCache) storeUserFacts(chatID, userID int64, gen uint64, facts []UserFact) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(chatID, true)
+	if e.gen[kindFacts] != gen {
+		return
+	}
+	if e.facts == nil {
+		e.facts = make(map[int64][]UserFact)
+	}
+	if _, ok := e.facts[userID]; !ok && len(e.facts) >= maxCachedFactUsers {
+		for uid := range e.facts {
+			delete(e.facts, uid)
+			break
+		}
+	}
+	stored := make([]UserFact, len(facts))
+	copy(stored, facts)
+	e.facts[userID] = stored
+}
+
+// addUserFact appends a newly inserted fact to a loaded fact list.
+func (c *ContextCache) addUserFact(f UserFact) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(f.ChatID, false)
+	if e == nil {
+		return
+	}
+	e.gen[kindFacts]++
+	if facts, ok := e.facts[f.UserID]; ok {
+		e.facts[f.UserID] = append(facts, f)
+	}
+}
+
+// removeUserFact drops a deleted fact from a loaded fact list.
+func (c *ContextCache) removeUserFact(chatID, userID, factID int64) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e := c.entry(chatID, false)
+	if e == nil {
+		return
+	}
+	e.gen[kindFacts]++
+	facts, ok := e.facts[userID]
+	if !ok {
+		return
+	}
+	kept := facts[:0]
+	for _, f := range facts {
+		if f.ID != factID {
+			kept = append(kept, f)
+		}
+	}
+	e.facts[userID] = kept
+}
@@ -0,0 +1,146 @@
+package db
+
+import (
+	"testing"
+	"time"
+)
+
+func textPtr(s string) *string { return &s }
+
+func TestContextCache_MessageRing(t *testing.T) {
+	c := NewContextCache(10, 3)
+
+	if _, ok := c.recentMessages(1, 3); ok {
+		t.Fatal("expected miss before load")
+	}
+	gen := c.generation(1, kindMessages)
+	c.storeMessages(1, gen, []Message{{ID: 1, ChatID: 1}, {ID: 2, ChatID: 1}})
+
+	msgs, ok := c.recentMessages(1, 3)
+	if !ok || len(msgs) != 2 {
+		t.Fatalf("expected hit with 2 messages, got ok=%v len=%d", ok, len(msgs))
+	}
+
+	c.appendMessage(Message{ID: 3, ChatID: 1})
+	c.appendMessage(Message{ID: 4, ChatID: 1, Text: textPtr("newest")})
+
+	msgs, _ = c.recentMessages(1, 3)
+	if len(msgs) != 3 || msgs[0].ID != 2 || msgs[2].ID != 4 {
+		t.Fatalf("expected ring [2 3 4], got %+v", msgs)
+	}
+	msgs, _ = c.recentMessages(1, 1)
+	if len(msgs) != 1 || msgs[0].ID != 4 {
+		t.Fatalf("expected last message 4, got %+v", msgs)
+	}
+	if _, ok := c.recentMessages(1, 4); ok {
+		t.Error("expected miss for limit larger than ring")
+	}
+
+	stats := c.Stats()
+	if stats.MessageHits != 3 || stats.MessageMisses != 2 {
+		t.Errorf("expected 3 hits / 2 misses, got %d / %d", stats.MessageHits, stats.MessageMisses)
+	}
+}
+
+func TestContextCache_StaleLoadDiscarded(t *testing.T) {
+	c := NewContextCache(10, 5)
+	gen := c.generation(1, kindMessages)
+	// A write lands while the load query is in flight
+	c.appendMessage(Message{ID: 9, ChatID: 1})
+	c.storeMessages(1, gen, []Message{{ID: 8, ChatID: 1}})
+
+	if _, ok := c.recentMessages(1, 5); ok {
+		t.Error("expected stale load to be discarded")
+	}
+}
+
+func TestContextCache_Eviction(t *testing.T) {
+	c := NewContextCache(2, 5)
+	for chatID := int64(1); chatID <= 3; chatID++ {
+		c.storeMessages(chatID, c.generation(chatID, kindMessages), []Message{{ChatID: chatID}})
+	}
+	if _, ok := c.recentMessages(1, 1); ok {
+		t.Error("expected least recently used chat to be evicted")
+	}
+	if _, ok := c.recentMessages(3, 1); !ok {
+		t.Error("expected most recent chat to be cached")
+	}
+	if got := c.Stats().Chats; got != 2 {
+		t.Errorf("expected 2 cached chats, got %d", got)
+	}
+}
+
+func TestContextCache_Summaries(t *testing.T) {
+	c := NewContextCache(10, 5)
+	if _, ok := c.latestSummary(1, "7day"); ok {
+		t.Fatal("expected miss before load")
+	}
+	c.storeSummary(1, c.generation(1, kindSummaries), "7day", "", time.Time{})
+	if text, ok := c.latestSummary(1, "7day"); !ok || text != "" {
+		t.Errorf("expected cached empty summary, got %q ok=%v", text, ok)
+	}
+	week := time.Date(2026, 2, 24, 0, 0, 0, 0, time.UTC)
+	c.addSummary(1, "7day", "new week", week)
+	if text, _ := c.latestSummary(1, "7day"); text != "new week" {
+		t.Errorf("expected written summary, got %q", text)
+	}
+	// A backfill of an older window must not replace the current summary
+	c.addSummary(1, "7day", "old week", week.AddDate(0, 0, -7))
+	if text, _ := c.latestSummary(1, "7day"); text != "new week" {
+		t.Errorf("older summary replaced the latest: got %q", text)
+	}
+	// A summary written for a type that is not cached is not assumed to be the latest
+	c.addSummary(1, "30day", "month", week)
+	if _, ok := c.latestSummary(1, "30day"); ok {
+		t.Error("expected 30day to still miss")
+	}
+}
+
+func TestContextCache_UserFacts(t *testing.T) {
+	c := NewContextCache(10, 5)
+	if _, ok := c.userFacts(1, 7); ok {
+		t.Fatal("expected miss before load")
+	}
+	c.storeUserFacts(1, 7, c.generation(1, kindFacts), []UserFact{{ID: 1, ChatID: 1, UserID: 7, FactText: "Likes cats"}})
+	c.addUserFact(UserFact{ID: 2, ChatID: 1, UserID: 7, FactText: "Lives in Kyiv"})
+	c.addUserFact(UserFact{ID: 3, ChatID: 1, UserID: 8, FactText: "Not loaded"})
+
+	facts, ok := c.userFacts(1, 7)
+	if !ok || len(facts) != 2 {
+		t.Fatalf("expected 2 facts, got ok=%v %+v", ok, facts)
+	}
+	if _, ok := c.userFacts(1, 8); ok {
+		t.Error("expected facts of an unloaded user to stay uncached")
+	}
+
+	c.removeUserFact(1, 7, 1)
+	facts, _ = c.userFacts(1, 7)
+	if len(facts) != 1 || facts[0].ID != 2 {
+		t.Errorf("expected only fact 2 after delete, got %+v", facts)
+	}
+}
+
+func TestContextCache_GenerationsPerKind(t *testing.T) {
+	c := NewContextCache(10, 5)
+	factGen := c.generation(1, kindFacts)
+	summaryGen := c.generation(1, kindSummaries)
+	// A message insert lands while the fact and summary loads are in flight
+	c.appendMessage(Message{ID: 1, ChatID: 1})
+	c.storeUserFacts(1, 7, factGen, []UserFact{{ID: 1, ChatID: 1, UserID: 7}})
+	c.storeSummary(1, summaryGen, "7day", "week", time.Now())
+
+	if _, ok := c.userFacts(1, 7); !ok {
+		t.Error("message insert discarded a fact load")
+	}
+	if _, ok := c.latestSummary(1, "7day"); !ok {
+		t.Error("message insert discarded a summary load")
+	}
+
+	// A fact write does invalidate a concurrent fact load
+	factGen = c.generation(1, kindFacts)
+	c.addUserFact(UserFact{ID: 2, ChatID: 1, UserID: 8})
+	c.storeUserFacts(1, 8, factGen, nil)
+	if _, ok := c.userFacts(1, 8); ok {
+		t.Error("expected stale fact load to be discarded")
+	}
+}
@@ -0,0 +1,243 @@
+package db
+
+import (
+	"context"
+	"fmt"
+	"sort"
+	"strconv"
+	"strings"
+	"time"
+)
+
+// EmbeddingDimensions is the size of the vector columns (migration 007).
+const EmbeddingDimensions = 768
+
+// MaxEmbeddingAttempts is the number of failed attempts after which a row is no longer embedded
+// (embedding_attempts, migration 011; the pending queries and idx_messages_embedding_pending use it).
+const MaxEmbeddingAttempts = 5
+
+// EmbeddingJob is a fact or message still to be embedded.
+type EmbeddingJob struct {
+	ID        int64
+	CreatedAt time.Time // messages: part of the primary key (partitioning)
+	Text      string
+}
+
+// EmbeddingSchemaReady reports whether the vector columns exist. Migration 007 skips them where the
+// pgvector extension is not available.
+func (d *DB) EmbeddingSchemaReady(ctx context.Context) (bool, error) {
+	const query = `
+		SELECT EXISTS (SELECT 1 FROM information_schema.columns
+		               WHERE table_schema = current_schema() AND table_name = 'messages' AND column_name = 'embedding')`
+	var ok bool
+	if err := d.queryRowContext(ctx, query).Scan(&ok); err != nil {
+		return false, fmt.Errorf("check embedding schema: %w", err)
+	}
+	return ok, nil
+}
+
+// vectorLiteral encodes v in pgvector's text format ("[1,2,3]"), passed as a parameter cast to vector.
+func vectorLiteral(v []float32) string {
+	var b strings.Builder
+	b.Grow(len(v) * 10)
+	b.WriteByte('[')
+	for i, x := range v {
+		if i > 0 {
+			b.WriteByte(',')
+		}
+		b.WriteString(strconv.FormatFloat(float64(x), 'g', -1, 32))
+	}
+	b.WriteByte(']')
+	return b.String()
+}
+
+// PendingFactEmbeddings returns up to limit facts without an embedding, newest first. Facts that
+// failed MaxEmbeddingAttempts times are skipped.
+func (d *DB) PendingFactEmbeddings(ctx context.Context, limit int) ([]EmbeddingJob, error) {
+	const query = `
+		SELECT id, created_at, fact_text FROM user_facts
+		WHERE embedding IS NULL AND embedding_attempts < 5
+		ORDER BY id DESC
+		LIMIT $1`
+	return d.embeddingJobs(ctx, query, limit)
+}
+
+// PendingMessageEmbeddings returns up to limit messages without an embedding, newest first. Messages
+// shorter than 16 characters are never embedded, nor are messages that failed MaxEmbeddingAttempts
+// times (the predicate of idx_messages_embedding_pending, so it is spelled out literally).
+func (d *DB) PendingMessageEmbeddings(ctx context.Context, limit int) ([]EmbeddingJob, error) {
+	const query = `
+		SELECT id, created_at, text FROM messages
+		WHERE embedding IS NULL AND length(text) >= 16 AND embedding_attempts < 5
+		ORDER BY created_at DESC
+		LIMIT $1`
+	return d.embeddingJobs(ctx, query, limit)
+}
+
+func (d *DB) embeddingJobs(ctx context.Context, query string, limit int) ([]EmbeddingJob, error) {
+	rows, err := d.queryContext(ctx, query, limit)
+	if err != nil {
+		return nil, fmt.Errorf("pending embeddings: %w", err)
+	}
+	defer rows.Close()
+	var jobs []EmbeddingJob
+	for rows.Next() {
+		var j EmbeddingJob
+		if err := rows.Scan(&j.ID, &j.CreatedAt, &j.Text); err != nil {
+			return nil, fmt.Errorf("scan embedding job: %w", err)
+		}
+		jobs = append(jobs, j)
+	}
+	if err := rows.Err(); err != nil {
+		return nil, fmt.Errorf("pending embeddings: %w", err)
+	}
+	return jobs, nil
+}
+
+// SetFactEmbedding stores a fact's embedding.
+func (d *DB) SetFactEmbedding(ctx context.Context, id int64, v []float32) error {
+	if _, err := d.execContext(ctx, "UPDATE user_facts SET embedding = $1::vector WHERE id = $2", vectorLiteral(v), id); err != nil {
+		return fmt.Errorf("set fact embedding: %w", err)
+	}
+	return nil
+}
+
+// SetMessageEmbedding stores a message's embedding. created_at lets Postgres touch only its partition.
+func (d *DB) SetMessageEmbedding(ctx context.Context, id int64, createdAt time.Time, v []float32) error {
+	if _, err := d.execContext(ctx,
+		"UPDATE messages SET embedding = $1::vector WHERE id = $2 AND created_at = $3",
+		vectorLiteral(v), id, createdAt); err != nil {
+		return fmt.Errorf("set message embedding: %w", err)
+	}
+	return nil
+}
+
+// RecordFactEmbeddingFailure counts a failed attempt to embed a fact.
+func (d *DB) RecordFactEmbeddingFailure(ctx context.Context, id int64) error {
+	if _, err := d.execContext(ctx, "UPDATE user_facts SET embedding_attempts = embedding_attempts + 1 WHERE id = $1", id); err != nil {
+		return fmt.Errorf("record fact embedding failure: %w", err)
+	}
+	return nil
+}
+
+// RecordMessageEmbeddingFailure counts a failed attempt to embed a message.
+func (d *DB) RecordMessageEmbeddingFailure(ctx context.Context, id int64, createdAt time.Time) error {
+	if _, err := d.execContext(ctx,
+		"UPDATE messages SET embedding_attempts = embedding_attempts + 1 WHERE id = $1 AND created_at = $2",
+		id, createdAt); err != nil {
+		return fmt.Errorf("record message embedding failure: %w", err)
+	}
+	return nil
+}
+
+// RankUserFacts returns a user's facts ordered by similarity to query, most relevant first. Facts not
+// embedded yet follow, newest first.
+func (d *DB) RankUserFacts(ctx context.Context, chatID, userID int64, query []float32, limit int) ([]UserFact, error) {
+	const sqlQuery = `
+		SELECT id, chat_id, user_id, fact_text, created_at, updated_at
+		FROM user_facts
+		WHERE chat_id = $1 AND user_id = $2
+		ORDER BY embedding <=> $3::vector NULLS LAST, created_at DESC
+		LIMIT $4`
+	rows, err := d.queryContext(ctx, sqlQuery, chatID, userID, vectorLiteral(query), limit)
+	if err != nil {
+		return nil, fmt.Errorf("rank user facts: %w", err)
+	}
+	defer rows.Close()
+	var facts []UserFact
+	for rows.Next() {
+		var f UserFact
+		if err := rows.Scan(&f.ID, &f.ChatID, &f.UserID, &f.FactText, &f.CreatedAt, &f.UpdatedAt); err != nil {
+			return nil, fmt.Errorf("scan user fact: %w", err)
+		}
+		facts = append(facts, f)
+	}
+	if err := rows.Err(); err != nil {
+		return nil, fmt.Errorf("rank user facts: %w", err)
+	}
+	return facts, nil
+}
+
+// SemanticSearchMessages returns a chat's messages closest in meaning to query, most similar first.
+// Rank is the cosine similarity.
+func (d *DB) SemanticSearchMessages(ctx context.Context, chatID int64, query []float32, limit int) ([]SearchResult, error) {
+	if limit <= 0 {
+		limit = 10
+	}
+	if limit > 50 {
+		limit = 50
+	}
+	tx, err := d.pool.BeginTx(ctx, nil)
+	if err != nil {
+		return nil, fmt.Errorf("semantic search: %w", err)
+	}
+	defer tx.Rollback()
+	// The HNSW index is shared by all chats; iterative scans keep walking it until enough rows of
+	// this chat are found instead of returning the few that survive the filter.
+	if _, err := tx.ExecContext(ctx, "SET LOCAL hnsw.iterative_scan = relaxed_order"); err != nil {
+		return nil, fmt.Errorf("semantic search: %w", err)
+	}
+	const sqlQuery = `
+		SELECT id, chat_id, user_id, username, first_name, text, file_id, message_id, media_type, is_bot_reply,
+		       1 - (embedding <=> $1::vector) AS rank
+		FROM messages
+		WHERE chat_id = $2 AND embedding IS NOT NULL
+		ORDER BY embedding <=> $1::vector
+		LIMIT $3`
+	rows, err := tx.QueryContext(ctx, sqlQuery, vectorLiteral(query), chatID, limit)
+	if err != nil {
+		return nil, fmt.Errorf("semantic search: %w", err)
+	}
+	defer rows.Close()
+	var results []SearchResult
+	for rows.Next() {
+		var r SearchResult
+		if err := rows.Scan(
+			&r.ID, &r.ChatID, &r.UserID, &r.Username, &r.FirstName,
+			&r.Text, &r.FileID, &r.MessageID, &r.MediaType, &r.IsBotReply, &r.Rank,
+		); err != nil {
+			return nil, fmt.Errorf("scan search result: %w", err)
+		}
+		r.MessageLink = ComposeMessageLink(r.ChatID, r.MessageID)
+		results = append(results, r)
+	}
+	if err := rows.Err(); err != nil {
+		return nil, fmt.Errorf("semantic search: %w", err)
+	}
+	// relaxed_order may return rows slightly out of order
+	sort.SliceStable(results, func(i, j int) bool { return results[i].Rank > results[j].Rank })
+	return results, nil
+}
+
+// FuseSearchResults merges ranked result lists (full-text and semantic) by reciprocal rank fusion:
+// a message found by both ranks above one found by either alone. Rank of the output is the fused score.
+func FuseSearchResults(limit int, lists ...[]SearchResult) []SearchResult {
+	const k = 60 // standard RRF damping constant
+	type fused struct {
+		r     SearchResult
+		score float64
+	}
+	byID := make(map[int64]*fused)
+	var order []*fused
+	for _, list := range lists {
+		for pos, r := range list {
+			f, ok := byID[r.ID]
+			if !ok {
+				f = &fused{r: r}
+				byID[r.ID] = f
+				order = append(order, f)
+			}
+			f.score += 1 / float64(k+pos+1)
+		}
+	}
+	sort.SliceStable(order, func(i, j int) bool { return order[i].score > order[j].score })
+	if len(order) > limit {
+		order = order[:limit]
+	}
+	out := make([]SearchResult, len(order))
+	for i, f := range order {
+		out[i] = f.r
+		out[i].Rank = f.score
+	}
+	return out
+}
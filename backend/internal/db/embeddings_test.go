@@ -0,0 +1,24 @@
+package db
+
+import "testing"
+
+func TestVectorLiteral(t *testing.T) {
+	if got := vectorLiteral([]float32{1, -0.5, 0.25}); got != "[1,-0.5,0.25]" {
+		t.Fatalf("vectorLiteral = %q", got)
+	}
+}
+
+func TestFuseSearchResultsPrefersMessagesFoundByBoth(t *testing.T) {
+	fullText := []SearchResult{{ID: 1}, {ID: 2}, {ID: 3}}
+	semantic := []SearchResult{{ID: 3}, {ID: 4}}
+	got := FuseSearchResults(3, fullText, semantic)
+	if len(got) != 3 {
+		t.Fatalf("got %d results, want 3", len(got))
+	}
+	if got[0].ID != 3 {
+		t.Fatalf("first result = %d, want 3 (found by both)", got[0].ID)
+	}
+	if got[1].ID != 1 {
+		t.Fatalf("second result = %d, want 1 (top full-text match)", got[1].ID)
+	}
+}
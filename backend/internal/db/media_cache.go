@@ -3,12 +3,14 @@ package db
 import (
 	"context"
 	"database/sql"
+	"errors"
 	"fmt"
-	"os"
-	"path/filepath"
+	"io"
+	"log/slog"
 	"time"
 
 	"github.com/google/uuid"
+	"github.com/lib/pq"
 )
 
 // MediaCacheEntry represents a row in the media_cache table.
@@ -23,38 +25,53 @@ type MediaCacheEntry struct {
 	CreatedAt time.Time
 }
 
-// InsertMediaCache writes data to cacheDir, inserts a row, and returns the new media_id.
-// ttlHours is used to set expires_at (e.g. 24 or 48).
-func (d *DB) InsertMediaCache(ctx context.Context, cacheDir string, chatID int64, userID *int64, data []byte, ttlHours int) (mediaID string, err error) {
-	if ttlHours <= 0 {
-		ttlHours = 48
+var errMediaStoreDisabled = errors.New("media store not enabled")
+
+// EnableMediaStore stores media_cache files content-addressed under dir, with up to memoryBytes of hot
+// images kept in memory (see MediaStore). Call once at startup.
+func (d *DB) EnableMediaStore(dir string, memoryBytes int64) {
+	d.media = NewMediaStore(dir, memoryBytes)
+	slog.Info("media store enabled", "dir", dir, "memory_bytes", memoryBytes)
+}
+
+// MediaStoreStats returns the media store counters; ok is false when the store is disabled.
+func (d *DB) MediaStoreStats() (stats MediaStoreStats, ok bool) {
+	if d == nil || d.media == nil {
+		return MediaStoreStats{}, false
 	}
-	mediaID = uuid.New().String()
-	ext := ".png"
-	path := filepath.Join(cacheDir, mediaID+ext)
-	if err := os.MkdirAll(cacheDir, 0755); err != nil {
-		return "", fmt.Errorf("media cache mkdir: %w", err)
+	return d.media.Stats(), true
+}
+
+// InsertMediaCache stores data in the media store (reusing the file when the same bytes are already
+// stored), inserts a row, and returns the new media_id. ttlHours is used to set expires_at (e.g. 24 or 48).
+func (d *DB) InsertMediaCache(ctx context.Context, chatID int64, userID *int64, data []byte, ttlHours int) (mediaID string, err error) {
+	if d.media == nil {
+		return "", errMediaStoreDisabled
 	}
-	if err := os.WriteFile(path, data, 0644); err != nil {
-		return "", fmt.Errorf("media cache write: %w", err)
+	if ttlHours <= 0 {
+		ttlHours = 48
 	}
-	absPath, err := filepath.Abs(path)
+	d.media.mu.Lock()
+	defer d.media.mu.Unlock()
+	path, err := d.media.write(data)
 	if err != nil {
-		absPath = path
+		return "", err
 	}
+	mediaID = uuid.New().String()
 	expiresAt := time.Now().Add(time.Duration(ttlHours) * time.Hour)
 	const query = `
 		INSERT INTO media_cache (media_id, chat_id, user_id, file_path, media_type, expires_at)
 		VALUES ($1, $2, $3, $4, 'image', $5)`
-	_, err = d.pool.ExecContext(ctx, query, mediaID, chatID, userID, absPath, expiresAt)
-	if err != nil {
-		_ = os.Remove(path)
+	// The file is left in place on failure: other rows may share it, and the sweeper only removes
+	// files no row references.
+	if _, err := d.execContext(ctx, query, mediaID, chatID, userID, path, expiresAt); err != nil {
 		return "", fmt.Errorf("media cache insert: %w", err)
 	}
 	return mediaID, nil
 }
 
-// GetMediaCacheByID returns the entry by media_id if not expired. Caller reads file from FilePath.
+// GetMediaCacheByID returns the entry by media_id if not expired. Read the file with OpenMedia or
+// ReadMedia.
 func (d *DB) GetMediaCacheByID(ctx context.Context, mediaID string) (*MediaCacheEntry, error) {
 	const query = `
 		SELECT id, media_id, chat_id, user_id, file_path, media_type, expires_at, created_at
@@ -62,7 +79,7 @@ func (d *DB) GetMediaCacheByID(ctx context.Context, mediaID string) (*MediaCache
 		WHERE media_id = $1 AND expires_at > NOW()`
 	var e MediaCacheEntry
 	var userID sql.NullInt64
-	err := d.pool.QueryRowContext(ctx, query, mediaID).Scan(
+	err := d.queryRowContext(ctx, query, mediaID).Scan(
 		&e.ID, &e.MediaID, &e.ChatID, &userID, &e.FilePath, &e.MediaType, &e.ExpiresAt, &e.CreatedAt,
 	)
 	if err == sql.ErrNoRows {
@@ -76,3 +93,138 @@ func (d *DB) GetMediaCacheByID(ctx context.Context, mediaID string) (*MediaCache
 	}
 	return &e, nil
 }
+
+// OpenMedia returns a reader over an entry's file for streaming, and its modification time.
+func (d *DB) OpenMedia(e *MediaCacheEntry) (io.ReadSeekCloser, time.Time, error) {
+	if d.media == nil {
+		return nil, time.Time{}, errMediaStoreDisabled
+	}
+	return d.media.Open(e.FilePath)
+}
+
+// ReadMedia returns the bytes of an entry's file, from memory when it was used recently.
+func (d *DB) ReadMedia(e *MediaCacheEntry) ([]byte, error) {
+	if d.media == nil {
+		return nil, errMediaStoreDisabled
+	}
+	return d.media.ReadFile(e.FilePath)
+}
+
+// SweepExpiredMedia deletes expired media_cache rows in batches of batchSize (oldest first, along
+// idx_media_cache_expires), then removes the files no remaining row references. It returns the rows
+// and files deleted.
+func (d *DB) SweepExpiredMedia(ctx context.Context, batchSize int) (rows, files int, err error) {
+	if d.media == nil {
+		return 0, 0, errMediaStoreDisabled
+	}
+	if batchSize <= 0 {
+		batchSize = 500
+	}
+	const query = `
+		DELETE FROM media_cache WHERE id IN (
+			SELECT id FROM media_cache WHERE expires_at <= NOW() ORDER BY expires_at LIMIT $1
+		)
+		RETURNING file_path`
+	for {
+		paths, err := d.deleteExpiredMediaRows(ctx, query, batchSize)
+		if err != nil {
+			return rows, files, err
+		}
+		rows += len(paths)
+		n, err := d.removeUnreferencedMedia(ctx, paths)
+		files += n
+		if err != nil {
+			return rows, files, err
+		}
+		if len(paths) < batchSize || ctx.Err() != nil {
+			return rows, files, ctx.Err()
+		}
+	}
+}
+
+func (d *DB) deleteExpiredMediaRows(ctx context.Context, query string, batchSize int) ([]string, error) {
+	rows, err := d.pool.QueryContext(ctx, query, batchSize)
+	if err != nil {
+		return nil, fmt.Errorf("delete expired media: %w", err)
+	}
+	defer rows.Close()
+	var paths []string
+	for rows.Next() {
+		var p string
+		if err := rows.Scan(&p); err != nil {
+			return nil, fmt.Errorf("scan media path: %w", err)
+		}
+		paths = append(paths, p)
+	}
+	if err := rows.Err(); err != nil {
+		return nil, fmt.Errorf("delete expired media: %w", err)
+	}
+	return paths, nil
+}
+
+// removeUnreferencedMedia removes those of paths that no media_cache row points at any more.
+func (d *DB) removeUnreferencedMedia(ctx context.Context, paths []string) (int, error) {
+	if len(paths) == 0 {
+		return 0, nil
+	}
+	d.media.mu.Lock()
+	defer d.media.mu.Unlock()
+	rows, err := d.pool.QueryContext(ctx,
+		"SELECT DISTINCT file_path FROM media_cache WHERE file_path = ANY($1)", pq.Array(paths))
+	if err != nil {
+		return 0, fmt.Errorf("media references: %w", err)
+	}
+	referenced := make(map[string]bool)
+	for rows.Next() {
+		var p string
+		if err := rows.Scan(&p); err != nil {
+			rows.Close()
+			return 0, fmt.Errorf("scan media path: %w", err)
+		}
+		referenced[p] = true
+	}
+	err = rows.Err()
+	rows.Close()
+	if err != nil {
+		return 0, fmt.Errorf("media references: %w", err)
+	}
+
+	removed := 0
+	for _, p := range paths {
+		if referenced[p] {
+			continue
+		}
+		// Duplicates in paths (rows sharing a file) were removed on the first pass
+		referenced[p] = true
+		if err := d.media.remove(p); err != nil {
+			slog.Warn("remove media file failed", "path", p, "error", err)
+			continue
+		}
+		removed++
+	}
+	return removed, nil
+}
+
+// RunMediaSweeper deletes expired media every interval until ctx is cancelled. Meant to be started
+// in its own goroutine.
+func (d *DB) RunMediaSweeper(ctx context.Context, interval time.Duration, batchSize int) {
+	if interval <= 0 {
+		return
+	}
+	ticker := time.NewTicker(interval)
+	defer ticker.Stop()
+	for {
+		rows, files, err := d.SweepExpiredMedia(ctx, batchSize)
+		if err != nil && ctx.Err() == nil {
+			slog.Warn("media sweep failed", "error", err)
+		}
+		if rows > 0 {
+			slog.Info("swept expired media", "rows", rows, "files", files)
+		}
+		select {
+		case <-ctx.Done():
+			return
+		case <-ticker.C:
+		}
+	}
+}
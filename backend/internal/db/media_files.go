@@ -0,0 +1,31 @@
+package db
+
+import (
+	"context"
+	"database/sql"
+	"fmt"
+	"time"
+)
+
+// mediaFileLifetime is how long Gemini keeps a Files API upload; older rows cannot hold a live URI,
+// which limits the lookup to the newest partitions.
+const mediaFileLifetime = 48 * time.Hour
+
+// GetMediaURI returns the Gemini Files API URI stored with a message carrying Telegram file fileID that
+// stays valid for at least minValidity, and its expiry. uri is "" when there is none.
+func (d *DB) GetMediaURI(ctx context.Context, fileID string, minValidity time.Duration) (uri string, expiresAt time.Time, err error) {
+	now := time.Now()
+	const query = `
+		SELECT media_uri, media_uri_expires_at FROM messages
+		WHERE file_id = $1 AND media_uri IS NOT NULL AND created_at > $2 AND media_uri_expires_at > $3
+		ORDER BY created_at DESC
+		LIMIT 1`
+	err = d.queryRowContext(ctx, query, fileID, now.Add(-mediaFileLifetime), now.Add(minValidity)).Scan(&uri, &expiresAt)
+	if err == sql.ErrNoRows {
+		return "", time.Time{}, nil
+	}
+	if err != nil {
+		return "", time.Time{}, fmt.Errorf("get media uri: %w", err)
+	}
+	return uri, expiresAt, nil
+}
@@ -0,0 +1,218 @@
+package db
+
+import (
+	"bytes"
+	"container/list"
+	"crypto/sha256"
+	"encoding/hex"
+	"errors"
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// MediaStore keeps media_cache files content-addressed: a file is named by the SHA-256 of its bytes
+// (<dir>/<first 2 hex chars>/<hash>.png), so identical images are stored once however many rows point
+// at them. The most recently read files are also held in memory, up to maxBytes.
+//
+// mu serializes "reuse or write a file, then insert its row" against the sweeper's "check a file is
+// unreferenced, then remove it", so a file is never removed under a row that was just inserted.
+type MediaStore struct {
+	dir string
+
+	mu sync.Mutex
+
+	lruMu    sync.Mutex
+	maxBytes int64
+	bytes    int64
+	files    map[string]*list.Element
+	lru      *list.List
+
+	hits, misses, reused atomic.Uint64
+}
+
+type mediaLRUEntry struct {
+	path    string
+	data    []byte
+	modTime time.Time
+}
+
+// MediaStoreStats is a snapshot of the store counters (for the admin stats endpoint).
+type MediaStoreStats struct {
+	MemoryFiles int    `json:"memory_files"`
+	MemoryBytes int64  `json:"memory_bytes"`
+	Hits        uint64 `json:"hits"`
+	Misses      uint64 `json:"misses"`
+	Reused      uint64 `json:"reused"` // inserts that found the file already stored
+}
+
+// NewMediaStore creates a store rooted at dir holding up to maxBytes of hot files in memory
+// (0 = no in-memory copies).
+func NewMediaStore(dir string, maxBytes int64) *MediaStore {
+	return &MediaStore{
+		dir:      dir,
+		maxBytes: maxBytes,
+		files:    make(map[string]*list.Element),
+		lru:      list.New(),
+	}
+}
+
+// Stats returns the current counters.
+func (s *MediaStore) Stats() MediaStoreStats {
+	s.lruMu.Lock()
+	files, size := len(s.files), s.bytes
+	s.lruMu.Unlock()
+	return MediaStoreStats{
+		MemoryFiles: files,
+		MemoryBytes: size,
+		Hits:        s.hits.Load(),
+		Misses:      s.misses.Load(),
+		Reused:      s.reused.Load(),
+	}
+}
+
+// pathFor returns the absolute content-addressed path of data.
+func (s *MediaStore) pathFor(data []byte) string {
+	sum := sha256.Sum256(data)
+	name := hex.EncodeToString(sum[:])
+	path := filepath.Join(s.dir, name[:2], name+".png")
+	if abs, err := filepath.Abs(path); err == nil {
+		return abs
+	}
+	return path
+}
+
+// write stores data under its hash unless that file already exists, and returns the path. The file is
+// written to a temporary name and renamed, so readers never see a partial image. Callers hold s.mu.
+func (s *MediaStore) write(data []byte) (string, error) {
+	path := s.pathFor(data)
+	if _, err := os.Stat(path); err == nil {
+		s.reused.Add(1)
+		s.remember(path, data, time.Now())
+		return path, nil
+	}
+	if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+		return "", fmt.Errorf("media store mkdir: %w", err)
+	}
+	tmp, err := os.CreateTemp(filepath.Dir(path), ".tmp-*")
+	if err != nil {
+		return "", fmt.Errorf("media store write: %w", err)
+	}
+	_, err = tmp.Write(data)
+	if closeErr := tmp.Close(); err == nil {
+		err = closeErr
+	}
+	if err == nil {
+		err = os.Chmod(tmp.Name(), 0644)
+	}
+	if err == nil {
+		err = os.Rename(tmp.Name(), path)
+	}
+	if err != nil {
+		_ = os.Remove(tmp.Name())
+		return "", fmt.Errorf("media store write: %w", err)
+	}
+	// A fresh image is likely to be fetched by the frontend and edited next
+	s.remember(path, data, time.Now())
+	return path, nil
+}
+
+// Open returns a reader over the file at path: the in-memory copy when hot, otherwise the file itself,
+// streamed from disk. The caller closes it.
+func (s *MediaStore) Open(path string) (io.ReadSeekCloser, time.Time, error) {
+	if data, modTime, ok := s.lookup(path); ok {
+		return nopSeekCloser{bytes.NewReader(data)}, modTime, nil
+	}
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, time.Time{}, err
+	}
+	info, err := f.Stat()
+	if err != nil {
+		f.Close()
+		return nil, time.Time{}, err
+	}
+	return f, info.ModTime(), nil
+}
+
+// ReadFile returns the bytes of the file at path, from memory when hot. Files read from disk are kept
+// in memory for the next read.
+func (s *MediaStore) ReadFile(path string) ([]byte, error) {
+	if data, _, ok := s.lookup(path); ok {
+		return data, nil
+	}
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	s.remember(path, data, time.Now())
+	return data, nil
+}
+
+// remove deletes a file and its in-memory copy. Callers hold s.mu.
+func (s *MediaStore) remove(path string) error {
+	s.forget(path)
+	if err := os.Remove(path); err != nil && !errors.Is(err, os.ErrNotExist) {
+		return err
+	}
+	return nil
+}
+
+func (s *MediaStore) lookup(path string) ([]byte, time.Time, bool) {
+	s.lruMu.Lock()
+	defer s.lruMu.Unlock()
+	el, ok := s.files[path]
+	if !ok {
+		s.misses.Add(1)
+		return nil, time.Time{}, false
+	}
+	s.hits.Add(1)
+	s.lru.MoveToFront(el)
+	e := el.Value.(*mediaLRUEntry)
+	return e.data, e.modTime, true
+}
+
+// remember keeps data in memory as the most recently used file, evicting the least recently used
+// beyond maxBytes. Files larger than maxBytes are not kept.
+func (s *MediaStore) remember(path string, data []byte, modTime time.Time) {
+	size := int64(len(data))
+	if s.maxBytes <= 0 || size > s.maxBytes {
+		return
+	}
+	s.lruMu.Lock()
+	defer s.lruMu.Unlock()
+	if el, ok := s.files[path]; ok {
+		s.lru.MoveToFront(el)
+		return
+	}
+	s.files[path] = s.lru.PushFront(&mediaLRUEntry{path: path, data: data, modTime: modTime})
+	s.bytes += size
+	for s.bytes > s.maxBytes {
+		oldest := s.lru.Back()
+		e := oldest.Value.(*mediaLRUEntry)
+		s.lru.Remove(oldest)
+		delete(s.files, e.path)
+		s.bytes -= int64(len(e.data))
+	}
+}
+
+func (s *MediaStore) forget(path string) {
+	s.lruMu.Lock()
+	defer s.lruMu.Unlock()
+	if el, ok := s.files[path]; ok {
+		s.lru.Remove(el)
+		delete(s.files, path)
+		s.bytes -= int64(len(el.Value.(*mediaLRUEntry).data))
+	}
+}
+
+// nopSeekCloser gives an in-memory reader the io.ReadSeekCloser shape of an *os.File.
+type nopSeekCloser struct {
+	*bytes.Reader
+}
+
+func (nopSeekCloser) Close() error { return nil }
@@ -0,0 +1,75 @@
+package db
+
+import (
+	"io"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+)
+
+func TestMediaStoreWriteIsContentAddressed(t *testing.T) {
+	s := NewMediaStore(t.TempDir(), 0)
+	a, err := s.write([]byte("image-a"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	again, err := s.write([]byte("image-a"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	b, err := s.write([]byte("image-b"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if a != again || a == b {
+		t.Fatalf("paths: a=%s again=%s b=%s", a, again, b)
+	}
+	if !strings.HasSuffix(a, ".png") || filepath.Base(filepath.Dir(a)) != filepath.Base(a)[:2] {
+		t.Errorf("unexpected layout %s", a)
+	}
+	if got := s.Stats().Reused; got != 1 {
+		t.Errorf("reused = %d, want 1", got)
+	}
+	data, err := os.ReadFile(a)
+	if err != nil || string(data) != "image-a" {
+		t.Fatalf("file content = %q, %v", data, err)
+	}
+}
+
+func TestMediaStoreLRU(t *testing.T) {
+	s := NewMediaStore(t.TempDir(), 10)
+	p1, _ := s.write([]byte("aaaa"))
+	p2, _ := s.write([]byte("bbbb"))
+	if _, err := s.ReadFile(p1); err != nil { // p1 becomes most recent
+		t.Fatal(err)
+	}
+	p3, _ := s.write([]byte("cccc")) // evicts p2
+	if st := s.Stats(); st.MemoryFiles != 2 || st.MemoryBytes != 8 {
+		t.Fatalf("stats = %+v", st)
+	}
+	if _, _, ok := s.lookup(p2); ok {
+		t.Error("least recently used file still in memory")
+	}
+
+	// Evicted files are streamed from disk
+	r, _, err := s.Open(p2)
+	if err != nil {
+		t.Fatal(err)
+	}
+	data, _ := io.ReadAll(r)
+	r.Close()
+	if string(data) != "bbbb" {
+		t.Errorf("read %q from disk", data)
+	}
+
+	if err := s.remove(p3); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := os.Stat(p3); !os.IsNotExist(err) {
+		t.Error("removed file still on disk")
+	}
+	if _, _, ok := s.lookup(p3); ok {
+		t.Error("removed file still in memory")
+	}
+}
@@ -0,0 +1,350 @@
+package db
+
+import (
+	"context"
+	"fmt"
+	"log/slog"
+	"sort"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/metrics"
+)
+
+// messageColumns is the column list of a message log row written by the batched writer.
+const messageColumns = "chat_id, user_id, username, first_name, text, message_id, media_type, file_id, is_bot_reply, request_id, was_throttled, reply_to_message_id, media_uri, media_uri_expires_at, created_at"
+
+const messageColumnCount = 15
+
+// maxMessageBatchSize is the most rows one INSERT can bind: Postgres allows 65535 parameters.
+const maxMessageBatchSize = 65535 / messageColumnCount
+
+// messageWriteTimeout bounds one batch INSERT, and each single-row retry of a failed batch.
+const messageWriteTimeout = 10 * time.Second
+
+// MessageWriter batches message log INSERTs off the request path. Rows are queued by InsertMessage and
+// written as one multi-row INSERT when batchSize rows are waiting or flushInterval passed since the
+// first one. The queue is bounded: when Postgres falls behind, InsertMessage blocks (backpressure)
+// instead of buffering without limit.
+//
+// created_at is set when a row is queued, so log order is arrival order even though rows are written
+// later. It therefore comes from the backend's clock, not the database's now() as for rows inserted
+// synchronously. Keyset reads (WalkMessagesBackward's (created_at, id) cursor), the monthly partition
+// a row lands in and retention all depend on it, so the backend and database clocks must agree.
+//
+// Queued and in-flight rows are overlaid on GetRecentMessages reads, so a message is visible to the
+// next context build whether or not it has been written yet (and whether or not the context cache is
+// on).
+type MessageWriter struct {
+	insert        func(ctx context.Context, batch []*Message) error // DB.insertMessageBatch; swapped out in tests
+	queue         chan *Message
+	batchSize     int
+	flushInterval time.Duration
+	writeTimeout  time.Duration // messageWriteTimeout; shortened in tests
+
+	// closeMu makes Close wait for in-progress enqueues; closed is set under its write lock.
+	closeMu sync.RWMutex
+	closed  bool
+	quit    chan struct{}
+	stopped chan struct{}
+
+	pendingMu sync.Mutex
+	pending   map[int64][]*Message // queued or being written, per chat
+
+	queued, written, batches, failed atomic.Uint64
+	blockedUs, flushMaxUs            atomic.Int64
+}
+
+// MessageWriterStats is a snapshot of the writer counters (for the admin stats endpoint).
+type MessageWriterStats struct {
+	Queued     uint64  `json:"queued"`
+	Written    uint64  `json:"written"`
+	Batches    uint64  `json:"batches"`
+	Failed     uint64  `json:"failed"`
+	Backlog    int     `json:"backlog"`
+	BlockedMs  float64 `json:"blocked_ms"`   // total time callers waited on a full queue
+	FlushMaxMs float64 `json:"flush_max_ms"` // slowest batch write
+}
+
+func newMessageWriter(insert func(context.Context, []*Message) error, batchSize int, flushInterval time.Duration, queueSize int) *MessageWriter {
+	if batchSize <= 0 {
+		batchSize = 1
+	}
+	if batchSize > maxMessageBatchSize {
+		slog.Warn("message write batch size above the bind parameter limit, clamping", "batch_size", batchSize, "max", maxMessageBatchSize)
+		batchSize = maxMessageBatchSize
+	}
+	if queueSize < batchSize {
+		queueSize = batchSize
+	}
+	w := &MessageWriter{
+		insert:        insert,
+		queue:         make(chan *Message, queueSize),
+		batchSize:     batchSize,
+		flushInterval: flushInterval,
+		writeTimeout:  messageWriteTimeout,
+		quit:          make(chan struct{}),
+		stopped:       make(chan struct{}),
+		pending:       make(map[int64][]*Message),
+	}
+	go w.run()
+	return w
+}
+
+// enqueue queues a row for the next batch. It blocks while the queue is full, until ctx ends.
+// ok is false when the writer is closed; the caller then writes the row itself.
+func (w *MessageWriter) enqueue(ctx context.Context, msg *Message) (ok bool, err error) {
+	w.closeMu.RLock()
+	defer w.closeMu.RUnlock()
+	if w.closed {
+		return false, nil
+	}
+
+	w.addPending(msg)
+	select {
+	case w.queue <- msg:
+	default:
+		start := time.Now()
+		select {
+		case w.queue <- msg:
+			w.blockedUs.Add(time.Since(start).Microseconds())
+		case <-ctx.Done():
+			w.removePending([]*Message{msg})
+			return true, fmt.Errorf("queue message: %w", ctx.Err())
+		}
+	}
+	w.queued.Add(1)
+	return true, nil
+}
+
+// Close stops accepting rows and writes everything still queued. It returns once the queue is drained
+// or ctx ends.
+func (w *MessageWriter) Close(ctx context.Context) error {
+	w.closeMu.Lock()
+	if w.closed {
+		w.closeMu.Unlock()
+		return nil
+	}
+	w.closed = true
+	w.closeMu.Unlock()
+	close(w.quit)
+
+	select {
+	case <-w.stopped:
+		return nil
+	case <-ctx.Done():
+		return fmt.Errorf("drain message writer: %w", ctx.Err())
+	}
+}
+
+func (w *MessageWriter) run() {
+	defer close(w.stopped)
+	batch := make([]*Message, 0, w.batchSize)
+	timer := time.NewTimer(time.Hour)
+	timer.Stop()
+
+	flush := func() {
+		if len(batch) > 0 {
+			w.flush(batch)
+			batch = batch[:0]
+		}
+	}
+	for {
+		select {
+		case m := <-w.queue:
+			batch = append(batch, m)
+			if len(batch) == 1 {
+				timer.Reset(w.flushInterval)
+			}
+			if len(batch) >= w.batchSize {
+				timer.Stop()
+				flush()
+			}
+		case <-timer.C:
+			flush()
+		case <-w.quit:
+			timer.Stop()
+			// No enqueue can be in progress once quit is closed; drain what is left.
+			for {
+				select {
+				case m := <-w.queue:
+					batch = append(batch, m)
+					if len(batch) >= w.batchSize {
+						flush()
+					}
+				default:
+					flush()
+					return
+				}
+			}
+		}
+	}
+}
+
+// flush writes one batch. A failed batch is retried row by row so one bad row does not drop the others.
+func (w *MessageWriter) flush(batch []*Message) {
+	defer w.removePending(batch)
+	start := time.Now()
+	ctx, cancel := context.WithTimeout(context.Background(), w.writeTimeout)
+	err := w.insert(ctx, batch)
+	cancel()
+	w.recordFlush(time.Since(start))
+	if err == nil {
+		w.written.Add(uint64(len(batch)))
+		w.batches.Add(1)
+		return
+	}
+	slog.Error("message batch insert failed, retrying rows individually", "rows", len(batch), "error", err)
+	for _, m := range batch {
+		// Each retry gets its own deadline: when the batch failed by timing out, its ctx is already done
+		ctx, cancel := context.WithTimeout(context.Background(), w.writeTimeout)
+		err := w.insert(ctx, []*Message{m})
+		cancel()
+		if err != nil {
+			w.failed.Add(1)
+			slog.Error("failed to store message", "chat_id", m.ChatID, "error", err)
+			continue
+		}
+		w.written.Add(1)
+	}
+	w.batches.Add(1)
+}
+
+func (w *MessageWriter) recordFlush(d time.Duration) {
+	us := d.Microseconds()
+	for {
+		cur := w.flushMaxUs.Load()
+		if us <= cur || w.flushMaxUs.CompareAndSwap(cur, us) {
+			return
+		}
+	}
+}
+
+func (w *MessageWriter) addPending(msg *Message) {
+	w.pendingMu.Lock()
+	w.pending[msg.ChatID] = append(w.pending[msg.ChatID], msg)
+	w.pendingMu.Unlock()
+}
+
+func (w *MessageWriter) removePending(done []*Message) {
+	w.pendingMu.Lock()
+	defer w.pendingMu.Unlock()
+	for _, m := range done {
+		rows := w.pending[m.ChatID]
+		for i, p := range rows {
+			if p == m {
+				rows = append(rows[:i], rows[i+1:]...)
+				break
+			}
+		}
+		if len(rows) == 0 {
+			delete(w.pending, m.ChatID)
+		} else {
+			w.pending[m.ChatID] = rows
+		}
+	}
+}
+
+// pendingFor returns copies of the chat's rows not yet known to be written, oldest first.
+func (w *MessageWriter) pendingFor(chatID int64) []Message {
+	w.pendingMu.Lock()
+	defer w.pendingMu.Unlock()
+	rows := w.pending[chatID]
+	if len(rows) == 0 {
+		return nil
+	}
+	out := make([]Message, len(rows))
+	for i, m := range rows {
+		out[i] = *m
+	}
+	return out
+}
+
+// Stats returns the current counters.
+func (w *MessageWriter) Stats() MessageWriterStats {
+	return MessageWriterStats{
+		Queued:     w.queued.Load(),
+		Written:    w.written.Load(),
+		Batches:    w.batches.Load(),
+		Failed:     w.failed.Load(),
+		Backlog:    len(w.queue),
+		BlockedMs:  float64(w.blockedUs.Load()) / 1000,
+		FlushMaxMs: float64(w.flushMaxUs.Load()) / 1000,
+	}
+}
+
+// insertMessageBatch writes rows with one multi-row INSERT, keeping their queued created_at, and folds
+// them into chat_activity in the same statement.
+func (d *DB) insertMessageBatch(ctx context.Context, batch []*Message) error {
+	var b strings.Builder
+	b.WriteString("WITH inserted AS (INSERT INTO messages (" + messageColumns + ") VALUES ")
+	args := make([]any, 0, len(batch)*messageColumnCount)
+	for i, m := range batch {
+		if i > 0 {
+			b.WriteString(", ")
+		}
+		b.WriteByte('(')
+		for c := 0; c < messageColumnCount; c++ {
+			if c > 0 {
+				b.WriteString(", ")
+			}
+			fmt.Fprintf(&b, "$%d", i*messageColumnCount+c+1)
+		}
+		b.WriteByte(')')
+		args = append(args,
+			m.ChatID, m.UserID, m.Username, m.FirstName,
+			m.Text, m.MessageID, m.MediaType, m.FileID,
+			m.IsBotReply, m.RequestID, m.WasThrottled, m.ReplyToMessageID,
+			m.MediaURI, m.MediaURIExpiresAt, m.CreatedAt,
+		)
+	}
+	b.WriteString(" RETURNING chat_id, created_at, is_bot_reply)" + chatActivityUpsert)
+	defer metrics.PostgresDuration.With("insert_batch").Since(time.Now())
+	if _, err := d.pool.ExecContext(ctx, b.String(), args...); err != nil {
+		return fmt.Errorf("insert message batch: %w", err)
+	}
+	return nil
+}
+
+// mergePending overlays rows not yet written onto a recent-messages read (oldest first) and returns the
+// last limit rows. pending must be snapshotted before the read: a row written in between shows up in
+// loaded and is recognised by its queued created_at and request fields.
+func mergePending(loaded, pending []Message, limit int) []Message {
+	if len(pending) == 0 {
+		return loaded
+	}
+	merged := loaded
+	for _, p := range pending {
+		if !containsMessage(loaded, p) {
+			merged = append(merged, p)
+		}
+	}
+	sort.SliceStable(merged, func(i, j int) bool { return merged[i].CreatedAt.Before(merged[j].CreatedAt) })
+	if len(merged) > limit {
+		merged = merged[len(merged)-limit:]
+	}
+	return merged
+}
+
+func containsMessage(rows []Message, m Message) bool {
+	for i := len(rows) - 1; i >= 0; i-- {
+		r := rows[i]
+		if r.CreatedAt.Equal(m.CreatedAt) && r.IsBotReply == m.IsBotReply && r.WasThrottled == m.WasThrottled &&
+			equalStringPtr(r.RequestID, m.RequestID) {
+			return true
+		}
+		if r.CreatedAt.Before(m.CreatedAt) {
+			return false
+		}
+	}
+	return false
+}
+
+func equalStringPtr(a, b *string) bool {
+	if a == nil || b == nil {
+		return a == b
+	}
+	return *a == *b
+}
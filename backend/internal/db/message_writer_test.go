@@ -0,0 +1,168 @@
+package db
+
+import (
+	"context"
+	"errors"
+	"sync"
+	"testing"
+	"time"
+)
+
+// recordingInsert collects written batches; failRow makes any batch containing it fail.
+type recordingInsert struct {
+	mu      sync.Mutex
+	batches [][]*Message
+	failRow *Message
+	block   chan struct{}
+}
+
+func (r *recordingInsert) insert(ctx context.Context, batch []*Message) error {
+	if r.block != nil {
+		<-r.block
+	}
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	for _, m := range batch {
+		if m == r.failRow {
+			return errors.New("bad row")
+		}
+	}
+	r.batches = append(r.batches, append([]*Message(nil), batch...))
+	return nil
+}
+
+func (r *recordingInsert) rows() int {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	n := 0
+	for _, b := range r.batches {
+		n += len(b)
+	}
+	return n
+}
+
+func TestMessageWriter_BatchesAndDrains(t *testing.T) {
+	rec := &recordingInsert{}
+	w := newMessageWriter(rec.insert, 3, time.Hour, 10)
+	ctx := context.Background()
+	for i := 0; i < 7; i++ {
+		if ok, err := w.enqueue(ctx, &Message{ChatID: 1}); !ok || err != nil {
+			t.Fatalf("enqueue %d: ok=%v err=%v", i, ok, err)
+		}
+	}
+	if err := w.Close(ctx); err != nil {
+		t.Fatalf("Close: %v", err)
+	}
+	if rec.rows() != 7 || len(rec.batches) != 3 {
+		t.Fatalf("expected 7 rows in 3 batches (3+3+1), got %d rows in %d batches", rec.rows(), len(rec.batches))
+	}
+	if len(w.pendingFor(1)) != 0 {
+		t.Error("expected no pending rows after drain")
+	}
+	if ok, _ := w.enqueue(ctx, &Message{ChatID: 1}); ok {
+		t.Error("expected enqueue after Close to be refused")
+	}
+}
+
+func TestMessageWriter_FlushesOnInterval(t *testing.T) {
+	rec := &recordingInsert{}
+	w := newMessageWriter(rec.insert, 100, 10*time.Millisecond, 100)
+	defer w.Close(context.Background())
+
+	w.enqueue(context.Background(), &Message{ChatID: 1})
+	deadline := time.Now().Add(2 * time.Second)
+	for rec.rows() == 0 && time.Now().Before(deadline) {
+		time.Sleep(5 * time.Millisecond)
+	}
+	if rec.rows() != 1 {
+		t.Fatal("expected partial batch to be written after the flush interval")
+	}
+}
+
+func TestMessageWriter_RetriesFailedBatchRowByRow(t *testing.T) {
+	bad := &Message{ChatID: 1}
+	rec := &recordingInsert{failRow: bad}
+	w := newMessageWriter(rec.insert, 3, time.Hour, 10)
+	ctx := context.Background()
+	w.enqueue(ctx, &Message{ChatID: 1})
+	w.enqueue(ctx, bad)
+	w.enqueue(ctx, &Message{ChatID: 1})
+	w.Close(ctx)
+
+	if rec.rows() != 2 || w.Stats().Failed != 1 {
+		t.Errorf("expected 2 rows written and 1 failed, got %d / %d", rec.rows(), w.Stats().Failed)
+	}
+}
+
+func TestMessageWriter_RetriesAfterBatchTimeoutWithFreshDeadline(t *testing.T) {
+	var mu sync.Mutex
+	calls := 0
+	insert := func(ctx context.Context, batch []*Message) error {
+		mu.Lock()
+		calls++
+		mu.Unlock()
+		if len(batch) > 1 { // the batch times out
+			<-ctx.Done()
+			return ctx.Err()
+		}
+		return ctx.Err()
+	}
+	w := newMessageWriter(insert, 2, time.Hour, 10)
+	w.writeTimeout = 20 * time.Millisecond
+	ctx := context.Background()
+	w.enqueue(ctx, &Message{ChatID: 1})
+	w.enqueue(ctx, &Message{ChatID: 1})
+	w.Close(ctx)
+
+	if st := w.Stats(); st.Written != 2 || st.Failed != 0 || calls != 3 {
+		t.Errorf("expected both rows written on retry after the batch timed out, got %+v (calls %d)", st, calls)
+	}
+}
+
+func TestMessageWriter_Backpressure(t *testing.T) {
+	rec := &recordingInsert{block: make(chan struct{})}
+	w := newMessageWriter(rec.insert, 1, time.Hour, 1)
+
+	// One row is held by the blocked insert, one fills the queue; the next must wait.
+	w.enqueue(context.Background(), &Message{ChatID: 1})
+	w.enqueue(context.Background(), &Message{ChatID: 1})
+	ctx, cancel := context.WithTimeout(context.Background(), 20*time.Millisecond)
+	defer cancel()
+	for {
+		if _, err := w.enqueue(ctx, &Message{ChatID: 1}); err != nil {
+			break
+		}
+		if ctx.Err() != nil {
+			t.Fatal("expected enqueue to block on a full queue")
+		}
+	}
+	close(rec.block)
+	w.Close(context.Background())
+}
+
+func TestMergePending_OverlaysUnwrittenRows(t *testing.T) {
+	t0 := time.Now().Truncate(time.Microsecond)
+	req := textPtr("req-1")
+	loaded := []Message{
+		{ID: 1, ChatID: 1, CreatedAt: t0},
+		// already written copy of the first pending row (queued created_at, same request)
+		{ID: 2, ChatID: 1, CreatedAt: t0.Add(time.Second), RequestID: req},
+	}
+	pending := []Message{
+		{ChatID: 1, CreatedAt: t0.Add(time.Second), RequestID: req},
+		{ChatID: 1, CreatedAt: t0.Add(2 * time.Second), RequestID: req, IsBotReply: true},
+	}
+	got := mergePending(loaded, pending, 2)
+	if len(got) != 2 || got[0].ID != 2 || !got[1].IsBotReply {
+		t.Fatalf("expected [written row 2, pending bot reply], got %+v", got)
+	}
+}
+
+func TestMessageWriter_ClampsBatchSizeToBindParameterLimit(t *testing.T) {
+	rec := &recordingInsert{}
+	w := newMessageWriter(rec.insert, 10000, time.Hour, 10)
+	defer w.Close(context.Background())
+	if w.batchSize != maxMessageBatchSize || w.batchSize*messageColumnCount > 65535 {
+		t.Errorf("expected batch size clamped to %d, got %d", maxMessageBatchSize, w.batchSize)
+	}
+}
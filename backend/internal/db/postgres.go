@@ -5,8 +5,10 @@ import (
 	"database/sql"
 	"fmt"
 	"log/slog"
+	"math"
 	"time"
 
+	"github.com/ThatHunky/gryag/backend/internal/metrics"
 	_ "github.com/lib/pq"
 )
 
@@ -25,6 +27,8 @@ type Message struct {
 	RequestID          *string
 	WasThrottled       bool
 	ReplyToMessageID   *int64
+	MediaURI           *string    // Gemini Files API URI of the attachment (see GetMediaURI)
+	MediaURIExpiresAt  *time.Time
 	CreatedAt          time.Time
 }
 
@@ -40,19 +44,24 @@ type UserFact struct {
 
 // DB wraps the PostgreSQL connection pool.
 type DB struct {
-	pool *sql.DB
+	pool   *sql.DB
+	stmts  *stmtCache     // nil when prepared statements are disabled
+	cache  *ContextCache  // optional; see EnableContextCache
+	writer *MessageWriter // optional; see EnableMessageWriter
+	media  *MediaStore    // optional; see EnableMediaStore
 }
 
 // New creates a new DB connection pool.
-func New(dsn string) (*DB, error) {
+func New(dsn string, opts PoolOptions) (*DB, error) {
 	pool, err := sql.Open("postgres", dsn)
 	if err != nil {
 		return nil, fmt.Errorf("db open: %w", err)
 	}
 
-	pool.SetMaxOpenConns(25)
-	pool.SetMaxIdleConns(5)
-	pool.SetConnMaxLifetime(5 * time.Minute)
+	pool.SetMaxOpenConns(opts.MaxOpenConns)
+	pool.SetMaxIdleConns(opts.MaxIdleConns)
+	pool.SetConnMaxLifetime(opts.ConnMaxLifetime)
+	pool.SetConnMaxIdleTime(opts.ConnMaxIdleTime)
 
 	ctx, cancel := context.WithTimeout(context.Background(), 5*time.Second)
 	defer cancel()
@@ -61,12 +70,17 @@ func New(dsn string) (*DB, error) {
 		return nil, fmt.Errorf("db ping: %w", err)
 	}
 
-	slog.Info("postgres connected")
-	return &DB{pool: pool}, nil
+	d := &DB{pool: pool}
+	if opts.PreparedStatements {
+		d.stmts = &stmtCache{stmts: make(map[string]*sql.Stmt)}
+	}
+	slog.Info("postgres connected", "max_open_conns", opts.MaxOpenConns, "max_idle_conns", opts.MaxIdleConns, "prepared_statements", opts.PreparedStatements)
+	return d, nil
 }
 
 // Close shuts down the connection pool.
 func (d *DB) Close() error {
+	d.closeStatements()
 	return d.pool.Close()
 }
 
@@ -75,29 +89,131 @@ func (d *DB) Pool() *sql.DB {
 	return d.pool
 }
 
+// EnableContextCache turns on the in-process context cache for recent messages, summaries and user facts.
+// ringSize should be at least the context size requested by callers (ImmediateContextSize); larger reads
+// bypass the cache. Call once at startup, before serving requests.
+func (d *DB) EnableContextCache(maxChats, ringSize int) {
+	d.cache = NewContextCache(maxChats, ringSize)
+	slog.Info("context cache enabled", "max_chats", maxChats, "ring_size", ringSize)
+}
+
+// ContextCacheStats returns cache hit/miss counters; ok is false when the cache is disabled.
+func (d *DB) ContextCacheStats() (stats ContextCacheStats, ok bool) {
+	if d == nil || d.cache == nil {
+		return ContextCacheStats{}, false
+	}
+	return d.cache.Stats(), true
+}
+
+// EnableMessageWriter makes InsertMessage queue rows for batched background INSERTs (see MessageWriter).
+// Call once at startup, before serving requests, and CloseMessageWriter on shutdown.
+func (d *DB) EnableMessageWriter(batchSize int, flushInterval time.Duration, queueSize int) {
+	d.writer = newMessageWriter(d.insertMessageBatch, batchSize, flushInterval, queueSize)
+	slog.Info("message writer enabled", "batch_size", batchSize, "flush_interval", flushInterval, "queue_size", queueSize)
+}
+
+// CloseMessageWriter writes all queued messages and switches InsertMessage back to direct INSERTs.
+func (d *DB) CloseMessageWriter(ctx context.Context) error {
+	if d.writer == nil {
+		return nil
+	}
+	return d.writer.Close(ctx)
+}
+
+// MessageWriterStats returns the batched writer counters; ok is false when the writer is disabled.
+func (d *DB) MessageWriterStats() (stats MessageWriterStats, ok bool) {
+	if d == nil || d.writer == nil {
+		return MessageWriterStats{}, false
+	}
+	return d.writer.Stats(), true
+}
+
+// pendingMessages returns the chat's rows queued in the message writer but not yet written.
+func (d *DB) pendingMessages(chatID int64) []Message {
+	if d.writer == nil {
+		return nil
+	}
+	return d.writer.pendingFor(chatID)
+}
+
 // ── Message Operations ──────────────────────────────────────────────────
 
 // InsertMessage stores a message in the log. Throttled messages use wasThrottled=true.
+// With the message writer enabled the row is queued (blocking while the queue is full) and written in
+// the next batch; the returned id is then 0. Reads through this DB see the row immediately either way.
 func (d *DB) InsertMessage(ctx context.Context, msg *Message) (int64, error) {
+	defer metrics.Stage("db_insert", time.Now())
+	if d.writer != nil {
+		row := *msg
+		// Postgres keeps microseconds; truncating keeps the queued row comparable with the written one.
+		row.CreatedAt = time.Now().Truncate(time.Microsecond)
+		queued, err := d.writer.enqueue(ctx, &row)
+		if err != nil {
+			return 0, fmt.Errorf("insert message: %w", err)
+		}
+		if queued {
+			if d.cache != nil {
+				d.cache.appendMessage(row)
+			}
+			return 0, nil
+		}
+	}
+
 	const query = `
-		INSERT INTO messages (chat_id, user_id, username, first_name, text, message_id, media_type, file_id, is_bot_reply, request_id, was_throttled, reply_to_message_id)
-		VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12)
-		RETURNING id`
+		WITH inserted AS (
+			INSERT INTO messages (chat_id, user_id, username, first_name, text, message_id, media_type, file_id, is_bot_reply, request_id, was_throttled, reply_to_message_id, media_uri, media_uri_expires_at)
+			VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, $13, $14)
+			RETURNING id, chat_id, created_at, is_bot_reply
+		), activity AS (` + chatActivityUpsert + `
+		)
+		SELECT id, created_at FROM inserted`
 
 	var id int64
-	err := d.pool.QueryRowContext(ctx, query,
+	var createdAt time.Time
+	err := d.queryRowContext(ctx, query,
 		msg.ChatID, msg.UserID, msg.Username, msg.FirstName,
 		msg.Text, msg.MessageID, msg.MediaType, msg.FileID,
 		msg.IsBotReply, msg.RequestID, msg.WasThrottled, msg.ReplyToMessageID,
-	).Scan(&id)
+		msg.MediaURI, msg.MediaURIExpiresAt,
+	).Scan(&id, &createdAt)
 	if err != nil {
 		return 0, fmt.Errorf("insert message: %w", err)
 	}
+	if d.cache != nil {
+		cached := *msg
+		cached.ID = id
+		cached.CreatedAt = createdAt
+		d.cache.appendMessage(cached)
+	}
 	return id, nil
 }
 
 // GetRecentMessages returns the last N messages for a chat, ordered oldest to newest.
+// Served from the context cache when enabled and limit fits in its ring.
 func (d *DB) GetRecentMessages(ctx context.Context, chatID int64, limit int) ([]Message, error) {
+	if d.cache == nil || limit > d.cache.ringSize {
+		return d.queryRecentMessages(ctx, chatID, limit)
+	}
+	if messages, ok := d.cache.recentMessages(chatID, limit); ok {
+		return messages, nil
+	}
+	gen := d.cache.generation(chatID, kindMessages)
+	messages, err := d.queryRecentMessages(ctx, chatID, d.cache.ringSize)
+	if err != nil {
+		return nil, err
+	}
+	d.cache.storeMessages(chatID, gen, messages)
+	if len(messages) > limit {
+		messages = messages[len(messages)-limit:]
+	}
+	return messages, nil
+}
+
+// queryRecentMessages loads the last N messages for a chat from Postgres, ordered oldest to newest,
+// including rows still queued in the message writer.
+func (d *DB) queryRecentMessages(ctx context.Context, chatID int64, limit int) ([]Message, error) {
+	// Snapshot before the read, so a row written meanwhile is found in one of the two
+	pending := d.pendingMessages(chatID)
 	const query = `
 		SELECT id, chat_id, user_id, username, first_name, text, message_id, media_type, is_bot_reply, request_id, was_throttled, reply_to_message_id, created_at
 		FROM messages
@@ -105,7 +221,7 @@ func (d *DB) GetRecentMessages(ctx context.Context, chatID int64, limit int) ([]
 		ORDER BY created_at DESC
 		LIMIT $2`
 
-	rows, err := d.pool.QueryContext(ctx, query, chatID, limit)
+	rows, err := d.queryContext(ctx, query, chatID, limit)
 	if err != nil {
 		return nil, fmt.Errorf("get recent messages: %w", err)
 	}
@@ -123,30 +239,60 @@ func (d *DB) GetRecentMessages(ctx context.Context, chatID int64, limit int) ([]
 		}
 		messages = append(messages, m)
 	}
+	if err := rows.Err(); err != nil {
+		return nil, fmt.Errorf("get recent messages: %w", err)
+	}
 
 	// Reverse to oldest-first order
 	for i, j := 0, len(messages)-1; i < j; i, j = i+1, j-1 {
 		messages[i], messages[j] = messages[j], messages[i]
 	}
 
-	return messages, nil
+	return mergePending(messages, pending, limit), nil
 }
 
-// GetMessagesInRange returns messages for a chat within a time window, ordered oldest to newest.
-// Limit caps the number of messages to avoid unbounded result sets (e.g. 2000).
-func (d *DB) GetMessagesInRange(ctx context.Context, chatID int64, since, until time.Time, limit int) ([]Message, error) {
+// messagePageSize is how many rows one keyset page of WalkMessagesBackward fetches.
+const messagePageSize = 200
+
+// WalkMessagesBackward calls fn for a chat's messages in [since, until], newest first, until fn returns
+// false or the window is exhausted. Rows are read in keyset pages on (chat_id, created_at, id), so
+// memory stays at one page however many messages the window holds and the caller can stop as soon as
+// it has enough.
+func (d *DB) WalkMessagesBackward(ctx context.Context, chatID int64, since, until time.Time, fn func(Message) bool) error {
 	const query = `
 		SELECT id, chat_id, user_id, username, first_name, text, message_id, media_type, is_bot_reply, request_id, was_throttled, reply_to_message_id, created_at
 		FROM messages
-		WHERE chat_id = $1 AND created_at >= $2 AND created_at <= $3
-		ORDER BY created_at ASC
-		LIMIT $4`
-	rows, err := d.pool.QueryContext(ctx, query, chatID, since, until, limit)
+		WHERE chat_id = $1 AND created_at >= $2 AND (created_at, id) < ($3, $4)
+		ORDER BY created_at DESC, id DESC
+		LIMIT $5`
+	// The first page starts just past until; (until, MaxInt64) also covers rows exactly at until.
+	cursorAt, cursorID := until, int64(math.MaxInt64)
+	for {
+		page, err := d.messagePage(ctx, query, chatID, since, cursorAt, cursorID)
+		if err != nil {
+			return err
+		}
+		for _, m := range page {
+			if !fn(m) {
+				return nil
+			}
+		}
+		if len(page) < messagePageSize {
+			return nil
+		}
+		last := page[len(page)-1]
+		cursorAt, cursorID = last.CreatedAt, last.ID
+	}
+}
+
+// messagePage reads one keyset page for WalkMessagesBackward.
+func (d *DB) messagePage(ctx context.Context, query string, chatID int64, since, cursorAt time.Time, cursorID int64) ([]Message, error) {
+	rows, err := d.queryContext(ctx, query, chatID, since, cursorAt, cursorID, messagePageSize)
 	if err != nil {
-		return nil, fmt.Errorf("get messages in range: %w", err)
+		return nil, fmt.Errorf("walk messages: %w", err)
 	}
 	defer rows.Close()
-	var messages []Message
+	page := make([]Message, 0, messagePageSize)
 	for rows.Next() {
 		var m Message
 		if err := rows.Scan(
@@ -156,38 +302,44 @@ func (d *DB) GetMessagesInRange(ctx context.Context, chatID int64, since, until
 		); err != nil {
 			return nil, fmt.Errorf("scan message: %w", err)
 		}
-		messages = append(messages, m)
+		page = append(page, m)
 	}
-	return messages, nil
+	if err := rows.Err(); err != nil {
+		return nil, fmt.Errorf("walk messages: %w", err)
+	}
+	return page, nil
 }
 
-// GetRecentChatIDs returns distinct chat_id values that have messages since the given duration,
-// ordered by most recent activity first (for proactive messaging candidate selection).
+// GetRecentChatIDs returns the chats that have messages since the given duration, ordered by most
+// recent activity first (summarizer candidate selection). Read from chat_activity, one row per chat.
 func (d *DB) GetRecentChatIDs(ctx context.Context, since time.Duration) ([]int64, error) {
-	const query = `
-		SELECT chat_id
-		FROM messages
-		WHERE created_at > $1
-		GROUP BY chat_id
-		ORDER BY MAX(created_at) DESC`
-	rows, err := d.pool.QueryContext(ctx, query, time.Now().Add(-since))
+	chats, err := d.GetChatActivity(ctx, since)
 	if err != nil {
 		return nil, fmt.Errorf("get recent chat ids: %w", err)
 	}
-	defer rows.Close()
-	var ids []int64
-	for rows.Next() {
-		var id int64
-		if err := rows.Scan(&id); err != nil {
-			return nil, fmt.Errorf("scan chat_id: %w", err)
-		}
-		ids = append(ids, id)
+	ids := make([]int64, len(chats))
+	for i, c := range chats {
+		ids[i] = c.ChatID
 	}
 	return ids, nil
 }
 
 // ── Chat Summary Operations ─────────────────────────────────────────────
 
+// SummaryTypeDaily is the summary type of the per-day chunks the 7-day and 30-day summaries are
+// built from. Chunks are never read into the prompt directly.
+const SummaryTypeDaily = "1day"
+
+// ChatSummary is a stored summary row.
+type ChatSummary struct {
+	ID          int64
+	ChatID      int64
+	SummaryType string
+	SummaryText string
+	PeriodStart time.Time
+	PeriodEnd   time.Time
+}
+
 // InsertChatSummary stores a new 7-day or 30-day summary for a chat.
 func (d *DB) InsertChatSummary(ctx context.Context, chatID int64, summaryType, summaryText string, periodStart, periodEnd time.Time) (int64, error) {
 	const query = `
@@ -195,27 +347,89 @@ func (d *DB) InsertChatSummary(ctx context.Context, chatID int64, summaryType, s
 		VALUES ($1, $2, $3, $4, $5)
 		RETURNING id`
 	var id int64
-	err := d.pool.QueryRowContext(ctx, query, chatID, summaryType, summaryText, periodStart, periodEnd).Scan(&id)
+	err := d.queryRowContext(ctx, query, chatID, summaryType, summaryText, periodStart, periodEnd).Scan(&id)
 	if err != nil {
 		return 0, fmt.Errorf("insert chat summary: %w", err)
 	}
+	if d.cache != nil {
+		d.cache.addSummary(chatID, summaryType, summaryText, periodEnd)
+	}
 	return id, nil
 }
 
+// InsertDailySummary stores the chunk for one day of a chat. A chunk already stored for that day is
+// kept (a concurrent run got there first).
+func (d *DB) InsertDailySummary(ctx context.Context, chatID int64, summaryText string, periodStart, periodEnd time.Time) error {
+	const query = `
+		INSERT INTO chat_summaries (chat_id, summary_type, summary_text, period_start, period_end)
+		VALUES ($1, '1day', $2, $3, $4)
+		ON CONFLICT (chat_id, period_start) WHERE summary_type = '1day' DO NOTHING`
+	if _, err := d.execContext(ctx, query, chatID, summaryText, periodStart, periodEnd); err != nil {
+		return fmt.Errorf("insert daily summary: %w", err)
+	}
+	return nil
+}
+
+// GetDailySummaries returns a chat's daily chunks starting in [since, until), oldest first.
+func (d *DB) GetDailySummaries(ctx context.Context, chatID int64, since, until time.Time) ([]ChatSummary, error) {
+	const query = `
+		SELECT id, chat_id, summary_type, summary_text, period_start, period_end
+		FROM chat_summaries
+		WHERE chat_id = $1 AND summary_type = '1day' AND period_start >= $2 AND period_start < $3
+		ORDER BY period_start ASC`
+	rows, err := d.queryContext(ctx, query, chatID, since, until)
+	if err != nil {
+		return nil, fmt.Errorf("get daily summaries: %w", err)
+	}
+	defer rows.Close()
+	var out []ChatSummary
+	for rows.Next() {
+		var s ChatSummary
+		if err := rows.Scan(&s.ID, &s.ChatID, &s.SummaryType, &s.SummaryText, &s.PeriodStart, &s.PeriodEnd); err != nil {
+			return nil, fmt.Errorf("scan daily summary: %w", err)
+		}
+		out = append(out, s)
+	}
+	if err := rows.Err(); err != nil {
+		return nil, fmt.Errorf("get daily summaries: %w", err)
+	}
+	return out, nil
+}
+
+// DeleteDailySummariesBefore removes daily chunks of days starting before cutoff (no longer inside any
+// summary window).
+func (d *DB) DeleteDailySummariesBefore(ctx context.Context, cutoff time.Time) (int64, error) {
+	result, err := d.execContext(ctx,
+		"DELETE FROM chat_summaries WHERE summary_type = '1day' AND period_start < $1", cutoff)
+	if err != nil {
+		return 0, fmt.Errorf("delete daily summaries: %w", err)
+	}
+	n, _ := result.RowsAffected()
+	return n, nil
+}
+
 // GetLatestSummary returns the most recent summary text for a chat and type (7day or 30day), or empty string if none.
 func (d *DB) GetLatestSummary(ctx context.Context, chatID int64, summaryType string) (string, error) {
+	var gen uint64
+	if d.cache != nil {
+		if text, ok := d.cache.latestSummary(chatID, summaryType); ok {
+			return text, nil
+		}
+		gen = d.cache.generation(chatID, kindSummaries)
+	}
 	const query = `
-		SELECT summary_text FROM chat_summaries
+		SELECT summary_text, period_end FROM chat_summaries
 		WHERE chat_id = $1 AND summary_type = $2
 		ORDER BY period_end DESC LIMIT 1`
 	var text string
-	err := d.pool.QueryRowContext(ctx, query, chatID, summaryType).Scan(&text)
-	if err == sql.ErrNoRows {
-		return "", nil
-	}
-	if err != nil {
+	var periodEnd time.Time
+	err := d.queryRowContext(ctx, query, chatID, summaryType).Scan(&text, &periodEnd)
+	if err != nil && err != sql.ErrNoRows {
 		return "", fmt.Errorf("get latest summary: %w", err)
 	}
+	if d.cache != nil {
+		d.cache.storeSummary(chatID, gen, summaryType, text, periodEnd)
+	}
 	return text, nil
 }
 
@@ -227,28 +441,38 @@ func (d *DB) InsertUserFact(ctx context.Context, chatID, userID int64, factText
 		INSERT INTO user_facts (chat_id, user_id, fact_text)
 		VALUES ($1, $2, $3)
 		ON CONFLICT (chat_id, user_id, md5(fact_text)) DO NOTHING
-		RETURNING id`
+		RETURNING id, created_at, updated_at`
 
-	var id int64
-	err := d.pool.QueryRowContext(ctx, query, chatID, userID, factText).Scan(&id)
+	f := UserFact{ChatID: chatID, UserID: userID, FactText: factText}
+	err := d.queryRowContext(ctx, query, chatID, userID, factText).Scan(&f.ID, &f.CreatedAt, &f.UpdatedAt)
 	if err == sql.ErrNoRows {
 		return 0, nil // duplicate — silently ignored
 	}
 	if err != nil {
 		return 0, fmt.Errorf("insert user fact: %w", err)
 	}
-	return id, nil
+	if d.cache != nil {
+		d.cache.addUserFact(f)
+	}
+	return f.ID, nil
 }
 
 // GetUserFacts returns all facts stored for a specific user in a chat.
 func (d *DB) GetUserFacts(ctx context.Context, chatID, userID int64) ([]UserFact, error) {
+	var gen uint64
+	if d.cache != nil {
+		if facts, ok := d.cache.userFacts(chatID, userID); ok {
+			return facts, nil
+		}
+		gen = d.cache.generation(chatID, kindFacts)
+	}
 	const query = `
 		SELECT id, chat_id, user_id, fact_text, created_at, updated_at
 		FROM user_facts
 		WHERE chat_id = $1 AND user_id = $2
 		ORDER BY created_at ASC`
 
-	rows, err := d.pool.QueryContext(ctx, query, chatID, userID)
+	rows, err := d.queryContext(ctx, query, chatID, userID)
 	if err != nil {
 		return nil, fmt.Errorf("get user facts: %w", err)
 	}
@@ -262,14 +486,27 @@ func (d *DB) GetUserFacts(ctx context.Context, chatID, userID int64) ([]UserFact
 		}
 		facts = append(facts, f)
 	}
+	if err := rows.Err(); err != nil {
+		return nil, fmt.Errorf("get user facts: %w", err)
+	}
+	if d.cache != nil {
+		d.cache.storeUserFacts(chatID, userID, gen, facts)
+	}
 	return facts, nil
 }
 
 // DeleteUserFact removes a specific fact by ID.
 func (d *DB) DeleteUserFact(ctx context.Context, factID int64) error {
-	_, err := d.pool.ExecContext(ctx, "DELETE FROM user_facts WHERE id = $1", factID)
+	var chatID, userID int64
+	err := d.queryRowContext(ctx, "DELETE FROM user_facts WHERE id = $1 RETURNING chat_id, user_id", factID).Scan(&chatID, &userID)
+	if err == sql.ErrNoRows {
+		return nil
+	}
 	if err != nil {
 		return fmt.Errorf("delete user fact: %w", err)
 	}
+	if d.cache != nil {
+		d.cache.removeUserFact(chatID, userID, factID)
+	}
 	return nil
 }
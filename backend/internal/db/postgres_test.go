@@ -0,0 +1,117 @@
+package db
+
+import (
+	"context"
+	"fmt"
+	"os"
+	"testing"
+	"time"
+)
+
+// benchChatID is the chat the Postgres benchmarks write to; its rows are deleted afterwards.
+const benchChatID = -1009999999999
+
+// getTestDB connects to POSTGRES_TEST_DSN (e.g. the bench compose stack's Postgres) and applies the
+// migrations. Skips when it is unset or unreachable.
+func getTestDB(tb testing.TB, opts PoolOptions) *DB {
+	tb.Helper()
+	dsn := os.Getenv("POSTGRES_TEST_DSN")
+	if dsn == "" {
+		tb.Skip("skipping postgres benchmarks: POSTGRES_TEST_DSN not set")
+	}
+	d, err := New(dsn, opts)
+	if err != nil {
+		tb.Skipf("skipping postgres benchmarks: %v", err)
+	}
+	if err := RunMigrations(d.Pool(), "../../../migrations"); err != nil {
+		d.Close()
+		tb.Fatalf("migrations: %v", err)
+	}
+	tb.Cleanup(func() {
+		ctx := context.Background()
+		d.Pool().ExecContext(ctx, `DELETE FROM messages WHERE chat_id = $1`, benchChatID)
+		d.Pool().ExecContext(ctx, `DELETE FROM chat_activity WHERE chat_id = $1`, benchChatID)
+		d.Close()
+	})
+	return d
+}
+
+func benchOptions(prepared bool) PoolOptions {
+	return PoolOptions{MaxOpenConns: 25, MaxIdleConns: 25, ConnMaxLifetime: time.Hour, ConnMaxIdleTime: time.Minute, PreparedStatements: prepared}
+}
+
+func benchMessage(i int) *Message {
+	userID, messageID := int64(100+i%7), int64(i)
+	name, text := fmt.Sprintf("user%d", i%7), fmt.Sprintf("benchmark message %d with some ordinary chat text", i)
+	return &Message{ChatID: benchChatID, UserID: &userID, FirstName: &name, Text: &text, MessageID: &messageID}
+}
+
+// Run with: POSTGRES_TEST_DSN=... go test -run '^$' -bench Postgres ./internal/db
+func BenchmarkPostgresInsertMessage(b *testing.B) {
+	for _, bc := range []struct {
+		name     string
+		prepared bool
+		writer   bool
+	}{
+		{"sync", false, false},
+		{"sync_prepared", true, false},
+		{"message_writer", true, true},
+	} {
+		b.Run(bc.name, func(b *testing.B) {
+			d := getTestDB(b, benchOptions(bc.prepared))
+			if bc.writer {
+				d.EnableMessageWriter(100, 50*time.Millisecond, 10000)
+			}
+			ctx := context.Background()
+			b.ResetTimer()
+			b.RunParallel(func(pb *testing.PB) {
+				i := 0
+				for pb.Next() {
+					if _, err := d.InsertMessage(ctx, benchMessage(i)); err != nil {
+						b.Error(err)
+						return
+					}
+					i++
+				}
+			})
+			if bc.writer {
+				// Count the drain, so the writer is not credited with rows it has not written yet
+				if err := d.CloseMessageWriter(ctx); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
+
+func BenchmarkPostgresGetRecentMessages(b *testing.B) {
+	for _, bc := range []struct {
+		name   string
+		cached bool
+	}{
+		{"query", false},
+		{"context_cache", true},
+	} {
+		b.Run(bc.name, func(b *testing.B) {
+			d := getTestDB(b, benchOptions(true))
+			if bc.cached {
+				d.EnableContextCache(100, 50)
+			}
+			ctx := context.Background()
+			for i := 0; i < 200; i++ {
+				if _, err := d.InsertMessage(ctx, benchMessage(i)); err != nil {
+					b.Fatal(err)
+				}
+			}
+			b.ResetTimer()
+			b.RunParallel(func(pb *testing.PB) {
+				for pb.Next() {
+					if _, err := d.GetRecentMessages(ctx, benchChatID, 50); err != nil {
+						b.Error(err)
+						return
+					}
+				}
+			})
+		})
+	}
+}
@@ -4,27 +4,211 @@ import (
 	"context"
 	"fmt"
 	"log/slog"
+	"strings"
+	"time"
 )
 
-// PruneOldMessages deletes messages older than retentionDays.
-// Called on startup to enforce the configured retention policy.
-func (d *DB) PruneOldMessages(ctx context.Context, retentionDays int) (int64, error) {
+// messages is range-partitioned by created_at into monthly partitions named messages_pYYYYMM (UTC
+// month boundaries), plus messages_default for rows outside every partition (see migration 004).
+const (
+	messagePartitionPrefix  = "messages_p"
+	messagePartitionLayout  = "200601"
+	messageDefaultPartition = "messages_default"
+	// messagePartitionsAhead is how many months beyond the current one are created in advance.
+	messagePartitionsAhead = 2
+)
+
+// messagePartitionName returns the partition holding month m.
+func messagePartitionName(m time.Time) string {
+	return messagePartitionPrefix + m.UTC().Format(messagePartitionLayout)
+}
+
+// parseMessagePartition returns the month a partition name covers. ok is false for names that are not
+// monthly partitions (messages_default, partitions created by hand).
+func parseMessagePartition(name string) (month time.Time, ok bool) {
+	suffix, found := strings.CutPrefix(name, messagePartitionPrefix)
+	if !found {
+		return time.Time{}, false
+	}
+	m, err := time.Parse(messagePartitionLayout, suffix)
+	if err != nil {
+		return time.Time{}, false
+	}
+	return m, true
+}
+
+// monthStart truncates t to the first instant of its UTC month.
+func monthStart(t time.Time) time.Time {
+	t = t.UTC()
+	return time.Date(t.Year(), t.Month(), 1, 0, 0, 0, 0, time.UTC)
+}
+
+// EnsureMessagePartitions creates the partitions for the current month and monthsAhead following
+// months, so inserts never fall into messages_default.
+func (d *DB) EnsureMessagePartitions(ctx context.Context, now time.Time, monthsAhead int) error {
+	start := monthStart(now)
+	for i := 0; i <= monthsAhead; i++ {
+		from := start.AddDate(0, i, 0)
+		to := from.AddDate(0, 1, 0)
+		// DDL takes no bind parameters; the name and bounds are generated here, not user input.
+		query := fmt.Sprintf(
+			"CREATE TABLE IF NOT EXISTS %s PARTITION OF messages FOR VALUES FROM ('%s') TO ('%s')",
+			messagePartitionName(from), from.Format(time.RFC3339), to.Format(time.RFC3339),
+		)
+		if _, err := d.pool.ExecContext(ctx, query); err != nil {
+			return fmt.Errorf("create message partition %s: %w", messagePartitionName(from), err)
+		}
+	}
+	return nil
+}
+
+// messagePartitionLockTimeout bounds how long detaching a partition may wait for its locks. A DDL
+// statement queued for a lock on messages blocks every insert and read queued behind it; on timeout the
+// partition is left for the next maintenance pass.
+const messagePartitionLockTimeout = "3s"
+
+// messageTable is a monthly partition of messages, or a table detached from it but not dropped yet.
+type messageTable struct {
+	name          string
+	attached      bool
+	detachPending bool // an interrupted DETACH ... CONCURRENTLY, completed with FINALIZE
+}
+
+// listMessageTables returns the monthly message tables and whether messages has a default partition.
+func (d *DB) listMessageTables(ctx context.Context) (tables []messageTable, hasDefault bool, err error) {
+	rows, err := d.pool.QueryContext(ctx,
+		`SELECT c.relname, i.inhrelid IS NOT NULL, COALESCE(i.inhdetachpending, FALSE)
+		 FROM pg_class c
+		 LEFT JOIN pg_inherits i ON i.inhrelid = c.oid AND i.inhparent = 'messages'::regclass
+		 WHERE c.relnamespace = to_regnamespace(current_schema()) AND c.relkind = 'r'
+		   AND (c.relname LIKE 'messages\_p%' OR c.relname = $1)`, messageDefaultPartition)
+	if err != nil {
+		return nil, false, fmt.Errorf("list message partitions: %w", err)
+	}
+	defer rows.Close()
+	for rows.Next() {
+		var t messageTable
+		if err := rows.Scan(&t.name, &t.attached, &t.detachPending); err != nil {
+			return nil, false, fmt.Errorf("scan message partition: %w", err)
+		}
+		if t.name == messageDefaultPartition {
+			hasDefault = hasDefault || t.attached
+			continue
+		}
+		tables = append(tables, t)
+	}
+	if err := rows.Err(); err != nil {
+		return nil, false, fmt.Errorf("list message partitions: %w", err)
+	}
+	return tables, hasDefault, nil
+}
+
+// DropExpiredMessagePartitions enforces the retention policy: monthly partitions whose whole range is
+// older than retentionDays are dropped (no row-by-row DELETE, no index bloat), and stray old rows in
+// messages_default are deleted. Retention is therefore month-granular: a message is kept for at least
+// retentionDays and at most about a month longer.
+//
+// A partition is detached before it is dropped, so the DROP does not lock messages. DETACH ...
+// CONCURRENTLY only needs a SHARE UPDATE EXCLUSIVE lock, but Postgres refuses it while messages has a
+// default partition; the plain DETACH used then takes an ACCESS EXCLUSIVE lock, held for a catalog
+// update only. Both wait at most messagePartitionLockTimeout.
+func (d *DB) DropExpiredMessagePartitions(ctx context.Context, now time.Time, retentionDays int) (int, error) {
 	if retentionDays <= 0 {
-		slog.Info("message retention disabled (0 days = keep forever)")
 		return 0, nil
 	}
+	cutoff := now.Add(-time.Duration(retentionDays) * 24 * time.Hour)
+
+	tables, hasDefault, err := d.listMessageTables(ctx)
+	if err != nil {
+		return 0, err
+	}
+	var expired []messageTable
+	for _, t := range tables {
+		if m, ok := parseMessagePartition(t.name); ok && !m.AddDate(0, 1, 0).After(cutoff) {
+			expired = append(expired, t)
+		}
+	}
+
+	dropped := 0
+	if len(expired) > 0 {
+		// lock_timeout is a session setting: use one connection and reset it before returning it
+		conn, err := d.pool.Conn(ctx)
+		if err != nil {
+			return 0, fmt.Errorf("drop message partitions: %w", err)
+		}
+		defer conn.Close()
+		if _, err := conn.ExecContext(ctx, "SET lock_timeout = '"+messagePartitionLockTimeout+"'"); err != nil {
+			return 0, fmt.Errorf("set lock timeout: %w", err)
+		}
+		defer conn.ExecContext(context.WithoutCancel(ctx), "RESET lock_timeout")
+
+		for _, t := range expired {
+			// DDL takes no bind parameters; the name comes from pg_class and matched the partition pattern.
+			var detach string
+			switch {
+			case t.detachPending:
+				detach = "ALTER TABLE messages DETACH PARTITION " + t.name + " FINALIZE"
+			case t.attached && !hasDefault:
+				detach = "ALTER TABLE messages DETACH PARTITION " + t.name + " CONCURRENTLY"
+			case t.attached:
+				detach = "ALTER TABLE messages DETACH PARTITION " + t.name
+			}
+			if detach != "" {
+				if _, err := conn.ExecContext(ctx, detach); err != nil {
+					return dropped, fmt.Errorf("detach message partition %s: %w", t.name, err)
+				}
+			}
+			if _, err := conn.ExecContext(ctx, "DROP TABLE IF EXISTS "+t.name); err != nil {
+				return dropped, fmt.Errorf("drop message partition %s: %w", t.name, err)
+			}
+			dropped++
+			slog.Info("dropped expired message partition", "partition", t.name, "retention_days", retentionDays)
+		}
+	}
 
 	result, err := d.pool.ExecContext(ctx,
-		"DELETE FROM messages WHERE created_at < NOW() - INTERVAL '1 day' * $1",
-		retentionDays,
-	)
+		"DELETE FROM "+messageDefaultPartition+" WHERE created_at < $1", cutoff)
 	if err != nil {
-		return 0, fmt.Errorf("prune old messages: %w", err)
+		return dropped, fmt.Errorf("prune default message partition: %w", err)
+	}
+	if count, _ := result.RowsAffected(); count > 0 {
+		slog.Info("pruned old messages from default partition", "deleted", count, "retention_days", retentionDays)
 	}
+	if err := d.pruneChatActivity(ctx, cutoff); err != nil {
+		return dropped, err
+	}
+	return dropped, nil
+}
+
+// maintainMessages runs one maintenance pass: create upcoming partitions, then apply retention.
+func (d *DB) maintainMessages(ctx context.Context, retentionDays int) {
+	now := time.Now()
+	if err := d.EnsureMessagePartitions(ctx, now, messagePartitionsAhead); err != nil {
+		slog.Error("message partition maintenance failed", "error", err)
+	}
+	if _, err := d.DropExpiredMessagePartitions(ctx, now, retentionDays); err != nil {
+		slog.Warn("message retention cleanup failed", "error", err)
+	}
+}
 
-	count, _ := result.RowsAffected()
-	if count > 0 {
-		slog.Info("pruned old messages", "deleted", count, "retention_days", retentionDays)
+// RunMessageMaintenance keeps the messages partitions in shape: it runs one pass right away and then
+// every interval until ctx is cancelled. Meant to be started in its own goroutine.
+func (d *DB) RunMessageMaintenance(ctx context.Context, retentionDays int, interval time.Duration) {
+	if retentionDays <= 0 {
+		slog.Info("message retention disabled (0 days = keep forever)")
+	}
+	d.maintainMessages(ctx, retentionDays)
+	if interval <= 0 {
+		return
+	}
+	ticker := time.NewTicker(interval)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-ctx.Done():
+			return
+		case <-ticker.C:
+			d.maintainMessages(ctx, retentionDays)
+		}
 	}
-	return count, nil
 }
@@ -0,0 +1,35 @@
+package db
+
+import (
+	"testing"
+	"time"
+)
+
+func TestMessagePartitionNameRoundTrip(t *testing.T) {
+	m := time.Date(2026, time.October, 14, 23, 30, 0, 0, time.UTC)
+	name := messagePartitionName(monthStart(m))
+	if name != "messages_p202610" {
+		t.Fatalf("name = %q, want messages_p202610", name)
+	}
+	got, ok := parseMessagePartition(name)
+	if !ok || !got.Equal(monthStart(m)) {
+		t.Fatalf("parse(%q) = %v, %v; want %v", name, got, ok, monthStart(m))
+	}
+}
+
+func TestParseMessagePartitionIgnoresOtherTables(t *testing.T) {
+	for _, name := range []string{"messages_default", "messages_p2026", "messages_pabcdef", "user_facts"} {
+		if _, ok := parseMessagePartition(name); ok {
+			t.Errorf("parse(%q) accepted a non-monthly partition", name)
+		}
+	}
+}
+
+func TestMonthStartUsesUTC(t *testing.T) {
+	kyiv := time.FixedZone("EET", 2*60*60)
+	// 00:30 on Nov 1 in Kyiv is still October in UTC.
+	got := monthStart(time.Date(2026, time.November, 1, 0, 30, 0, 0, kyiv))
+	if want := time.Date(2026, time.October, 1, 0, 0, 0, 0, time.UTC); !got.Equal(want) {
+		t.Fatalf("monthStart = %v, want %v", got, want)
+	}
+}
@@ -54,7 +54,7 @@ func (d *DB) SearchMessages(ctx context.Context, chatID int64, query string, lim
 		ORDER BY rank DESC, created_at DESC
 		LIMIT $3`
 
-	rows, err := d.pool.QueryContext(ctx, sqlQuery, tsQuery, chatID, limit)
+	rows, err := d.queryContext(ctx, sqlQuery, tsQuery, chatID, limit)
 	if err != nil {
 		return nil, fmt.Errorf("search messages: %w", err)
 	}
@@ -0,0 +1,138 @@
+package db
+
+import (
+	"context"
+	"database/sql"
+	"log/slog"
+	"sync"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/metrics"
+)
+
+// PoolOptions configures the connection pool and statement handling (see config DB_*).
+type PoolOptions struct {
+	MaxOpenConns    int
+	MaxIdleConns    int
+	ConnMaxLifetime time.Duration
+	ConnMaxIdleTime time.Duration
+	// PreparedStatements prepares each fixed query once and reuses it, instead of having Postgres parse
+	// and plan it on every call.
+	PreparedStatements bool
+}
+
+// stmtCache holds prepared statements keyed by query text. database/sql prepares a *sql.Stmt lazily on
+// each pooled connection it runs on and re-prepares after reconnects, so entries stay valid for the
+// pool's lifetime. Only constant query strings go through it; the batch INSERT (shape varies with the
+// batch size) does not.
+type stmtCache struct {
+	mu    sync.Mutex
+	stmts map[string]*sql.Stmt
+}
+
+// stmt returns the prepared statement for query, preparing it on first use. ok is false when
+// statements are disabled or preparing failed; the caller then runs the query unprepared.
+func (d *DB) stmt(ctx context.Context, query string) (*sql.Stmt, bool) {
+	if d.stmts == nil {
+		return nil, false
+	}
+	d.stmts.mu.Lock()
+	s, ok := d.stmts.stmts[query]
+	d.stmts.mu.Unlock()
+	if ok {
+		return s, true
+	}
+
+	// Prepared outside the lock so a slow prepare doesn't stall other queries
+	s, err := d.pool.PrepareContext(ctx, query)
+	if err != nil {
+		// Not cached: the next call tries again (e.g. after a transient connection error).
+		slog.Warn("prepare statement failed, running unprepared", "error", err)
+		return nil, false
+	}
+	d.stmts.mu.Lock()
+	defer d.stmts.mu.Unlock()
+	if existing, ok := d.stmts.stmts[query]; ok {
+		s.Close()
+		return existing, true
+	}
+	d.stmts.stmts[query] = s
+	return s, true
+}
+
+// queryContext runs a row-returning query through the statement cache. The round trip (until the first
+// rows arrive) is recorded as gryag_postgres_query_duration_seconds{op="query"}, and likewise below.
+func (d *DB) queryContext(ctx context.Context, query string, args ...any) (*sql.Rows, error) {
+	defer metrics.PostgresDuration.With("query").Since(time.Now())
+	if s, ok := d.stmt(ctx, query); ok {
+		return s.QueryContext(ctx, args...)
+	}
+	return d.pool.QueryContext(ctx, query, args...)
+}
+
+// queryRowContext runs a single-row query through the statement cache.
+func (d *DB) queryRowContext(ctx context.Context, query string, args ...any) *sql.Row {
+	defer metrics.PostgresDuration.With("query_row").Since(time.Now())
+	if s, ok := d.stmt(ctx, query); ok {
+		return s.QueryRowContext(ctx, args...)
+	}
+	return d.pool.QueryRowContext(ctx, query, args...)
+}
+
+// execContext runs a statement without result rows through the statement cache.
+func (d *DB) execContext(ctx context.Context, query string, args ...any) (sql.Result, error) {
+	defer metrics.PostgresDuration.With("exec").Since(time.Now())
+	if s, ok := d.stmt(ctx, query); ok {
+		return s.ExecContext(ctx, args...)
+	}
+	return d.pool.ExecContext(ctx, query, args...)
+}
+
+// closeStatements closes all prepared statements (before the pool is closed).
+func (d *DB) closeStatements() {
+	if d.stmts == nil {
+		return
+	}
+	d.stmts.mu.Lock()
+	defer d.stmts.mu.Unlock()
+	for q, s := range d.stmts.stmts {
+		s.Close()
+		delete(d.stmts.stmts, q)
+	}
+}
+
+// PoolStats is a snapshot of connection pool usage (for the admin stats endpoint).
+type PoolStats struct {
+	MaxOpen            int     `json:"max_open"`
+	Open               int     `json:"open"`
+	InUse              int     `json:"in_use"`
+	Idle               int     `json:"idle"`
+	WaitCount          int64   `json:"wait_count"`
+	WaitMs             float64 `json:"wait_ms"` // total time callers waited for a free connection
+	MaxIdleClosed      int64   `json:"max_idle_closed"`
+	MaxIdleTimeClosed  int64   `json:"max_idle_time_closed"`
+	MaxLifetimeClosed  int64   `json:"max_lifetime_closed"`
+	PreparedStatements int     `json:"prepared_statements"`
+}
+
+// PoolStats returns the current pool counters.
+func (d *DB) PoolStats() PoolStats {
+	s := d.pool.Stats()
+	ps := PoolStats{
+		MaxOpen:           s.MaxOpenConnections,
+		Open:              s.OpenConnections,
+		InUse:             s.InUse,
+		Idle:              s.Idle,
+		WaitCount:         s.WaitCount,
+		WaitMs:            float64(s.WaitDuration.Microseconds()) / 1000,
+		MaxIdleClosed:     s.MaxIdleClosed,
+		MaxIdleTimeClosed: s.MaxIdleTimeClosed,
+		MaxLifetimeClosed: s.MaxLifetimeClosed,
+	}
+	if d.stmts != nil {
+		d.stmts.mu.Lock()
+		ps.PreparedStatements = len(d.stmts.stmts)
+		d.stmts.mu.Unlock()
+	}
+	return ps
+}
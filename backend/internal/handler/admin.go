@@ -4,27 +4,35 @@ import (
 	"encoding/json"
 	"log/slog"
 	"net/http"
-	"os"
 	"runtime"
 	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/config"
 	"github.com/ThatHunky/gryag/backend/internal/db"
+	"github.com/ThatHunky/gryag/backend/internal/llm"
+	"github.com/ThatHunky/gryag/backend/internal/summarizer"
+	"github.com/ThatHunky/gryag/backend/internal/tools"
 )
 
 // AdminHandler provides management endpoints for bot administrators.
 type AdminHandler struct {
 	db     *db.DB
 	config *config.Config
+	llm    *llm.Client
+	executor *tools.Executor
+	summarizer *summarizer.Runner // nil when summarization is off
 	startTime time.Time
 }
 
-// NewAdminHandler creates a new admin handler.
-func NewAdminHandler(cfg *config.Config, database *db.DB) *AdminHandler {
+// NewAdminHandler creates a new admin handler. summarizerRunner may be nil.
+func NewAdminHandler(cfg *config.Config, database *db.DB, llmClient *llm.Client, executor *tools.Executor, summarizerRunner *summarizer.Runner) *AdminHandler {
 	return &AdminHandler{
-		db:        database,
-		config:    cfg,
-		startTime: time.Now(),
+		db:         database,
+		config:     cfg,
+		llm:        llmClient,
+		executor:   executor,
+		summarizer: summarizerRunner,
+		startTime:  time.Now(),
 	}
 }
 
@@ -70,6 +78,26 @@ func (a *AdminHandler) Stats(w http.ResponseWriter, r *http.Request) {
 		"gemini_model":    a.config.GeminiModel,
 		"default_lang":    a.config.DefaultLang,
 	}
+	if cacheStats, ok := a.db.ContextCacheStats(); ok {
+		stats["context_cache"] = cacheStats
+	}
+	if a.db != nil {
+		stats["db_pool"] = a.db.PoolStats()
+	}
+	if writerStats, ok := a.db.MessageWriterStats(); ok {
+		stats["message_writer"] = writerStats
+	}
+	if mediaStats, ok := a.db.MediaStoreStats(); ok {
+		stats["media_store"] = mediaStats
+	}
+	if a.summarizer != nil {
+		stats["summarizer"] = a.summarizer.Stats()
+	}
+	if a.executor != nil {
+		if poolStats := a.executor.SandboxPoolStats(); poolStats != nil {
+			stats["sandbox_pool"] = poolStats
+		}
+	}
 
 	w.Header().Set("Content-Type", "application/json")
 	json.NewEncoder(w).Encode(stats)
@@ -93,19 +121,19 @@ func (a *AdminHandler) ReloadPersona(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 
-	// Verify the persona file is readable
-	if _, err := os.ReadFile(a.config.PersonaFile); err != nil {
+	slog.Info("persona reload requested", "user_id", req.UserID, "path", a.config.PersonaFile)
+
+	// Re-read the persona; the cached prompt prefix is rebuilt in the background
+	if err := a.llm.ReloadPersona(); err != nil {
 		slog.Error("persona file not readable", "path", a.config.PersonaFile, "error", err)
 		http.Error(w, `{"error":"persona file not readable"}`, http.StatusInternalServerError)
 		return
 	}
 
-	slog.Info("persona reload requested", "user_id", req.UserID, "path", a.config.PersonaFile)
-
 	w.Header().Set("Content-Type", "application/json")
 	json.NewEncoder(w).Encode(map[string]string{
 		"status":  "ok",
-		"message": "Persona will be reloaded on next request.",
+		"message": "Persona reloaded.",
 		"file":    a.config.PersonaFile,
 	})
 }
@@ -0,0 +1,124 @@
+package handler
+
+import (
+	"context"
+	"fmt"
+	"log/slog"
+	"net/http"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/cache"
+)
+
+const (
+	// proactiveStreamWait is how long one pop blocks on the queue; an idle stream sends a keepalive
+	// comment this often, so proxies and the frontend's read timeout see traffic.
+	proactiveStreamWait = 15 * time.Second
+	// proactiveStreamBatch caps the items written per pop.
+	proactiveStreamBatch = 20
+	// proactiveStreamWriteTimeout replaces the server WriteTimeout for each write of the stream.
+	proactiveStreamWriteTimeout = 30 * time.Second
+)
+
+// proactiveQueue is the part of the cache the proactive stream reads (a fake in tests).
+type proactiveQueue interface {
+	PopProactiveBatch(ctx context.Context, timeout time.Duration, max int) ([]cache.ProactiveItem, error)
+	RequeueProactive(ctx context.Context, items []cache.ProactiveItem) error
+}
+
+// ProactiveStream handles GET /api/v1/proactive/stream: a long-lived Server-Sent Events stream that
+// delivers proactive messages as soon as the runner queues them. Events:
+//
+//	event: proactive — {"chat_id": ..., "reply": "..."} per queued message, oldest first
+//
+// plus a ": keepalive" comment every proactiveStreamWait while the queue is empty. The queue is FIFO
+// and is read by one stream at a time, so messages for the same chat arrive in the order they were
+// queued. Items popped but not written (client gone) are put back at the head of the queue.
+func (h *Handler) ProactiveStream(w http.ResponseWriter, r *http.Request) {
+	streamProactive(w, r, h.cache, h.streamsStop)
+}
+
+// StopProactiveStreams ends the open proactive streams, so a graceful shutdown does not wait on them
+// (register it with http.Server.RegisterOnShutdown). The frontend reconnects to the next instance.
+func (h *Handler) StopProactiveStreams() {
+	h.stopStreams.Do(func() { close(h.streamsStop) })
+}
+
+func streamProactive(w http.ResponseWriter, r *http.Request, queue proactiveQueue, stop <-chan struct{}) {
+	flusher, ok := w.(http.Flusher)
+	if !ok {
+		http.Error(w, "streaming unsupported", http.StatusInternalServerError)
+		return
+	}
+	// The stream outlives the server's WriteTimeout; each write gets its own deadline instead
+	rc := http.NewResponseController(w)
+	_ = rc.SetWriteDeadline(time.Now().Add(proactiveStreamWriteTimeout))
+
+	w.Header().Set("Content-Type", "text/event-stream")
+	w.Header().Set("Cache-Control", "no-cache")
+	w.Header().Set("X-Accel-Buffering", "no")
+	w.WriteHeader(http.StatusOK)
+	flusher.Flush()
+
+	ctx, cancel := context.WithCancel(r.Context())
+	defer cancel()
+	go func() {
+		select {
+		case <-stop:
+			cancel()
+		case <-ctx.Done():
+		}
+	}()
+	delivered := 0
+	slog.Info("proactive stream opened", "remote", r.RemoteAddr)
+	defer func() {
+		slog.Info("proactive stream closed", "remote", r.RemoteAddr, "delivered", delivered)
+	}()
+
+	for {
+		items, err := queue.PopProactiveBatch(ctx, proactiveStreamWait, proactiveStreamBatch)
+		if ctx.Err() != nil {
+			requeueProactive(queue, items)
+			return
+		}
+		if err != nil {
+			slog.Warn("proactive stream pop failed", "error", err)
+			select {
+			case <-ctx.Done():
+				return
+			case <-time.After(time.Second):
+			}
+			continue
+		}
+
+		_ = rc.SetWriteDeadline(time.Now().Add(proactiveStreamWriteTimeout))
+		if len(items) == 0 {
+			if _, err := fmt.Fprint(w, ": keepalive\n\n"); err != nil {
+				return
+			}
+			flusher.Flush()
+			continue
+		}
+		for i, item := range items {
+			if err := writeSSE(w, "proactive", item); err != nil {
+				slog.Warn("proactive stream write failed", "error", err, "requeued", len(items)-i)
+				requeueProactive(queue, items[i:])
+				return
+			}
+		}
+		flusher.Flush()
+		delivered += len(items)
+	}
+}
+
+// requeueProactive puts undelivered items back; the request context is usually gone by then.
+func requeueProactive(queue proactiveQueue, items []cache.ProactiveItem) {
+	if len(items) == 0 {
+		return
+	}
+	ctx, cancel := context.WithTimeout(context.Background(), 5*time.Second)
+	defer cancel()
+	if err := queue.RequeueProactive(ctx, items); err != nil {
+		slog.Error("proactive requeue failed, messages lost", "count", len(items), "error", err)
+	}
+}
@@ -0,0 +1,97 @@
+package handler
+
+import (
+	"context"
+	"errors"
+	"net/http/httptest"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/cache"
+)
+
+// fakeProactiveQueue returns the given batches in turn, then cancels the stream.
+type fakeProactiveQueue struct {
+	batches  [][]cache.ProactiveItem
+	cancel   context.CancelFunc
+	requeued []cache.ProactiveItem
+}
+
+func (q *fakeProactiveQueue) PopProactiveBatch(ctx context.Context, _ time.Duration, _ int) ([]cache.ProactiveItem, error) {
+	if len(q.batches) == 0 {
+		q.cancel()
+		return nil, ctx.Err()
+	}
+	b := q.batches[0]
+	q.batches = q.batches[1:]
+	return b, nil
+}
+
+func (q *fakeProactiveQueue) RequeueProactive(_ context.Context, items []cache.ProactiveItem) error {
+	q.requeued = append(q.requeued, items...)
+	return nil
+}
+
+func TestStreamProactive_OrderAndKeepalive(t *testing.T) {
+	ctx, cancel := context.WithCancel(context.Background())
+	q := &fakeProactiveQueue{
+		cancel: cancel,
+		batches: [][]cache.ProactiveItem{
+			{{ChatID: 1, Reply: "first"}, {ChatID: 1, Reply: "second"}},
+			nil,
+			{{ChatID: 2, Reply: "third"}},
+		},
+	}
+	req := httptest.NewRequest("GET", "/api/v1/proactive/stream", nil).WithContext(ctx)
+	w := httptest.NewRecorder()
+
+	streamProactive(w, req, q, nil)
+
+	if ct := w.Header().Get("Content-Type"); ct != "text/event-stream" {
+		t.Fatalf("content type = %q", ct)
+	}
+	body := w.Body.String()
+	first := strings.Index(body, `"reply":"first"`)
+	second := strings.Index(body, `"reply":"second"`)
+	keepalive := strings.Index(body, ": keepalive")
+	third := strings.Index(body, `"reply":"third"`)
+	if first < 0 || !(first < second && second < keepalive && keepalive < third) {
+		t.Errorf("events out of order:\n%s", body)
+	}
+	if n := strings.Count(body, "event: proactive\n"); n != 3 {
+		t.Errorf("proactive events = %d, want 3", n)
+	}
+	if len(q.requeued) != 0 {
+		t.Errorf("requeued %v, want nothing", q.requeued)
+	}
+}
+
+// failingWriter accepts the headers and the first n writes, then fails.
+type failingWriter struct {
+	*httptest.ResponseRecorder
+	n int
+}
+
+func (w *failingWriter) Write(p []byte) (int, error) {
+	if w.n <= 0 {
+		return 0, errors.New("client gone")
+	}
+	w.n--
+	return w.ResponseRecorder.Write(p)
+}
+
+func TestStreamProactive_RequeuesUndelivered(t *testing.T) {
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	items := []cache.ProactiveItem{{ChatID: 1, Reply: "a"}, {ChatID: 1, Reply: "b"}, {ChatID: 1, Reply: "c"}}
+	q := &fakeProactiveQueue{cancel: cancel, batches: [][]cache.ProactiveItem{items}}
+	req := httptest.NewRequest("GET", "/api/v1/proactive/stream", nil).WithContext(ctx)
+	w := &failingWriter{ResponseRecorder: httptest.NewRecorder(), n: 1}
+
+	streamProactive(w, req, q, nil)
+
+	if len(q.requeued) != 2 || q.requeued[0].Reply != "b" || q.requeued[1].Reply != "c" {
+		t.Errorf("requeued %v, want [b c]", q.requeued)
+	}
+}
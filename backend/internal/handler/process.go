@@ -7,6 +7,8 @@ import (
 	"fmt"
 	"log/slog"
 	"net/http"
+	"strings"
+	"sync"
 	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/cache"
@@ -14,10 +16,15 @@ import (
 	"github.com/ThatHunky/gryag/backend/internal/db"
 	"github.com/ThatHunky/gryag/backend/internal/i18n"
 	"github.com/ThatHunky/gryag/backend/internal/llm"
+	"github.com/ThatHunky/gryag/backend/internal/metrics"
 	"github.com/ThatHunky/gryag/backend/internal/tools"
 	"google.golang.org/genai"
 )
 
+// processWriteTimeout is the deadline of each write of a /process response, replacing the server
+// WriteTimeout, which starts counting when the request is read (see extendWriteDeadline).
+const processWriteTimeout = 30 * time.Second
+
 // ProcessRequest holds the incoming message payload from the Python frontend.
 type ProcessRequest struct {
 	ChatID            int64   `json:"chat_id"`
@@ -29,10 +36,19 @@ type ProcessRequest struct {
 	Date              string  `json:"date"`
 	FileID            string  `json:"file_id"`
 	MediaType         string  `json:"media_type"`
-	MediaBase64       string  `json:"media_base64"`
+	MediaBase64       string  `json:"media_base64"` // legacy JSON transport; decoded into Media on read
 	MimeType          string  `json:"mime_type"`
 	ReplyToMessageID  *int64  `json:"reply_to_message_id,omitempty"`
 	ReplyToText       string  `json:"reply_to_text,omitempty"`
+	// AttachmentRef is a Gemini file URI returned as attachment_ref for the same media earlier; the
+	// frontend sends it instead of the media bytes.
+	AttachmentRef string `json:"attachment_ref,omitempty"`
+
+	// Media holds the decoded attachment (multipart "media" part or decoded media_base64).
+	Media []byte `json:"-"`
+	// mediaURI is the Gemini Files API URI of the attachment, when it is sent by reference.
+	mediaURI          string
+	mediaURIExpiresAt time.Time
 }
 
 type ProcessResponse struct {
@@ -40,7 +56,14 @@ type ProcessResponse struct {
 	RequestID   string `json:"request_id"`
 	MediaURL    string `json:"media_url,omitempty"`
 	MediaType   string `json:"media_type,omitempty"`
+	// MediaID references a generated image in media_cache; fetch it with GET /api/v1/media/{media_id}.
+	// MediaBase64 is only set when the image could not be cached.
+	MediaID     string `json:"media_id,omitempty"`
 	MediaBase64 string `json:"media_base64,omitempty"`
+	// AttachmentRef is the Gemini file URI of the incoming attachment (until AttachmentRefExpiresAt);
+	// the frontend may send it back as attachment_ref instead of the same bytes.
+	AttachmentRef          string     `json:"attachment_ref,omitempty"`
+	AttachmentRefExpiresAt *time.Time `json:"attachment_ref_expires_at,omitempty"`
 }
 
 // Handler wires all subsystems together for request processing.
@@ -52,11 +75,15 @@ type Handler struct {
 	executor *tools.Executor
 	config   *config.Config
 	bundle   *i18n.Bundle
+	queue    *chatQueue
+
+	streamsStop chan struct{} // closed by StopProactiveStreams
+	stopStreams sync.Once
 }
 
 // New creates a new request handler with all dependencies.
 func New(cfg *config.Config, database *db.DB, c *cache.Cache, llmClient *llm.Client, reg *tools.Registry, exe *tools.Executor, bundle *i18n.Bundle) *Handler {
-	return &Handler{
+	h := &Handler{
 		db:       database,
 		cache:    c,
 		llm:      llmClient,
@@ -64,37 +91,128 @@ func New(cfg *config.Config, database *db.DB, c *cache.Cache, llmClient *llm.Cli
 		executor: exe,
 		config:   cfg,
 		bundle:   bundle,
+
+		streamsStop: make(chan struct{}),
 	}
+	h.queue = newChatQueue(cfg.CoalesceDebounce(), cfg.CoalesceMaxWait(), cfg.CoalesceMaxBatch, cfg.CoalesceMaxPending, h.runTurn)
+	return h
+}
+
+// TurnQueueDepth returns the number of messages waiting for their chat's running turn.
+func (h *Handler) TurnQueueDepth() int {
+	return h.queue.waiting()
 }
 
 // Process handles the /api/v1/process endpoint — the main entry point for messages.
+// Responds 204 when the message was coalesced into a turn answered through a newer message.
 func (h *Handler) Process(w http.ResponseWriter, r *http.Request) {
 	requestID := r.Header.Get("X-Request-ID")
 	logger := slog.With("request_id", requestID)
 
-	var req ProcessRequest
-	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
+	req, err := h.readRequest(r)
+	if err != nil {
+		logger.Warn("invalid request payload", "error", err)
+		WriteDecodeError(w, err)
+		return
+	}
+	defer r.Body.Close()
+
+	resp := h.submit(r.Context(), req, requestID, nil)
+	extendWriteDeadline(w)
+	if resp == nil {
+		w.WriteHeader(http.StatusNoContent)
+		return
+	}
+	respondJSON(w, resp)
+}
+
+// ProcessStream handles /api/v1/process/stream: same pipeline as Process, but reply text is pushed to the
+// frontend as Server-Sent Events while Gemini generates it. Events:
+//
+//	event: delta — {"text": "..."} for each text fragment (across all tool-loop rounds)
+//	event: done  — the final ProcessResponse (full reply, media), sent once at the end
+//
+// The stream starts with the first event, so a coalesced message still gets a plain 204.
+func (h *Handler) ProcessStream(w http.ResponseWriter, r *http.Request) {
+	requestID := r.Header.Get("X-Request-ID")
+	logger := slog.With("request_id", requestID)
+
+	req, err := h.readRequest(r)
+	if err != nil {
 		logger.Warn("invalid request payload", "error", err)
-		http.Error(w, `{"error":"invalid payload"}`, http.StatusBadRequest)
+		WriteDecodeError(w, err)
 		return
 	}
 	defer r.Body.Close()
 
+	flusher, ok := w.(http.Flusher)
+	if !ok {
+		// No streaming support on this writer; fall back to a single JSON response.
+		resp := h.submit(r.Context(), req, requestID, nil)
+		extendWriteDeadline(w)
+		if resp != nil {
+			respondJSON(w, resp)
+		} else {
+			w.WriteHeader(http.StatusNoContent)
+		}
+		return
+	}
+
+	started := false
+	start := func() {
+		if started {
+			return
+		}
+		started = true
+		w.Header().Set("Content-Type", "text/event-stream")
+		w.Header().Set("Cache-Control", "no-cache")
+		w.Header().Set("X-Accel-Buffering", "no")
+		w.WriteHeader(http.StatusOK)
+	}
+	onText := func(text string) {
+		extendWriteDeadline(w)
+		start()
+		if err := writeSSE(w, "delta", map[string]string{"text": text}); err != nil {
+			logger.Debug("stream delta write failed", "error", err)
+			return
+		}
+		flusher.Flush()
+	}
+	resp := h.submit(r.Context(), req, requestID, onText)
+	extendWriteDeadline(w)
+	if resp == nil && !started {
+		w.WriteHeader(http.StatusNoContent)
+		return
+	}
+	start()
+	if resp == nil {
+		resp = &ProcessResponse{RequestID: requestID}
+	}
+	if err := writeSSE(w, "done", resp); err != nil {
+		logger.Warn("stream done write failed", "error", err)
+		return
+	}
+	flusher.Flush()
+}
+
+// submit logs the incoming message and queues it for its chat's next turn (see chatQueue).
+// Returns nil when the message was coalesced into a turn answered through a newer message.
+func (h *Handler) submit(ctx context.Context, req *ProcessRequest, requestID string, onText func(string)) *ProcessResponse {
+	logger := slog.With("request_id", requestID)
+
 	logger.Info("processing message",
 		"chat_id", req.ChatID,
 		"user_id", req.UserID,
 		"text_length", len(req.Text),
-		"has_media", req.MediaBase64 != "",
+		"has_media", len(req.Media) > 0,
 		"media_type", req.MediaType,
+		"stream", onText != nil,
 	)
 
-	ctx := r.Context()
+	// Large attachments are uploaded once and referenced by URI for the rest of the turn
+	h.resolveMediaFile(ctx, logger, req)
 
-	// 1. Log the incoming message to PostgreSQL (even if later throttled at tool level)
-	userID := int64(0)
-	if req.UserID != nil {
-		userID = *req.UserID
-	}
+	// 1. Log the incoming message to PostgreSQL on arrival, so the log keeps arrival order
 	msgRecord := &db.Message{
 		ChatID:           req.ChatID,
 		UserID:           req.UserID,
@@ -106,43 +224,94 @@ func (h *Handler) Process(w http.ResponseWriter, r *http.Request) {
 		FileID:           strPtr(req.FileID),
 		MediaType:        strPtr(req.MediaType),
 		ReplyToMessageID: req.ReplyToMessageID,
+		MediaURI:         strPtr(req.mediaURI),
+	}
+	if !req.mediaURIExpiresAt.IsZero() {
+		msgRecord.MediaURIExpiresAt = &req.mediaURIExpiresAt
 	}
 	if _, err := h.db.InsertMessage(ctx, msgRecord); err != nil {
 		logger.Error("failed to store incoming message", "error", err)
 	}
 
+	return h.queue.submit(&queuedMessage{ctx: ctx, req: req, requestID: requestID, onText: onText})
+}
+
+// runTurn runs one generation for a batch of queued messages of the same chat (oldest first). The newest
+// message is the current one; earlier ones are shown to the model as part of the same turn. The reply
+// is streamed to and stored under batch[replyTo], the newest message whose client is still connected.
+//
+// The turn runs on a context detached from the requests (keeping their values) with its own timeout:
+// a client that disconnects or times out while queued must not fail a turn that others wait for.
+func (h *Handler) runTurn(batch []*queuedMessage, replyTo int) *ProcessResponse {
+	target := batch[replyTo]
+	if len(batch) > 1 {
+		slog.Info("coalesced messages into one turn", "request_id", target.requestID, "chat_id", target.req.ChatID, "messages", len(batch))
+	}
+	ctx, cancel := context.WithTimeout(context.WithoutCancel(target.ctx), h.config.TurnTimeout())
+	defer cancel()
+	return h.run(ctx, batch, target.requestID, target.onText)
+}
+
+// run executes the generation pipeline (context, tool loop, store reply) for a batch and returns the response.
+// When onText is non-nil, Gemini is called in streaming mode and each text fragment is passed to onText.
+func (h *Handler) run(ctx context.Context, batch []*queuedMessage, requestID string, onText func(string)) *ProcessResponse {
+	logger := slog.With("request_id", requestID)
+	req := batch[len(batch)-1].req
+
+	userID := int64(0)
+	if req.UserID != nil {
+		userID = *req.UserID
+	}
+
 	// 2. Build Dynamic Instructions from DB context
-	di, err := llm.NewDynamicInstructions(ctx, h.db, req.ChatID, userID, req.Username, req.FirstName, req.Text, h.config.ImmediateContextSize, req.ReplyToMessageID, req.ReplyToText)
+	contextStart := time.Now()
+	di, err := llm.NewDynamicInstructions(ctx, h.db, h.llm, req.ChatID, userID, req.Username, req.FirstName, req.Text, h.config.ImmediateContextSize, h.config.ContextStageTimeout(), req.ReplyToMessageID, req.ReplyToText)
+	metrics.Stage("context_build", contextStart)
 	if err != nil {
 		logger.Error("failed to build dynamic instructions", "error", err)
 		reply := "Internal error building context."
 		if h.bundle != nil {
 			reply = h.bundle.T(h.config.DefaultLang, "error.context_build")
 		}
-		respondJSON(w, &ProcessResponse{Reply: reply, RequestID: requestID})
-		return
+		return &ProcessResponse{Reply: reply, RequestID: requestID}
+	}
+	di.StablePrefix = h.config.StablePromptLayout()
+	di.TokenBudget = h.config.ContextTokenBudget
+	for _, m := range batch[:len(batch)-1] {
+		di.EarlierTurnMessages = append(di.EarlierTurnMessages, llm.TurnMessage{
+			UserID:    m.req.UserID,
+			Username:  m.req.Username,
+			FirstName: m.req.FirstName,
+			Text:      m.req.Text,
+		})
 	}
-	di.ToolsDescription = h.registry.GetToolDescription()
 
-	// Inject current message media into context (Section 8.6) so the model can see/hear it
-	if req.MediaBase64 != "" {
-		data, err := base64.StdEncoding.DecodeString(req.MediaBase64)
-		if err != nil {
-			logger.Warn("failed to decode media_base64", "error", err)
+	// Inject the turn's media into context (Section 8.6) so the model can see/hear it
+	var contextMedia []byte
+	mediaMax := h.config.MediaBufferMax
+	if mediaMax < 1 {
+		mediaMax = 1
+	}
+	for _, m := range batch {
+		if (len(m.req.Media) == 0 && m.req.mediaURI == "") || len(di.MediaParts) >= mediaMax {
+			continue
+		}
+		mime := inferMimeType(m.req.MediaType, m.req.MimeType)
+		if m.req.mediaURI != "" {
+			di.MediaParts = append(di.MediaParts, genai.NewPartFromURI(m.req.mediaURI, mime))
 		} else {
-			mime := inferMimeType(req.MediaType, req.MimeType)
-			di.MediaParts = []*genai.Part{genai.NewPartFromBytes(data, mime)}
+			di.MediaParts = append(di.MediaParts, genai.NewPartFromBytes(m.req.Media, mime))
+		}
+		if len(m.req.Media) > 0 {
+			contextMedia = m.req.Media
 		}
 	}
 
-	// Pass request media (base64) in context for edit_image(use_context_image=true)
-	if req.MediaBase64 != "" {
-		ctx = context.WithValue(ctx, tools.RequestMediaBase64Key, req.MediaBase64)
+	// Pass the newest request media in context for edit_image(use_context_image=true)
+	if contextMedia != nil {
+		ctx = context.WithValue(ctx, tools.RequestMediaKey, contextMedia)
 	}
 
-	// 3. Get the registered tools for the API call
-	genaiTools := h.registry.GetTools()
-
 	// 4. Initial conversation history payload
 	contents := []*genai.Content{
 		{
@@ -153,19 +322,25 @@ func (h *Handler) Process(w http.ResponseWriter, r *http.Request) {
 
 	reply := ""
 	mediaBase64 := ""
+	mediaID := ""
 	mediaType := ""
 
 	// 5. Tool execution loop (max 5 iterations to prevent infinite loops)
 	for i := 0; i < 5; i++ {
-		resp, err := h.llm.GenerateResponse(ctx, contents, genaiTools)
+		var resp *genai.GenerateContentResponse
+		var err error
+		if onText != nil {
+			resp, err = h.llm.GenerateResponseStream(ctx, contents, onText)
+		} else {
+			resp, err = h.llm.GenerateResponse(ctx, contents)
+		}
 		if err != nil {
 			logger.Error("gemini generation failed", "error", err)
 			reply := "Error generating response."
 			if h.bundle != nil {
 				reply = h.bundle.T(h.config.DefaultLang, "error.generation_failed")
 			}
-			respondJSON(w, &ProcessResponse{Reply: reply, RequestID: requestID})
-			return
+			return &ProcessResponse{Reply: reply, RequestID: requestID}
 		}
 
 		if len(resp.Candidates) == 0 || resp.Candidates[0].Content == nil {
@@ -176,50 +351,54 @@ func (h *Handler) Process(w http.ResponseWriter, r *http.Request) {
 		// Ensure we append the model's exact response to the history
 		contents = append(contents, cand.Content)
 
-		hasToolCall := false
-		var toolResponses []*genai.Part
-
+		var calls []*genai.FunctionCall
 		for _, part := range cand.Content.Parts {
 			if part.Text != "" {
 				reply += part.Text
 			} else if part.FunctionCall != nil {
-				hasToolCall = true
-				res := h.HandleToolCall(ctx, part.FunctionCall)
-
-				returnToModel := res.Output
+				calls = append(calls, part.FunctionCall)
+			}
+		}
+		if len(calls) == 0 {
+			break
+		}
 
-				// Intercept image output: set response media and store in media_cache for edit by media_id
-				responsePayload := map[string]any{"result": returnToModel}
-				if part.FunctionCall.Name == "generate_image" || part.FunctionCall.Name == "edit_image" {
-					var raw struct {
-						MediaBase64 string `json:"media_base64"`
-						MediaType   string `json:"media_type"`
+		// Independent calls of one turn run concurrently; responses are built in call order
+		var toolResponses []*genai.Part
+		results := h.executor.ExecuteAll(ctx, calls)
+		for i, res := range results {
+			fc := calls[i]
+			returnToModel := res.Output
+
+			// Intercept image output: set response media and store in media_cache for edit by media_id
+			responsePayload := map[string]any{"result": returnToModel}
+			if fc.Name == "generate_image" || fc.Name == "edit_image" {
+				var raw struct {
+					MediaBase64 string `json:"media_base64"`
+					MediaType   string `json:"media_type"`
+				}
+				if err := json.Unmarshal([]byte(res.Output), &raw); err == nil && raw.MediaBase64 != "" {
+					mediaBase64, mediaID = raw.MediaBase64, ""
+					if raw.MediaType != "" {
+						mediaType = raw.MediaType
+					} else {
+						mediaType = "photo"
 					}
-					if err := json.Unmarshal([]byte(res.Output), &raw); err == nil && raw.MediaBase64 != "" {
-						mediaBase64 = raw.MediaBase64
-						if raw.MediaType != "" {
-							mediaType = raw.MediaType
-						} else {
-							mediaType = "photo"
-						}
-						returnToModel = "Image generated successfully. It has been attached to the chat for the user to see."
-						// Store in media_cache; pass media_id only in structured response so the model can use it for edit_image but must not echo it
-						if data, decErr := base64.StdEncoding.DecodeString(raw.MediaBase64); decErr == nil && h.config.MediaCacheDir != "" {
-							if mid, insErr := h.db.InsertMediaCache(ctx, h.config.MediaCacheDir, req.ChatID, req.UserID, data, h.config.MediaCacheTTLHours); insErr == nil {
-								returnToModel = "Image generated and attached to the chat. To edit later, call edit_image with the media_id from this response. Do not mention or show the media_id to the user—it is internal only."
-								responsePayload["media_id"] = mid
-							}
+					returnToModel = "Image generated successfully. It has been attached to the chat for the user to see."
+					// Store in media_cache; pass media_id only in structured response so the model can use it for edit_image but must not echo it
+					if data, decErr := base64.StdEncoding.DecodeString(raw.MediaBase64); decErr == nil && h.config.MediaCacheDir != "" {
+						if mid, insErr := h.db.InsertMediaCache(ctx, req.ChatID, req.UserID, data, h.config.MediaCacheTTLHours); insErr == nil {
+							returnToModel = "Image generated and attached to the chat. To edit later, call edit_image with the media_id from this response. Do not mention or show the media_id to the user—it is internal only."
+							responsePayload["media_id"] = mid
+							// The frontend fetches the cached file by reference instead of receiving base64
+							mediaBase64, mediaID = "", mid
 						}
-						responsePayload["result"] = returnToModel
 					}
+					responsePayload["result"] = returnToModel
 				}
-
-				toolResponses = append(toolResponses, genai.NewPartFromFunctionResponse(part.FunctionCall.Name, responsePayload))
 			}
-		}
 
-		if !hasToolCall {
-			break
+			toolResponses = append(toolResponses, genai.NewPartFromFunctionResponse(fc.Name, responsePayload))
 		}
 
 		// Append tool execution results and loop
@@ -232,9 +411,14 @@ func (h *Handler) Process(w http.ResponseWriter, r *http.Request) {
 	resp := &ProcessResponse{
 		Reply:       reply,
 		RequestID:   requestID,
+		MediaID:     mediaID,
 		MediaBase64: mediaBase64,
 		MediaType:   mediaType,
 	}
+	if req.mediaURI != "" && !req.mediaURIExpiresAt.IsZero() {
+		resp.AttachmentRef = req.mediaURI
+		resp.AttachmentRefExpiresAt = &req.mediaURIExpiresAt
+	}
 
 	// 6. Store the bot's reply in the message log
 	botReply := &db.Message{
@@ -247,8 +431,21 @@ func (h *Handler) Process(w http.ResponseWriter, r *http.Request) {
 		logger.Error("failed to store bot reply", "error", err)
 	}
 
-	logger.Info("reply generated", "reply_length", len(reply), "has_media", mediaBase64 != "")
-	respondJSON(w, resp)
+	logger.Info("reply generated", "reply_length", len(reply), "has_media", mediaID != "" || mediaBase64 != "")
+	return resp
+}
+
+// readRequest returns the request decoded by the rate limiter, or decodes the body when the handler is
+// mounted without it, capping attachments at MEDIA_MAX_BYTES.
+func (h *Handler) readRequest(r *http.Request) (*ProcessRequest, error) {
+	if req, ok := RequestFromContext(r.Context()); ok {
+		return req, nil
+	}
+	var maxMedia int64
+	if h.config != nil {
+		maxMedia = int64(h.config.MediaMaxBytes)
+	}
+	return ReadProcessRequest(r, maxMedia)
 }
 
 // HandleToolCall processes a function call from Gemini and returns the tool result.
@@ -257,6 +454,23 @@ func (h *Handler) HandleToolCall(ctx context.Context, fc *genai.FunctionCall) *t
 	return h.executor.Execute(ctx, fc.Name, args)
 }
 
+// writeSSE writes one Server-Sent Event with a JSON-encoded data line.
+func writeSSE(w http.ResponseWriter, event string, v any) error {
+	data, err := json.Marshal(v)
+	if err != nil {
+		return err
+	}
+	_, err = fmt.Fprintf(w, "event: %s\ndata: %s\n\n", event, data)
+	return err
+}
+
+// extendWriteDeadline gives the next write processWriteTimeout from now. Time spent queued behind a
+// chat's running turn and generating counts against the server's WriteTimeout, which would otherwise
+// cut off a late reply or a long stream without an error.
+func extendWriteDeadline(w http.ResponseWriter) {
+	_ = http.NewResponseController(w).SetWriteDeadline(time.Now().Add(processWriteTimeout))
+}
+
 // respondJSON encodes a response as JSON.
 func respondJSON(w http.ResponseWriter, resp *ProcessResponse) {
 	w.Header().Set("Content-Type", "application/json")
@@ -271,6 +485,44 @@ func strPtr(s string) *string {
 	return &s
 }
 
+// mediaURIMinValidity is how long a stored Files API upload must stay valid to be reused: the turn,
+// its tool loop and a reply referencing it all finish well within it.
+const mediaURIMinValidity = time.Hour
+
+// resolveMediaFile decides how the attachment reaches Gemini. An attachment_ref from the frontend is
+// used as is. Non-image attachments (video, voice, GIFs) of at least MEDIA_UPLOAD_MIN_BYTES reuse the
+// upload stored for the same file_id, or are uploaded to the Files API now. Anything else, or a failed
+// upload, stays inline; images keep their bytes for edit_image(use_context_image).
+func (h *Handler) resolveMediaFile(ctx context.Context, logger *slog.Logger, req *ProcessRequest) {
+	if req.AttachmentRef != "" && len(req.Media) == 0 {
+		req.mediaURI = req.AttachmentRef
+		return
+	}
+	minBytes := h.config.MediaUploadMinBytes
+	mime := inferMimeType(req.MediaType, req.MimeType)
+	if h.llm == nil || minBytes <= 0 || len(req.Media) < minBytes || strings.HasPrefix(mime, "image/") {
+		return
+	}
+	if req.FileID != "" {
+		uri, expiresAt, err := h.db.GetMediaURI(ctx, req.FileID, mediaURIMinValidity)
+		if err != nil {
+			logger.Warn("media uri lookup failed", "error", err)
+		} else if uri != "" {
+			req.mediaURI, req.mediaURIExpiresAt = uri, expiresAt
+			logger.Info("reusing uploaded media", "file_id", req.FileID)
+			return
+		}
+	}
+	start := time.Now()
+	uri, expiresAt, err := h.llm.UploadMedia(ctx, req.Media, mime)
+	if err != nil {
+		logger.Warn("media upload failed, sending inline", "size_bytes", len(req.Media), "error", err)
+		return
+	}
+	req.mediaURI, req.mediaURIExpiresAt = uri, expiresAt
+	logger.Info("uploaded media", "size_bytes", len(req.Media), "upload_ms", time.Since(start).Milliseconds())
+}
+
 // inferMimeType returns a MIME type for Gemini from Telegram media_type and optional mime_type.
 func inferMimeType(mediaType, mimeType string) string {
 	if mimeType != "" {
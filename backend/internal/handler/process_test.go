@@ -1,11 +1,16 @@
 package handler
 
 import (
+	"context"
 	"encoding/json"
+	"log/slog"
 	"net/http"
 	"net/http/httptest"
 	"strings"
 	"testing"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/config"
 )
 
 func TestHealthCheck(t *testing.T) {
@@ -40,6 +45,49 @@ func TestProcess_InvalidPayload(t *testing.T) {
 	}
 }
 
+func TestProcessStream_InvalidPayload(t *testing.T) {
+	h := &Handler{}
+
+	req := httptest.NewRequest("POST", "/api/v1/process/stream", strings.NewReader("not json"))
+	req.Header.Set("X-Request-ID", "test-123")
+	w := httptest.NewRecorder()
+
+	h.ProcessStream(w, req)
+
+	if w.Code != http.StatusBadRequest {
+		t.Errorf("expected 400, got %d", w.Code)
+	}
+}
+
+func TestWriteSSE(t *testing.T) {
+	w := httptest.NewRecorder()
+	if err := writeSSE(w, "delta", map[string]string{"text": "Привіт\nсвіт"}); err != nil {
+		t.Fatalf("writeSSE: %v", err)
+	}
+	if err := writeSSE(w, "done", &ProcessResponse{Reply: "Привіт\nсвіт", RequestID: "req-1"}); err != nil {
+		t.Fatalf("writeSSE: %v", err)
+	}
+
+	events := strings.Split(strings.TrimSuffix(w.Body.String(), "\n\n"), "\n\n")
+	if len(events) != 2 {
+		t.Fatalf("expected 2 events, got %d: %q", len(events), w.Body.String())
+	}
+	lines := strings.Split(events[0], "\n")
+	if len(lines) != 2 || lines[0] != "event: delta" || !strings.HasPrefix(lines[1], "data: ") {
+		t.Fatalf("unexpected delta event: %q", events[0])
+	}
+	var delta map[string]string
+	if err := json.Unmarshal([]byte(strings.TrimPrefix(lines[1], "data: ")), &delta); err != nil {
+		t.Fatalf("decode delta: %v", err)
+	}
+	if delta["text"] != "Привіт\nсвіт" {
+		t.Errorf("expected newline preserved in delta text, got %q", delta["text"])
+	}
+	if !strings.HasPrefix(events[1], "event: done\ndata: ") {
+		t.Errorf("unexpected done event: %q", events[1])
+	}
+}
+
 func TestRespondJSON(t *testing.T) {
 	w := httptest.NewRecorder()
 	resp := &ProcessResponse{
@@ -66,6 +114,29 @@ func TestRespondJSON(t *testing.T) {
 	}
 }
 
+// A reply written after the server WriteTimeout has passed (turn queued, then a long generation) must
+// still reach the client.
+func TestExtendWriteDeadline_OutlivesServerWriteTimeout(t *testing.T) {
+	srv := httptest.NewUnstartedServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		time.Sleep(150 * time.Millisecond)
+		extendWriteDeadline(w)
+		respondJSON(w, &ProcessResponse{Reply: "late"})
+	}))
+	srv.Config.WriteTimeout = 50 * time.Millisecond
+	srv.Start()
+	defer srv.Close()
+
+	resp, err := http.Post(srv.URL, "application/json", strings.NewReader("{}"))
+	if err != nil {
+		t.Fatalf("request failed: %v", err)
+	}
+	defer resp.Body.Close()
+	var decoded ProcessResponse
+	if err := json.NewDecoder(resp.Body).Decode(&decoded); err != nil || decoded.Reply != "late" {
+		t.Fatalf("expected the late reply, got %+v (err %v)", decoded, err)
+	}
+}
+
 // TestRespondJSON_MediaBase64 verifies that ProcessResponse serializes media_base64 and media_type
 // (used when the backend returns a generated image as base64 to the frontend).
 func TestRespondJSON_MediaBase64(t *testing.T) {
@@ -142,3 +213,19 @@ func TestInferMimeType(t *testing.T) {
 		t.Error("mime_type should override media_type")
 	}
 }
+
+func TestResolveMediaFile_AttachmentRef(t *testing.T) {
+	h := &Handler{config: &config.Config{MediaUploadMinBytes: 1}}
+	req := &ProcessRequest{MediaType: "voice", AttachmentRef: "https://generativelanguage.googleapis.com/v1beta/files/abc"}
+	h.resolveMediaFile(context.Background(), slog.Default(), req)
+	if req.mediaURI != req.AttachmentRef {
+		t.Errorf("mediaURI = %q, want the attachment_ref", req.mediaURI)
+	}
+
+	// Without a Gemini client (or for small media) the bytes stay inline
+	inline := &ProcessRequest{MediaType: "voice", Media: []byte("ogg")}
+	h.resolveMediaFile(context.Background(), slog.Default(), inline)
+	if inline.mediaURI != "" {
+		t.Errorf("mediaURI = %q, want inline media", inline.mediaURI)
+	}
+}
@@ -0,0 +1,209 @@
+package handler
+
+import (
+	"context"
+	"log/slog"
+	"sync"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/metrics"
+)
+
+// queuedMessage is one incoming message waiting for its chat's turn.
+type queuedMessage struct {
+	ctx       context.Context
+	req       *ProcessRequest
+	requestID string
+	onText    func(string)
+	// result receives the turn's response for the message that gets the reply, or nil when the
+	// message was folded into a turn answered through another request.
+	result chan *ProcessResponse
+}
+
+// chatTurns is the per-chat queue state. Guarded by chatQueue.mu.
+type chatTurns struct {
+	pending []*queuedMessage
+}
+
+// chatQueue serializes generations per chat and coalesces bursts (replaces the Redis SETNX lock).
+// The first message of an idle chat is processed immediately. Messages arriving while a turn is running
+// are batched: once the turn ends, the worker waits until no new message arrived for the debounce window
+// (capped by maxWait and maxBatch), then runs one generation that sees the whole batch as the current turn.
+// The reply goes to the newest message of the batch whose request is still connected (the newest one
+// when none is); the others are answered with nil (silent 204). The turn itself must not depend on the
+// waiters' contexts, which end when their clients leave; see Handler.runTurn.
+//
+// At most maxPending messages wait per chat; each one holds a blocked request with its decoded body
+// and media. Messages beyond that are answered at once with nil and counted as dropped.
+//
+// State is in-process, so exclusivity holds per backend instance.
+type chatQueue struct {
+	mu         sync.Mutex
+	chats      map[int64]*chatTurns // present = a worker is running for the chat
+	debounce   time.Duration
+	maxWait    time.Duration
+	maxBatch   int
+	maxPending int
+	// process runs one turn; replyTo is the index in batch of the message expected to get the reply.
+	process func(batch []*queuedMessage, replyTo int) *ProcessResponse
+}
+
+func newChatQueue(debounce, maxWait time.Duration, maxBatch, maxPending int, process func(batch []*queuedMessage, replyTo int) *ProcessResponse) *chatQueue {
+	if maxBatch <= 0 {
+		maxBatch = 1
+	}
+	if maxPending < maxBatch {
+		maxPending = maxBatch
+	}
+	if maxWait < debounce {
+		maxWait = debounce
+	}
+	return &chatQueue{
+		chats:      make(map[int64]*chatTurns),
+		debounce:   debounce,
+		maxWait:    maxWait,
+		maxBatch:   maxBatch,
+		maxPending: maxPending,
+		process:    process,
+	}
+}
+
+// submit queues a message and waits for its turn. It returns the response when this message got the
+// reply, or nil when it was coalesced into a turn answered elsewhere, the chat's queue was full or ctx
+// ended while waiting.
+func (q *chatQueue) submit(m *queuedMessage) *ProcessResponse {
+	m.result = make(chan *ProcessResponse, 1)
+	chatID := m.req.ChatID
+
+	q.mu.Lock()
+	st, busy := q.chats[chatID]
+	if !busy {
+		st = &chatTurns{}
+		q.chats[chatID] = st
+	}
+	if len(st.pending) >= q.maxPending {
+		q.mu.Unlock()
+		metrics.QueueDropped.With("turn_queue").Inc()
+		slog.Warn("chat turn queue full, dropping message", "chat_id", chatID, "request_id", m.requestID, "pending", q.maxPending)
+		return nil
+	}
+	st.pending = append(st.pending, m)
+	q.mu.Unlock()
+
+	if !busy {
+		go q.work(chatID)
+	}
+
+	select {
+	case resp := <-m.result:
+		return resp
+	case <-m.ctx.Done():
+		// Still part of its batch; the reply goes to the newest waiter still connected.
+		return nil
+	}
+}
+
+// work runs turns for one chat until its queue is empty. The first turn starts without debounce.
+func (q *chatQueue) work(chatID int64) {
+	first := true
+	for {
+		if !first {
+			q.settle(chatID)
+		}
+		first = false
+
+		q.mu.Lock()
+		st := q.chats[chatID]
+		if len(st.pending) == 0 {
+			delete(q.chats, chatID)
+			q.mu.Unlock()
+			return
+		}
+		n := len(st.pending)
+		if n > q.maxBatch {
+			n = q.maxBatch
+		}
+		batch := st.pending[:n:n]
+		st.pending = st.pending[n:]
+		q.mu.Unlock()
+
+		q.run(batch)
+	}
+}
+
+// waiting returns the number of messages queued behind running turns, over all chats.
+func (q *chatQueue) waiting() int {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	n := 0
+	for _, st := range q.chats {
+		n += len(st.pending)
+	}
+	return n
+}
+
+// settle waits until no new message arrived for the debounce window, the batch is full or maxWait passed.
+func (q *chatQueue) settle(chatID int64) {
+	if q.debounce <= 0 {
+		return
+	}
+	deadline := time.Now().Add(q.maxWait)
+	q.mu.Lock()
+	seen := len(q.chats[chatID].pending)
+	q.mu.Unlock()
+	if seen == 0 {
+		return
+	}
+	for {
+		wait := q.debounce
+		if left := time.Until(deadline); left < wait {
+			wait = left
+		}
+		if wait <= 0 {
+			return
+		}
+		time.Sleep(wait)
+		q.mu.Lock()
+		n := len(q.chats[chatID].pending)
+		q.mu.Unlock()
+		if n == seen || n >= q.maxBatch {
+			return
+		}
+		seen = n
+	}
+}
+
+// run processes one batch and delivers the reply to its newest message that is still connected.
+func (q *chatQueue) run(batch []*queuedMessage) {
+	to := replyTarget(batch)
+	var resp *ProcessResponse
+	defer func() {
+		// Never leave waiters hanging or kill the worker if processing panicked.
+		if r := recover(); r != nil {
+			slog.Error("chat turn panicked", "chat_id", batch[to].req.ChatID, "request_id", batch[to].requestID, "panic", r)
+		}
+		// The chosen waiter may have gone away during the turn; hand the reply to another one.
+		if batch[to].ctx.Err() != nil {
+			to = replyTarget(batch)
+		}
+		for i, m := range batch {
+			if i == to {
+				m.result <- resp
+			} else {
+				m.result <- nil
+			}
+		}
+	}()
+	resp = q.process(batch, to)
+}
+
+// replyTarget returns the index of the newest message whose request is still connected, or of the
+// newest message when none is.
+func replyTarget(batch []*queuedMessage) int {
+	for i := len(batch) - 1; i >= 0; i-- {
+		if batch[i].ctx.Err() == nil {
+			return i
+		}
+	}
+	return len(batch) - 1
+}
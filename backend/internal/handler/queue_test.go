@@ -0,0 +1,209 @@
+package handler
+
+import (
+	"context"
+	"sync"
+	"testing"
+	"time"
+)
+
+func queued(chatID int64, text string) *queuedMessage {
+	return &queuedMessage{ctx: context.Background(), req: &ProcessRequest{ChatID: chatID, Text: text}, requestID: text}
+}
+
+func TestChatQueue_IdleChatRunsImmediately(t *testing.T) {
+	q := newChatQueue(time.Hour, time.Hour, 10, 100, func(batch []*queuedMessage, replyTo int) *ProcessResponse {
+		return &ProcessResponse{Reply: "re: " + batch[0].req.Text}
+	})
+
+	start := time.Now()
+	resp := q.submit(queued(1, "hi"))
+	if resp == nil || resp.Reply != "re: hi" {
+		t.Fatalf("expected reply for single message, got %+v", resp)
+	}
+	if time.Since(start) > time.Second {
+		t.Error("expected no debounce for the first message of an idle chat")
+	}
+}
+
+func TestChatQueue_CoalescesMessagesDuringTurn(t *testing.T) {
+	release := make(chan struct{})
+	var mu sync.Mutex
+	var batches [][]string
+	q := newChatQueue(20*time.Millisecond, time.Second, 10, 100, func(batch []*queuedMessage, replyTo int) *ProcessResponse {
+		var texts []string
+		for _, m := range batch {
+			texts = append(texts, m.req.Text)
+		}
+		mu.Lock()
+		batches = append(batches, texts)
+		first := len(batches) == 1
+		mu.Unlock()
+		if first {
+			<-release
+		}
+		return &ProcessResponse{Reply: texts[len(texts)-1]}
+	})
+
+	results := make(map[string]*ProcessResponse)
+	var wg sync.WaitGroup
+	submit := func(text string) {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			resp := q.submit(queued(7, text))
+			mu.Lock()
+			results[text] = resp
+			mu.Unlock()
+		}()
+	}
+
+	submit("m1")
+	for { // wait until m1's turn is running
+		mu.Lock()
+		n := len(batches)
+		mu.Unlock()
+		if n == 1 {
+			break
+		}
+		time.Sleep(time.Millisecond)
+	}
+	for _, text := range []string{"m2", "m3", "m4"} {
+		submit(text)
+		time.Sleep(5 * time.Millisecond) // keep arrival order deterministic
+	}
+	close(release)
+	wg.Wait()
+
+	if len(batches) != 2 {
+		t.Fatalf("expected 2 turns, got %d: %v", len(batches), batches)
+	}
+	if got := batches[1]; len(got) != 3 || got[0] != "m2" || got[2] != "m4" {
+		t.Errorf("expected follow-up batch [m2 m3 m4], got %v", got)
+	}
+	if results["m1"] == nil || results["m4"] == nil || results["m4"].Reply != "m4" {
+		t.Errorf("expected replies for m1 and m4, got %+v", results)
+	}
+	if results["m2"] != nil || results["m3"] != nil {
+		t.Error("expected coalesced messages m2 and m3 to get no reply")
+	}
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	if len(q.chats) != 0 {
+		t.Error("expected idle chat to be removed from the queue")
+	}
+}
+
+func TestChatQueue_PanicDoesNotHangWaiters(t *testing.T) {
+	q := newChatQueue(0, 0, 10, 100, func([]*queuedMessage, int) *ProcessResponse { panic("boom") })
+	done := make(chan *ProcessResponse, 1)
+	go func() { done <- q.submit(queued(3, "x")) }()
+	select {
+	case resp := <-done:
+		if resp != nil {
+			t.Errorf("expected nil response after panic, got %+v", resp)
+		}
+	case <-time.After(time.Second):
+		t.Fatal("submit hung after a panicking turn")
+	}
+}
+
+func TestChatQueue_ReplyGoesToNewestConnectedWaiter(t *testing.T) {
+	release := make(chan struct{})
+	started := make(chan struct{}, 1)
+	var mu sync.Mutex
+	var gotReplyTo []int
+	q := newChatQueue(0, 0, 10, 100, func(batch []*queuedMessage, replyTo int) *ProcessResponse {
+		started <- struct{}{}
+		mu.Lock()
+		gotReplyTo = append(gotReplyTo, replyTo)
+		mu.Unlock()
+		<-release
+		return &ProcessResponse{Reply: "re: " + batch[replyTo].req.Text}
+	})
+
+	go q.submit(queued(5, "m1"))
+	<-started // m1's turn is running
+
+	results := make(map[string]*ProcessResponse)
+	var wg sync.WaitGroup
+	submit := func(m *queuedMessage) {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			resp := q.submit(m)
+			mu.Lock()
+			results[m.req.Text] = resp
+			mu.Unlock()
+		}()
+	}
+	submit(queued(5, "m2"))
+	time.Sleep(5 * time.Millisecond)
+	gone, cancel := context.WithCancel(context.Background())
+	m3 := queued(5, "m3")
+	m3.ctx = gone
+	submit(m3)
+	time.Sleep(5 * time.Millisecond)
+	cancel() // the newest client disconnects while queued
+
+	release <- struct{}{} // finish m1's turn
+	<-started             // the [m2 m3] turn
+	release <- struct{}{}
+	wg.Wait()
+
+	if len(gotReplyTo) != 2 || gotReplyTo[1] != 0 {
+		t.Fatalf("expected the follow-up turn to reply to m2 (index 0), got %v", gotReplyTo)
+	}
+	if results["m2"] == nil || results["m2"].Reply != "re: m2" {
+		t.Errorf("expected m2, still connected, to get the reply; got %+v", results["m2"])
+	}
+	if results["m3"] != nil {
+		t.Errorf("expected disconnected m3 to get nothing, got %+v", results["m3"])
+	}
+}
+
+func TestChatQueue_DropsMessagesBeyondMaxPending(t *testing.T) {
+	release := make(chan struct{})
+	started := make(chan struct{}, 1)
+	q := newChatQueue(0, 0, 1, 2, func(batch []*queuedMessage, replyTo int) *ProcessResponse {
+		started <- struct{}{}
+		<-release
+		return &ProcessResponse{Reply: "re: " + batch[replyTo].req.Text}
+	})
+
+	go q.submit(queued(9, "m1"))
+	<-started // m1's turn is running
+	var wg sync.WaitGroup
+	for _, text := range []string{"m2", "m3"} {
+		wg.Add(1)
+		go func(text string) {
+			defer wg.Done()
+			q.submit(queued(9, text))
+		}(text)
+	}
+	for q.waiting() < 2 {
+		time.Sleep(time.Millisecond)
+	}
+
+	done := make(chan *ProcessResponse, 1)
+	go func() { done <- q.submit(queued(9, "m4")) }()
+	select {
+	case resp := <-done:
+		if resp != nil {
+			t.Errorf("expected no reply for a message beyond the queue bound, got %+v", resp)
+		}
+	case <-time.After(time.Second):
+		t.Fatal("expected a message beyond the queue bound to be answered at once")
+	}
+	if n := q.waiting(); n != 2 {
+		t.Errorf("expected 2 messages still waiting, got %d", n)
+	}
+
+	for i := 0; i < 3; i++ {
+		release <- struct{}{}
+		if i < 2 {
+			<-started
+		}
+	}
+	wg.Wait()
+}
@@ -0,0 +1,175 @@
+package handler
+
+import (
+	"context"
+	"encoding/base64"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"log/slog"
+	"mime"
+	"mime/multipart"
+	"net/http"
+	"path/filepath"
+	"strconv"
+
+	"github.com/ThatHunky/gryag/backend/internal/config"
+)
+
+// Wire format of /api/v1/process and /api/v1/process/stream:
+//
+//	application/json     — ProcessRequest as JSON; media, if any, inline as media_base64 (legacy)
+//	multipart/form-data  — part "payload": ProcessRequest as JSON (must come first),
+//	                       optional part "media": the raw attachment bytes with its Content-Type
+//
+// Either way the attachment ends up once, decoded, in ProcessRequest.Media.
+const (
+	payloadPartName = "payload"
+	mediaPartName   = "media"
+)
+
+// errMediaTooLarge is returned when the attachment exceeds MEDIA_MAX_BYTES.
+var errMediaTooLarge = errors.New("media exceeds size limit")
+
+// ReadProcessRequest decodes a ProcessRequest from either wire format. maxMedia caps the attachment
+// size in bytes (0 = no limit).
+func ReadProcessRequest(r *http.Request, maxMedia int64) (*ProcessRequest, error) {
+	mediaType, params, _ := mime.ParseMediaType(r.Header.Get("Content-Type"))
+	if mediaType == "multipart/form-data" {
+		return readMultipartRequest(multipart.NewReader(r.Body, params["boundary"]), maxMedia)
+	}
+
+	var req ProcessRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
+		return nil, fmt.Errorf("decode payload: %w", err)
+	}
+	if req.MediaBase64 != "" {
+		data, err := base64.StdEncoding.DecodeString(req.MediaBase64)
+		req.MediaBase64 = ""
+		if err != nil {
+			// Same as before: a broken attachment is dropped, the text is still answered.
+			slog.Warn("failed to decode media_base64", "error", err)
+		} else if maxMedia > 0 && int64(len(data)) > maxMedia {
+			return nil, errMediaTooLarge
+		} else {
+			req.Media = data
+		}
+	}
+	return &req, nil
+}
+
+func readMultipartRequest(mr *multipart.Reader, maxMedia int64) (*ProcessRequest, error) {
+	part, err := mr.NextPart()
+	if err != nil {
+		return nil, fmt.Errorf("read payload part: %w", err)
+	}
+	if part.FormName() != payloadPartName {
+		return nil, fmt.Errorf("first part is %q, want %q", part.FormName(), payloadPartName)
+	}
+	var req ProcessRequest
+	if err := json.NewDecoder(part).Decode(&req); err != nil {
+		return nil, fmt.Errorf("decode payload: %w", err)
+	}
+
+	for {
+		part, err := mr.NextPart()
+		if err == io.EOF {
+			return &req, nil
+		}
+		if err != nil {
+			return nil, fmt.Errorf("read media part: %w", err)
+		}
+		if part.FormName() != mediaPartName {
+			continue
+		}
+		src := io.Reader(part)
+		if maxMedia > 0 {
+			src = io.LimitReader(part, maxMedia+1)
+		}
+		data, err := io.ReadAll(src)
+		if err != nil {
+			return nil, fmt.Errorf("read media part: %w", err)
+		}
+		if maxMedia > 0 && int64(len(data)) > maxMedia {
+			return nil, errMediaTooLarge
+		}
+		req.Media = data
+		if req.MimeType == "" {
+			if ct := part.Header.Get("Content-Type"); ct != "" && ct != "application/octet-stream" {
+				req.MimeType = ct
+			}
+		}
+	}
+}
+
+// MaxRequestBytes is the body size limit for process requests: the attachment limit with room for
+// base64 inflation (legacy JSON transport) plus 1 MiB for the payload and multipart framing.
+// Returns 0 (no limit) when MEDIA_MAX_BYTES is 0.
+func MaxRequestBytes(cfg *config.Config) int64 {
+	if cfg.MediaMaxBytes <= 0 {
+		return 0
+	}
+	return int64(cfg.MediaMaxBytes)/3*4 + 4 + 1<<20
+}
+
+// requestKey is the context key for a ProcessRequest already decoded by the rate limiter.
+type requestKey struct{}
+
+// WithRequest returns ctx carrying the decoded request, so the handler does not read the body again.
+func WithRequest(ctx context.Context, req *ProcessRequest) context.Context {
+	return context.WithValue(ctx, requestKey{}, req)
+}
+
+// RequestFromContext returns the request stored by WithRequest, if any.
+func RequestFromContext(ctx context.Context) (*ProcessRequest, bool) {
+	req, ok := ctx.Value(requestKey{}).(*ProcessRequest)
+	return req, ok && req != nil
+}
+
+// WriteDecodeError answers a request whose payload could not be read.
+func WriteDecodeError(w http.ResponseWriter, err error) {
+	var maxErr *http.MaxBytesError
+	if errors.Is(err, errMediaTooLarge) || errors.As(err, &maxErr) {
+		http.Error(w, `{"error":"media too large"}`, http.StatusRequestEntityTooLarge)
+		return
+	}
+	http.Error(w, `{"error":"invalid payload"}`, http.StatusBadRequest)
+}
+
+// Media handles GET /api/v1/media/{media_id}?chat_id=...: streams a media_cache file (generated images)
+// so replies carry a media_id instead of the image bytes. Only the chat the image was generated for can
+// fetch it, and only when that chat passes the ALLOWED_CHAT_IDS whitelist, as for /api/v1/process;
+// other requests get 404, so a media_id alone does not give access.
+func (h *Handler) Media(w http.ResponseWriter, r *http.Request) {
+	mediaID := r.PathValue("media_id")
+	chatID, err := strconv.ParseInt(r.URL.Query().Get("chat_id"), 10, 64)
+	if err != nil {
+		http.Error(w, `{"error":"chat_id required"}`, http.StatusBadRequest)
+		return
+	}
+	if !h.config.ChatAllowed(chatID) {
+		slog.Info("chat_not_allowed", "chat_id", chatID, "media_id", mediaID)
+		http.NotFound(w, r)
+		return
+	}
+	entry, err := h.db.GetMediaCacheByID(r.Context(), mediaID)
+	if err != nil {
+		slog.Error("media lookup failed", "media_id", mediaID, "error", err)
+		http.Error(w, `{"error":"internal error"}`, http.StatusInternalServerError)
+		return
+	}
+	if entry == nil || entry.ChatID != chatID {
+		http.NotFound(w, r)
+		return
+	}
+	f, modTime, err := h.db.OpenMedia(entry)
+	if err != nil {
+		slog.Warn("media file missing", "media_id", mediaID, "error", err)
+		http.NotFound(w, r)
+		return
+	}
+	defer f.Close()
+	// Content-Type follows the file extension (.png)
+	http.ServeContent(w, r, filepath.Base(entry.FilePath), modTime, f)
+}
@@ -0,0 +1,111 @@
+package handler
+
+import (
+	"bytes"
+	"encoding/base64"
+	"mime/multipart"
+	"net/http"
+	"net/http/httptest"
+	"net/textproto"
+	"strings"
+	"testing"
+
+	"github.com/ThatHunky/gryag/backend/internal/config"
+)
+
+func newMultipartRequest(t *testing.T, payload string, media []byte, mediaType string) *http.Request {
+	t.Helper()
+	var body bytes.Buffer
+	mw := multipart.NewWriter(&body)
+	if err := mw.WriteField(payloadPartName, payload); err != nil {
+		t.Fatal(err)
+	}
+	if media != nil {
+		h := make(textproto.MIMEHeader)
+		h.Set("Content-Disposition", `form-data; name="media"; filename="media"`)
+		h.Set("Content-Type", mediaType)
+		part, err := mw.CreatePart(h)
+		if err != nil {
+			t.Fatal(err)
+		}
+		part.Write(media)
+	}
+	mw.Close()
+	req := httptest.NewRequest("POST", "/api/v1/process", &body)
+	req.Header.Set("Content-Type", mw.FormDataContentType())
+	return req
+}
+
+func TestReadProcessRequest_Multipart(t *testing.T) {
+	media := []byte{0xff, 0xd8, 0xff, 0x00, 0x01}
+	r := newMultipartRequest(t, `{"chat_id": -100, "text": "look", "media_type": "photo"}`, media, "image/jpeg")
+
+	req, err := ReadProcessRequest(r, 1024)
+	if err != nil {
+		t.Fatalf("ReadProcessRequest: %v", err)
+	}
+	if req.ChatID != -100 || req.Text != "look" {
+		t.Errorf("unexpected payload: %+v", req)
+	}
+	if !bytes.Equal(req.Media, media) {
+		t.Errorf("expected raw media bytes, got %v", req.Media)
+	}
+	if req.MimeType != "image/jpeg" {
+		t.Errorf("expected mime type from part header, got %q", req.MimeType)
+	}
+}
+
+func TestReadProcessRequest_LegacyBase64(t *testing.T) {
+	media := []byte("fake-png")
+	body := `{"chat_id": 1, "media_base64": "` + base64.StdEncoding.EncodeToString(media) + `"}`
+	r := httptest.NewRequest("POST", "/api/v1/process", strings.NewReader(body))
+
+	req, err := ReadProcessRequest(r, 1024)
+	if err != nil {
+		t.Fatalf("ReadProcessRequest: %v", err)
+	}
+	if !bytes.Equal(req.Media, media) || req.MediaBase64 != "" {
+		t.Errorf("expected media decoded once into Media, got %q / %q", req.Media, req.MediaBase64)
+	}
+}
+
+func TestReadProcessRequest_PayloadMustComeFirst(t *testing.T) {
+	var body bytes.Buffer
+	mw := multipart.NewWriter(&body)
+	mw.WriteField(mediaPartName, "data")
+	mw.WriteField(payloadPartName, `{"chat_id": 1}`)
+	mw.Close()
+	r := httptest.NewRequest("POST", "/api/v1/process", &body)
+	r.Header.Set("Content-Type", mw.FormDataContentType())
+
+	if _, err := ReadProcessRequest(r, 0); err == nil {
+		t.Error("expected error when media precedes payload")
+	}
+}
+
+func TestProcess_MediaTooLarge(t *testing.T) {
+	h := &Handler{config: &config.Config{MediaMaxBytes: 4}}
+	r := newMultipartRequest(t, `{"chat_id": 1}`, []byte("12345"), "image/png")
+	w := httptest.NewRecorder()
+
+	h.Process(w, r)
+
+	if w.Code != http.StatusRequestEntityTooLarge {
+		t.Errorf("expected 413, got %d", w.Code)
+	}
+}
+
+func TestMedia_RequiresAllowedChat(t *testing.T) {
+	h := &Handler{config: &config.Config{AllowedChatIDs: []int64{-100}}}
+	for path, want := range map[string]int{
+		"/api/v1/media/abc":             http.StatusBadRequest, // no chat_id
+		"/api/v1/media/abc?chat_id=x":   http.StatusBadRequest,
+		"/api/v1/media/abc?chat_id=-42": http.StatusNotFound, // not whitelisted; the lookup is never made
+	} {
+		rec := httptest.NewRecorder()
+		h.Media(rec, httptest.NewRequest(http.MethodGet, path, nil))
+		if rec.Code != want {
+			t.Errorf("GET %s: expected %d, got %d", path, want, rec.Code)
+		}
+	}
+}
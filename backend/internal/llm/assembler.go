@@ -0,0 +1,171 @@
+package llm
+
+import "log/slog"
+
+// mediaPartTokens is what one media part is counted as: Gemini bills an image at 258 tokens per tile.
+const mediaPartTokens = 258
+
+// EstimateTokens approximates the Gemini token count of text at about 4 bytes per token. That is close
+// for English and errs high for Cyrillic (2 bytes per letter), which is the safe side for a budget.
+// An exact count would cost a CountTokens round trip per prompt.
+func EstimateTokens(text string) int {
+	return (len(text) + 3) / 4
+}
+
+// TokenBudget hands out the tokens of one prompt. A limit of 0 or less means unlimited.
+type TokenBudget struct {
+	limit int
+	used  int
+}
+
+// NewTokenBudget returns a budget of limit tokens (0 = unlimited).
+func NewTokenBudget(limit int) *TokenBudget {
+	return &TokenBudget{limit: limit}
+}
+
+// Take reserves tokens if they still fit and reports whether they did.
+func (b *TokenBudget) Take(tokens int) bool {
+	if b.limit > 0 && b.used+tokens > b.limit {
+		return false
+	}
+	b.used += tokens
+	return true
+}
+
+// Charge reserves tokens whether or not they fit (blocks that are always sent).
+func (b *TokenBudget) Charge(tokens int) {
+	b.used += tokens
+}
+
+// Used returns the tokens reserved so far.
+func (b *TokenBudget) Used() int { return b.used }
+
+// ContextUsage is the estimated token count of each prompt block, filled in by BuildParts.
+type ContextUsage struct {
+	Budget          int // CONTEXT_TOKEN_BUDGET (0 = unlimited)
+	ChatInfo        int
+	Summaries       int
+	ChatLog         int
+	Facts           int
+	Media           int
+	Message         int
+	MessagesKept    int
+	MessagesDropped int
+	SummariesKept   int
+	FactsDropped    int
+}
+
+// Total returns the estimated tokens of the whole dynamic prompt.
+func (u ContextUsage) Total() int {
+	return u.ChatInfo + u.Summaries + u.ChatLog + u.Facts + u.Media + u.Message
+}
+
+// promptBlocks is the rendered text of each block; empty blocks are left out of the prompt.
+type promptBlocks struct {
+	chatInfo  string
+	summaries string
+	chatLog   string
+	facts     string
+	message   string
+	time      string // "# Current Time" header, placed by the layout
+}
+
+// assemble renders the blocks and fills the token budget by priority: the current message, chat info
+// and media are always sent; then user facts, the 7-day summary, the recent messages (newest first, so
+// the oldest are dropped) and last the 30-day summary. A block that does not fit as a whole is trimmed
+// (facts, chat log) or left out (summaries).
+func (di *DynamicInstructions) assemble() (promptBlocks, ContextUsage) {
+	budget := NewTokenBudget(di.TokenBudget)
+	usage := ContextUsage{Budget: di.TokenBudget}
+	var blocks promptBlocks
+
+	blocks.time = "# Current Time\n" + di.CurrentTime + "\n\n"
+	blocks.message = di.messageBlock()
+	usage.Message = EstimateTokens(blocks.time) + EstimateTokens(blocks.message)
+	budget.Charge(usage.Message)
+
+	blocks.chatInfo = di.chatInfoBlock()
+	usage.ChatInfo = EstimateTokens(blocks.chatInfo)
+	budget.Charge(usage.ChatInfo)
+
+	usage.Media = len(di.MediaParts) * mediaPartTokens
+	budget.Charge(usage.Media)
+
+	facts := di.UserFacts
+	if len(facts) > 0 {
+		header := di.factsHeader()
+		kept := 0
+		if budget.Take(EstimateTokens(header)) {
+			for _, f := range facts {
+				if !budget.Take(EstimateTokens(f.FactText) + 1) {
+					break
+				}
+				kept++
+			}
+		}
+		usage.FactsDropped = len(facts) - kept
+		if kept > 0 {
+			blocks.facts = di.factsBlock(header, facts[:kept])
+			usage.Facts = EstimateTokens(blocks.facts)
+		}
+	}
+
+	var summary7, summary30 string
+	if di.Summary7Day != "" && budget.Take(EstimateTokens(di.Summary7Day)+4) {
+		summary7 = di.Summary7Day
+	}
+
+	lines := di.chatLogLines(budget)
+	usage.MessagesKept = len(lines)
+	usage.MessagesDropped = len(di.RecentMessages) - len(lines)
+	blocks.chatLog = chatLogBlock(lines)
+	usage.ChatLog = EstimateTokens(blocks.chatLog)
+
+	if di.Summary30Day != "" && budget.Take(EstimateTokens(di.Summary30Day)+4) {
+		summary30 = di.Summary30Day
+	}
+	blocks.summaries = summariesBlock(summary30, summary7)
+	usage.Summaries = EstimateTokens(blocks.summaries)
+	for _, s := range []string{summary30, summary7} {
+		if s != "" {
+			usage.SummariesKept++
+		}
+	}
+
+	return blocks, usage
+}
+
+// chatLogLines renders the recent messages newest first while they fit budget.
+func (di *DynamicInstructions) chatLogLines(budget *TokenBudget) []string {
+	if len(di.RecentMessages) == 0 || !budget.Take(EstimateTokens(chatLogHeader)) {
+		return nil
+	}
+	lines := make([]string, 0, len(di.RecentMessages))
+	for i := len(di.RecentMessages) - 1; i >= 0; i-- {
+		line := ChatLine(di.RecentMessages[i])
+		if !budget.Take(EstimateTokens(line)) {
+			break
+		}
+		lines = append(lines, line)
+	}
+	return lines
+}
+
+// logUsage reports the token usage of each block of an assembled prompt.
+func (di *DynamicInstructions) logUsage(u ContextUsage) {
+	slog.Info("prompt assembled",
+		"chat_id", di.ChatID,
+		"budget_tokens", u.Budget,
+		"total_tokens", u.Total(),
+		"chat_info_tokens", u.ChatInfo,
+		"summaries_tokens", u.Summaries,
+		"chat_log_tokens", u.ChatLog,
+		"facts_tokens", u.Facts,
+		"media_tokens", u.Media,
+		"message_tokens", u.Message,
+		"messages_kept", u.MessagesKept,
+		"messages_dropped", u.MessagesDropped,
+		"summaries_kept", u.SummariesKept,
+		"facts_dropped", u.FactsDropped,
+	)
+}
@@ -0,0 +1,143 @@
+package llm
+
+import (
+	"fmt"
+	"io"
+	"log/slog"
+	"strings"
+	"testing"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+)
+
+func TestEstimateTokens(t *testing.T) {
+	if got := EstimateTokens(""); got != 0 {
+		t.Errorf("EstimateTokens(\"\") = %d, want 0", got)
+	}
+	if got := EstimateTokens("abcde"); got != 2 {
+		t.Errorf("EstimateTokens(5 bytes) = %d, want 2", got)
+	}
+	// Cyrillic letters are 2 bytes each
+	if got := EstimateTokens("Привіт"); got != 3 {
+		t.Errorf("EstimateTokens(Cyrillic) = %d, want 3", got)
+	}
+}
+
+func TestTokenBudget(t *testing.T) {
+	b := NewTokenBudget(10)
+	b.Charge(8)
+	if b.Take(3) {
+		t.Error("Take(3) succeeded with 2 tokens left")
+	}
+	if !b.Take(2) || b.Used() != 10 {
+		t.Errorf("Take(2) failed or used = %d, want 10", b.Used())
+	}
+	if !NewTokenBudget(0).Take(1 << 30) {
+		t.Error("a zero budget must be unlimited")
+	}
+}
+
+func TestAssembleDropsOldestMessagesFirst(t *testing.T) {
+	name := "Anna"
+	var messages []db.Message
+	for _, s := range []string{"oldest " + strings.Repeat("x", 400), "middle", "newest"} {
+		text := s
+		messages = append(messages, db.Message{FirstName: &name, Text: &text})
+	}
+	di := &DynamicInstructions{
+		CurrentTime:    "10:00 Monday, 24/02/2026",
+		ChatID:         1,
+		CurrentMessage: "hi",
+		FirstName:      "Bob",
+		Summary30Day:   strings.Repeat("m", 400),
+		Summary7Day:    "Week.",
+		UserFacts:      []db.UserFact{{FactText: "Likes tea"}},
+		RecentMessages: messages,
+		TokenBudget:    120,
+	}
+	blocks, usage := di.assemble()
+
+	if !strings.Contains(blocks.facts, "Likes tea") || !strings.Contains(blocks.summaries, "Week.") {
+		t.Errorf("facts and 7-day summary must fit: facts=%q summaries=%q", blocks.facts, blocks.summaries)
+	}
+	if strings.Contains(blocks.summaries, "30-Day") {
+		t.Error("30-day summary should be dropped first")
+	}
+	want := "# Immediate Chat Context\nAnna: middle\nAnna: newest\n"
+	if blocks.chatLog != want {
+		t.Errorf("chat log = %q, want %q", blocks.chatLog, want)
+	}
+	if usage.MessagesKept != 2 || usage.MessagesDropped != 1 || usage.SummariesKept != 1 {
+		t.Errorf("usage = %+v", usage)
+	}
+	if usage.Total() > di.TokenBudget {
+		t.Errorf("total %d exceeds budget %d", usage.Total(), di.TokenBudget)
+	}
+}
+
+func TestAssembleUnlimitedKeepsEverything(t *testing.T) {
+	text := "hello"
+	di := &DynamicInstructions{
+		CurrentTime:    "10:00 Monday, 24/02/2026",
+		CurrentMessage: "hi",
+		Summary30Day:   "Month.",
+		Summary7Day:    "Week.",
+		RecentMessages: []db.Message{{Text: &text}, {Text: &text}},
+	}
+	blocks, usage := di.assemble()
+	if usage.MessagesKept != 2 || usage.SummariesKept != 2 {
+		t.Errorf("usage = %+v", usage)
+	}
+	if blocks.chatLog != "# Immediate Chat Context\nUnknown: hello\nUnknown: hello\n" {
+		t.Errorf("chat log = %q", blocks.chatLog)
+	}
+}
+
+// benchInstructions is a prompt the size of a busy chat: a full context window, both summaries and
+// a handful of user facts.
+func benchInstructions(messages, budget int) *DynamicInstructions {
+	di := &DynamicInstructions{
+		CurrentTime:    "10:00 Monday, 24/02/2026",
+		ChatName:       "Bench chat",
+		ChatID:         -1001234567890,
+		UserID:         42,
+		FirstName:      "Bob",
+		CurrentMessage: "гряг, що думаєш?",
+		Summary30Day:   strings.Repeat("Місячний підсумок. ", 200),
+		Summary7Day:    strings.Repeat("Weekly summary. ", 100),
+		TokenBudget:    budget,
+	}
+	for i := 0; i < 10; i++ {
+		di.UserFacts = append(di.UserFacts, db.UserFact{FactText: fmt.Sprintf("Fact number %d about Bob", i)})
+	}
+	for i := 0; i < messages; i++ {
+		name := fmt.Sprintf("user%d", i%7)
+		text := fmt.Sprintf("message %d: %s", i, strings.Repeat("слово ", 12))
+		di.RecentMessages = append(di.RecentMessages, db.Message{FirstName: &name, Text: &text})
+	}
+	return di
+}
+
+func BenchmarkBuildParts(b *testing.B) {
+	defer slog.SetDefault(slog.Default())
+	slog.SetDefault(slog.New(slog.NewTextHandler(io.Discard, nil)))
+
+	for _, bc := range []struct {
+		name   string
+		budget int
+		stable bool
+	}{
+		{"unlimited", 0, false},
+		{"budget_4k", 4000, false},
+		{"stable_prefix", 0, true},
+	} {
+		b.Run(bc.name, func(b *testing.B) {
+			di := benchInstructions(100, bc.budget)
+			di.StablePrefix = bc.stable
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				di.BuildParts()
+			}
+		})
+	}
+}
@@ -0,0 +1,119 @@
+package llm
+
+import (
+	"context"
+	"errors"
+	"fmt"
+	"log/slog"
+	"time"
+
+	"google.golang.org/genai"
+)
+
+// SummaryResult is the outcome of one SummaryRequest in a batch.
+type SummaryResult struct {
+	Text string
+	Err  error
+}
+
+// ErrBatchCancelled is returned by WaitSummaryBatch when ctx ended and the job was cancelled. When
+// ctx ended but the cancel failed, the job may still be running and can be waited on again.
+var ErrBatchCancelled = errors.New("batch job cancelled")
+
+// SubmitSummaryBatch submits summarization requests as one Gemini Batch API job (inline requests) and
+// returns the job name for WaitSummaryBatch. Batch jobs are billed at a discount and do not use the
+// interactive quota, but can take minutes to hours; use them only where latency does not matter.
+func (c *Client) SubmitSummaryBatch(ctx context.Context, reqs []SummaryRequest, displayName string) (string, error) {
+	inlined := make([]*genai.InlinedRequest, len(reqs))
+	for i, req := range reqs {
+		contents, config := summaryContents(req)
+		inlined[i] = &genai.InlinedRequest{Contents: contents, Config: config}
+	}
+	job, err := c.genai.Batches.Create(ctx, c.config.GeminiModel,
+		&genai.BatchJobSource{InlinedRequests: inlined},
+		&genai.CreateBatchJobConfig{DisplayName: displayName})
+	if err != nil {
+		return "", fmt.Errorf("create batch job: %w", err)
+	}
+	slog.Info("summary batch submitted", "job", job.Name, "requests", len(reqs))
+	return job.Name, nil
+}
+
+// WaitSummaryBatch polls a batch job of n requests every pollInterval until it finishes and returns
+// the results in request order. The job may have been submitted by an earlier process. An error means
+// the job as a whole failed; per-request failures are in the results. When ctx ends first, the job is
+// cancelled (ErrBatchCancelled), so nobody pays for results that are no longer wanted.
+func (c *Client) WaitSummaryBatch(ctx context.Context, name string, n int, pollInterval time.Duration) ([]SummaryResult, error) {
+	job, err := c.genai.Batches.Get(ctx, name, nil)
+	if err != nil {
+		// Transient errors are retried by the poll loop below
+		slog.Warn("poll batch job failed", "job", name, "error", err)
+		job = &genai.BatchJob{Name: name}
+	}
+	ticker := time.NewTicker(pollInterval)
+	defer ticker.Stop()
+	for !batchDone(job.State) {
+		select {
+		case <-ctx.Done():
+			if c.cancelBatch(name) {
+				return nil, fmt.Errorf("wait for batch job %s: %w: %w", name, ErrBatchCancelled, ctx.Err())
+			}
+			return nil, fmt.Errorf("wait for batch job %s: %w", name, ctx.Err())
+		case <-ticker.C:
+		}
+		next, err := c.genai.Batches.Get(ctx, name, nil)
+		if err != nil {
+			// Transient; the job keeps running server-side
+			slog.Warn("poll batch job failed", "job", name, "error", err)
+			continue
+		}
+		job = next
+	}
+
+	if job.State != genai.JobStateSucceeded {
+		msg := string(job.State)
+		if job.Error != nil {
+			msg += ": " + job.Error.Message
+		}
+		return nil, fmt.Errorf("batch job %s: %s", name, msg)
+	}
+	if job.Dest == nil || len(job.Dest.InlinedResponses) != n {
+		return nil, fmt.Errorf("batch job %s: unexpected number of responses", name)
+	}
+	results := make([]SummaryResult, n)
+	for i, resp := range job.Dest.InlinedResponses {
+		switch {
+		case resp == nil:
+			results[i].Err = errors.New("missing batch response")
+		case resp.Error != nil:
+			results[i].Err = fmt.Errorf("batch request: %s", resp.Error.Message)
+		default:
+			results[i].Text = extractText(resp.Response)
+		}
+	}
+	return results, nil
+}
+
+// batchCancelTimeout bounds the cancel call made after the caller's ctx has ended.
+const batchCancelTimeout = 10 * time.Second
+
+// cancelBatch cancels a batch job whose results are no longer wanted (best effort) and reports
+// whether it was cancelled.
+func (c *Client) cancelBatch(name string) bool {
+	ctx, cancel := context.WithTimeout(context.Background(), batchCancelTimeout)
+	defer cancel()
+	if err := c.genai.Batches.Cancel(ctx, name, nil); err != nil {
+		slog.Warn("cancel batch job failed", "job", name, "error", err)
+		return false
+	}
+	slog.Info("summary batch cancelled", "job", name)
+	return true
+}
+
+func batchDone(state genai.JobState) bool {
+	switch state {
+	case genai.JobStateSucceeded, genai.JobStateFailed, genai.JobStateCancelled, genai.JobStateExpired:
+		return true
+	}
+	return false
+}
@@ -0,0 +1,203 @@
+package llm
+
+import (
+	"context"
+	"fmt"
+	"log/slog"
+	"net/http"
+	"time"
+	"unicode/utf8"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+	"google.golang.org/genai"
+)
+
+// Embedding task types (Gemini): stored texts and the texts they are searched with are embedded
+// differently.
+const (
+	embedTaskDocument = "RETRIEVAL_DOCUMENT"
+	embedTaskQuery    = "RETRIEVAL_QUERY"
+)
+
+// maxEmbedRunes truncates texts to stay within the embedding model's input limit (2048 tokens).
+const maxEmbedRunes = 6000
+
+// Embed returns one db.EmbeddingDimensions-long vector per text.
+func (c *Client) Embed(ctx context.Context, texts []string, taskType string) ([][]float32, error) {
+	contents := make([]*genai.Content, len(texts))
+	for i, t := range texts {
+		if utf8.RuneCountInString(t) > maxEmbedRunes {
+			t = string([]rune(t)[:maxEmbedRunes])
+		}
+		contents[i] = &genai.Content{Parts: []*genai.Part{genai.NewPartFromText(t)}}
+	}
+	resp, err := c.genai.Models.EmbedContent(ctx, c.config.EmbeddingModel, contents, &genai.EmbedContentConfig{
+		TaskType:             taskType,
+		OutputDimensionality: genai.Ptr(int32(db.EmbeddingDimensions)),
+	})
+	if err != nil {
+		return nil, fmt.Errorf("embed content: %w", err)
+	}
+	if resp == nil || len(resp.Embeddings) != len(texts) {
+		return nil, fmt.Errorf("embed content: expected %d embeddings", len(texts))
+	}
+	out := make([][]float32, len(texts))
+	for i, e := range resp.Embeddings {
+		if e == nil || len(e.Values) != db.EmbeddingDimensions {
+			return nil, fmt.Errorf("embed content: embedding %d has wrong dimensions", i)
+		}
+		out[i] = e.Values
+	}
+	return out, nil
+}
+
+// EmbedQuery embeds a search text (the current message, a search_messages query).
+func (c *Client) EmbedQuery(ctx context.Context, text string) ([]float32, error) {
+	v, err := c.Embed(ctx, []string{text}, embedTaskQuery)
+	if err != nil {
+		return nil, err
+	}
+	return v[0], nil
+}
+
+// EmbeddingsEnabled reports whether semantic memory is on (ENABLE_EMBEDDINGS).
+func (c *Client) EmbeddingsEnabled() bool {
+	return c != nil && c.config.EnableEmbeddings
+}
+
+// RunEmbeddingIndexer embeds new user facts and messages in the background until ctx is cancelled.
+// Rows are picked up from the database (embedding IS NULL), so this covers rows written by the
+// batched message writer, rows stored while Gemini was unreachable and the backlog from before
+// embeddings were enabled, newest first.
+func (c *Client) RunEmbeddingIndexer(ctx context.Context, database *db.DB) {
+	logger := slog.With("component", "embedding_indexer")
+	interval := c.config.EmbeddingPollInterval()
+	wait := interval
+	for {
+		factsDown := c.indexPending(ctx, logger, "user_facts", database.PendingFactEmbeddings, embeddingStore{
+			set:  func(j db.EmbeddingJob, v []float32) error { return database.SetFactEmbedding(ctx, j.ID, v) },
+			fail: func(j db.EmbeddingJob) error { return database.RecordFactEmbeddingFailure(ctx, j.ID) },
+		})
+		messagesDown := c.indexPending(ctx, logger, "messages", database.PendingMessageEmbeddings, embeddingStore{
+			set: func(j db.EmbeddingJob, v []float32) error {
+				return database.SetMessageEmbedding(ctx, j.ID, j.CreatedAt, v)
+			},
+			fail: func(j db.EmbeddingJob) error {
+				return database.RecordMessageEmbeddingFailure(ctx, j.ID, j.CreatedAt)
+			},
+		})
+		// While Gemini is down, poll less often instead of failing every row one at a time
+		if factsDown || messagesDown {
+			wait = min(wait*2, embedMaxBackoff)
+			logger.Warn("embedding API unavailable, backing off", "retry_in", wait)
+		} else {
+			wait = interval
+		}
+		select {
+		case <-ctx.Done():
+			return
+		case <-time.After(wait):
+		}
+	}
+}
+
+// embedOutageProbe is how many rows of a failed batch may fail on their own with a transient error,
+// with none succeeding, before the API is taken to be down.
+const embedOutageProbe = 3
+
+// embedMaxBackoff caps the indexer's poll interval while the API is down.
+const embedMaxBackoff = 5 * time.Minute
+
+// embeddingStore writes the indexer's results for one table.
+type embeddingStore struct {
+	set  func(db.EmbeddingJob, []float32) error
+	fail func(db.EmbeddingJob) error // counts a failed attempt (embedding_attempts)
+}
+
+// indexPending embeds one batch of pending rows with a single embedding call and reports whether the
+// API looked down.
+func (c *Client) indexPending(ctx context.Context, logger *slog.Logger, table string,
+	pending func(context.Context, int) ([]db.EmbeddingJob, error), store embeddingStore) bool {
+	batch := c.config.EmbeddingBatchSize
+	if batch <= 0 {
+		batch = 100
+	}
+	jobs, err := pending(ctx, batch)
+	if err != nil {
+		logger.Error("load pending embeddings failed", "table", table, "error", err)
+		return false
+	}
+	if len(jobs) == 0 {
+		return false
+	}
+	embed := func(ctx context.Context, texts []string) ([][]float32, error) {
+		return c.Embed(ctx, texts, embedTaskDocument)
+	}
+	return embedJobs(ctx, logger.With("table", table), jobs, embed, store)
+}
+
+// embedRejected reports whether the API refused the input itself (a 4xx other than 429, e.g. blocked
+// content), as opposed to a failure that a later attempt may not hit.
+func embedRejected(err error) bool {
+	apiErr, ok := apiError(err)
+	return ok && apiErr.Code >= 400 && apiErr.Code < 500 &&
+		apiErr.Code != http.StatusTooManyRequests && apiErr.Code != http.StatusRequestTimeout
+}
+
+// embedJobs embeds jobs in one call. When that fails, the rows are retried one at a time, so a row
+// the API always rejects (blocked content) cannot hold back the rest of the queue. Only rejections
+// count a failed attempt; after db.MaxEmbeddingAttempts the row is skipped. Other errors leave rows
+// pending, and when the first embedOutageProbe of them fail that way with none succeeding, the API is
+// taken to be down: embedJobs stops and returns true.
+func embedJobs(ctx context.Context, logger *slog.Logger, jobs []db.EmbeddingJob,
+	embed func(context.Context, []string) ([][]float32, error), store embeddingStore) bool {
+	texts := make([]string, len(jobs))
+	for i, j := range jobs {
+		texts[i] = j.Text
+	}
+	vectors, err := embed(ctx, texts)
+	if err == nil {
+		for i, j := range jobs {
+			if err := store.set(j, vectors[i]); err != nil {
+				logger.Error("store embedding failed", "id", j.ID, "error", err)
+			}
+		}
+		logger.Debug("embedded rows", "rows", len(jobs))
+		return false
+	}
+	if len(jobs) > 1 {
+		logger.Warn("embedding batch failed, retrying rows one at a time", "rows", len(jobs), "error", err)
+	}
+
+	embedded, rejected, transient := 0, 0, 0
+	for _, j := range jobs {
+		if ctx.Err() != nil {
+			return false
+		}
+		if len(jobs) > 1 {
+			vectors, err = embed(ctx, []string{j.Text})
+		}
+		if err == nil {
+			embedded++
+			if err := store.set(j, vectors[0]); err != nil {
+				logger.Error("store embedding failed", "id", j.ID, "error", err)
+			}
+			continue
+		}
+		if !embedRejected(err) {
+			transient++
+			if embedded == 0 && transient >= embedOutageProbe {
+				logger.Warn("embedding rows failed, API looks down", "error", err)
+				return true
+			}
+			continue
+		}
+		rejected++
+		logger.Warn("embedding row rejected", "id", j.ID, "max_attempts", db.MaxEmbeddingAttempts, "error", err)
+		if err := store.fail(j); err != nil {
+			logger.Error("record embedding failure failed", "id", j.ID, "error", err)
+		}
+	}
+	logger.Debug("embedded rows", "rows", embedded, "rejected", rejected, "failed", transient)
+	return embedded == 0 && rejected == 0
+}
@@ -0,0 +1,126 @@
+package llm
+
+import (
+	"context"
+	"fmt"
+	"io"
+	"log/slog"
+	"strings"
+	"testing"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+	"google.golang.org/genai"
+)
+
+// recordingStore remembers which jobs were embedded and which got a failed attempt counted.
+type recordingStore struct {
+	set, failed []int64
+}
+
+func (r *recordingStore) store() embeddingStore {
+	return embeddingStore{
+		set:  func(j db.EmbeddingJob, _ []float32) error { r.set = append(r.set, j.ID); return nil },
+		fail: func(j db.EmbeddingJob) error { r.failed = append(r.failed, j.ID); return nil },
+	}
+}
+
+// fakeEmbed fails any call containing a text with "blocked" in it (a 400, like the API does for a
+// batch with one rejected input) or "down" in it (a 503).
+func fakeEmbed(calls *int) func(context.Context, []string) ([][]float32, error) {
+	return func(_ context.Context, texts []string) ([][]float32, error) {
+		*calls++
+		out := make([][]float32, len(texts))
+		for i, t := range texts {
+			switch {
+			case strings.Contains(t, "blocked"):
+				return nil, fmt.Errorf("embed content: %w", genai.APIError{Code: 400, Message: "content blocked"})
+			case strings.Contains(t, "down"):
+				return nil, fmt.Errorf("embed content: %w", genai.APIError{Code: 503, Message: "unavailable"})
+			}
+			out[i] = []float32{1}
+		}
+		return out, nil
+	}
+}
+
+func jobs(texts ...string) []db.EmbeddingJob {
+	out := make([]db.EmbeddingJob, len(texts))
+	for i, t := range texts {
+		out[i] = db.EmbeddingJob{ID: int64(i + 1), Text: t}
+	}
+	return out
+}
+
+func quietLogger() *slog.Logger { return slog.New(slog.NewTextHandler(io.Discard, nil)) }
+
+func TestEmbedJobs_OneCallWhenBatchSucceeds(t *testing.T) {
+	var rec recordingStore
+	calls := 0
+	down := embedJobs(context.Background(), quietLogger(), jobs("a", "b", "c"), fakeEmbed(&calls), rec.store())
+	if down || calls != 1 || len(rec.set) != 3 || len(rec.failed) != 0 {
+		t.Errorf("expected 1 call, 3 stored, 0 failed; got down %v, %d calls, set %v, failed %v", down, calls, rec.set, rec.failed)
+	}
+}
+
+func TestEmbedJobs_RetriesRowsAndCountsRejectedOnes(t *testing.T) {
+	var rec recordingStore
+	calls := 0
+	down := embedJobs(context.Background(), quietLogger(), jobs("a", "blocked", "c"), fakeEmbed(&calls), rec.store())
+	if down {
+		t.Error("a rejected row is not an outage")
+	}
+	if calls != 4 {
+		t.Errorf("expected the batch call and 3 single-row calls, got %d", calls)
+	}
+	if len(rec.set) != 2 || rec.set[0] != 1 || rec.set[1] != 3 {
+		t.Errorf("expected rows 1 and 3 embedded, got %v", rec.set)
+	}
+	if len(rec.failed) != 1 || rec.failed[0] != 2 {
+		t.Errorf("expected a failed attempt for row 2 only, got %v", rec.failed)
+	}
+}
+
+func TestEmbedJobs_RejectedRowsAtTheHeadAreAllCounted(t *testing.T) {
+	var rec recordingStore
+	calls := 0
+	embedJobs(context.Background(), quietLogger(), jobs("blocked 1", "blocked 2", "blocked 3", "blocked 4", "e"),
+		fakeEmbed(&calls), rec.store())
+	if len(rec.failed) != 4 || len(rec.set) != 1 || rec.set[0] != 5 {
+		t.Errorf("expected rows 1-4 counted and row 5 embedded, got failed %v, set %v", rec.failed, rec.set)
+	}
+}
+
+func TestEmbedJobs_OutageCountsNoAttempts(t *testing.T) {
+	var rec recordingStore
+	calls := 0
+	down := embedJobs(context.Background(), quietLogger(), jobs("down 1", "down 2", "down 3", "down 4", "down 5"),
+		fakeEmbed(&calls), rec.store())
+	if !down {
+		t.Error("expected the outage to be reported")
+	}
+	if calls != 1+embedOutageProbe {
+		t.Errorf("expected the batch call and %d probes, got %d calls", embedOutageProbe, calls)
+	}
+	if len(rec.set) != 0 || len(rec.failed) != 0 {
+		t.Errorf("expected no rows stored or counted, got set %v, failed %v", rec.set, rec.failed)
+	}
+}
+
+func TestEmbedJobs_SingleRowFailure(t *testing.T) {
+	var rec recordingStore
+	calls := 0
+	if embedJobs(context.Background(), quietLogger(), jobs("blocked"), fakeEmbed(&calls), rec.store()) {
+		t.Error("a rejected row is not an outage")
+	}
+	if calls != 1 || len(rec.failed) != 1 {
+		t.Errorf("expected 1 call and 1 failed attempt, got %d calls, failed %v", calls, rec.failed)
+	}
+
+	rec = recordingStore{}
+	if !embedJobs(context.Background(), quietLogger(), jobs("down"), fakeEmbed(&calls), rec.store()) {
+		t.Error("expected a transient failure of the only row to be reported as an outage")
+	}
+	if len(rec.failed) != 0 {
+		t.Errorf("expected no failed attempt for a transient error, got %v", rec.failed)
+	}
+}
@@ -0,0 +1,46 @@
+package llm
+
+import (
+	"bytes"
+	"context"
+	"fmt"
+	"time"
+
+	"google.golang.org/genai"
+)
+
+// filePollInterval is how often an upload still being processed (video) is checked.
+const filePollInterval = time.Second
+
+// UploadMedia uploads an attachment to the Gemini Files API and waits until it can be referenced
+// (videos are processed first). It returns the file URI, for genai.NewPartFromURI, and when Gemini
+// deletes the file.
+func (c *Client) UploadMedia(ctx context.Context, data []byte, mimeType string) (uri string, expiresAt time.Time, err error) {
+	if timeout := c.config.MediaUploadTimeout(); timeout > 0 {
+		var cancel context.CancelFunc
+		ctx, cancel = context.WithTimeout(ctx, timeout)
+		defer cancel()
+	}
+	file, err := c.genai.Files.Upload(ctx, bytes.NewReader(data), &genai.UploadFileConfig{MIMEType: mimeType})
+	if err != nil {
+		return "", time.Time{}, fmt.Errorf("upload media: %w", err)
+	}
+	for file.State == genai.FileStateProcessing {
+		select {
+		case <-ctx.Done():
+			return "", time.Time{}, fmt.Errorf("upload media: %w", ctx.Err())
+		case <-time.After(filePollInterval):
+		}
+		if file, err = c.genai.Files.Get(ctx, file.Name, nil); err != nil {
+			return "", time.Time{}, fmt.Errorf("upload media: %w", err)
+		}
+	}
+	if file.State == genai.FileStateFailed {
+		return "", time.Time{}, fmt.Errorf("upload media: file %s failed processing", file.Name)
+	}
+	expiresAt = file.ExpirationTime
+	if expiresAt.IsZero() {
+		expiresAt = time.Now().Add(48 * time.Hour)
+	}
+	return file.URI, expiresAt, nil
+}
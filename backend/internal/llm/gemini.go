@@ -2,31 +2,39 @@ package llm
 
 import (
 	"context"
+	"errors"
 	"fmt"
 	"log/slog"
+	"net/http"
 	"os"
 	"strings"
+	"sync"
+	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/config"
 	"github.com/ThatHunky/gryag/backend/internal/db"
+	"github.com/ThatHunky/gryag/backend/internal/metrics"
 	"google.golang.org/genai"
 )
 
-const maxSummaryInputChars = 100_000
-
 // Client wraps the Google GenAI SDK client for Gemini interactions.
 type Client struct {
 	genai  *genai.Client
 	config *config.Config
-	persona string
+
+	mu            sync.RWMutex
+	prefix        staticPrefix // persona + tools, optionally held as a Gemini cached-content handle
+	prefixRefresh chan struct{}
 }
 
 // NewClient creates a new Gemini LLM client.
 func NewClient(cfg *config.Config) (*Client, error) {
 	ctx := context.Background()
 	client, err := genai.NewClient(ctx, &genai.ClientConfig{
-		APIKey:  cfg.GeminiAPIKey,
-		Backend: genai.BackendGeminiAPI,
+		APIKey:      cfg.GeminiAPIKey,
+		Backend:     genai.BackendGeminiAPI,
+		HTTPClient:  &http.Client{Transport: newTransport()},
+		HTTPOptions: genai.HTTPOptions{BaseURL: cfg.GeminiBaseURL}, // empty = the SDK default
 	})
 	if err != nil {
 		return nil, fmt.Errorf("genai client: %w", err)
@@ -45,46 +53,248 @@ func NewClient(cfg *config.Config) (*Client, error) {
 	)
 
 	return &Client{
-		genai:   client,
-		config:  cfg,
-		persona: string(persona),
+		genai:         client,
+		config:        cfg,
+		prefix:        staticPrefix{persona: string(persona)},
+		prefixRefresh: make(chan struct{}, 1),
 	}, nil
 }
 
+// newTransport returns the keep-alive transport shared by every Gemini call of the process (chat, summaries,
+// grounding and image generation), so TLS/HTTP2 connections are reused instead of set up per call.
+func newTransport() *http.Transport {
+	t := http.DefaultTransport.(*http.Transport).Clone()
+	t.MaxIdleConns = 64
+	t.MaxIdleConnsPerHost = 16
+	t.IdleConnTimeout = 90 * time.Second
+	t.ForceAttemptHTTP2 = true
+	return t
+}
+
+// GenAI returns the underlying SDK client, for tools that call other Gemini models (e.g. image generation)
+// over the same pooled connections. Nil-safe.
+func (c *Client) GenAI() *genai.Client {
+	if c == nil {
+		return nil
+	}
+	return c.genai
+}
+
 // GenerateResponse sends a conversation history to Gemini and returns the full response.
-func (c *Client) GenerateResponse(ctx context.Context, contents []*genai.Content, tools []*genai.Tool) (*genai.GenerateContentResponse, error) {
+// The static prefix (persona + tools registered with SetTools) is referenced through the cached-content
+// handle when one is active, and sent inline otherwise.
+func (c *Client) GenerateResponse(ctx context.Context, contents []*genai.Content) (*genai.GenerateContentResponse, error) {
 	logger := slog.With("model", c.config.GeminiModel)
 
+	defer metrics.Stage("llm_round", time.Now())
+	config, cacheName := c.generateConfig()
+	resp, err := c.genai.Models.GenerateContent(ctx, c.config.GeminiModel, contents, config)
+	if err != nil && cacheName != "" && cachedContentGone(err) {
+		// The handle expired or was evicted server-side; retry once with the prefix inline. Other errors
+		// (429, 5xx, blocked content) would fail the same way inline and are returned as they are.
+		logger.Warn("generation with cached prefix failed, retrying inline", "cache", cacheName, "error", err)
+		c.dropPrefixCache(cacheName)
+		config, cacheName = c.generateConfig()
+		resp, err = c.genai.Models.GenerateContent(ctx, c.config.GeminiModel, contents, config)
+	}
+	recordUsage("generate", resp, err)
+	if err != nil {
+		return nil, fmt.Errorf("generate content: %w", err)
+	}
+
+	logger.Info("generation complete", append([]any{"cached_prefix", cacheName != ""}, usageLogFields(resp)...)...)
+	return resp, nil
+}
+
+// GenerateResponseStream is GenerateResponse over GenerateContentStream: onText is called with each
+// text fragment as it arrives, and the chunks are merged into one response so callers can run the same
+// tool loop as with GenerateResponse. onText may be nil.
+func (c *Client) GenerateResponseStream(ctx context.Context, contents []*genai.Content, onText func(string)) (*genai.GenerateContentResponse, error) {
+	logger := slog.With("model", c.config.GeminiModel)
+
+	defer metrics.Stage("llm_round", time.Now())
+	config, cacheName := c.generateConfig()
+	merged, received, err := c.stream(ctx, contents, config, onText)
+	if err != nil && !received && cacheName != "" && cachedContentGone(err) {
+		logger.Warn("stream with cached prefix failed, retrying inline", "cache", cacheName, "error", err)
+		c.dropPrefixCache(cacheName)
+		config, cacheName = c.generateConfig()
+		merged, _, err = c.stream(ctx, contents, config, onText)
+	}
+	recordUsage("stream", merged, err)
+	if err != nil {
+		return nil, err
+	}
+
+	logger.Info("stream generation complete", append([]any{"cached_prefix", cacheName != ""}, usageLogFields(merged)...)...)
+	return merged, nil
+}
+
+// apiError returns the API's error response wrapped in err, if any.
+func apiError(err error) (genai.APIError, bool) {
+	var apiErr genai.APIError
+	if errors.As(err, &apiErr) {
+		return apiErr, true
+	}
+	var ptr *genai.APIError
+	if errors.As(err, &ptr) && ptr != nil {
+		return *ptr, true
+	}
+	return genai.APIError{}, false
+}
+
+// cachedContentGone reports whether a request failed because its cachedContent handle no longer exists
+// or is not valid for the request (404, or 400/403 about the cached content).
+func cachedContentGone(err error) bool {
+	apiErr, ok := apiError(err)
+	if !ok {
+		return false
+	}
+	switch apiErr.Code {
+	case http.StatusNotFound:
+		return true
+	case http.StatusBadRequest, http.StatusForbidden:
+		msg := strings.ToLower(apiErr.Message)
+		return strings.Contains(msg, "cachedcontent") || strings.Contains(msg, "cached content")
+	}
+	return false
+}
+
+// stream runs one GenerateContentStream call; received reports whether any chunk arrived before an error.
+func (c *Client) stream(ctx context.Context, contents []*genai.Content, config *genai.GenerateContentConfig, onText func(string)) (merged *genai.GenerateContentResponse, received bool, err error) {
+	merged = &genai.GenerateContentResponse{}
+	for chunk, err := range c.genai.Models.GenerateContentStream(ctx, c.config.GeminiModel, contents, config) {
+		if err != nil {
+			return nil, received, fmt.Errorf("generate content stream: %w", err)
+		}
+		received = true
+		appendStreamChunk(merged, chunk, onText)
+	}
+	return merged, received, nil
+}
+
+// usageLogFields returns token counts from the response's UsageMetadata as log fields, including how many
+// prompt tokens were served from cache (explicit cached content or implicit prefix caching).
+func usageLogFields(resp *genai.GenerateContentResponse) []any {
+	if resp == nil || resp.UsageMetadata == nil {
+		return nil
+	}
+	u := resp.UsageMetadata
+	cachedRatio := 0.0
+	if u.PromptTokenCount > 0 {
+		cachedRatio = float64(u.CachedContentTokenCount) / float64(u.PromptTokenCount)
+	}
+	return []any{
+		"prompt_tokens", u.PromptTokenCount,
+		"cached_tokens", u.CachedContentTokenCount,
+		"cached_ratio", cachedRatio,
+		"output_tokens", u.CandidatesTokenCount,
+		"thoughts_tokens", u.ThoughtsTokenCount,
+	}
+}
+
+// recordUsage counts one generate call and its tokens from UsageMetadata.
+func recordUsage(mode string, resp *genai.GenerateContentResponse, err error) {
+	if err != nil {
+		metrics.GeminiCalls.With(mode, "error").Inc()
+		return
+	}
+	metrics.GeminiCalls.With(mode, "ok").Inc()
+	if resp == nil || resp.UsageMetadata == nil {
+		return
+	}
+	u := resp.UsageMetadata
+	metrics.GeminiTokens.With("prompt").Add(float64(u.PromptTokenCount))
+	metrics.GeminiTokens.With("cached").Add(float64(u.CachedContentTokenCount))
+	metrics.GeminiTokens.With("output").Add(float64(u.CandidatesTokenCount))
+	metrics.GeminiTokens.With("thoughts").Add(float64(u.ThoughtsTokenCount))
+}
+
+// appendStreamChunk merges one streamed chunk into merged: consecutive text fragments are joined into
+// a single text part, function calls and other parts are kept as-is and in order.
+func appendStreamChunk(merged, chunk *genai.GenerateContentResponse, onText func(string)) {
+	if chunk == nil {
+		return
+	}
+	if chunk.UsageMetadata != nil {
+		merged.UsageMetadata = chunk.UsageMetadata
+	}
+	if len(chunk.Candidates) == 0 || chunk.Candidates[0].Content == nil {
+		return
+	}
+	cand := chunk.Candidates[0]
+	if len(merged.Candidates) == 0 {
+		merged.Candidates = []*genai.Candidate{{Content: &genai.Content{Role: cand.Content.Role}}}
+	}
+	out := merged.Candidates[0]
+	if cand.FinishReason != "" {
+		out.FinishReason = cand.FinishReason
+	}
+	for _, part := range cand.Content.Parts {
+		if part == nil {
+			continue
+		}
+		if part.Text != "" && part.FunctionCall == nil {
+			if onText != nil && !part.Thought {
+				onText(part.Text)
+			}
+			if n := len(out.Content.Parts); n > 0 {
+				last := out.Content.Parts[n-1]
+				if last.Text != "" && last.FunctionCall == nil && last.Thought == part.Thought {
+					last.Text += part.Text
+					// Thinking models sign the text they stream, usually on its last chunk; the signature
+					// must go back with the merged part in the tool loop.
+					if len(part.ThoughtSignature) > 0 {
+						last.ThoughtSignature = part.ThoughtSignature
+					}
+					continue
+				}
+			}
+			p := *part
+			out.Content.Parts = append(out.Content.Parts, &p)
+			continue
+		}
+		out.Content.Parts = append(out.Content.Parts, part)
+	}
+}
+
+// generateConfig builds the chat generation config shared by GenerateResponse and GenerateResponseStream.
+// It returns the cached-content name in use ("" when the prefix is sent inline); the API rejects
+// SystemInstruction and Tools alongside CachedContent, so only one of the two is set.
+func (c *Client) generateConfig() (*genai.GenerateContentConfig, string) {
 	config := &genai.GenerateContentConfig{
+		Temperature: genai.Ptr(float32(c.config.GeminiTemperature)),
+	}
+
+	c.mu.RLock()
+	cacheName := ""
+	if c.prefix.cacheName != "" && c.prefix.cachedVersion == c.prefix.version {
+		cacheName = c.prefix.cacheName
+		config.CachedContent = cacheName
+	} else {
 		// Section 14.1: SystemInstruction is the persona — separated from the conversation array
-		SystemInstruction: &genai.Content{
-			Parts: []*genai.Part{genai.NewPartFromText(c.persona)},
-		},
-		Temperature:      genai.Ptr(float32(c.config.GeminiTemperature)),
-		Tools:            tools,
+		config.SystemInstruction = c.prefix.systemInstruction()
+		config.Tools = c.prefix.tools
 	}
+	c.mu.RUnlock()
 
 	if c.config.GeminiThinkingBudget > 0 {
 		config.ThinkingConfig = &genai.ThinkingConfig{
 			ThinkingBudget: genai.Ptr(int32(c.config.GeminiThinkingBudget)),
 		}
 	}
-
-	resp, err := c.genai.Models.GenerateContent(ctx, c.config.GeminiModel, contents, config)
-	if err != nil {
-		return nil, fmt.Errorf("generate content: %w", err)
-	}
-
-	logger.Info("generation complete")
-	return resp, nil
+	return config, cacheName
 }
 
 // RouteIntent uses the model at low temperature to decide what tool(s) to call.
 // Returns structured JSON per Section 14.2.
 func (c *Client) RouteIntent(ctx context.Context, message string, tools []*genai.Tool) (*genai.GenerateContentResponse, error) {
+	c.mu.RLock()
+	persona := c.prefix.persona
+	c.mu.RUnlock()
 	config := &genai.GenerateContentConfig{
 		SystemInstruction: &genai.Content{
-			Parts: []*genai.Part{genai.NewPartFromText(c.persona)},
+			Parts: []*genai.Part{genai.NewPartFromText(persona)},
 		},
 		// Section 14.3: Low temperature for deterministic routing
 		Temperature: genai.Ptr(float32(c.config.GeminiRoutingTemperature)),
@@ -106,40 +316,74 @@ func (c *Client) RouteIntent(ctx context.Context, message string, tools []*genai
 	return resp, nil
 }
 
-// SummarizeChat produces a short factual summary of a chat log for the given window (e.g. "7-day", "30-day").
-// Messages are formatted like the immediate context block; input is truncated to maxSummaryInputChars.
-func (c *Client) SummarizeChat(ctx context.Context, messages []db.Message, windowLabel string) (string, error) {
-	if len(messages) == 0 {
+// ChatLine formats one message as a line of the immediate context block or a summarization chat log.
+// Lines end with a newline.
+func ChatLine(msg db.Message) string {
+	name := "Unknown"
+	if msg.FirstName != nil {
+		name = *msg.FirstName
+	}
+	if msg.Username != nil {
+		name += " (@" + *msg.Username + ")"
+	}
+	text := ""
+	if msg.Text != nil {
+		text = *msg.Text
+	}
+	prefix := ""
+	if msg.IsBotReply {
+		prefix = "[BOT] "
+	}
+	if msg.WasThrottled {
+		prefix = "[THROTTLED] "
+	}
+	return prefix + name + ": " + text + "\n"
+}
+
+// Summary prompts: a raw chat log (daily chunks) or daily summaries merged into a window summary.
+const (
+	chatSummaryInstruction   = "You are a summarization assistant. Summarize the following chat log concisely and factually. Preserve key topics, decisions, and context. Use the same language as the chat or English. Output only the summary, no preamble."
+	windowSummaryInstruction = "You are a summarization assistant. You are given summaries of consecutive days of a chat, oldest first, possibly followed by the raw messages of the current day. Write one concise, factual summary of the whole period. Preserve key topics, decisions, and context; drop what later days made obsolete. Use the same language as the chat or English. Output only the summary, no preamble."
+)
+
+// SummaryRequest is one summarization call, for SubmitSummaryBatch. Window false summarizes a raw chat
+// log (as SummarizeChat), true merges a window digest (as SummarizeWindow).
+type SummaryRequest struct {
+	Window bool
+	Input  string
+	Label  string // e.g. "1-day", "7-day"
+}
+
+// SummarizeChat produces a short factual summary of a chat log for the given window (e.g. "1-day").
+// chatLog is built from ChatLine lines, oldest first, within SUMMARY_INPUT_TOKEN_BUDGET.
+func (c *Client) SummarizeChat(ctx context.Context, chatLog string, windowLabel string) (string, error) {
+	return c.summarize(ctx, SummaryRequest{Input: chatLog, Label: windowLabel})
+}
+
+// SummarizeWindow merges daily summaries (and the raw log of the current day) into one summary of the
+// window (e.g. "7-day", "30-day"). digest is built by the summarizer; see summarizer.windowDigest.
+func (c *Client) SummarizeWindow(ctx context.Context, digest string, windowLabel string) (string, error) {
+	return c.summarize(ctx, SummaryRequest{Window: true, Input: digest, Label: windowLabel})
+}
+
+func (c *Client) summarize(ctx context.Context, req SummaryRequest) (string, error) {
+	if req.Input == "" {
 		return "", nil
 	}
-	var b strings.Builder
-	for _, msg := range messages {
-		name := "Unknown"
-		if msg.FirstName != nil {
-			name = *msg.FirstName
-		}
-		if msg.Username != nil {
-			name += " (@" + *msg.Username + ")"
-		}
-		text := ""
-		if msg.Text != nil {
-			text = *msg.Text
-		}
-		prefix := ""
-		if msg.IsBotReply {
-			prefix = "[BOT] "
-		}
-		if msg.WasThrottled {
-			prefix = "[THROTTLED] "
-		}
-		b.WriteString(fmt.Sprintf("%s%s: %s\n", prefix, name, text))
+	contents, config := summaryContents(req)
+	resp, err := c.genai.Models.GenerateContent(ctx, c.config.GeminiModel, contents, config)
+	if err != nil {
+		return "", fmt.Errorf("summarize chat: %w", err)
 	}
-	chatLog := b.String()
-	if len(chatLog) > maxSummaryInputChars {
-		chatLog = chatLog[len(chatLog)-maxSummaryInputChars:]
+	return extractText(resp), nil
+}
+
+// summaryContents builds the prompt of a summarization call (shared by the sync and batch paths).
+func summaryContents(req SummaryRequest) ([]*genai.Content, *genai.GenerateContentConfig) {
+	systemInstruction, intro := chatSummaryInstruction, "Summarize this "+req.Label+" conversation:\n\n"
+	if req.Window {
+		systemInstruction, intro = windowSummaryInstruction, "Summarize this "+req.Label+" period:\n\n"
 	}
-	systemInstruction := "You are a summarization assistant. Summarize the following chat log concisely and factually. Preserve key topics, decisions, and context. Use the same language as the chat or English. Output only the summary, no preamble."
-	userContent := "Summarize this " + windowLabel + " conversation:\n\n" + chatLog
 	config := &genai.GenerateContentConfig{
 		SystemInstruction: &genai.Content{
 			Parts: []*genai.Part{genai.NewPartFromText(systemInstruction)},
@@ -147,13 +391,9 @@ func (c *Client) SummarizeChat(ctx context.Context, messages []db.Message, windo
 		Temperature: genai.Ptr(float32(0.2)),
 	}
 	contents := []*genai.Content{
-		{Role: "user", Parts: []*genai.Part{genai.NewPartFromText(userContent)}},
-	}
-	resp, err := c.genai.Models.GenerateContent(ctx, c.config.GeminiModel, contents, config)
-	if err != nil {
-		return "", fmt.Errorf("summarize chat: %w", err)
+		{Role: "user", Parts: []*genai.Part{genai.NewPartFromText(intro + req.Input)}},
 	}
-	return extractText(resp), nil
+	return contents, config
 }
 
 // SearchWithGrounding runs a single Gemini request with Google Search grounding and returns
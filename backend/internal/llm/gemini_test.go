@@ -0,0 +1,83 @@
+package llm
+
+import (
+	"testing"
+
+	"google.golang.org/genai"
+)
+
+func chunk(parts ...*genai.Part) *genai.GenerateContentResponse {
+	return &genai.GenerateContentResponse{
+		Candidates: []*genai.Candidate{{Content: &genai.Content{Role: "model", Parts: parts}}},
+	}
+}
+
+func TestAppendStreamChunk_MergesTextAndKeepsFunctionCalls(t *testing.T) {
+	merged := &genai.GenerateContentResponse{}
+	var streamed string
+	onText := func(s string) { streamed += s }
+
+	appendStreamChunk(merged, chunk(genai.NewPartFromText("Hel")), onText)
+	appendStreamChunk(merged, chunk(genai.NewPartFromText("lo")), onText)
+	appendStreamChunk(merged, chunk(&genai.Part{FunctionCall: &genai.FunctionCall{Name: "search_web"}}), onText)
+	appendStreamChunk(merged, chunk(genai.NewPartFromText("!")), onText)
+
+	if streamed != "Hello!" {
+		t.Errorf("expected streamed text %q, got %q", "Hello!", streamed)
+	}
+	if len(merged.Candidates) != 1 {
+		t.Fatalf("expected 1 candidate, got %d", len(merged.Candidates))
+	}
+	parts := merged.Candidates[0].Content.Parts
+	if len(parts) != 3 {
+		t.Fatalf("expected 3 parts (text, call, text), got %d", len(parts))
+	}
+	if parts[0].Text != "Hello" || parts[1].FunctionCall == nil || parts[2].Text != "!" {
+		t.Errorf("unexpected merged parts: %q, %v, %q", parts[0].Text, parts[1].FunctionCall, parts[2].Text)
+	}
+	if merged.Candidates[0].Content.Role != "model" {
+		t.Errorf("expected role model, got %q", merged.Candidates[0].Content.Role)
+	}
+}
+
+func TestAppendStreamChunk_KeepsThoughtSignatureOfMergedText(t *testing.T) {
+	merged := &genai.GenerateContentResponse{}
+	appendStreamChunk(merged, chunk(genai.NewPartFromText("Hel")), nil)
+	appendStreamChunk(merged, chunk(&genai.Part{Text: "lo", ThoughtSignature: []byte("sig")}), nil)
+	appendStreamChunk(merged, chunk(genai.NewPartFromText("!")), nil)
+
+	parts := merged.Candidates[0].Content.Parts
+	if len(parts) != 1 || parts[0].Text != "Hello!" {
+		t.Fatalf("expected one merged text part, got %+v", parts)
+	}
+	if string(parts[0].ThoughtSignature) != "sig" {
+		t.Errorf("expected the signature of a later chunk to be kept, got %q", parts[0].ThoughtSignature)
+	}
+}
+
+func TestAppendStreamChunk_EmptyChunks(t *testing.T) {
+	merged := &genai.GenerateContentResponse{}
+	appendStreamChunk(merged, nil, nil)
+	appendStreamChunk(merged, &genai.GenerateContentResponse{}, nil)
+	if len(merged.Candidates) != 0 {
+		t.Errorf("expected no candidates from empty chunks, got %d", len(merged.Candidates))
+	}
+}
+
+func TestUsageLogFields(t *testing.T) {
+	if usageLogFields(&genai.GenerateContentResponse{}) != nil {
+		t.Error("expected no fields without usage metadata")
+	}
+	fields := usageLogFields(&genai.GenerateContentResponse{UsageMetadata: &genai.GenerateContentResponseUsageMetadata{
+		PromptTokenCount:        1000,
+		CachedContentTokenCount: 750,
+		CandidatesTokenCount:    20,
+	}})
+	got := map[any]any{}
+	for i := 0; i+1 < len(fields); i += 2 {
+		got[fields[i]] = fields[i+1]
+	}
+	if got["cached_tokens"] != int32(750) || got["cached_ratio"] != 0.75 {
+		t.Errorf("unexpected usage fields: %v", got)
+	}
+}
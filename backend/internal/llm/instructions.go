@@ -3,6 +3,10 @@ package llm
 import (
 	"context"
 	"fmt"
+	"log/slog"
+	"strconv"
+	"strings"
+	"sync"
 	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/db"
@@ -16,9 +20,6 @@ type DynamicInstructions struct {
 	ChatName    string
 	ChatID      int64
 
-	// Section 8.3: Tools block (built separately via registry)
-	ToolsDescription string
-
 	// Section 8.4: Multi-tiered summaries
 	Summary30Day string
 	Summary7Day  string
@@ -39,16 +40,91 @@ type DynamicInstructions struct {
 	CurrentMessage   string
 	ReplyToMessageID *int64
 	ReplyToText      string
+
+	// Messages that arrived while the previous turn was running (oldest first); answered together with
+	// CurrentMessage as one turn.
+	EarlierTurnMessages []TurnMessage
+
+	// StablePrefix selects the static-to-volatile block order (PROMPT_LAYOUT=stable_prefix).
+	StablePrefix bool
+
+	// TokenBudget caps the estimated tokens of the blocks (CONTEXT_TOKEN_BUDGET, 0 = unlimited).
+	TokenBudget int
+	// Usage is the estimated token count of each block, set by BuildParts.
+	Usage ContextUsage
 }
 
-// NewDynamicInstructions creates a DynamicInstructions from the database context.
+// TurnMessage is one message of a coalesced turn other than the current message.
+type TurnMessage struct {
+	UserID    *int64
+	Username  string
+	FirstName string
+	Text      string
+}
+
+// contextStage is one independent lookup run by NewDynamicInstructions.
+// Optional stages run under the per-stage deadline and degrade to "no data" on error or timeout.
+type contextStage struct {
+	name     string
+	optional bool
+	run      func(ctx context.Context) error
+}
+
+// runContextStages runs all stages concurrently and waits for them. Optional stages get their own
+// deadline (stageTimeout, 0 = none); their errors are logged and dropped. It returns the duration of each
+// stage (same order as stages) and the first error of a required stage.
+func runContextStages(ctx context.Context, stageTimeout time.Duration, stages []contextStage) ([]time.Duration, error) {
+	timings := make([]time.Duration, len(stages))
+	errs := make([]error, len(stages))
+	var wg sync.WaitGroup
+	for i, st := range stages {
+		wg.Add(1)
+		go func(i int, st contextStage) {
+			defer wg.Done()
+			sctx := ctx
+			if st.optional && stageTimeout > 0 {
+				var cancel context.CancelFunc
+				sctx, cancel = context.WithTimeout(ctx, stageTimeout)
+				defer cancel()
+			}
+			start := time.Now()
+			errs[i] = st.run(sctx)
+			timings[i] = time.Since(start)
+		}(i, st)
+	}
+	wg.Wait()
+
+	for i, st := range stages {
+		if errs[i] == nil {
+			continue
+		}
+		if !st.optional {
+			return timings, fmt.Errorf("%s: %w", st.name, errs[i])
+		}
+		slog.Warn("context stage degraded", "stage", st.name, "error", errs[i], "elapsed_ms", durationMs(timings[i]))
+	}
+	return timings, nil
+}
+
+// durationMs converts a duration to fractional milliseconds for log fields.
+func durationMs(d time.Duration) float64 {
+	return float64(d.Microseconds()) / 1000
+}
+
+// NewDynamicInstructions creates a DynamicInstructions from the database context. client selects the
+// user facts by relevance (nil = all facts).
+// The recent-messages, user-facts and summary lookups are independent and run concurrently. Facts and
+// summaries are optional: each gets stageTimeout (0 = bounded only by ctx) and is left empty if slow or
+// failing, so context building never waits on them longer than that.
 func NewDynamicInstructions(
 	ctx context.Context,
 	database *db.DB,
+	client *Client,
 	chatID int64,
 	userID int64,
 	username, firstName, text string,
 	contextSize int,
+	stageTimeout time.Duration,
 	replyToMessageID *int64,
 	replyToText string,
 ) (*DynamicInstructions, error) {
@@ -63,100 +139,77 @@ func NewDynamicInstructions(
 		ReplyToText:      replyToText,
 	}
 
-	// Load recent messages for immediate context
-	messages, err := database.GetRecentMessages(ctx, chatID, contextSize)
-	if err != nil {
-		return nil, fmt.Errorf("get recent messages: %w", err)
+	// Each stage writes only its own field of di, so no locking is needed.
+	stages := []contextStage{
+		// Immediate context (required)
+		{name: "recent_messages", run: func(ctx context.Context) (err error) {
+			di.RecentMessages, err = database.GetRecentMessages(ctx, chatID, contextSize)
+			return err
+		}},
+		// Current user context
+		{name: "user_facts", optional: true, run: func(ctx context.Context) (err error) {
+			di.UserFacts, err = selectUserFacts(ctx, client, database, chatID, userID, text)
+			return err
+		}},
+		// Latest 30-day and 7-day summaries (Section 8.4)
+		{name: "summary_30day", optional: true, run: func(ctx context.Context) (err error) {
+			di.Summary30Day, err = database.GetLatestSummary(ctx, chatID, "30day")
+			return err
+		}},
+		{name: "summary_7day", optional: true, run: func(ctx context.Context) (err error) {
+			di.Summary7Day, err = database.GetLatestSummary(ctx, chatID, "7day")
+			return err
+		}},
 	}
-	di.RecentMessages = messages
 
-	// Load user facts for current user context
-	facts, err := database.GetUserFacts(ctx, chatID, userID)
+	start := time.Now()
+	timings, err := runContextStages(ctx, stageTimeout, stages)
 	if err != nil {
-		return nil, fmt.Errorf("get user facts: %w", err)
+		return nil, err
 	}
-	di.UserFacts = facts
 
-	// Load latest 30-day and 7-day summaries (Section 8.4)
-	if s30, err := database.GetLatestSummary(ctx, chatID, "30day"); err == nil {
-		di.Summary30Day = s30
-	}
-	if s7, err := database.GetLatestSummary(ctx, chatID, "7day"); err == nil {
-		di.Summary7Day = s7
+	fields := []any{"chat_id", chatID, "total_ms", durationMs(time.Since(start))}
+	for i, st := range stages {
+		fields = append(fields, st.name+"_ms", durationMs(timings[i]))
 	}
+	slog.Info("context built", fields...)
 
 	return di, nil
 }
 
 // BuildParts assembles the Dynamic Instructions into genai.Part entries
-// following the strict ordering from Section 8.
+// following the strict ordering from Section 8, or the stable-prefix ordering when StablePrefix is set.
+// Blocks are fitted to TokenBudget first (see assemble); the estimated usage is stored in Usage and logged.
 func (di *DynamicInstructions) BuildParts() []*genai.Part {
+	blocks, usage := di.assemble()
+	di.Usage = usage
+	di.logUsage(usage)
+
+	if di.StablePrefix {
+		return di.buildStablePrefixParts(blocks)
+	}
+
 	var parts []*genai.Part
 
 	// 1. Current Time & Chat Info (Section 8.2)
-	timeBlock := fmt.Sprintf("# Current Time\n%s\n\n# Chat Info\nChat ID: %d",
-		di.CurrentTime, di.ChatID)
-	if di.ChatName != "" {
-		timeBlock += fmt.Sprintf("\nChat Name: %s", di.ChatName)
-	}
-	parts = append(parts, genai.NewPartFromText(timeBlock))
+	parts = append(parts, genai.NewPartFromText(blocks.time+blocks.chatInfo))
 
-	// 2. Tools Block (Section 8.3) — injected as descriptive text
-	if di.ToolsDescription != "" {
-		toolsBlock := "# Available Tools\n" + di.ToolsDescription
-		toolsBlock += "\n\nFor generate_image and edit_image: the prompt parameter MUST be in English only. If the user writes in another language, translate their request into English before calling the tool."
-		parts = append(parts, genai.NewPartFromText(toolsBlock))
-	}
+	// 2. Tools Block (Section 8.3) is part of the static prefix (system instruction + declarations),
+	// see Client.SetTools, so it can be served from the Gemini context cache.
 
 	// 3. Context Summaries (Section 8.4)
-	contextBlock := ""
-	if di.Summary30Day != "" {
-		contextBlock += "# 30-Day Summary\n" + di.Summary30Day + "\n\n"
-	}
-	if di.Summary7Day != "" {
-		contextBlock += "# 7-Day Summary\n" + di.Summary7Day + "\n\n"
-	}
-	if contextBlock != "" {
-		parts = append(parts, genai.NewPartFromText(contextBlock))
+	if blocks.summaries != "" {
+		parts = append(parts, genai.NewPartFromText(blocks.summaries))
 	}
 
 	// 4. Immediate Chat Context (Section 8.4 bottom)
-	if len(di.RecentMessages) > 0 {
-		chatLog := "# Immediate Chat Context\n"
-		for _, msg := range di.RecentMessages {
-			name := "Unknown"
-			if msg.FirstName != nil {
-				name = *msg.FirstName
-			}
-			if msg.Username != nil {
-				name += " (@" + *msg.Username + ")"
-			}
-
-			text := ""
-			if msg.Text != nil {
-				text = *msg.Text
-			}
-
-			prefix := ""
-			if msg.IsBotReply {
-				prefix = "[BOT] "
-			}
-			if msg.WasThrottled {
-				prefix = "[THROTTLED] "
-			}
-
-			chatLog += fmt.Sprintf("%s%s: %s\n", prefix, name, text)
-		}
-		parts = append(parts, genai.NewPartFromText(chatLog))
+	if blocks.chatLog != "" {
+		parts = append(parts, genai.NewPartFromText(blocks.chatLog))
 	}
 
 	// 5. Current User Context (Section 8.5)
-	if len(di.UserFacts) > 0 {
-		factsBlock := fmt.Sprintf("# Current User Context (user_id: %d)\n", di.UserID)
-		for _, f := range di.UserFacts {
-			factsBlock += fmt.Sprintf("- %s\n", f.FactText)
-		}
-		parts = append(parts, genai.NewPartFromText(factsBlock))
+	if blocks.facts != "" {
+		parts = append(parts, genai.NewPartFromText(blocks.facts))
 	}
 
 	// 6. Multi-Media Buffer (Section 8.6)
@@ -164,21 +217,155 @@ func (di *DynamicInstructions) BuildParts() []*genai.Part {
 	parts = append(parts, di.MediaParts...)
 
 	// 7. Current Message (Section 8.7), including reply/quote when present
-	msgBlock := fmt.Sprintf("# Current Message\nFrom: %s", di.FirstName)
+	parts = append(parts, genai.NewPartFromText(blocks.message))
+
+	return parts
+}
+
+// buildStablePrefixParts orders the blocks from most static to most volatile, so consecutive requests
+// in the same chat share the longest possible prompt prefix (provider-side implicit caching):
+// chat info, 30-day and 7-day summaries, user facts, the recent chat log, then media, time and the
+// current message. The tools block already precedes all of it in the system instruction.
+func (di *DynamicInstructions) buildStablePrefixParts(blocks promptBlocks) []*genai.Part {
+	var parts []*genai.Part
+
+	parts = append(parts, genai.NewPartFromText(blocks.chatInfo))
+	if blocks.summaries != "" {
+		parts = append(parts, genai.NewPartFromText(blocks.summaries))
+	}
+	if blocks.facts != "" {
+		parts = append(parts, genai.NewPartFromText(blocks.facts))
+	}
+	if blocks.chatLog != "" {
+		parts = append(parts, genai.NewPartFromText(blocks.chatLog))
+	}
+	parts = append(parts, di.MediaParts...)
+	parts = append(parts, genai.NewPartFromText(blocks.time+blocks.message))
+
+	return parts
+}
+
+// chatInfoBlock renders the chat identification (Section 8.2).
+func (di *DynamicInstructions) chatInfoBlock() string {
+	var b strings.Builder
+	b.Grow(48 + len(di.ChatName))
+	b.WriteString("# Chat Info\nChat ID: ")
+	b.WriteString(strconv.FormatInt(di.ChatID, 10))
+	if di.ChatName != "" {
+		b.WriteString("\nChat Name: ")
+		b.WriteString(di.ChatName)
+	}
+	return b.String()
+}
+
+// chatLogHeader is the heading of the immediate chat context block.
+const chatLogHeader = "# Immediate Chat Context\n"
+
+// chatLogBlock renders the immediate chat context from ChatLine lines given newest first; "" when
+// there are none.
+func chatLogBlock(lines []string) string {
+	if len(lines) == 0 {
+		return ""
+	}
+	size := len(chatLogHeader)
+	for _, l := range lines {
+		size += len(l)
+	}
+	var b strings.Builder
+	b.Grow(size)
+	b.WriteString(chatLogHeader)
+	for i := len(lines) - 1; i >= 0; i-- {
+		b.WriteString(lines[i])
+	}
+	return b.String()
+}
+
+// summariesBlock renders the 30-day and 7-day summaries (Section 8.4); "" when there are none.
+func summariesBlock(summary30, summary7 string) string {
+	if summary30 == "" && summary7 == "" {
+		return ""
+	}
+	var b strings.Builder
+	b.Grow(len(summary30) + len(summary7) + 40)
+	if summary30 != "" {
+		b.WriteString("# 30-Day Summary\n")
+		b.WriteString(summary30)
+		b.WriteString("\n\n")
+	}
+	if summary7 != "" {
+		b.WriteString("# 7-Day Summary\n")
+		b.WriteString(summary7)
+		b.WriteString("\n\n")
+	}
+	return b.String()
+}
+
+// factsHeader is the heading of the current user's facts block.
+func (di *DynamicInstructions) factsHeader() string {
+	return "# Current User Context (user_id: " + strconv.FormatInt(di.UserID, 10) + ")\n"
+}
+
+// factsBlock renders the current user's facts (Section 8.5), already fitted to the budget.
+func (di *DynamicInstructions) factsBlock(header string, facts []db.UserFact) string {
+	size := len(header)
+	for _, f := range facts {
+		size += len(f.FactText) + 3
+	}
+	var b strings.Builder
+	b.Grow(size)
+	b.WriteString(header)
+	for _, f := range facts {
+		b.WriteString("- ")
+		b.WriteString(f.FactText)
+		b.WriteByte('\n')
+	}
+	return b.String()
+}
+
+// messageBlock renders the current message (Section 8.7), including reply/quote when present,
+// preceded by the earlier messages of a coalesced turn.
+func (di *DynamicInstructions) messageBlock() string {
+	size := 96 + len(di.FirstName) + len(di.Username) + len(di.CurrentMessage) + len(di.ReplyToText)
+	for _, m := range di.EarlierTurnMessages {
+		size += 32 + len(m.FirstName) + len(m.Username) + len(m.Text)
+	}
+	var b strings.Builder
+	b.Grow(size)
+	if len(di.EarlierTurnMessages) > 0 {
+		b.WriteString("# Current Turn\n")
+		b.WriteString(strconv.Itoa(len(di.EarlierTurnMessages) + 1))
+		b.WriteString(" messages arrived since your last reply; answer them together. Earlier ones:\n")
+		for _, m := range di.EarlierTurnMessages {
+			b.WriteString("- ")
+			b.WriteString(m.FirstName)
+			if m.Username != "" {
+				b.WriteString(" (@" + m.Username + ")")
+			}
+			if m.UserID != nil {
+				b.WriteString(" [user_id: " + strconv.FormatInt(*m.UserID, 10) + "]")
+			}
+			b.WriteString(": ")
+			b.WriteString(m.Text)
+			b.WriteByte('\n')
+		}
+		b.WriteByte('\n')
+	}
+	b.WriteString("# Current Message\nFrom: ")
+	b.WriteString(di.FirstName)
 	if di.Username != "" {
-		msgBlock += fmt.Sprintf(" (@%s)", di.Username)
+		b.WriteString(" (@" + di.Username + ")")
 	}
-	msgBlock += fmt.Sprintf(" [user_id: %d]\nMessage: %s", di.UserID, di.CurrentMessage)
+	b.WriteString(" [user_id: " + strconv.FormatInt(di.UserID, 10) + "]\nMessage: ")
+	b.WriteString(di.CurrentMessage)
 	if di.ReplyToText != "" {
 		if di.ReplyToMessageID != nil {
-			msgBlock += fmt.Sprintf("\nReplying to (message_id %d): %s", *di.ReplyToMessageID, di.ReplyToText)
+			b.WriteString("\nReplying to (message_id " + strconv.FormatInt(*di.ReplyToMessageID, 10) + "): ")
 		} else {
-			msgBlock += "\nReplying to: " + di.ReplyToText
+			b.WriteString("\nReplying to: ")
 		}
+		b.WriteString(di.ReplyToText)
 	} else if di.ReplyToMessageID != nil {
-		msgBlock += fmt.Sprintf("\nReplying to message_id: %d", *di.ReplyToMessageID)
+		b.WriteString("\nReplying to message_id: " + strconv.FormatInt(*di.ReplyToMessageID, 10))
 	}
-	parts = append(parts, genai.NewPartFromText(msgBlock))
-
-	return parts
+	return b.String()
 }
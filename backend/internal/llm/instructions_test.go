@@ -1,7 +1,11 @@
 package llm
 
 import (
+	"context"
+	"errors"
+	"strings"
 	"testing"
+	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/db"
 	"google.golang.org/genai"
@@ -114,3 +118,125 @@ func TestDynamicInstructions_BuildParts_WithMediaParts(t *testing.T) {
 		t.Error("expected one part to have InlineData from MediaParts")
 	}
 }
+
+func TestRunContextStages_ConcurrentAndDegrading(t *testing.T) {
+	var recent, summary string
+	stages := []contextStage{
+		{name: "recent_messages", run: func(ctx context.Context) error {
+			time.Sleep(20 * time.Millisecond)
+			recent = "ok"
+			return nil
+		}},
+		{name: "summary_30day", optional: true, run: func(ctx context.Context) error {
+			// Slow lookup: must be cut off by the stage deadline
+			select {
+			case <-ctx.Done():
+				return ctx.Err()
+			case <-time.After(2 * time.Second):
+				summary = "too late"
+				return nil
+			}
+		}},
+		{name: "summary_7day", optional: true, run: func(ctx context.Context) error {
+			time.Sleep(20 * time.Millisecond)
+			return errors.New("boom")
+		}},
+	}
+
+	start := time.Now()
+	timings, err := runContextStages(context.Background(), 50*time.Millisecond, stages)
+	elapsed := time.Since(start)
+
+	if err != nil {
+		t.Fatalf("optional stage failures must not fail the build: %v", err)
+	}
+	if recent != "ok" || summary != "" {
+		t.Errorf("unexpected stage results: recent=%q summary=%q", recent, summary)
+	}
+	if len(timings) != len(stages) {
+		t.Fatalf("expected %d timings, got %d", len(stages), len(timings))
+	}
+	// Stages run concurrently and the slow one is bounded by the 50ms deadline
+	if elapsed > time.Second {
+		t.Errorf("expected stages to finish near the deadline, took %v", elapsed)
+	}
+}
+
+func TestRunContextStages_RequiredError(t *testing.T) {
+	stages := []contextStage{
+		{name: "recent_messages", run: func(ctx context.Context) error { return errors.New("db down") }},
+		{name: "user_facts", optional: true, run: func(ctx context.Context) error { return nil }},
+	}
+	if _, err := runContextStages(context.Background(), 0, stages); err == nil {
+		t.Error("expected error from required stage")
+	}
+}
+
+func TestDynamicInstructions_BuildParts_StablePrefixOrder(t *testing.T) {
+	username := "testuser"
+	firstName := "Test"
+	text := "Hello there"
+	di := &DynamicInstructions{
+		CurrentTime:    "10:00 Monday, 24/02/2026",
+		ChatID:         123,
+		CurrentMessage: "New message",
+		UserID:         456,
+		FirstName:      "Sender",
+		Summary30Day:   "Month.",
+		Summary7Day:    "Week.",
+		UserFacts:      []db.UserFact{{FactText: "Likes tea"}},
+		RecentMessages: []db.Message{{ChatID: 123, Username: &username, FirstName: &firstName, Text: &text}},
+		StablePrefix:   true,
+	}
+
+	parts := di.BuildParts()
+	if len(parts) != 5 {
+		t.Fatalf("expected 5 parts (chat info, summaries, facts, log, message), got %d", len(parts))
+	}
+	wantPrefixes := []string{"# Chat Info", "# 30-Day Summary", "# Current User Context", "# Immediate Chat Context", "# Current Time"}
+	for i, want := range wantPrefixes {
+		if !strings.HasPrefix(parts[i].Text, want) {
+			t.Errorf("part %d: expected prefix %q, got %q", i, want, parts[i].Text)
+		}
+	}
+	if !strings.Contains(parts[4].Text, "# Current Message") {
+		t.Error("expected current message in the last part")
+	}
+
+	// Only the tail differs between two consecutive turns
+	di2 := *di
+	di2.CurrentTime = "10:01 Monday, 24/02/2026"
+	di2.CurrentMessage = "Another"
+	parts2 := di2.BuildParts()
+	for i := 0; i < 4; i++ {
+		if parts[i].Text != parts2[i].Text {
+			t.Errorf("part %d changed between turns", i)
+		}
+	}
+}
+
+func TestDynamicInstructions_BuildParts_CoalescedTurn(t *testing.T) {
+	uid := int64(11)
+	di := &DynamicInstructions{
+		CurrentTime:    "10:00 Monday, 24/02/2026",
+		ChatID:         123,
+		CurrentMessage: "third",
+		UserID:         456,
+		FirstName:      "Sender",
+		EarlierTurnMessages: []TurnMessage{
+			{UserID: &uid, Username: "a", FirstName: "Anna", Text: "first"},
+			{FirstName: "Bob", Text: "second"},
+		},
+	}
+	parts := di.BuildParts()
+	last := parts[len(parts)-1].Text
+	if !strings.Contains(last, "# Current Turn\n3 messages") {
+		t.Errorf("expected current turn header, got %q", last)
+	}
+	if !strings.Contains(last, "- Anna (@a) [user_id: 11]: first\n- Bob: second\n") {
+		t.Errorf("expected earlier messages in order, got %q", last)
+	}
+	if strings.Index(last, "second") > strings.Index(last, "# Current Message") {
+		t.Error("expected earlier messages before the current message")
+	}
+}
@@ -0,0 +1,71 @@
+package llm
+
+import (
+	"context"
+	"log/slog"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+)
+
+// selectUserFacts picks the user facts for the prompt. When all of them fit the token budget they are
+// used as is, without an embedding call. Otherwise, with embeddings on, the USER_FACTS_TOP_K facts most
+// relevant to the current message are taken; without embeddings (or if the lookup fails), the newest.
+// Either way the result is trimmed to USER_FACTS_TOKEN_BUDGET.
+func selectUserFacts(ctx context.Context, client *Client, database *db.DB, chatID, userID int64, text string) ([]db.UserFact, error) {
+	facts, err := database.GetUserFacts(ctx, chatID, userID)
+	if err != nil || client == nil {
+		return facts, err
+	}
+	budget := client.config.UserFactsTokenBudget
+	if budget <= 0 || factTokens(facts) <= budget {
+		return facts, nil
+	}
+
+	if client.EmbeddingsEnabled() && text != "" {
+		topK := client.config.UserFactsTopK
+		if topK <= 0 {
+			topK = 20
+		}
+		ranked, err := rankUserFacts(ctx, client, database, chatID, userID, text, topK)
+		if err == nil {
+			return fitFacts(ranked, budget), nil
+		}
+		slog.Warn("fact retrieval failed, using newest facts", "chat_id", chatID, "user_id", userID, "error", err)
+	}
+
+	// GetUserFacts is oldest first; keep the newest that fit
+	newest := make([]db.UserFact, len(facts))
+	for i, f := range facts {
+		newest[len(facts)-1-i] = f
+	}
+	return fitFacts(newest, budget), nil
+}
+
+func rankUserFacts(ctx context.Context, client *Client, database *db.DB, chatID, userID int64, text string, topK int) ([]db.UserFact, error) {
+	vec, err := client.EmbedQuery(ctx, text)
+	if err != nil {
+		return nil, err
+	}
+	return database.RankUserFacts(ctx, chatID, userID, vec, topK)
+}
+
+// factTokens estimates the prompt tokens of facts, list markers included.
+func factTokens(facts []db.UserFact) int {
+	n := 0
+	for _, f := range facts {
+		n += EstimateTokens(f.FactText) + 1
+	}
+	return n
+}
+
+// fitFacts keeps facts in order while they fit within budget tokens.
+func fitFacts(facts []db.UserFact, budget int) []db.UserFact {
+	used := 0
+	for i := range facts {
+		used += factTokens(facts[i : i+1])
+		if used > budget {
+			return facts[:i]
+		}
+	}
+	return facts
+}
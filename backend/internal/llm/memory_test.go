@@ -0,0 +1,19 @@
+package llm
+
+import (
+	"strings"
+	"testing"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+)
+
+func TestFitFactsStopsAtBudget(t *testing.T) {
+	fact := func(n int) db.UserFact { return db.UserFact{FactText: strings.Repeat("x", n)} }
+	facts := []db.UserFact{fact(40), fact(40), fact(40)} // 12 tokens each
+	if got := fitFacts(facts, 30); len(got) != 2 {
+		t.Fatalf("fitFacts kept %d facts, want 2", len(got))
+	}
+	if got := fitFacts(facts, 1000); len(got) != 3 {
+		t.Fatalf("fitFacts kept %d facts under a large budget, want 3", len(got))
+	}
+}
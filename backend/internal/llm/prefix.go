@@ -0,0 +1,235 @@
+package llm
+
+import (
+	"context"
+	"crypto/sha256"
+	"encoding/json"
+	"fmt"
+	"log/slog"
+	"os"
+	"strings"
+	"time"
+
+	"google.golang.org/genai"
+)
+
+const (
+	// prefixCacheRefreshMargin is how long before expiry the cached prefix TTL is extended.
+	prefixCacheRefreshMargin = 5 * time.Minute
+	// prefixCacheRetryInterval is the wait before retrying after a failed cache create (e.g. prefix below
+	// the model's minimum cacheable size); requests send the prefix inline meanwhile.
+	prefixCacheRetryInterval = 10 * time.Minute
+
+	imagePromptLanguageNote = "For generate_image and edit_image: the prompt parameter MUST be in English only. If the user writes in another language, translate their request into English before calling the tool."
+)
+
+// staticPrefix is the part of every chat generation request that does not depend on the chat:
+// persona (system instruction), tool declarations and the tools description block.
+// Guarded by Client.mu; version bumps whenever persona or tools change.
+type staticPrefix struct {
+	persona          string
+	tools            []*genai.Tool
+	toolsDescription string
+	toolsFingerprint [32]byte
+	version          uint64
+
+	// Gemini cached-content handle for the prefix at cachedVersion ("" = send the prefix inline).
+	cacheName     string
+	cachedVersion uint64
+	cacheExpires  time.Time
+	superseded    []string // handles dropped by dropPrefixCache, deleted by the next refresh
+}
+
+// SetTools registers the tool declarations and description block sent with every chat generation.
+// Calling it with a different declaration set (e.g. after feature toggles change) refreshes the cached prefix.
+func (c *Client) SetTools(tools []*genai.Tool, description string) {
+	fp := toolsFingerprint(tools, description)
+	c.mu.Lock()
+	changed := fp != c.prefix.toolsFingerprint
+	if changed {
+		c.prefix.tools = tools
+		c.prefix.toolsDescription = description
+		c.prefix.toolsFingerprint = fp
+		c.prefix.version++
+	}
+	c.mu.Unlock()
+	if changed {
+		c.signalPrefixRefresh()
+	}
+}
+
+// ReloadPersona re-reads the persona file from disk and refreshes the cached prefix (hot-swap, Section 13).
+func (c *Client) ReloadPersona() error {
+	persona, err := os.ReadFile(c.config.PersonaFile)
+	if err != nil {
+		return fmt.Errorf("read persona file %s: %w", c.config.PersonaFile, err)
+	}
+	c.mu.Lock()
+	changed := string(persona) != c.prefix.persona
+	if changed {
+		c.prefix.persona = string(persona)
+		c.prefix.version++
+	}
+	c.mu.Unlock()
+	slog.Info("persona reloaded", "persona_file", c.config.PersonaFile, "persona_length", len(persona), "changed", changed)
+	if changed {
+		c.signalPrefixRefresh()
+	}
+	return nil
+}
+
+// signalPrefixRefresh wakes RunPrefixCache without blocking.
+func (c *Client) signalPrefixRefresh() {
+	select {
+	case c.prefixRefresh <- struct{}{}:
+	default:
+	}
+}
+
+// systemInstruction returns the full static system instruction: persona plus the tools block.
+// Caller holds c.mu (read or write).
+func (p *staticPrefix) systemInstruction() *genai.Content {
+	text := p.persona
+	if p.toolsDescription != "" {
+		text += "\n\n# Available Tools\n" + p.toolsDescription + "\n" + imagePromptLanguageNote
+	}
+	return &genai.Content{Parts: []*genai.Part{genai.NewPartFromText(text)}}
+}
+
+// RunPrefixCache keeps a Gemini cached-content handle for the static prefix alive until ctx is done:
+// it creates the cache, extends its TTL before expiry and recreates it when persona or tools change.
+// While no valid handle exists, generation requests send the prefix inline.
+func (c *Client) RunPrefixCache(ctx context.Context) {
+	logger := slog.With("component", "prefix_cache")
+	for {
+		wait := c.refreshPrefixCache(ctx, logger)
+		select {
+		case <-ctx.Done():
+			return
+		case <-c.prefixRefresh:
+		case <-time.After(wait):
+		}
+	}
+}
+
+// refreshPrefixCache brings the cached prefix up to date and returns how long to wait before the next check.
+func (c *Client) refreshPrefixCache(ctx context.Context, logger *slog.Logger) time.Duration {
+	ttl := c.config.GeminiContextCacheTTL()
+
+	c.mu.Lock()
+	version := c.prefix.version
+	name := c.prefix.cacheName
+	current := name != "" && c.prefix.cachedVersion == version
+	expires := c.prefix.cacheExpires
+	sys := c.prefix.systemInstruction()
+	tools := c.prefix.tools
+	superseded := c.prefix.superseded
+	c.prefix.superseded = nil
+	c.mu.Unlock()
+
+	for _, old := range superseded {
+		c.deletePrefixCache(old, logger)
+	}
+
+	if current {
+		if until := time.Until(expires) - prefixCacheRefreshMargin; until > 0 {
+			return until
+		}
+		updated, err := c.genai.Caches.Update(ctx, name, &genai.UpdateCachedContentConfig{TTL: ttl})
+		if err == nil {
+			c.mu.Lock()
+			if c.prefix.cacheName == name {
+				c.prefix.cacheExpires = cacheExpiry(updated, ttl)
+			}
+			c.mu.Unlock()
+			logger.Info("prefix cache ttl extended", "name", name)
+			return ttl - prefixCacheRefreshMargin
+		}
+		logger.Warn("prefix cache ttl update failed, recreating", "name", name, "error", err)
+	}
+
+	created, err := c.genai.Caches.Create(ctx, c.config.GeminiModel, &genai.CreateCachedContentConfig{
+		DisplayName:       "gryag-static-prefix",
+		TTL:               ttl,
+		SystemInstruction: sys,
+		Tools:             tools,
+	})
+	if err != nil {
+		logger.Warn("prefix cache create failed, sending prefix inline", "error", err)
+		c.mu.Lock()
+		if c.prefix.cacheName == name {
+			c.prefix.cacheName = ""
+		}
+		c.mu.Unlock()
+		c.deletePrefixCache(name, logger)
+		return prefixCacheRetryInterval
+	}
+
+	c.mu.Lock()
+	stale := c.prefix.version != version
+	if !stale {
+		c.prefix.cacheName = created.Name
+		c.prefix.cachedVersion = version
+		c.prefix.cacheExpires = cacheExpiry(created, ttl)
+	}
+	c.mu.Unlock()
+
+	if stale {
+		// Persona or tools changed while creating; drop this one and build again right away.
+		c.deletePrefixCache(created.Name, logger)
+		return 0
+	}
+	if name != created.Name {
+		c.deletePrefixCache(name, logger)
+	}
+	tokens := int32(0)
+	if created.UsageMetadata != nil {
+		tokens = created.UsageMetadata.TotalTokenCount
+	}
+	logger.Info("prefix cache created", "name", created.Name, "tokens", tokens, "ttl", ttl)
+	return ttl - prefixCacheRefreshMargin
+}
+
+// deletePrefixCache removes a superseded cache handle in the background (best effort; it also expires on its own).
+func (c *Client) deletePrefixCache(name string, logger *slog.Logger) {
+	if name == "" {
+		return
+	}
+	go func() {
+		ctx, cancel := context.WithTimeout(context.Background(), 30*time.Second)
+		defer cancel()
+		if _, err := c.genai.Caches.Delete(ctx, name, nil); err != nil {
+			logger.Debug("prefix cache delete failed", "name", name, "error", err)
+		}
+	}()
+}
+
+// dropPrefixCache forgets a handle that the API rejected, so following requests go inline until refreshed.
+// The refresh also deletes it, in case it still exists server-side and would be billed until its TTL.
+func (c *Client) dropPrefixCache(name string) {
+	c.mu.Lock()
+	if c.prefix.cacheName == name {
+		c.prefix.cacheName = ""
+		c.prefix.superseded = append(c.prefix.superseded, name)
+	}
+	c.mu.Unlock()
+	c.signalPrefixRefresh()
+}
+
+// cacheExpiry returns the handle's expiry as reported by the API, or now+ttl if missing.
+func cacheExpiry(cc *genai.CachedContent, ttl time.Duration) time.Time {
+	if cc != nil && !cc.ExpireTime.IsZero() {
+		return cc.ExpireTime
+	}
+	return time.Now().Add(ttl)
+}
+
+// toolsFingerprint hashes the declarations and description to detect tool-set changes.
+func toolsFingerprint(tools []*genai.Tool, description string) [32]byte {
+	data, _ := json.Marshal(tools)
+	var b strings.Builder
+	b.Write(data)
+	b.WriteString("\x00")
+	b.WriteString(description)
+	return sha256.Sum256([]byte(b.String()))
+}
@@ -0,0 +1,114 @@
+package llm
+
+import (
+	"context"
+	"fmt"
+	"strings"
+	"testing"
+
+	"github.com/ThatHunky/gryag/backend/internal/config"
+	"google.golang.org/genai"
+)
+
+func newPrefixTestClient() *Client {
+	return &Client{
+		config:        &config.Config{GeminiModel: "test-model"},
+		prefix:        staticPrefix{persona: "You are gryag."},
+		prefixRefresh: make(chan struct{}, 1),
+	}
+}
+
+func TestSetTools_BumpsVersionOnlyOnChange(t *testing.T) {
+	c := newPrefixTestClient()
+	tools := []*genai.Tool{{FunctionDeclarations: []*genai.FunctionDeclaration{{Name: "remember_memory"}}}}
+
+	c.SetTools(tools, "- remember_memory: store a fact")
+	if c.prefix.version != 1 {
+		t.Fatalf("expected version 1 after first SetTools, got %d", c.prefix.version)
+	}
+	c.SetTools(tools, "- remember_memory: store a fact")
+	if c.prefix.version != 1 {
+		t.Errorf("expected unchanged tools to keep version 1, got %d", c.prefix.version)
+	}
+	c.SetTools(tools, "- remember_memory: store a user fact")
+	if c.prefix.version != 2 {
+		t.Errorf("expected changed description to bump version to 2, got %d", c.prefix.version)
+	}
+}
+
+func TestSystemInstruction_IncludesToolsBlock(t *testing.T) {
+	c := newPrefixTestClient()
+	if got := c.prefix.systemInstruction().Parts[0].Text; got != "You are gryag." {
+		t.Errorf("expected bare persona without tools, got %q", got)
+	}
+	c.SetTools(nil, "- search_web: search")
+	got := c.prefix.systemInstruction().Parts[0].Text
+	if !strings.HasPrefix(got, "You are gryag.\n\n# Available Tools\n- search_web: search") {
+		t.Errorf("expected persona followed by tools block, got %q", got)
+	}
+	if !strings.Contains(got, imagePromptLanguageNote) {
+		t.Error("expected image prompt language note in tools block")
+	}
+}
+
+func TestGenerateConfig_CachedOrInline(t *testing.T) {
+	c := newPrefixTestClient()
+	tools := []*genai.Tool{{FunctionDeclarations: []*genai.FunctionDeclaration{{Name: "search_web"}}}}
+	c.SetTools(tools, "- search_web: search")
+
+	cfg, name := c.generateConfig()
+	if name != "" || cfg.CachedContent != "" {
+		t.Fatalf("expected inline prefix without a cache handle, got %q", name)
+	}
+	if cfg.SystemInstruction == nil || len(cfg.Tools) != 1 {
+		t.Fatal("expected inline system instruction and tools")
+	}
+
+	c.prefix.cacheName = "cachedContents/abc"
+	c.prefix.cachedVersion = c.prefix.version
+	cfg, name = c.generateConfig()
+	if name != "cachedContents/abc" || cfg.CachedContent != name {
+		t.Fatalf("expected cached handle, got %q", name)
+	}
+	if cfg.SystemInstruction != nil || cfg.Tools != nil {
+		t.Error("expected no system instruction or tools alongside CachedContent")
+	}
+
+	// A persona/tools change makes the handle stale until RunPrefixCache recreates it.
+	c.SetTools(nil, "")
+	if _, name = c.generateConfig(); name != "" {
+		t.Errorf("expected stale handle to fall back inline, got %q", name)
+	}
+}
+
+func TestCachedContentGone(t *testing.T) {
+	cases := []struct {
+		err  error
+		want bool
+	}{
+		{fmt.Errorf("generate content: %w", genai.APIError{Code: 404, Message: "CachedContent not found"}), true},
+		{genai.APIError{Code: 400, Message: "Invalid cachedContent name"}, true},
+		{genai.APIError{Code: 400, Message: "Request contains an invalid argument."}, false},
+		{genai.APIError{Code: 429, Message: "Resource exhausted"}, false},
+		{genai.APIError{Code: 503, Message: "The model is overloaded"}, false},
+		{context.DeadlineExceeded, false},
+	}
+	for _, tc := range cases {
+		if got := cachedContentGone(tc.err); got != tc.want {
+			t.Errorf("cachedContentGone(%v) = %v, want %v", tc.err, got, tc.want)
+		}
+	}
+}
+
+func TestDropPrefixCache_RecordsHandleForDeletion(t *testing.T) {
+	c := newPrefixTestClient()
+	c.prefix.cacheName = "cachedContents/abc"
+	c.dropPrefixCache("cachedContents/abc")
+	c.dropPrefixCache("cachedContents/abc") // a second failed request with the same handle
+	if c.prefix.cacheName != "" {
+		t.Errorf("expected the handle to be dropped, got %q", c.prefix.cacheName)
+	}
+	if len(c.prefix.superseded) != 1 || c.prefix.superseded[0] != "cachedContents/abc" {
+		t.Errorf("expected the dropped handle queued for deletion once, got %v", c.prefix.superseded)
+	}
+}
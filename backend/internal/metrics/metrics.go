@@ -0,0 +1,77 @@
+package metrics
+
+import (
+	"net/http"
+	"strconv"
+	"time"
+)
+
+// The backend's metrics. Stages of a /process request (stage label):
+//
+//	rate_limit    — whitelist and rate-limit checks in the middleware (one Redis call)
+//	context_build — NewDynamicInstructions: recent messages, facts and summaries
+//	llm_round     — one Gemini call of the tool loop
+//	db_insert     — InsertMessage as seen by the request (queueing, or the INSERT when synchronous)
+var (
+	HTTPRequestDuration = NewHistogramVec("gryag_http_request_duration_seconds",
+		"Latency of backend HTTP requests by route and status code.", LatencyBuckets, "route", "code")
+	StageDuration = NewHistogramVec("gryag_stage_duration_seconds",
+		"Latency of each stage of message processing.", LatencyBuckets, "stage")
+	ToolDuration = NewHistogramVec("gryag_tool_duration_seconds",
+		"Latency of tool calls by tool and outcome (ok, error).", LatencyBuckets, "tool", "outcome")
+	GeminiTokens = NewCounterVec("gryag_gemini_tokens_total",
+		"Gemini tokens from UsageMetadata by kind (prompt, cached, output, thoughts).", "kind")
+	GeminiCalls = NewCounterVec("gryag_gemini_calls_total",
+		"Gemini generate calls by mode (generate, stream) and outcome (ok, error).", "mode", "outcome")
+	RedisDuration = NewHistogramVec("gryag_redis_command_duration_seconds",
+		"Redis round trips by command (pipelines as \"pipeline\"). Blocking pops include their wait.", LatencyBuckets, "command")
+	PostgresDuration = NewHistogramVec("gryag_postgres_query_duration_seconds",
+		"Postgres round trips by operation (query, query_row, exec, insert_batch).", LatencyBuckets, "op")
+	QueueDepth = NewGaugeVec("gryag_queue_depth",
+		"Items waiting per queue (message_writer, turn_queue, proactive), read at scrape time.", "queue")
+	QueueDropped = NewCounterVec("gryag_queue_dropped_total",
+		"Items dropped because their queue was full, by queue (turn_queue).", "queue")
+)
+
+// Stage records the time since start for one processing stage.
+func Stage(stage string, start time.Time) {
+	StageDuration.With(stage).Since(start)
+}
+
+// Instrument wraps a handler to record its latency under route. The wrapped ResponseWriter keeps
+// Flush and Unwrap, so streaming handlers and http.ResponseController work through it.
+func Instrument(route string, next http.Handler) http.Handler {
+	return http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		start := time.Now()
+		sw := &statusWriter{ResponseWriter: w, code: http.StatusOK}
+		next.ServeHTTP(sw, r)
+		HTTPRequestDuration.With(route, strconv.Itoa(sw.code)).Since(start)
+	})
+}
+
+type statusWriter struct {
+	http.ResponseWriter
+	code        int
+	wroteHeader bool
+}
+
+func (w *statusWriter) WriteHeader(code int) {
+	if !w.wroteHeader {
+		w.code = code
+		w.wroteHeader = true
+	}
+	w.ResponseWriter.WriteHeader(code)
+}
+
+func (w *statusWriter) Write(p []byte) (int, error) {
+	w.wroteHeader = true
+	return w.ResponseWriter.Write(p)
+}
+
+func (w *statusWriter) Flush() {
+	if f, ok := w.ResponseWriter.(http.Flusher); ok {
+		f.Flush()
+	}
+}
+
+func (w *statusWriter) Unwrap() http.ResponseWriter { return w.ResponseWriter }
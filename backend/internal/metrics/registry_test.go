@@ -0,0 +1,80 @@
+package metrics
+
+import (
+	"net/http"
+	"net/http/httptest"
+	"strings"
+	"testing"
+)
+
+func scrape(t *testing.T) string {
+	t.Helper()
+	w := httptest.NewRecorder()
+	Handler().ServeHTTP(w, httptest.NewRequest("GET", "/metrics", nil))
+	if ct := w.Header().Get("Content-Type"); !strings.HasPrefix(ct, "text/plain; version=0.0.4") {
+		t.Fatalf("content type = %q", ct)
+	}
+	return w.Body.String()
+}
+
+func TestCounterAndGauge(t *testing.T) {
+	c := NewCounterVec("test_events_total", "Test events.", "kind")
+	c.With("a").Inc()
+	c.With("a").Add(2)
+	c.With("b").Add(-1) // ignored
+	g := NewGaugeVec("test_depth", "Test depth.", "queue")
+	Default.OnScrape(func() { g.With(`we"ird`).Set(7) })
+
+	body := scrape(t)
+	for _, want := range []string{
+		"# TYPE test_events_total counter\n",
+		`test_events_total{kind="a"} 3` + "\n",
+		`test_events_total{kind="b"} 0` + "\n",
+		`test_depth{queue="we\"ird"} 7` + "\n",
+	} {
+		if !strings.Contains(body, want) {
+			t.Errorf("missing %q in:\n%s", want, body)
+		}
+	}
+}
+
+func TestHistogramBuckets(t *testing.T) {
+	h := NewHistogramVec("test_latency_seconds", "Test latency.", []float64{0.1, 1}, "stage")
+	for _, v := range []float64{0.05, 0.1, 0.5, 3} {
+		h.With("x").Observe(v)
+	}
+
+	body := scrape(t)
+	for _, want := range []string{
+		"# TYPE test_latency_seconds histogram\n",
+		`test_latency_seconds_bucket{stage="x",le="0.1"} 2` + "\n",
+		`test_latency_seconds_bucket{stage="x",le="1"} 3` + "\n",
+		`test_latency_seconds_bucket{stage="x",le="+Inf"} 4` + "\n",
+		`test_latency_seconds_sum{stage="x"} 3.65` + "\n",
+		`test_latency_seconds_count{stage="x"} 4` + "\n",
+	} {
+		if !strings.Contains(body, want) {
+			t.Errorf("missing %q in:\n%s", want, body)
+		}
+	}
+}
+
+func TestInstrument_RecordsStatusAndKeepsFlusher(t *testing.T) {
+	flushed := false
+	next := http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		if _, ok := w.(http.Flusher); !ok {
+			t.Error("wrapped writer lost http.Flusher")
+		} else {
+			flushed = true
+		}
+		w.WriteHeader(http.StatusNoContent)
+	})
+	Instrument("test_route", next).ServeHTTP(httptest.NewRecorder(), httptest.NewRequest("POST", "/", nil))
+
+	if !flushed {
+		t.Fatal("handler not called")
+	}
+	if body := scrape(t); !strings.Contains(body, `gryag_http_request_duration_seconds_count{route="test_route",code="204"} 1`) {
+		t.Errorf("request not recorded:\n%s", body)
+	}
+}
@@ -1,11 +1,7 @@
 package middleware
 
 import (
-	"bytes"
 	"context"
-	"encoding/json"
-	"fmt"
-	"io"
 	"log/slog"
 	"net/http"
 	"time"
@@ -13,10 +9,11 @@ import (
 	"github.com/ThatHunky/gryag/backend/internal/cache"
 	"github.com/ThatHunky/gryag/backend/internal/config"
 	"github.com/ThatHunky/gryag/backend/internal/db"
+	"github.com/ThatHunky/gryag/backend/internal/handler"
+	"github.com/ThatHunky/gryag/backend/internal/metrics"
 )
 
-// RateLimiter is an HTTP middleware that enforces tiered rate limiting
-// and exclusive queue locking per Section 10 of the architecture.
+// RateLimiter is an HTTP middleware that enforces tiered rate limiting per Section 10 of the architecture.
 type RateLimiter struct {
 	cache  *cache.Cache
 	db     *db.DB
@@ -41,104 +38,55 @@ func (rl *RateLimiter) Middleware(next http.Handler) http.Handler {
 		requestID := r.Header.Get("X-Request-ID")
 		logger := slog.With("request_id", requestID)
 
-		// Read the full body so we can both parse it here and pass it downstream.
-		bodyBytes, err := io.ReadAll(r.Body)
+		// Decode the full request once (size-limited); the handler takes the typed value from context.
+		if limit := handler.MaxRequestBytes(rl.config); limit > 0 {
+			r.Body = http.MaxBytesReader(w, r.Body, limit)
+		}
+		payload, err := handler.ReadProcessRequest(r, int64(rl.config.MediaMaxBytes))
 		r.Body.Close()
 		if err != nil {
-			logger.Warn("failed to read request body", "error", err)
-			http.Error(w, `{"error":"invalid payload"}`, http.StatusBadRequest)
-			return
-		}
-
-		var payload struct {
-			ChatID int64  `json:"chat_id"`
-			UserID *int64 `json:"user_id"`
-			Text   string `json:"text"`
-		}
-		if err := json.Unmarshal(bodyBytes, &payload); err != nil {
-			http.Error(w, `{"error":"invalid payload"}`, http.StatusBadRequest)
+			logger.Warn("invalid request payload", "error", err)
+			handler.WriteDecodeError(w, err)
 			return
 		}
 
 		ctx := r.Context()
+		limitStart := time.Now()
 
 		// ── Check 0: Chat/group whitelist (if configured) ───────────────
-		if len(rl.config.AllowedChatIDs) > 0 {
-			allowed := false
-			for _, id := range rl.config.AllowedChatIDs {
-				if id == payload.ChatID {
-					allowed = true
-					break
-				}
-			}
-			if !allowed {
-				logger.Info("chat_not_allowed", "chat_id", payload.ChatID)
-				w.WriteHeader(http.StatusNoContent)
-				return
-			}
-		}
-
-		// ── Check 1: Global Chat Rate Limit ───────────────────────────
-		chatKey := fmt.Sprintf("rl:chat:%d", payload.ChatID)
-		chatResult, err := rl.cache.CheckRateLimit(ctx, chatKey, rl.config.RateLimitGlobalPerMinute, time.Minute)
-		if err != nil {
-			logger.Error("chat rate limit check failed", "error", err)
-			// On error, allow the request through (fail-open for rate limiting)
-		} else if !chatResult.Allowed {
-			logger.Info("throttled_chat",
-				"chat_id", payload.ChatID,
-				"retry_in", chatResult.RetryIn,
-			)
-			rl.logThrottledMessage(ctx, payload.ChatID, payload.UserID, payload.Text, requestID)
-			// Strict silence — return 204 No Content (Section 10)
+		if !rl.config.ChatAllowed(payload.ChatID) {
+			logger.Info("chat_not_allowed", "chat_id", payload.ChatID)
 			w.WriteHeader(http.StatusNoContent)
 			return
 		}
 
-		// ── Check 2: Per-User Rate Limit ──────────────────────────────
-		if payload.UserID != nil {
-			userKey := fmt.Sprintf("rl:user:%d:%d", payload.ChatID, *payload.UserID)
-			userResult, err := rl.cache.CheckRateLimit(ctx, userKey, rl.config.RateLimitUserPerMinute, time.Minute)
-			if err != nil {
-				logger.Error("user rate limit check failed", "error", err)
-			} else if !userResult.Allowed {
-				logger.Info("throttled_user",
-					"user_id", *payload.UserID,
-					"chat_id", payload.ChatID,
-					"retry_in", userResult.RetryIn,
-				)
-				rl.logThrottledMessage(ctx, payload.ChatID, payload.UserID, payload.Text, requestID)
-				w.WriteHeader(http.StatusNoContent)
-				return
-			}
-		}
-
-		// ── Check 3: Queue Lock (Exclusive Processing) ────────────────
-		locked, err := rl.cache.AcquireLock(ctx, payload.ChatID, 2*time.Minute)
+		// ── Checks 1-2: chat limit and per-user limit (one atomic call) ──
+		// Check 3 (exclusive processing per chat) is the handler's turn queue, which coalesces
+		// messages arriving during a generation instead of dropping them.
+		admit, err := rl.cache.Admit(ctx, cache.AdmitRequest{
+			ChatID:    payload.ChatID,
+			UserID:    payload.UserID,
+			ChatLimit: rl.config.RateLimitGlobalPerMinute,
+			UserLimit: rl.config.RateLimitUserPerMinute,
+			Window:    time.Minute,
+		})
+		metrics.Stage("rate_limit", limitStart)
 		if err != nil {
-			logger.Error("queue lock check failed", "error", err)
-		} else if !locked {
-			logger.Info("queue_locked",
-				"chat_id", payload.ChatID,
-			)
+			// On error, allow the request through (fail-open for rate limiting)
+			logger.Error("admission check failed", "error", err)
+		} else if admit.Status != cache.AdmitAllowed {
+			if admit.Status == cache.AdmitUserThrottled {
+				logger.Info("throttled_user", "user_id", *payload.UserID, "chat_id", payload.ChatID, "retry_in", admit.RetryIn)
+			} else {
+				logger.Info("throttled_chat", "chat_id", payload.ChatID, "retry_in", admit.RetryIn)
+			}
 			rl.logThrottledMessage(ctx, payload.ChatID, payload.UserID, payload.Text, requestID)
+			// Strict silence — return 204 No Content (Section 10)
 			w.WriteHeader(http.StatusNoContent)
 			return
 		}
 
-		// Ensure the lock is released when processing completes
-		defer func() {
-			if err := rl.cache.ReleaseLock(ctx, payload.ChatID); err != nil {
-				logger.Error("failed to release queue lock", "error", err)
-			}
-		}()
-
-		// Restore body for downstream handler (Process needs full JSON).
-		// Do this after WithContext so the request we pass has the body set.
-		ctx = context.WithValue(ctx, payloadKey{}, payload)
-		r = r.WithContext(ctx)
-		r.Body = io.NopCloser(bytes.NewReader(bodyBytes))
-		r.ContentLength = int64(len(bodyBytes))
+		r = r.WithContext(handler.WithRequest(ctx, payload))
 
 		// Pass through to the actual handler
 		next.ServeHTTP(w, r)
@@ -158,19 +106,3 @@ func (rl *RateLimiter) logThrottledMessage(ctx context.Context, chatID int64, us
 		slog.Error("failed to log throttled message", "error", err)
 	}
 }
-
-// payloadKey is a context key for the parsed request payload.
-type payloadKey struct{}
-
-// GetPayload retrieves the parsed payload from the request context.
-func GetPayload(ctx context.Context) (chatID int64, userID *int64, text string, ok bool) {
-	p, exists := ctx.Value(payloadKey{}).(struct {
-		ChatID int64  `json:"chat_id"`
-		UserID *int64 `json:"user_id"`
-		Text   string `json:"text"`
-	})
-	if !exists {
-		return 0, nil, "", false
-	}
-	return p.ChatID, p.UserID, p.Text, true
-}
@@ -0,0 +1,48 @@
+package middleware
+
+import (
+	"net/http"
+	"net/http/httptest"
+	"strings"
+	"testing"
+
+	"github.com/ThatHunky/gryag/backend/internal/config"
+)
+
+func TestMiddleware_RejectsBeforeAdmission(t *testing.T) {
+	// Decode failures are answered before cache or DB are touched
+	rl := NewRateLimiter(nil, nil, &config.Config{MediaMaxBytes: 16})
+	next := http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		t.Error("next handler must not run")
+	})
+
+	cases := []struct {
+		name string
+		body string
+		want int
+	}{
+		{"invalid json", "not json", http.StatusBadRequest},
+		{"body over limit", `{"chat_id": 1, "text": "` + strings.Repeat("x", 2<<20) + `"}`, http.StatusRequestEntityTooLarge},
+	}
+	for _, tc := range cases {
+		w := httptest.NewRecorder()
+		rl.Middleware(next).ServeHTTP(w, httptest.NewRequest("POST", "/api/v1/process", strings.NewReader(tc.body)))
+		if w.Code != tc.want {
+			t.Errorf("%s: expected %d, got %d", tc.name, tc.want, w.Code)
+		}
+	}
+}
+
+func TestMiddleware_WhitelistUsesDecodedPayload(t *testing.T) {
+	rl := NewRateLimiter(nil, nil, &config.Config{AllowedChatIDs: []int64{7}})
+	next := http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		t.Error("next handler must not run")
+	})
+
+	// A chat outside the whitelist is dropped silently
+	w := httptest.NewRecorder()
+	rl.Middleware(next).ServeHTTP(w, httptest.NewRequest("POST", "/api/v1/process", strings.NewReader(`{"chat_id": 8}`)))
+	if w.Code != http.StatusNoContent {
+		t.Errorf("expected silent 204 for chat outside whitelist, got %d", w.Code)
+	}
+}
@@ -0,0 +1,55 @@
+package proactive
+
+import (
+	"math"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+)
+
+// minCandidateActivity keeps chats that have gone silent for days possible picks, just unlikely ones.
+const minCandidateActivity = 0.1
+
+// candidateWeight scores a chat for a proactive turn: its activity now (user messages in about the last
+// day) times how quiet it is right now, 1 - e^(-idle/quiet). A chat mid-conversation scores near zero,
+// a busy chat that has been idle for an hour or more scores highest, and a chat silent for days decays
+// toward minCandidateActivity.
+func candidateWeight(a db.ChatActivity, now time.Time, quiet time.Duration) float64 {
+	idle := now.Sub(a.LastMessageAt)
+	if idle <= 0 {
+		return 0
+	}
+	quietness := 1.0
+	if quiet > 0 {
+		quietness = -math.Expm1(-float64(idle) / float64(quiet))
+	}
+	return (a.ActivityAt(now) + minCandidateActivity) * quietness
+}
+
+// pickCandidate draws one chat with probability proportional to candidateWeight. roll returns a number
+// in [0, 1). ok is false when no chat has any weight.
+func pickCandidate(chats []db.ChatActivity, now time.Time, quiet time.Duration, roll func() float64) (chatID int64, ok bool) {
+	weights := make([]float64, len(chats))
+	total := 0.0
+	for i, c := range chats {
+		weights[i] = candidateWeight(c, now, quiet)
+		total += weights[i]
+	}
+	if total <= 0 {
+		return 0, false
+	}
+	target := roll() * total
+	for i, w := range weights {
+		if target < w {
+			return chats[i].ChatID, true
+		}
+		target -= w
+	}
+	// Rounding left target at the very end
+	for i := len(chats) - 1; i >= 0; i-- {
+		if weights[i] > 0 {
+			return chats[i].ChatID, true
+		}
+	}
+	return 0, false
+}
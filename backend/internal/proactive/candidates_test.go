@@ -0,0 +1,43 @@
+package proactive
+
+import (
+	"testing"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+)
+
+func TestCandidateWeight_PrefersActiveButQuiet(t *testing.T) {
+	now := time.Now()
+	quiet := time.Hour
+	busyNow := db.ChatActivity{ChatID: 1, LastMessageAt: now.Add(-time.Minute), Activity: 50}
+	busyQuiet := db.ChatActivity{ChatID: 2, LastMessageAt: now.Add(-2 * time.Hour), Activity: 50}
+	dead := db.ChatActivity{ChatID: 3, LastMessageAt: now.Add(-6 * 24 * time.Hour), Activity: 50}
+
+	wNow := candidateWeight(busyNow, now, quiet)
+	wQuiet := candidateWeight(busyQuiet, now, quiet)
+	wDead := candidateWeight(dead, now, quiet)
+	if !(wQuiet > wNow && wQuiet > wDead) {
+		t.Errorf("weights: mid-conversation %.3f, active but quiet %.3f, silent %.3f", wNow, wQuiet, wDead)
+	}
+	if wDead <= 0 {
+		t.Errorf("silent chat weight = %v, want > 0", wDead)
+	}
+}
+
+func TestPickCandidate(t *testing.T) {
+	now := time.Now()
+	chats := []db.ChatActivity{
+		{ChatID: 1, LastMessageAt: now.Add(-3 * time.Hour), Activity: 1},
+		{ChatID: 2, LastMessageAt: now.Add(-3 * time.Hour), Activity: 9},
+	}
+	if id, ok := pickCandidate(chats, now, time.Hour, func() float64 { return 0 }); !ok || id != 1 {
+		t.Errorf("roll 0: got %d, %v", id, ok)
+	}
+	if id, ok := pickCandidate(chats, now, time.Hour, func() float64 { return 0.5 }); !ok || id != 2 {
+		t.Errorf("roll 0.5: got %d, %v", id, ok)
+	}
+	if _, ok := pickCandidate(nil, now, time.Hour, func() float64 { return 0 }); ok {
+		t.Error("no chats: want ok = false")
+	}
+}
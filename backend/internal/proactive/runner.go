@@ -2,7 +2,6 @@ package proactive
 
 import (
 	"context"
-	"encoding/json"
 	"log/slog"
 	"math/rand"
 	"time"
@@ -35,20 +34,19 @@ func NewRunner(cfg *config.Config, database *db.DB, llmClient *llm.Client, reg *
 	return &Runner{cfg: cfg, db: database, llm: llmClient, registry: reg, executor: exe, cache: c}
 }
 
-// RunOne picks a recent chat, runs the proactive LLM flow with tools, and pushes a message to the queue if the model replies.
+// RunOne picks a chat (weighted toward active chats that are quiet right now), runs the proactive LLM flow with tools, and pushes a message to the queue if the model replies.
 func (r *Runner) RunOne(ctx context.Context) {
 	logger := slog.With("component", "proactive")
 
-	chatIDs, err := r.db.GetRecentChatIDs(ctx, 7*24*time.Hour)
+	chats, err := r.db.GetChatActivity(ctx, 7*24*time.Hour)
 	if err != nil {
-		logger.Error("get recent chat ids failed", "error", err)
+		logger.Error("get chat activity failed", "error", err)
 		return
 	}
-	if len(chatIDs) == 0 {
+	chatID, ok := pickCandidate(chats, time.Now(), r.cfg.ProactiveQuiet(), rand.Float64)
+	if !ok {
 		return
 	}
-
-	chatID := chatIDs[rand.Intn(len(chatIDs))]
 	messages, err := r.db.GetRecentMessages(ctx, chatID, r.cfg.ImmediateContextSize)
 	if err != nil || len(messages) == 0 {
 		return
@@ -70,12 +68,13 @@ func (r *Runner) RunOne(ctx context.Context) {
 		}
 	}
 
-	di, err := llm.NewDynamicInstructions(ctx, r.db, chatID, userID, username, firstName, "[Proactive turn]", r.cfg.ImmediateContextSize, nil, "")
+	di, err := llm.NewDynamicInstructions(ctx, r.db, r.llm, chatID, userID, username, firstName, "[Proactive turn]", r.cfg.ImmediateContextSize, r.cfg.ContextStageTimeout(), nil, "")
 	if err != nil {
 		logger.Error("dynamic instructions failed", "error", err)
 		return
 	}
-	di.ToolsDescription = r.registry.GetToolDescription()
+	di.StablePrefix = r.cfg.StablePromptLayout()
+	di.TokenBudget = r.cfg.ContextTokenBudget
 
 	parts := di.BuildParts()
 	proactiveText := proactiveBlock
@@ -88,11 +87,10 @@ func (r *Runner) RunOne(ctx context.Context) {
 	contents := []*genai.Content{
 		{Role: "user", Parts: parts},
 	}
-	genaiTools := r.registry.GetTools()
 
 	reply := ""
 	for i := 0; i < 5; i++ {
-		resp, err := r.llm.GenerateResponse(ctx, contents, genaiTools)
+		resp, err := r.llm.GenerateResponse(ctx, contents)
 		if err != nil {
 			logger.Error("proactive generation failed", "error", err)
 			return
@@ -103,25 +101,27 @@ func (r *Runner) RunOne(ctx context.Context) {
 		cand := resp.Candidates[0]
 		contents = append(contents, cand.Content)
 
-		hasToolCall := false
-		var toolResponses []*genai.Part
+		var calls []*genai.FunctionCall
 		for _, part := range cand.Content.Parts {
 			if part.Text != "" {
 				reply += part.Text
 			} else if part.FunctionCall != nil {
-				hasToolCall = true
-				args, _ := json.Marshal(part.FunctionCall.Args)
-				res := r.executor.Execute(ctx, part.FunctionCall.Name, args)
-				payload := map[string]any{"result": res.Output}
-				if res.Error != "" {
-					payload["error"] = res.Error
-				}
-				toolResponses = append(toolResponses, genai.NewPartFromFunctionResponse(part.FunctionCall.Name, payload))
+				calls = append(calls, part.FunctionCall)
 			}
 		}
-		if !hasToolCall {
+		if len(calls) == 0 {
 			break
 		}
+		// Independent calls of one turn run concurrently; responses keep the call order
+		var toolResponses []*genai.Part
+		results := r.executor.ExecuteAll(ctx, calls)
+		for i, res := range results {
+			payload := map[string]any{"result": res.Output}
+			if res.Error != "" {
+				payload["error"] = res.Error
+			}
+			toolResponses = append(toolResponses, genai.NewPartFromFunctionResponse(calls[i].Name, payload))
+		}
 		reply = ""
 		contents = append(contents, &genai.Content{Role: "user", Parts: toolResponses})
 	}
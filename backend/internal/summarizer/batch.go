@@ -0,0 +1,240 @@
+package summarizer
+
+import (
+	"context"
+	"errors"
+	"log/slog"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/llm"
+)
+
+// batchMaxBytes caps the input of one batch job; Gemini accepts up to 20 MB of inline requests.
+const batchMaxBytes = 16 << 20
+
+var errDailyChunks = errors.New("daily summaries failed")
+
+// batchItem is one request of a batch run and the chat it belongs to.
+type batchItem struct {
+	chatID int64
+	day    time.Time // daily chunk requests
+	req    llm.SummaryRequest
+	chunks int // window requests: daily chunks in the digest
+	today  int // window requests: raw messages of the current day
+}
+
+func (it batchItem) ref() batchItemRef {
+	return batchItemRef{ChatID: it.chatID, Day: it.day, Chunks: it.chunks, Today: it.today}
+}
+
+func (ref batchItemRef) item() batchItem {
+	return batchItem{chatID: ref.ChatID, day: ref.Day, chunks: ref.Chunks, today: ref.Today}
+}
+
+// batchQueue collects requests of one round and submits them in jobs of up to batchMaxBytes.
+type batchQueue struct {
+	r      *Runner
+	logger *slog.Logger
+	w      window
+	round  string
+	name   string
+	items  []batchItem
+	bytes  int
+	handle func(window, batchItem, llm.SummaryResult)
+}
+
+func (q *batchQueue) add(ctx context.Context, item batchItem) {
+	q.items = append(q.items, item)
+	q.bytes += len(item.req.Input)
+	if q.bytes >= batchMaxBytes {
+		q.flush(ctx)
+	}
+}
+
+// flush submits the queued requests as one batch job and hands each result to handle. The job is
+// recorded in the checkpoint until its results are handled. When the job cannot be run, the requests
+// go through the synchronous path instead.
+func (q *batchQueue) flush(ctx context.Context) {
+	if len(q.items) == 0 {
+		return
+	}
+	reqs := make([]llm.SummaryRequest, len(q.items))
+	refs := make([]batchItemRef, len(q.items))
+	for i, it := range q.items {
+		reqs[i] = it.req
+		refs[i] = it.ref()
+	}
+	job, err := q.r.llm.SubmitSummaryBatch(ctx, reqs, q.name)
+	var results []llm.SummaryResult
+	if err == nil {
+		q.r.saveBatch(ctx, q.w.summaryType, pendingBatch{Job: job, Round: q.round, Start: q.w.start, End: q.w.end, Items: refs})
+		results, err = q.r.llm.WaitSummaryBatch(ctx, job, len(reqs), q.r.config.SummaryBatchPollInterval())
+	}
+	if err != nil {
+		q.logger.Warn("summary batch failed, falling back to synchronous calls", "requests", len(reqs), "error", err)
+		results = make([]llm.SummaryResult, len(reqs))
+		for i, req := range reqs {
+			if ctx.Err() != nil {
+				results[i].Err = ctx.Err()
+				continue
+			}
+			results[i].Text, results[i].Err = q.r.generate(ctx, req.Input, func() (string, error) {
+				if req.Window {
+					return q.r.llm.SummarizeWindow(ctx, req.Input, req.Label)
+				}
+				return q.r.llm.SummarizeChat(ctx, req.Input, req.Label)
+			})
+		}
+	}
+	for i, it := range q.items {
+		q.handle(q.w, it, results[i])
+	}
+	if job != "" && (ctx.Err() == nil || errors.Is(err, llm.ErrBatchCancelled)) {
+		// Otherwise the job may still be running and the next start re-attaches to it
+		q.r.clearBatch(ctx, q.w.summaryType)
+	}
+	q.items, q.bytes = q.items[:0], 0
+}
+
+// resume waits for the job an interrupted run left behind and hands its results to handle, with the
+// window of the run that submitted it. If the job failed, its requests are simply built again by the
+// rest of the run.
+func (q *batchQueue) resume(ctx context.Context, pb *pendingBatch) {
+	q.logger.Info("re-attaching to summary batch", "job", pb.Job, "round", pb.Round, "requests", len(pb.Items))
+	results, err := q.r.llm.WaitSummaryBatch(ctx, pb.Job, len(pb.Items), q.r.config.SummaryBatchPollInterval())
+	if err != nil {
+		if ctx.Err() != nil && !errors.Is(err, llm.ErrBatchCancelled) {
+			return
+		}
+		q.logger.Warn("resumed summary batch failed, rebuilding its requests", "job", pb.Job, "error", err)
+		q.r.clearBatch(ctx, q.w.summaryType)
+		return
+	}
+	w := q.w
+	w.start, w.end = pb.Start, pb.End
+	for i, ref := range pb.Items {
+		q.handle(w, ref.item(), results[i])
+	}
+	q.r.clearBatch(ctx, q.w.summaryType)
+}
+
+// runBatch summarizes chats through the Gemini Batch API in two rounds: first the missing daily
+// chunks of all chats, then the window summaries built from them. It returns false when ctx ended
+// before every chat was handled. The pending job is kept in the checkpoint: a restart during a round
+// passes it as resumed and it is waited on before the rest is built; a shutdown cancels it.
+func (r *Runner) runBatch(ctx context.Context, logger *slog.Logger, w window, chatIDs []int64, resumed *pendingBatch) bool {
+	limit := r.messageLimit()
+	failed := make(map[int64]bool)
+	created := make(map[int64]int)
+	handled := make(map[int64]bool) // window summaries of a resumed job
+
+	// Round 1: daily chunks
+	chunkQueue := &batchQueue{r: r, logger: logger, w: w, round: roundDaily, name: "gryag-summary-1day-" + w.today.Format(time.DateOnly),
+		handle: func(_ window, it batchItem, res llm.SummaryResult) {
+			if res.Err != nil {
+				logger.Error("daily summary failed", "chat_id", it.chatID, "day", it.day.Format(time.DateOnly), "error", res.Err)
+				failed[it.chatID] = true
+				return
+			}
+			if res.Text == "" {
+				return
+			}
+			if err := r.db.InsertDailySummary(ctx, it.chatID, res.Text, it.day, it.day.AddDate(0, 0, 1)); err != nil {
+				logger.Error("insert daily summary failed", "chat_id", it.chatID, "error", err)
+				failed[it.chatID] = true
+				return
+			}
+			created[it.chatID]++
+		}}
+	windowQueue := &batchQueue{r: r, logger: logger, w: w, round: roundWindow, name: "gryag-summary-" + w.summaryType + "-" + w.today.Format(time.DateOnly),
+		handle: func(w window, it batchItem, res llm.SummaryResult) {
+			handled[it.chatID] = true
+			err := res.Err
+			if err == nil && res.Text != "" {
+				_, err = r.db.InsertChatSummary(ctx, it.chatID, w.summaryType, res.Text, w.start, w.end)
+			}
+			r.metrics.chatCounted(created[it.chatID], err)
+			if err != nil {
+				logger.Error("summarize chat failed", "chat_id", it.chatID, "error", err)
+				return
+			}
+			logger.Info("summary stored", "chat_id", it.chatID, "daily_chunks", it.chunks, "new_chunks", created[it.chatID], "messages_today", it.today)
+			r.checkpoint(ctx, w.summaryType, it.chatID)
+		}}
+
+	// A job left behind by a restart: handle its results before building the rest of the run
+	if resumed != nil {
+		if resumed.Round == roundWindow {
+			windowQueue.resume(ctx, resumed)
+		} else {
+			chunkQueue.resume(ctx, resumed)
+		}
+		if ctx.Err() != nil {
+			return false
+		}
+	}
+
+	for _, chatID := range chatIDs {
+		if ctx.Err() != nil {
+			return false
+		}
+		_, missing, err := r.missingDays(ctx, chatID, w.start, w.today)
+		if err != nil {
+			logger.Error("daily summaries failed", "chat_id", chatID, "error", err)
+			failed[chatID] = true
+			continue
+		}
+		for _, day := range missing {
+			dayLog, err := r.dayLog(ctx, chatID, day, limit)
+			if err != nil {
+				logger.Error("read chat log failed", "chat_id", chatID, "error", err)
+				failed[chatID] = true
+				break
+			}
+			if dayLog.count() > 0 {
+				chunkQueue.add(ctx, batchItem{chatID: chatID, day: day, req: llm.SummaryRequest{Input: dayLog.String(), Label: "1-day"}})
+			}
+		}
+	}
+	chunkQueue.flush(ctx)
+	if ctx.Err() != nil {
+		return false
+	}
+
+	// Round 2: window summaries
+	for _, chatID := range chatIDs {
+		if ctx.Err() != nil {
+			return false
+		}
+		if handled[chatID] {
+			continue
+		}
+		if failed[chatID] {
+			// Without every day the window summary would have gaps; the next run retries.
+			r.metrics.chatCounted(created[chatID], errDailyChunks)
+			continue
+		}
+		chunks, err := r.db.GetDailySummaries(ctx, chatID, w.start, w.today)
+		if err != nil {
+			logger.Error("daily summaries failed", "chat_id", chatID, "error", err)
+			r.metrics.chatCounted(created[chatID], err)
+			continue
+		}
+		tail, err := r.collectChatLog(ctx, chatID, w.today, w.end, limit)
+		if err != nil {
+			logger.Error("read chat log failed", "chat_id", chatID, "error", err)
+			r.metrics.chatCounted(created[chatID], err)
+			continue
+		}
+		digest := windowDigest(chunks, w.today, tail.String())
+		if digest == "" {
+			r.metrics.chatCounted(created[chatID], nil)
+			r.checkpoint(ctx, w.summaryType, chatID)
+			continue
+		}
+		windowQueue.add(ctx, batchItem{chatID: chatID, req: llm.SummaryRequest{Window: true, Input: digest, Label: w.label},
+			chunks: len(chunks), today: tail.count()})
+	}
+	windowQueue.flush(ctx)
+	return ctx.Err() == nil
+}
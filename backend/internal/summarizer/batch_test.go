@@ -0,0 +1,39 @@
+package summarizer
+
+import (
+	"encoding/json"
+	"testing"
+	"time"
+)
+
+func TestPendingBatch_RoundTripKeepsItemsInOrder(t *testing.T) {
+	day := time.Date(2026, 3, 1, 0, 0, 0, 0, time.UTC)
+	items := []batchItem{
+		{chatID: -100, day: day},
+		{chatID: 42, chunks: 6, today: 17},
+	}
+	pb := pendingBatch{Job: "batches/abc", Round: roundWindow, Start: day, End: day.AddDate(0, 0, 7)}
+	for _, it := range items {
+		pb.Items = append(pb.Items, it.ref())
+	}
+	data, err := json.Marshal(pb)
+	if err != nil {
+		t.Fatal(err)
+	}
+	var got pendingBatch
+	if err := json.Unmarshal(data, &got); err != nil {
+		t.Fatal(err)
+	}
+	if got.Job != pb.Job || got.Round != pb.Round || !got.Start.Equal(pb.Start) || !got.End.Equal(pb.End) {
+		t.Errorf("job fields changed: %+v", got)
+	}
+	if len(got.Items) != len(items) {
+		t.Fatalf("expected %d items, got %d", len(items), len(got.Items))
+	}
+	for i, ref := range got.Items {
+		it := ref.item()
+		if it.chatID != items[i].chatID || !it.day.Equal(items[i].day) || it.chunks != items[i].chunks || it.today != items[i].today {
+			t.Errorf("item %d: expected %+v, got %+v", i, items[i], it)
+		}
+	}
+}
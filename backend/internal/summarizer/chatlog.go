@@ -0,0 +1,60 @@
+package summarizer
+
+import (
+	"context"
+	"strings"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+	"github.com/ThatHunky/gryag/backend/internal/llm"
+)
+
+// chatLog collects chat lines newest first until a token or message budget is filled, and renders them
+// oldest first. Whole lines are kept or dropped; the newest messages win.
+type chatLog struct {
+	lines       []string
+	chars       int
+	budget      *llm.TokenBudget
+	maxMessages int
+}
+
+// newChatLog returns an empty log of at most maxTokens estimated tokens (0 = unlimited) and maxMessages
+// lines (0 = unlimited).
+func newChatLog(maxTokens, maxMessages int) *chatLog {
+	return &chatLog{budget: llm.NewTokenBudget(maxTokens), maxMessages: maxMessages}
+}
+
+// add takes the next older line. It returns false once the budget is full and nothing more fits.
+func (l *chatLog) add(line string) bool {
+	if l.maxMessages > 0 && len(l.lines) >= l.maxMessages {
+		return false
+	}
+	if !l.budget.Take(llm.EstimateTokens(line)) {
+		return false
+	}
+	l.lines = append(l.lines, line)
+	l.chars += len(line)
+	return true
+}
+
+func (l *chatLog) count() int { return len(l.lines) }
+
+// String returns the log oldest first.
+func (l *chatLog) String() string {
+	var b strings.Builder
+	b.Grow(l.chars)
+	for i := len(l.lines) - 1; i >= 0; i-- {
+		b.WriteString(l.lines[i])
+	}
+	return b.String()
+}
+
+// collectChatLog reads a chat's window backwards from the newest message and stops as soon as the
+// budget is filled, so only what is sent to the model is loaded.
+func (r *Runner) collectChatLog(ctx context.Context, chatID int64, since, until time.Time, maxMessages int) (*chatLog, error) {
+	log := newChatLog(r.config.SummaryInputTokenBudget, maxMessages)
+	err := r.db.WalkMessagesBackward(ctx, chatID, since, until, func(m db.Message) bool {
+		return log.add(llm.ChatLine(m))
+	})
+	return log, err
+}
@@ -0,0 +1,50 @@
+package summarizer
+
+import (
+	"testing"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+)
+
+func TestChatLogKeepsNewestLinesOldestFirst(t *testing.T) {
+	l := newChatLog(4, 0) // 2 tokens per line
+	// Added newest first, as the backward walk delivers them
+	for _, line := range []string{"c: 3\n", "b: 2\n", "a: 1\n"} {
+		if !l.add(line) {
+			break
+		}
+	}
+	if got, want := l.String(), "b: 2\nc: 3\n"; got != want {
+		t.Fatalf("log = %q, want %q", got, want)
+	}
+	if l.count() != 2 {
+		t.Fatalf("count = %d, want 2", l.count())
+	}
+}
+
+func TestChatLogStopsAtMessageCap(t *testing.T) {
+	l := newChatLog(1000, 2)
+	if !l.add("x\n") || !l.add("y\n") {
+		t.Fatal("lines within the cap were rejected")
+	}
+	if l.add("z\n") {
+		t.Fatal("third line accepted past maxMessages = 2")
+	}
+}
+
+func TestWindowDigest(t *testing.T) {
+	day := func(d int) time.Time { return time.Date(2026, time.October, d, 0, 0, 0, 0, time.UTC) }
+	chunks := []db.ChatSummary{
+		{SummaryText: "Planned the trip.\n", PeriodStart: day(12)},
+		{SummaryText: "Booked tickets.", PeriodStart: day(13)},
+	}
+	got := windowDigest(chunks, day(14), "Anna: packed?\n")
+	want := "[2026-10-12]\nPlanned the trip.\n\n[2026-10-13]\nBooked tickets.\n\n[2026-10-14, messages so far]\nAnna: packed?"
+	if got != want {
+		t.Fatalf("digest =\n%q\nwant\n%q", got, want)
+	}
+	if windowDigest(nil, day(14), "") != "" {
+		t.Fatal("digest of an empty window is not empty")
+	}
+}
@@ -0,0 +1,132 @@
+package summarizer
+
+import (
+	"context"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"log/slog"
+	"strconv"
+	"time"
+
+	"github.com/redis/go-redis/v9"
+)
+
+// checkpointTTL bounds how long an interrupted run can be resumed; after that it starts over.
+const checkpointTTL = 48 * time.Hour
+
+// checkpointStartedField marks a run in progress; the other fields of the hash are finished chat IDs
+// and checkpointBatchField.
+const checkpointStartedField = "started"
+
+func checkpointKey(summaryType string) string {
+	return "summary:checkpoint:" + summaryType
+}
+
+// startCheckpoint opens the checkpoint of a run, or reopens the one an interrupted run left behind,
+// and returns the chats already finished in it.
+func (r *Runner) startCheckpoint(ctx context.Context, summaryType string) (map[int64]bool, error) {
+	key := checkpointKey(summaryType)
+	fields, err := r.cache.Client().HGetAll(ctx, key).Result()
+	if err != nil {
+		return nil, err
+	}
+	done := make(map[int64]bool, len(fields))
+	for f := range fields {
+		if id, err := strconv.ParseInt(f, 10, 64); err == nil {
+			done[id] = true
+		}
+	}
+	if len(fields) == 0 {
+		if err := r.cache.Client().HSet(ctx, key, checkpointStartedField, time.Now().Unix()).Err(); err != nil {
+			return done, err
+		}
+		if err := r.cache.Client().Expire(ctx, key, checkpointTTL).Err(); err != nil {
+			return done, err
+		}
+	}
+	return done, nil
+}
+
+// checkpoint records a finished chat. A failed write only costs redoing that chat after a restart.
+func (r *Runner) checkpoint(ctx context.Context, summaryType string, chatID int64) {
+	if err := r.cache.Client().HSet(ctx, checkpointKey(summaryType), strconv.FormatInt(chatID, 10), 1).Err(); err != nil {
+		slog.Warn("summary checkpoint write failed", "summary_type", summaryType, "chat_id", chatID, "error", err)
+	}
+}
+
+// clearCheckpoint ends a completed run.
+func (r *Runner) clearCheckpoint(ctx context.Context, summaryType string) {
+	if err := r.cache.Client().Del(ctx, checkpointKey(summaryType)).Err(); err != nil {
+		slog.Warn("summary checkpoint clear failed", "summary_type", summaryType, "error", err)
+	}
+}
+
+// Interrupted reports whether a run of the type was left unfinished (e.g. by a restart).
+func (r *Runner) Interrupted(ctx context.Context, summaryType string) (bool, error) {
+	n, err := r.cache.Client().Exists(ctx, checkpointKey(summaryType)).Result()
+	return n > 0, err
+}
+
+// checkpointBatchField holds the batch job the run is waiting on (pendingBatch as JSON). A restart
+// re-attaches to that job instead of submitting the same requests again.
+const checkpointBatchField = "batch"
+
+// Batch rounds of a run (see runBatch).
+const (
+	roundDaily  = "daily"
+	roundWindow = "window"
+)
+
+// pendingBatch is a submitted batch job and the items its results belong to, in request order.
+// Start and End are the window of the run that submitted it.
+type pendingBatch struct {
+	Job   string         `json:"job"`
+	Round string         `json:"round"`
+	Start time.Time      `json:"start"`
+	End   time.Time      `json:"end"`
+	Items []batchItemRef `json:"items"`
+}
+
+// batchItemRef is a batchItem without its request input.
+type batchItemRef struct {
+	ChatID int64     `json:"chat_id"`
+	Day    time.Time `json:"day"`
+	Chunks int       `json:"chunks"`
+	Today  int       `json:"today"`
+}
+
+// saveBatch records a submitted job. If the write fails, a restart submits the requests again.
+func (r *Runner) saveBatch(ctx context.Context, summaryType string, pb pendingBatch) {
+	data, err := json.Marshal(pb)
+	if err == nil {
+		err = r.cache.Client().HSet(ctx, checkpointKey(summaryType), checkpointBatchField, data).Err()
+	}
+	if err != nil {
+		slog.Warn("summary batch checkpoint write failed", "summary_type", summaryType, "job", pb.Job, "error", err)
+	}
+}
+
+// loadBatch returns the job an interrupted run was waiting on, or nil.
+func (r *Runner) loadBatch(ctx context.Context, summaryType string) (*pendingBatch, error) {
+	data, err := r.cache.Client().HGet(ctx, checkpointKey(summaryType), checkpointBatchField).Bytes()
+	if errors.Is(err, redis.Nil) {
+		return nil, nil
+	}
+	if err != nil {
+		return nil, err
+	}
+	var pb pendingBatch
+	if err := json.Unmarshal(data, &pb); err != nil {
+		return nil, fmt.Errorf("decode summary batch checkpoint: %w", err)
+	}
+	return &pb, nil
+}
+
+// clearBatch forgets the job once its results are handled or it is gone. It also runs after ctx was
+// cancelled (a job cancelled at shutdown).
+func (r *Runner) clearBatch(ctx context.Context, summaryType string) {
+	if err := r.cache.Client().HDel(context.WithoutCancel(ctx), checkpointKey(summaryType), checkpointBatchField).Err(); err != nil {
+		slog.Warn("summary batch checkpoint clear failed", "summary_type", summaryType, "error", err)
+	}
+}
@@ -0,0 +1,115 @@
+package summarizer
+
+import (
+	"context"
+	"sync"
+	"time"
+)
+
+// bucket is a token bucket refilled continuously at rate tokens per second up to burst.
+type bucket struct {
+	rate   float64
+	burst  float64
+	tokens float64
+}
+
+func newBucket(perMinute int) *bucket {
+	if perMinute <= 0 {
+		return nil
+	}
+	return &bucket{rate: float64(perMinute) / 60, burst: float64(perMinute), tokens: float64(perMinute)}
+}
+
+func (b *bucket) refill(elapsed time.Duration) {
+	b.tokens += elapsed.Seconds() * b.rate
+	if b.tokens > b.burst {
+		b.tokens = b.burst
+	}
+}
+
+// wait returns how long until n tokens are available (0 = now).
+func (b *bucket) wait(n float64) time.Duration {
+	if n > b.burst {
+		n = b.burst
+	}
+	if b.tokens >= n {
+		return 0
+	}
+	return time.Duration((n - b.tokens) / b.rate * float64(time.Second))
+}
+
+func (b *bucket) take(n float64) {
+	if n > b.burst {
+		n = b.burst
+	}
+	b.tokens -= n
+}
+
+// rateLimiter keeps summarizer Gemini calls within a requests-per-minute and a tokens-per-minute
+// budget, shared by all workers. Either limit may be off (0).
+type rateLimiter struct {
+	mu       sync.Mutex
+	requests *bucket
+	tokens   *bucket
+	last     time.Time
+	now      func() time.Time
+}
+
+func newRateLimiter(rpm, tpm int) *rateLimiter {
+	return &rateLimiter{requests: newBucket(rpm), tokens: newBucket(tpm), now: time.Now}
+}
+
+// reserve takes one request and n tokens if both are available. Otherwise it takes nothing and
+// returns how long to wait before trying again.
+func (l *rateLimiter) reserve(n int) time.Duration {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	now := l.now()
+	if !l.last.IsZero() {
+		elapsed := now.Sub(l.last)
+		for _, b := range []*bucket{l.requests, l.tokens} {
+			if b != nil {
+				b.refill(elapsed)
+			}
+		}
+	}
+	l.last = now
+
+	var d time.Duration
+	if l.requests != nil {
+		d = max(d, l.requests.wait(1))
+	}
+	if l.tokens != nil {
+		d = max(d, l.tokens.wait(float64(n)))
+	}
+	if d > 0 {
+		return d
+	}
+	if l.requests != nil {
+		l.requests.take(1)
+	}
+	if l.tokens != nil {
+		l.tokens.take(float64(n))
+	}
+	return 0
+}
+
+// wait blocks until one request with about n tokens may be sent, or ctx ends. It returns the time
+// spent waiting.
+func (l *rateLimiter) wait(ctx context.Context, n int) (time.Duration, error) {
+	var waited time.Duration
+	for {
+		d := l.reserve(n)
+		if d == 0 {
+			return waited, nil
+		}
+		t := time.NewTimer(d)
+		select {
+		case <-ctx.Done():
+			t.Stop()
+			return waited, ctx.Err()
+		case <-t.C:
+			waited += d
+		}
+	}
+}
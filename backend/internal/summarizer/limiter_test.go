@@ -0,0 +1,53 @@
+package summarizer
+
+import (
+	"testing"
+	"time"
+)
+
+func TestRateLimiterRequestsPerMinute(t *testing.T) {
+	now := time.Unix(0, 0)
+	l := newRateLimiter(60, 0) // one request per second, burst 60
+	l.now = func() time.Time { return now }
+
+	for i := 0; i < 60; i++ {
+		if d := l.reserve(1); d != 0 {
+			t.Fatalf("request %d within burst had to wait %v", i, d)
+		}
+	}
+	if d := l.reserve(1); d <= 0 || d > time.Second {
+		t.Fatalf("request past the burst: wait = %v, want (0, 1s]", d)
+	}
+	now = now.Add(time.Second)
+	if d := l.reserve(1); d != 0 {
+		t.Fatalf("request after refill had to wait %v", d)
+	}
+}
+
+func TestRateLimiterTokensPerMinute(t *testing.T) {
+	now := time.Unix(0, 0)
+	l := newRateLimiter(0, 6000) // 100 tokens per second
+	l.now = func() time.Time { return now }
+
+	if d := l.reserve(6000); d != 0 {
+		t.Fatalf("first request within budget had to wait %v", d)
+	}
+	d := l.reserve(500)
+	if d < 4*time.Second || d > 5*time.Second {
+		t.Fatalf("wait for 500 tokens on an empty bucket = %v, want ~5s", d)
+	}
+	// A request larger than the whole budget waits for a full bucket instead of forever
+	now = now.Add(time.Minute)
+	if d := l.reserve(10_000); d != 0 {
+		t.Fatalf("oversized request on a full bucket had to wait %v", d)
+	}
+}
+
+func TestRateLimiterUnlimited(t *testing.T) {
+	l := newRateLimiter(0, 0)
+	for i := 0; i < 1000; i++ {
+		if d := l.reserve(1_000_000); d != 0 {
+			t.Fatalf("unlimited limiter made request %d wait %v", i, d)
+		}
+	}
+}
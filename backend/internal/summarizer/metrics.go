@@ -0,0 +1,96 @@
+package summarizer
+
+import (
+	"sync"
+	"time"
+)
+
+// Stats is a snapshot of summarizer counters (for the admin stats endpoint).
+type Stats struct {
+	Running       string    `json:"running,omitempty"` // summary type of the run in progress
+	Runs          uint64    `json:"runs"`
+	ChatsDone     uint64    `json:"chats_done"`
+	ChatsFailed   uint64    `json:"chats_failed"`
+	ChatsResumed  uint64    `json:"chats_resumed"` // skipped because an interrupted run had finished them
+	ChatsBatched  uint64    `json:"chats_batched"` // done through the Batch API (not in the timings)
+	DailyChunks   uint64    `json:"daily_chunks"`  // daily chunks created
+	ChatAvgMs     float64   `json:"chat_avg_ms"`
+	ChatMaxMs     float64   `json:"chat_max_ms"`
+	RateWaitMs    float64   `json:"rate_wait_ms"` // total time calls waited for the Gemini rate limit
+	LastRunType   string    `json:"last_run_type,omitempty"`
+	LastRunAt     time.Time `json:"last_run_at"`
+	LastRunTookMs float64   `json:"last_run_ms,omitempty"`
+}
+
+type metrics struct {
+	mu      sync.Mutex
+	s       Stats
+	totalMs float64
+}
+
+func (m *metrics) runStarted(summaryType string, resumed int) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	m.s.Running = summaryType
+	m.s.Runs++
+	m.s.ChatsResumed += uint64(resumed)
+	m.s.LastRunType = summaryType
+	m.s.LastRunAt = time.Now()
+}
+
+func (m *metrics) runFinished(took time.Duration) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	m.s.Running = ""
+	m.s.LastRunTookMs = float64(took.Milliseconds())
+}
+
+func (m *metrics) chatFinished(took time.Duration, chunks int, err error) {
+	ms := float64(took.Microseconds()) / 1000
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if err != nil {
+		m.s.ChatsFailed++
+	} else {
+		m.s.ChatsDone++
+	}
+	m.s.DailyChunks += uint64(chunks)
+	m.totalMs += ms
+	m.s.ChatMaxMs = max(m.s.ChatMaxMs, ms)
+}
+
+// chatCounted counts a chat handled by a batch run, where per-chat timings do not apply.
+func (m *metrics) chatCounted(chunks int, err error) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if err != nil {
+		m.s.ChatsFailed++
+	} else {
+		m.s.ChatsBatched++
+	}
+	m.s.DailyChunks += uint64(chunks)
+}
+
+func (m *metrics) limited(waited time.Duration) {
+	if waited <= 0 {
+		return
+	}
+	m.mu.Lock()
+	m.s.RateWaitMs += float64(waited.Microseconds()) / 1000
+	m.mu.Unlock()
+}
+
+func (m *metrics) snapshot() Stats {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	s := m.s
+	if n := s.ChatsDone; n > 0 {
+		s.ChatAvgMs = m.totalMs / float64(n)
+	}
+	return s
+}
+
+// Stats returns the current summarizer counters.
+func (r *Runner) Stats() Stats {
+	return r.metrics.snapshot()
+}
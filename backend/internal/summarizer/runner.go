@@ -3,8 +3,12 @@ package summarizer
 import (
 	"context"
 	"errors"
+	"fmt"
 	"log/slog"
+	"sort"
 	"strconv"
+	"strings"
+	"sync"
 	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/cache"
@@ -21,77 +25,292 @@ const (
 
 // Runner runs summarization for 7-day or 30-day windows.
 type Runner struct {
-	db     *db.DB
-	cache  *cache.Cache
-	llm    *llm.Client
-	config *config.Config
+	db      *db.DB
+	cache   *cache.Cache
+	llm     *llm.Client
+	config  *config.Config
+	limiter *rateLimiter
+	metrics metrics
 }
 
 // NewRunner creates a summarizer runner.
 func NewRunner(database *db.DB, c *cache.Cache, llmClient *llm.Client, cfg *config.Config) *Runner {
-	return &Runner{db: database, cache: c, llm: llmClient, config: cfg}
+	return &Runner{
+		db: database, cache: c, llm: llmClient, config: cfg,
+		limiter: newRateLimiter(cfg.SummaryMaxRPM, cfg.SummaryMaxTPM),
+	}
+}
+
+// maxWindowDays is the longest summary window; daily chunks older than that are deleted.
+const maxWindowDays = 30
+
+// summaryWindow returns the window length in days and its label for a summary type.
+func summaryWindow(summaryType string) (days int, label string, ok bool) {
+	switch summaryType {
+	case "7day":
+		return 7, "7-day", true
+	case "30day":
+		return 30, "30-day", true
+	}
+	return 0, "", false
 }
 
-// RunOne runs summarization for the given type ("7day" or "30day") for all eligible chats.
-func (r *Runner) RunOne(ctx context.Context, summaryType string) {
+// window is one summary run's period: complete days [start, today) plus today up to end.
+type window struct {
+	summaryType string
+	label       string
+	start       time.Time
+	today       time.Time
+	end         time.Time
+}
+
+// RunOne runs summarization for the given type ("7day" or "30day") for all eligible chats and
+// reports whether the run completed (false when ctx ended first or the type is unknown).
+//
+// Windows are built incrementally: every complete UTC day in the window is summarized once into a
+// daily chunk (db.SummaryTypeDaily) and reused by later runs and by the other window type. The window
+// summary is then made from those chunks plus the raw messages of the current day, so a run only sends
+// the days not summarized yet to the model.
+//
+// Chats are handled by SUMMARY_WORKERS workers sharing one Gemini rate limit. Each finished chat is
+// checkpointed in Redis, so a run interrupted by a restart resumes with the chats not done yet.
+func (r *Runner) RunOne(ctx context.Context, summaryType string) bool {
 	logger := slog.With("component", "summarizer", "summary_type", summaryType)
-	var since time.Duration
-	var windowLabel string
-	var periodStart, periodEnd time.Time
-	if summaryType == "7day" {
-		since = 7 * 24 * time.Hour
-		windowLabel = "7-day"
-		periodEnd = time.Now()
-		periodStart = periodEnd.Add(-since)
-	} else if summaryType == "30day" {
-		since = 30 * 24 * time.Hour
-		windowLabel = "30-day"
-		periodEnd = time.Now()
-		periodStart = periodEnd.Add(-since)
-	} else {
+	days, windowLabel, ok := summaryWindow(summaryType)
+	if !ok {
 		logger.Warn("unknown summary type, skipping")
-		return
+		return false
 	}
+	periodEnd := time.Now()
+	today := dayStart(periodEnd)
+	w := window{summaryType: summaryType, label: windowLabel, start: today.AddDate(0, 0, -days), today: today, end: periodEnd}
 
-	chatIDs, err := r.db.GetRecentChatIDs(ctx, since)
+	chatIDs, err := r.db.GetRecentChatIDs(ctx, w.end.Sub(w.start))
 	if err != nil {
 		logger.Error("failed to get recent chat IDs", "error", err)
-		return
+		return false
 	}
-	if len(chatIDs) == 0 {
-		logger.Info("no chats to summarize")
-		return
+	done, err := r.startCheckpoint(ctx, summaryType)
+	if err != nil {
+		// Still runs, just without resume
+		logger.Warn("summary checkpoint unavailable", "error", err)
+	}
+	pending := make([]int64, 0, len(chatIDs))
+	for _, id := range chatIDs {
+		if !done[id] {
+			pending = append(pending, id)
+		}
+	}
+	if len(done) > 0 {
+		logger.Info("resuming summarization", "done", len(chatIDs)-len(pending), "remaining", len(pending))
+	}
+	r.metrics.runStarted(summaryType, len(chatIDs)-len(pending))
+	started := time.Now()
+
+	// A batch job left behind by a restart is waited on even if the run is small now
+	batch, err := r.loadBatch(ctx, summaryType)
+	if err != nil {
+		logger.Warn("summary batch checkpoint unavailable", "error", err)
 	}
+	var completed bool
+	if batch != nil || (r.config.SummaryBatchMode && len(pending) >= r.config.SummaryBatchMinChats) {
+		logger.Info("summarizing via batch job", "chats", len(pending))
+		completed = r.runBatch(ctx, logger, w, pending, batch)
+	} else {
+		completed = r.runPool(ctx, logger, w, pending)
+	}
+	r.metrics.runFinished(time.Since(started))
+	if !completed {
+		logger.Warn("summarization interrupted, will resume from checkpoint")
+		return false
+	}
+	r.clearCheckpoint(ctx, summaryType)
 
-	limit := r.config.SummaryMaxMessagesPerWindow
-	if limit <= 0 {
-		limit = 2000
+	if n, err := r.db.DeleteDailySummariesBefore(ctx, w.today.AddDate(0, 0, -maxWindowDays)); err != nil {
+		logger.Warn("delete old daily summaries failed", "error", err)
+	} else if n > 0 {
+		logger.Info("deleted old daily summaries", "deleted", n)
 	}
+	logger.Info("summarization finished", "chats", len(chatIDs), "duration_ms", time.Since(started).Milliseconds())
+	return true
+}
 
+// runPool summarizes chats with SUMMARY_WORKERS workers through the synchronous Gemini path. It
+// returns false when ctx ended before every chat was handled.
+func (r *Runner) runPool(ctx context.Context, logger *slog.Logger, w window, chatIDs []int64) bool {
+	workers := r.config.SummaryWorkers
+	if workers <= 0 {
+		workers = 1
+	}
+	queue := make(chan int64)
+	var wg sync.WaitGroup
+	for i := 0; i < min(workers, max(len(chatIDs), 1)); i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for chatID := range queue {
+				r.runChat(ctx, logger, w, chatID)
+			}
+		}()
+	}
+	completed := true
+feed:
 	for _, chatID := range chatIDs {
-		messages, err := r.db.GetMessagesInRange(ctx, chatID, periodStart, periodEnd, limit)
+		select {
+		case queue <- chatID:
+		case <-ctx.Done():
+			completed = false
+			break feed
+		}
+	}
+	close(queue)
+	wg.Wait()
+	return completed && ctx.Err() == nil
+}
+
+// runChat summarizes one chat's window, records its timing and checkpoints it when it succeeded.
+func (r *Runner) runChat(ctx context.Context, logger *slog.Logger, w window, chatID int64) {
+	start := time.Now()
+	created, err := r.summarizeChat(ctx, logger, w, chatID)
+	elapsed := time.Since(start)
+	r.metrics.chatFinished(elapsed, created, err)
+	if err != nil {
+		logger.Error("summarize chat failed", "chat_id", chatID, "duration_ms", elapsed.Milliseconds(), "error", err)
+		return
+	}
+	r.checkpoint(ctx, w.summaryType, chatID)
+}
+
+// summarizeChat builds and stores one chat's window summary. created counts new daily chunks.
+func (r *Runner) summarizeChat(ctx context.Context, logger *slog.Logger, w window, chatID int64) (created int, err error) {
+	limit := r.messageLimit()
+	chunks, created, err := r.ensureDailyChunks(ctx, chatID, w.start, w.today, limit)
+	if err != nil {
+		// Without every day the window summary would have gaps; the next run retries
+		// (chunks stored so far are kept).
+		return created, fmt.Errorf("daily summaries: %w", err)
+	}
+	tail, err := r.collectChatLog(ctx, chatID, w.today, w.end, limit)
+	if err != nil {
+		return created, fmt.Errorf("read chat log: %w", err)
+	}
+	digest := windowDigest(chunks, w.today, tail.String())
+	if digest == "" {
+		return created, nil
+	}
+	summary, err := r.generate(ctx, digest, func() (string, error) {
+		return r.llm.SummarizeWindow(ctx, digest, w.label)
+	})
+	if err != nil {
+		return created, err
+	}
+	if summary == "" {
+		return created, nil
+	}
+	if _, err := r.db.InsertChatSummary(ctx, chatID, w.summaryType, summary, w.start, w.end); err != nil {
+		return created, err
+	}
+	logger.Info("summary stored", "chat_id", chatID, "daily_chunks", len(chunks), "new_chunks", created, "messages_today", tail.count())
+	return created, nil
+}
+
+// messageLimit is the message cap per daily chunk and for the current day.
+func (r *Runner) messageLimit() int {
+	if r.config.SummaryMaxMessagesPerWindow <= 0 {
+		return 2000
+	}
+	return r.config.SummaryMaxMessagesPerWindow
+}
+
+// generate runs one summarization call once the rate limit allows a request of input's size.
+func (r *Runner) generate(ctx context.Context, input string, call func() (string, error)) (string, error) {
+	waited, err := r.limiter.wait(ctx, llm.EstimateTokens(input))
+	r.metrics.limited(waited)
+	if err != nil {
+		return "", err
+	}
+	return call()
+}
+
+// ensureDailyChunks returns the chat's daily chunks for the days in [since, until), oldest first,
+// summarizing the days that have messages but no chunk yet. created counts the new chunks.
+func (r *Runner) ensureDailyChunks(ctx context.Context, chatID int64, since, until time.Time, limit int) (chunks []db.ChatSummary, created int, err error) {
+	stored, missing, err := r.missingDays(ctx, chatID, since, until)
+	if err != nil {
+		return nil, 0, err
+	}
+	for _, day := range missing {
+		dayLog, err := r.dayLog(ctx, chatID, day, limit)
 		if err != nil {
-			logger.Error("get messages in range failed", "chat_id", chatID, "error", err)
-			continue
+			return nil, created, err
 		}
-		if len(messages) == 0 {
+		if dayLog.count() == 0 {
 			continue
 		}
-		summary, err := r.llm.SummarizeChat(ctx, messages, windowLabel)
+		input := dayLog.String()
+		text, err := r.generate(ctx, input, func() (string, error) {
+			return r.llm.SummarizeChat(ctx, input, "1-day")
+		})
 		if err != nil {
-			logger.Error("summarize chat failed", "chat_id", chatID, "error", err)
-			continue
+			return nil, created, fmt.Errorf("summarize %s: %w", day.Format(time.DateOnly), err)
 		}
-		if summary == "" {
+		if text == "" {
 			continue
 		}
-		_, err = r.db.InsertChatSummary(ctx, chatID, summaryType, summary, periodStart, periodEnd)
-		if err != nil {
-			logger.Error("insert chat summary failed", "chat_id", chatID, "error", err)
-			continue
+		next := day.AddDate(0, 0, 1)
+		if err := r.db.InsertDailySummary(ctx, chatID, text, day, next); err != nil {
+			return nil, created, err
+		}
+		created++
+		stored = append(stored, db.ChatSummary{
+			ChatID: chatID, SummaryType: db.SummaryTypeDaily, SummaryText: text, PeriodStart: day, PeriodEnd: next,
+		})
+	}
+	sort.Slice(stored, func(i, j int) bool { return stored[i].PeriodStart.Before(stored[j].PeriodStart) })
+	return stored, created, nil
+}
+
+// missingDays returns the chat's stored daily chunks in [since, until) and the days without one.
+func (r *Runner) missingDays(ctx context.Context, chatID int64, since, until time.Time) (stored []db.ChatSummary, missing []time.Time, err error) {
+	stored, err = r.db.GetDailySummaries(ctx, chatID, since, until)
+	if err != nil {
+		return nil, nil, err
+	}
+	have := make(map[time.Time]bool, len(stored))
+	for _, s := range stored {
+		have[s.PeriodStart.UTC()] = true
+	}
+	for day := since; day.Before(until); day = day.AddDate(0, 0, 1) {
+		if !have[day] {
+			missing = append(missing, day)
 		}
-		logger.Info("summary stored", "chat_id", chatID, "messages", len(messages))
 	}
+	return stored, missing, nil
+}
+
+// dayLog reads the chat log of one UTC day.
+func (r *Runner) dayLog(ctx context.Context, chatID int64, day time.Time, limit int) (*chatLog, error) {
+	// Postgres timestamps have microsecond precision; the walk's upper bound is inclusive.
+	return r.collectChatLog(ctx, chatID, day, day.AddDate(0, 0, 1).Add(-time.Microsecond), limit)
+}
+
+// windowDigest is the input of a window summary: one dated block per daily chunk, then the raw log of
+// the current day. Empty when there is nothing to summarize.
+func windowDigest(chunks []db.ChatSummary, today time.Time, todayLog string) string {
+	var b strings.Builder
+	for _, c := range chunks {
+		fmt.Fprintf(&b, "[%s]\n%s\n\n", c.PeriodStart.UTC().Format(time.DateOnly), strings.TrimSpace(c.SummaryText))
+	}
+	if todayLog != "" {
+		fmt.Fprintf(&b, "[%s, messages so far]\n%s", today.Format(time.DateOnly), todayLog)
+	}
+	return strings.TrimRight(b.String(), "\n")
+}
+
+// dayStart truncates t to the start of its UTC day.
+func dayStart(t time.Time) time.Time {
+	t = t.UTC()
+	return time.Date(t.Year(), t.Month(), t.Day(), 0, 0, 0, 0, time.UTC)
 }
 
 // SetLastRun records the last run time for the given summary type in Redis.
@@ -11,7 +11,7 @@ import (
 const pollInterval = 1 * time.Minute
 
 // Scheduler runs summarization daily at SummaryRunHour (Kyiv). 7-day runs every Summary7DayIntervalDays,
-// 30-day every Summary30DayIntervalDays.
+// 30-day every Summary30DayIntervalDays. A run interrupted by a restart is resumed right at startup.
 func Scheduler(ctx context.Context, r *Runner, cfg *config.Config) {
 	logger := slog.With("component", "summarizer_scheduler")
 	kyiv, err := time.LoadLocation("Europe/Kyiv")
@@ -35,6 +35,20 @@ func Scheduler(ctx context.Context, r *Runner, cfg *config.Config) {
 		interval30 = 12
 	}
 
+	for _, summaryType := range []string{"7day", "30day"} {
+		interrupted, err := r.Interrupted(ctx, summaryType)
+		if err != nil {
+			logger.Warn("check summary checkpoint failed", "summary_type", summaryType, "error", err)
+			continue
+		}
+		if interrupted {
+			logger.Info("resuming interrupted summarization", "summary_type", summaryType)
+			if r.RunOne(ctx, summaryType) {
+				_ = r.SetLastRun(ctx, summaryType)
+			}
+		}
+	}
+
 	for {
 		now := time.Now().In(kyiv)
 		hour := now.Hour()
@@ -50,8 +64,9 @@ func Scheduler(ctx context.Context, r *Runner, cfg *config.Config) {
 			}
 			if run7 {
 				logger.Info("running 7-day summarization")
-				r.RunOne(ctx, "7day")
-				_ = r.SetLastRun(ctx, "7day")
+				if r.RunOne(ctx, "7day") {
+					_ = r.SetLastRun(ctx, "7day")
+				}
 			}
 
 			run30 := false
@@ -64,8 +79,9 @@ func Scheduler(ctx context.Context, r *Runner, cfg *config.Config) {
 			}
 			if run30 {
 				logger.Info("running 30-day summarization")
-				r.RunOne(ctx, "30day")
-				_ = r.SetLastRun(ctx, "30day")
+				if r.RunOne(ctx, "30day") {
+					_ = r.SetLastRun(ctx, "30day")
+				}
 			}
 		}
 
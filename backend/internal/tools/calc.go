@@ -0,0 +1,572 @@
+package tools
+
+import (
+	"errors"
+	"fmt"
+	"math"
+	"math/big"
+	"strconv"
+	"strings"
+	"unicode"
+)
+
+// Native calculator: a small recursive-descent parser for Python-style arithmetic, evaluated exactly
+// with big.Rat (arbitrary-size integers and decimals) and falling back to float64 for transcendental
+// functions. It only knows numbers, operators, a fixed set of math functions and constants, so there is
+// no path to arbitrary code. Expressions it can't handle return errCalcUnsupported and go to the sandbox.
+//
+// Grammar (Python precedence; ** is right-associative and binds tighter than unary minus on its left):
+//
+//	expr   = term { ("+" | "-") term }
+//	term   = unary { ("*" | "/" | "//" | "%") unary }
+//	unary  = ("+" | "-") unary | power
+//	power  = primary [ "**" unary ]
+//	primary = number | name | name "(" [ expr { "," expr } ] ")" | "(" expr ")"
+
+const (
+	calcMaxInputLen   = 1000
+	calcMaxResultBits = 1 << 16 // ~19.7k decimal digits
+	calcMaxExponent   = 1 << 14
+	calcMaxFactorial  = 2000
+	calcFracDigits    = 20 // digits after the point for non-terminating exact results
+)
+
+var (
+	errCalcUnsupported = errors.New("expression not supported by the native calculator")
+	errCalcDivZero     = errors.New("ZeroDivisionError: division by zero")
+	errCalcDomain      = errors.New("ValueError: math domain error")
+)
+
+// calcValue is an exact rational, or an inexact float once a transcendental function was applied.
+type calcValue struct {
+	rat   *big.Rat // nil when inexact
+	float float64
+}
+
+func exact(r *big.Rat) calcValue { return calcValue{rat: r} }
+
+func (v calcValue) toFloat() float64 {
+	if v.rat == nil {
+		return v.float
+	}
+	f, _ := v.rat.Float64()
+	return f
+}
+
+func (v calcValue) isInt() bool { return v.rat != nil && v.rat.IsInt() }
+
+// evalCalculator evaluates expr and returns the formatted result. errCalcUnsupported means the caller
+// should fall back to the sandbox; other errors are user-facing evaluation errors.
+func evalCalculator(expr string) (string, error) {
+	if len(expr) > calcMaxInputLen {
+		return "", errCalcUnsupported
+	}
+	toks, err := calcTokenize(expr)
+	if err != nil {
+		return "", err
+	}
+	p := &calcParser{toks: toks}
+	v, err := p.expr()
+	if err != nil {
+		return "", err
+	}
+	if p.pos != len(p.toks) {
+		return "", errCalcUnsupported
+	}
+	return formatCalcValue(v)
+}
+
+type calcToken struct {
+	kind byte // 'n' number, 'i' identifier, 'o' operator
+	text string
+}
+
+func calcTokenize(s string) ([]calcToken, error) {
+	var toks []calcToken
+	for i := 0; i < len(s); {
+		c := s[i]
+		switch {
+		case c == ' ' || c == '\t' || c == '\n':
+			i++
+		case c >= '0' && c <= '9' || c == '.':
+			j := i
+			for j < len(s) && (s[j] >= '0' && s[j] <= '9' || s[j] == '.' || s[j] == '_') {
+				j++
+			}
+			if j < len(s) && (s[j] == 'e' || s[j] == 'E') {
+				k := j + 1
+				if k < len(s) && (s[k] == '+' || s[k] == '-') {
+					k++
+				}
+				if k < len(s) && s[k] >= '0' && s[k] <= '9' {
+					for k < len(s) && s[k] >= '0' && s[k] <= '9' {
+						k++
+					}
+					j = k
+				}
+			}
+			toks = append(toks, calcToken{'n', strings.ReplaceAll(s[i:j], "_", "")})
+			i = j
+		case c < unicode.MaxASCII && (unicode.IsLetter(rune(c)) || c == '_'):
+			j := i
+			for j < len(s) && s[j] < unicode.MaxASCII && (unicode.IsLetter(rune(s[j])) || unicode.IsDigit(rune(s[j])) || s[j] == '_' || s[j] == '.') {
+				j++
+			}
+			toks = append(toks, calcToken{'i', strings.TrimPrefix(s[i:j], "math.")})
+			i = j
+		case strings.HasPrefix(s[i:], "**") || strings.HasPrefix(s[i:], "//"):
+			toks = append(toks, calcToken{'o', s[i : i+2]})
+			i += 2
+		case strings.IndexByte("+-*/%(),", c) >= 0:
+			toks = append(toks, calcToken{'o', string(c)})
+			i++
+		default:
+			// ^, &, comparisons, strings, ... — let Python decide
+			return nil, errCalcUnsupported
+		}
+	}
+	return toks, nil
+}
+
+type calcParser struct {
+	toks  []calcToken
+	pos   int
+	depth int
+}
+
+func (p *calcParser) peek(op string) bool {
+	return p.pos < len(p.toks) && p.toks[p.pos].kind == 'o' && p.toks[p.pos].text == op
+}
+
+func (p *calcParser) expr() (calcValue, error) {
+	p.depth++
+	defer func() { p.depth-- }()
+	if p.depth > 100 {
+		return calcValue{}, errCalcUnsupported
+	}
+	left, err := p.term()
+	if err != nil {
+		return calcValue{}, err
+	}
+	for p.peek("+") || p.peek("-") {
+		op := p.toks[p.pos].text
+		p.pos++
+		right, err := p.term()
+		if err != nil {
+			return calcValue{}, err
+		}
+		if left, err = calcBinary(op, left, right); err != nil {
+			return calcValue{}, err
+		}
+	}
+	return left, nil
+}
+
+func (p *calcParser) term() (calcValue, error) {
+	left, err := p.unary()
+	if err != nil {
+		return calcValue{}, err
+	}
+	for p.peek("*") || p.peek("/") || p.peek("//") || p.peek("%") {
+		op := p.toks[p.pos].text
+		p.pos++
+		right, err := p.unary()
+		if err != nil {
+			return calcValue{}, err
+		}
+		if left, err = calcBinary(op, left, right); err != nil {
+			return calcValue{}, err
+		}
+	}
+	return left, nil
+}
+
+func (p *calcParser) unary() (calcValue, error) {
+	if p.peek("-") || p.peek("+") {
+		neg := p.toks[p.pos].text == "-"
+		p.pos++
+		p.depth++
+		defer func() { p.depth-- }()
+		if p.depth > 100 {
+			return calcValue{}, errCalcUnsupported
+		}
+		v, err := p.unary()
+		if err != nil || !neg {
+			return v, err
+		}
+		if v.rat != nil {
+			return exact(new(big.Rat).Neg(v.rat)), nil
+		}
+		return calcValue{float: -v.float}, nil
+	}
+	return p.power()
+}
+
+func (p *calcParser) power() (calcValue, error) {
+	base, err := p.primary()
+	if err != nil {
+		return calcValue{}, err
+	}
+	if !p.peek("**") {
+		return base, nil
+	}
+	p.pos++
+	exp, err := p.unary()
+	if err != nil {
+		return calcValue{}, err
+	}
+	return calcPow(base, exp)
+}
+
+func (p *calcParser) primary() (calcValue, error) {
+	if p.pos >= len(p.toks) {
+		return calcValue{}, errCalcUnsupported
+	}
+	tok := p.toks[p.pos]
+	p.pos++
+	switch tok.kind {
+	case 'n':
+		// A literal like 1e999999 would otherwise bypass the result-size checks of the operators
+		if calcExponentTooLarge(tok.text) {
+			return calcValue{}, errCalcUnsupported
+		}
+		r, ok := new(big.Rat).SetString(tok.text)
+		if !ok || ratBits(r) > calcMaxResultBits {
+			return calcValue{}, errCalcUnsupported
+		}
+		return exact(r), nil
+	case 'i':
+		if !p.peek("(") {
+			return calcConstant(tok.text)
+		}
+		p.pos++
+		var args []calcValue
+		for !p.peek(")") {
+			if len(args) > 0 {
+				if !p.peek(",") {
+					return calcValue{}, errCalcUnsupported
+				}
+				p.pos++
+			}
+			v, err := p.expr()
+			if err != nil {
+				return calcValue{}, err
+			}
+			args = append(args, v)
+		}
+		p.pos++
+		return calcCall(tok.text, args)
+	default:
+		if tok.text != "(" {
+			return calcValue{}, errCalcUnsupported
+		}
+		v, err := p.expr()
+		if err != nil {
+			return calcValue{}, err
+		}
+		if !p.peek(")") {
+			return calcValue{}, errCalcUnsupported
+		}
+		p.pos++
+		return v, nil
+	}
+}
+
+func calcBinary(op string, a, b calcValue) (calcValue, error) {
+	if a.rat != nil && b.rat != nil {
+		r := new(big.Rat)
+		switch op {
+		case "+":
+			r.Add(a.rat, b.rat)
+		case "-":
+			r.Sub(a.rat, b.rat)
+		case "*":
+			r.Mul(a.rat, b.rat)
+		case "/", "//", "%":
+			if b.rat.Sign() == 0 {
+				return calcValue{}, errCalcDivZero
+			}
+			r.Quo(a.rat, b.rat)
+			if op != "/" {
+				fl := ratFloor(r)
+				if op == "//" {
+					r = fl
+				} else { // Python: a % b = a - b*floor(a/b), sign follows b
+					r.Sub(a.rat, new(big.Rat).Mul(b.rat, fl))
+				}
+			}
+		}
+		if ratBits(r) > calcMaxResultBits {
+			return calcValue{}, errCalcUnsupported
+		}
+		return exact(r), nil
+	}
+	x, y := a.toFloat(), b.toFloat()
+	switch op {
+	case "+":
+		return calcFloat(x + y)
+	case "-":
+		return calcFloat(x - y)
+	case "*":
+		return calcFloat(x * y)
+	}
+	if y == 0 {
+		return calcValue{}, errCalcDivZero
+	}
+	switch op {
+	case "/":
+		return calcFloat(x / y)
+	case "//":
+		return calcFloat(math.Floor(x / y))
+	default:
+		return calcFloat(x - y*math.Floor(x/y))
+	}
+}
+
+func calcPow(base, exp calcValue) (calcValue, error) {
+	if base.rat != nil && exp.isInt() && exp.rat.Num().IsInt64() {
+		n := exp.rat.Num().Int64()
+		if n > calcMaxExponent || n < -calcMaxExponent {
+			return calcValue{}, errCalcUnsupported
+		}
+		if base.rat.Sign() == 0 && n < 0 {
+			return calcValue{}, errCalcDivZero
+		}
+		abs := n
+		if abs < 0 {
+			abs = -abs
+		}
+		if int64(ratBits(base.rat))*abs > calcMaxResultBits {
+			return calcValue{}, errCalcUnsupported
+		}
+		e := big.NewInt(abs)
+		num := new(big.Int).Exp(base.rat.Num(), e, nil)
+		den := new(big.Int).Exp(base.rat.Denom(), e, nil)
+		if n < 0 {
+			num, den = den, num
+		}
+		return exact(new(big.Rat).SetFrac(num, den)), nil
+	}
+	x, y := base.toFloat(), exp.toFloat()
+	if x < 0 && y != math.Trunc(y) {
+		return calcValue{}, errCalcUnsupported // Python returns a complex number here
+	}
+	return calcFloat(math.Pow(x, y))
+}
+
+func calcConstant(name string) (calcValue, error) {
+	switch name {
+	case "pi":
+		return calcValue{float: math.Pi}, nil
+	case "e":
+		return calcValue{float: math.E}, nil
+	case "tau":
+		return calcValue{float: 2 * math.Pi}, nil
+	case "inf":
+		return calcValue{float: math.Inf(1)}, nil
+	}
+	return calcValue{}, errCalcUnsupported
+}
+
+// calcFuncs1 are the float-valued single-argument functions.
+var calcFuncs1 = map[string]func(float64) float64{
+	"sqrt": math.Sqrt, "exp": math.Exp, "log10": math.Log10, "log2": math.Log2,
+	"sin": math.Sin, "cos": math.Cos, "tan": math.Tan,
+	"asin": math.Asin, "acos": math.Acos, "atan": math.Atan,
+	"sinh": math.Sinh, "cosh": math.Cosh, "tanh": math.Tanh,
+	"degrees": func(x float64) float64 { return x * 180 / math.Pi },
+	"radians": func(x float64) float64 { return x * math.Pi / 180 },
+}
+
+func calcCall(name string, args []calcValue) (calcValue, error) {
+	if f, ok := calcFuncs1[name]; ok {
+		if len(args) != 1 {
+			return calcValue{}, errCalcUnsupported
+		}
+		if name == "sqrt" && args[0].rat != nil {
+			if r, ok := ratSqrt(args[0].rat); ok {
+				return exact(r), nil
+			}
+		}
+		return calcFloat(f(args[0].toFloat()))
+	}
+	switch name {
+	case "log":
+		if len(args) == 1 {
+			return calcFloat(math.Log(args[0].toFloat()))
+		}
+		if len(args) == 2 {
+			return calcFloat(math.Log(args[0].toFloat()) / math.Log(args[1].toFloat()))
+		}
+	case "pow":
+		if len(args) == 2 {
+			return calcPow(args[0], args[1])
+		}
+	case "abs", "fabs":
+		if len(args) == 1 {
+			if args[0].rat != nil {
+				return exact(new(big.Rat).Abs(args[0].rat)), nil
+			}
+			return calcFloat(math.Abs(args[0].float))
+		}
+	case "floor", "ceil", "round", "trunc", "int":
+		if len(args) == 1 {
+			return calcRound(name, args[0])
+		}
+	case "factorial":
+		if len(args) == 1 && args[0].isInt() {
+			n := args[0].rat.Num()
+			if n.Sign() < 0 {
+				return calcValue{}, errors.New("ValueError: factorial() not defined for negative values")
+			}
+			if !n.IsInt64() || n.Int64() > calcMaxFactorial {
+				return calcValue{}, errCalcUnsupported
+			}
+			return exact(new(big.Rat).SetInt(new(big.Int).MulRange(1, n.Int64()))), nil
+		}
+	case "min", "max":
+		if len(args) > 0 {
+			best := args[0]
+			for _, v := range args[1:] {
+				c := calcCompare(v, best)
+				if (name == "min" && c < 0) || (name == "max" && c > 0) {
+					best = v
+				}
+			}
+			return best, nil
+		}
+	}
+	return calcValue{}, errCalcUnsupported
+}
+
+func calcRound(name string, v calcValue) (calcValue, error) {
+	if v.rat == nil {
+		if math.IsNaN(v.float) || math.IsInf(v.float, 0) {
+			return calcValue{}, errCalcUnsupported
+		}
+		v = exact(new(big.Rat).SetFloat64(v.float))
+	}
+	fl := ratFloor(v.rat)
+	switch name {
+	case "floor":
+		return exact(fl), nil
+	case "ceil":
+		if v.rat.IsInt() {
+			return v, nil
+		}
+		return exact(fl.Add(fl, big.NewRat(1, 1))), nil
+	case "trunc", "int":
+		if v.rat.Sign() >= 0 || v.rat.IsInt() {
+			return exact(fl), nil
+		}
+		return exact(fl.Add(fl, big.NewRat(1, 1))), nil
+	}
+	// round: half to even, like Python
+	diff := new(big.Rat).Sub(v.rat, fl)
+	switch diff.Cmp(big.NewRat(1, 2)) {
+	case 1:
+		fl.Add(fl, big.NewRat(1, 1))
+	case 0:
+		if new(big.Int).And(fl.Num(), big.NewInt(1)).Sign() != 0 {
+			fl.Add(fl, big.NewRat(1, 1))
+		}
+	}
+	return exact(fl), nil
+}
+
+func calcCompare(a, b calcValue) int {
+	if a.rat != nil && b.rat != nil {
+		return a.rat.Cmp(b.rat)
+	}
+	x, y := a.toFloat(), b.toFloat()
+	switch {
+	case x < y:
+		return -1
+	case x > y:
+		return 1
+	}
+	return 0
+}
+
+func calcFloat(f float64) (calcValue, error) {
+	if math.IsNaN(f) {
+		return calcValue{}, errCalcDomain
+	}
+	return calcValue{float: f}, nil
+}
+
+// ratFloor returns floor(r) as a new Rat.
+func ratFloor(r *big.Rat) *big.Rat {
+	q := new(big.Int)
+	m := new(big.Int)
+	q.DivMod(r.Num(), r.Denom(), m) // Euclidean: m >= 0, so q is the floor for a positive denominator
+	return new(big.Rat).SetInt(q)
+}
+
+// ratSqrt returns the exact square root of r when numerator and denominator are perfect squares.
+func ratSqrt(r *big.Rat) (*big.Rat, bool) {
+	if r.Sign() < 0 {
+		return nil, false
+	}
+	n, d := new(big.Int).Sqrt(r.Num()), new(big.Int).Sqrt(r.Denom())
+	if new(big.Int).Mul(n, n).Cmp(r.Num()) != 0 || new(big.Int).Mul(d, d).Cmp(r.Denom()) != 0 {
+		return nil, false
+	}
+	return new(big.Rat).SetFrac(n, d), true
+}
+
+// calcExponentTooLarge reports whether a number literal's decimal exponent exceeds calcMaxExponent in
+// magnitude, before big.Rat materializes 10^exp.
+func calcExponentTooLarge(lit string) bool {
+	i := strings.IndexAny(lit, "eE")
+	if i < 0 {
+		return false
+	}
+	exp, err := strconv.Atoi(lit[i+1:])
+	return err != nil || exp > calcMaxExponent || exp < -calcMaxExponent
+}
+
+func ratBits(r *big.Rat) int {
+	return r.Num().BitLen() + r.Denom().BitLen()
+}
+
+// formatCalcValue prints integers in full, terminating decimals exactly, other rationals with
+// calcFracDigits digits after the point plus the exact fraction, and floats in shortest round-trip form.
+func formatCalcValue(v calcValue) (string, error) {
+	if v.rat == nil {
+		switch {
+		case math.IsInf(v.float, 1):
+			return "inf", nil
+		case math.IsInf(v.float, -1):
+			return "-inf", nil
+		}
+		return strconv.FormatFloat(v.float, 'g', -1, 64), nil
+	}
+	if v.rat.IsInt() {
+		return v.rat.Num().String(), nil
+	}
+	// The decimal terminates iff the denominator has no prime factors other than 2 and 5.
+	d := new(big.Int).Set(v.rat.Denom())
+	digits := 0
+	for _, p := range []int64{2, 5} {
+		bp := big.NewInt(p)
+		m := new(big.Int)
+		n := 0
+		for {
+			q, r := new(big.Int).QuoRem(d, bp, m)
+			if r.Sign() != 0 {
+				break
+			}
+			d = q
+			n++
+		}
+		if n > digits {
+			digits = n
+		}
+	}
+	if d.Cmp(big.NewInt(1)) == 0 && digits <= 1000 {
+		return v.rat.FloatString(digits), nil
+	}
+	s := strings.TrimRight(v.rat.FloatString(calcFracDigits), "0")
+	return fmt.Sprintf("%s (exactly %s)", s, v.rat.RatString()), nil
+}
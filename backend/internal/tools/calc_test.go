@@ -0,0 +1,68 @@
+package tools
+
+import (
+	"errors"
+	"strings"
+	"testing"
+)
+
+func TestEvalCalculator(t *testing.T) {
+	cases := map[string]string{
+		"2**10 + 3.14":            "1027.14",
+		"0.1 + 0.2":               "0.3",
+		"2**100":                  "1267650600228229401496703205376",
+		"-2**2":                   "-4",
+		"2**-1":                   "0.5",
+		"7 // 2":                  "3",
+		"-7 // 2":                 "-4",
+		"-7 % 3":                  "2",
+		"(1 + 2) * 3 - 4 / 5":     "8.2",
+		"1/3":                     "0.33333333333333333333 (exactly 1/3)",
+		"sqrt(16)":                "4",
+		"math.sqrt(2)":            "1.4142135623730951",
+		"factorial(25)":           "15511210043330985984000000",
+		"round(2.5) + round(3.5)": "6",
+		"max(1, 7/2, 3)":          "3.5",
+		"log(8, 2)":               "3",
+		"1_000_000 * 3":           "3000000",
+		"1.5e3":                   "1500",
+		"abs(-12.5)":              "12.5",
+		"floor(-1.5) + ceil(1.2)": "0",
+	}
+	for expr, want := range cases {
+		got, err := evalCalculator(expr)
+		if err != nil {
+			t.Errorf("%q: unexpected error: %v", expr, err)
+			continue
+		}
+		if got != want {
+			t.Errorf("%q: got %q, want %q", expr, got, want)
+		}
+	}
+}
+
+func TestEvalCalculator_Errors(t *testing.T) {
+	if _, err := evalCalculator("1/0"); !errors.Is(err, errCalcDivZero) {
+		t.Errorf("expected division by zero, got %v", err)
+	}
+	if _, err := evalCalculator("sqrt(-1)"); !errors.Is(err, errCalcDomain) {
+		t.Errorf("expected domain error, got %v", err)
+	}
+	// Anything outside the grammar goes to the sandbox instead
+	for _, expr := range []string{"__import__('os')", "2^3", "[1,2]", "x + 1", "9**9**9", "1e999999", "1e-999999", "-1e99999999999999999999", "2 +", strings.Repeat("(", 200) + "1" + strings.Repeat(")", 200)} {
+		if _, err := evalCalculator(expr); !errors.Is(err, errCalcUnsupported) {
+			t.Errorf("%q: expected errCalcUnsupported, got %v", expr, err)
+		}
+	}
+	if out, err := evalCalculator("1e300 * 2"); err != nil || !strings.HasPrefix(out, "2") {
+		t.Errorf("1e300 * 2: got %q, %v", out, err)
+	}
+}
+
+func BenchmarkEvalCalculator(b *testing.B) {
+	for i := 0; i < b.N; i++ {
+		if _, err := evalCalculator("(2**64 + 17) * 3.5 / 7 - sqrt(144)"); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
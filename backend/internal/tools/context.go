@@ -1,7 +1,7 @@
 package tools
 
-// RequestMediaBase64Key is the context key for the current request's media (base64) when the user sent an attachment.
+// RequestMediaKey is the context key for the current request's attachment bytes ([]byte) when the user sent one.
 // Used by edit_image with use_context_image to get the image from the current message.
-var RequestMediaBase64Key = &requestMediaKeyType{}
+var RequestMediaKey = &requestMediaKeyType{}
 
-type requestMediaKeyType struct{}
\ No newline at end of file
+type requestMediaKeyType struct{}
@@ -3,13 +3,18 @@ package tools
 import (
 	"context"
 	"encoding/json"
+	"errors"
 	"fmt"
 	"log/slog"
+	"sync"
+	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/config"
 	"github.com/ThatHunky/gryag/backend/internal/db"
 	"github.com/ThatHunky/gryag/backend/internal/i18n"
 	"github.com/ThatHunky/gryag/backend/internal/llm"
+	"github.com/ThatHunky/gryag/backend/internal/metrics"
+	"google.golang.org/genai"
 )
 
 // Executor dispatches tool calls from the LLM to their concrete implementations.
@@ -21,7 +26,7 @@ type Executor struct {
 	config    *config.Config
 	i18n      *i18n.Bundle
 	lang      string
-	llmClient *llm.Client // optional; used for search_web (Gemini Grounding)
+	llmClient *llm.Client // optional; used for search_web (Gemini Grounding) and semantic search_messages
 }
 
 // NewExecutor creates a new tool executor with all implementations wired up.
@@ -29,7 +34,7 @@ type Executor struct {
 func NewExecutor(cfg *config.Config, database *db.DB, bundle *i18n.Bundle, llmClient *llm.Client) *Executor {
 	return &Executor{
 		memory:    NewMemoryTool(database, bundle, cfg.DefaultLang),
-		imageGen:  NewImageGenTool(cfg, database),
+		imageGen:  NewImageGenTool(cfg, database, llmClient.GenAI()),
 		sandbox:   NewSandboxTool(cfg),
 		db:        database,
 		config:    cfg,
@@ -39,6 +44,53 @@ func NewExecutor(cfg *config.Config, database *db.DB, bundle *i18n.Bundle, llmCl
 	}
 }
 
+// StartSandboxPool starts the warm sandbox container pool when sandboxing is enabled.
+func (e *Executor) StartSandboxPool() {
+	if e.config.EnableSandbox {
+		e.sandbox.StartPool()
+	}
+}
+
+// SandboxPoolStats returns the warm sandbox pool counters (nil when the pool is disabled).
+func (e *Executor) SandboxPoolStats() *SandboxPoolStats {
+	return e.sandbox.PoolStats()
+}
+
+// Close releases executor resources (warm sandbox containers).
+func (e *Executor) Close() {
+	e.sandbox.Close()
+}
+
+// ExecuteAll runs the function calls of one model turn concurrently, at most ToolMaxParallel at a time,
+// and returns their results in call order. Each call keeps Execute's own panic boundary.
+func (e *Executor) ExecuteAll(ctx context.Context, calls []*genai.FunctionCall) []*ToolResult {
+	results := make([]*ToolResult, len(calls))
+	if len(calls) == 1 {
+		args, _ := json.Marshal(calls[0].Args)
+		results[0] = e.Execute(ctx, calls[0].Name, args)
+		return results
+	}
+
+	limit := e.config.ToolMaxParallel
+	if limit <= 0 {
+		limit = 1
+	}
+	sem := make(chan struct{}, limit)
+	var wg sync.WaitGroup
+	for i, fc := range calls {
+		wg.Add(1)
+		sem <- struct{}{}
+		go func(i int, fc *genai.FunctionCall) {
+			defer wg.Done()
+			defer func() { <-sem }()
+			args, _ := json.Marshal(fc.Args)
+			results[i] = e.Execute(ctx, fc.Name, args)
+		}(i, fc)
+	}
+	wg.Wait()
+	return results
+}
+
 // ToolResult holds the result of a tool execution.
 type ToolResult struct {
 	Name   string `json:"name"`
@@ -56,11 +108,21 @@ func (e *Executor) t(key string, args ...string) string {
 
 // Execute runs a tool by name with the given arguments (JSON).
 // Each tool execution is wrapped in an isolated error boundary (Section 15.3).
-func (e *Executor) Execute(ctx context.Context, name string, args json.RawMessage) *ToolResult {
+func (e *Executor) Execute(ctx context.Context, name string, args json.RawMessage) (result *ToolResult) {
 	logger := slog.With("tool", name)
 	logger.Info("executing tool", "args_length", len(args))
 
-	result := &ToolResult{Name: name}
+	result = &ToolResult{Name: name}
+
+	// Registered first so it runs last, after a recovered panic has set result.Error
+	start, label := time.Now(), name
+	defer func() {
+		outcome := "ok"
+		if result.Error != "" {
+			outcome = "error"
+		}
+		metrics.ToolDuration.With(label, outcome).Since(start)
+	}()
 
 	// Recover from panics — feature isolation per Section 15.3
 	defer func() {
@@ -114,6 +176,9 @@ func (e *Executor) Execute(ctx context.Context, name string, args json.RawMessag
 				params.Limit = 10
 			}
 			results, searchErr := e.db.SearchMessages(ctx, params.ChatID, params.Query, params.Limit)
+			if searchErr == nil && e.llmClient.EmbeddingsEnabled() {
+				results = e.withSemanticMatches(ctx, params.ChatID, params.Query, params.Limit, results)
+			}
 			if searchErr != nil {
 				err = searchErr
 			} else if len(results) == 0 {
@@ -144,15 +209,24 @@ func (e *Executor) Execute(ctx context.Context, name string, args json.RawMessag
 			err = jsonErr
 		}
 
-	// Calculator — evaluated via sandbox for safety
+	// Calculator — evaluated natively; the sandbox only runs expressions the native evaluator rejects
 	case "calculator":
 		var params struct {
 			Expression string `json:"expression"`
 		}
 		if jsonErr := json.Unmarshal(args, &params); jsonErr == nil {
-			code := fmt.Sprintf("print(eval(%q))", params.Expression)
-			codeArgs, _ := json.Marshal(map[string]string{"code": code})
-			output, err = e.sandbox.RunPythonCode(ctx, codeArgs)
+			// Native evaluator first (exact big-number arithmetic, no container); the sandbox only
+			// sees expressions it doesn't support.
+			var calcErr error
+			output, calcErr = evalCalculator(params.Expression)
+			if errors.Is(calcErr, errCalcUnsupported) {
+				logger.Info("calculator falling back to sandbox")
+				code := fmt.Sprintf("print(eval(%q))", params.Expression)
+				codeArgs, _ := json.Marshal(map[string]string{"code": code})
+				output, err = e.sandbox.RunPythonCode(ctx, codeArgs)
+			} else if calcErr != nil {
+				output = calcErr.Error()
+			}
 		} else {
 			err = jsonErr
 		}
@@ -180,6 +254,7 @@ func (e *Executor) Execute(ctx context.Context, name string, args json.RawMessag
 		}
 
 	default:
+		label = "unknown" // names come from the model; keep them out of the metric labels
 		result.Error = e.t("tool.unknown", name)
 		return result
 	}
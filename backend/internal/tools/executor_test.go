@@ -7,6 +7,7 @@ import (
 	"testing"
 
 	"github.com/ThatHunky/gryag/backend/internal/config"
+	"google.golang.org/genai"
 )
 
 func TestExecutor_UnknownTool(t *testing.T) {
@@ -65,3 +66,37 @@ func TestExecutor_DisabledImageGen(t *testing.T) {
 	}
 }
 
+func TestExecutor_ExecuteAllKeepsCallOrder(t *testing.T) {
+	os.Setenv("GEMINI_API_KEY", "test-key")
+	os.Setenv("TOOL_MAX_PARALLEL", "2")
+	defer func() {
+		os.Unsetenv("GEMINI_API_KEY")
+		os.Unsetenv("TOOL_MAX_PARALLEL")
+	}()
+	cfg, _ := config.Load()
+
+	executor := NewExecutor(cfg, nil, nil, nil)
+	calls := []*genai.FunctionCall{
+		{Name: "calculator", Args: map[string]any{"expression": "1+1"}},
+		// nil DB makes the memory tool panic; only this call may fail
+		{Name: "recall_memories", Args: map[string]any{"user_id": 1, "chat_id": 1}},
+		{Name: "nonexistent_tool"},
+		{Name: "calculator", Args: map[string]any{"expression": "2*3"}},
+	}
+	results := executor.ExecuteAll(context.Background(), calls)
+
+	if len(results) != len(calls) {
+		t.Fatalf("expected %d results, got %d", len(calls), len(results))
+	}
+	for i, res := range results {
+		if res.Name != calls[i].Name {
+			t.Errorf("result %d: expected %s, got %s", i, calls[i].Name, res.Name)
+		}
+	}
+	if results[0].Output != "2" || results[3].Output != "6" {
+		t.Errorf("unexpected calculator outputs: %q, %q", results[0].Output, results[3].Output)
+	}
+	if results[1].Error == "" || results[2].Error == "" {
+		t.Error("expected errors for the panicking and the unknown tool")
+	}
+}
@@ -4,27 +4,120 @@ import (
 	"context"
 	"encoding/base64"
 	"encoding/json"
+	"errors"
 	"fmt"
 	"log/slog"
-	"os"
+	"sync"
+	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/config"
 	"github.com/ThatHunky/gryag/backend/internal/db"
 	"google.golang.org/genai"
 )
 
+// imageModel is the Gemini model used for image generation and editing.
+const imageModel = "gemini-3-pro-image-preview"
+
+// imageBusyMessage is returned to the model when the image queue deadline passes.
+const imageBusyMessage = "Image generation is busy right now (too many requests in progress). Ask the user to try again in a minute."
+
 // ImageGenTool handles image generation and editing via Gemini 3 Pro Image.
+// Requests share one genai client (pooled keep-alive connections) and a process-wide concurrency limit:
+// at most ImageGenMaxConcurrent image calls run at once, others wait up to ImageGenQueueTimeoutSec,
+// so a burst of image prompts cannot tie up the chat path.
 type ImageGenTool struct {
 	config *config.Config
 	db     *db.DB
+
+	clientOnce sync.Once
+	client     *genai.Client
+	clientErr  error
+
+	slots     chan struct{}
+	queueWait time.Duration
+}
+
+// NewImageGenTool creates a new image generation tool. client is the process's shared genai client
+// (llm.Client.GenAI); when nil, one is created on first use and reused afterwards.
+func NewImageGenTool(cfg *config.Config, database *db.DB, client *genai.Client) *ImageGenTool {
+	maxConcurrent := cfg.ImageGenMaxConcurrent
+	if maxConcurrent <= 0 {
+		maxConcurrent = 1
+	}
+	ig := &ImageGenTool{
+		config:    cfg,
+		db:        database,
+		slots:     make(chan struct{}, maxConcurrent),
+		queueWait: time.Duration(cfg.ImageGenQueueTimeoutSec) * time.Second,
+	}
+	if client != nil {
+		ig.clientOnce.Do(func() { ig.client = client })
+	}
+	return ig
+}
+
+// genaiClient returns the shared client, creating it once if none was injected.
+func (ig *ImageGenTool) genaiClient(ctx context.Context) (*genai.Client, error) {
+	ig.clientOnce.Do(func() {
+		ig.client, ig.clientErr = genai.NewClient(ctx, &genai.ClientConfig{
+			APIKey:      ig.config.GeminiAPIKey,
+			Backend:     genai.BackendGeminiAPI,
+			HTTPOptions: genai.HTTPOptions{BaseURL: ig.config.GeminiBaseURL},
+		})
+	})
+	if ig.clientErr != nil {
+		return nil, fmt.Errorf("genai client: %w", ig.clientErr)
+	}
+	return ig.client, nil
 }
 
-// NewImageGenTool creates a new image generation tool.
-func NewImageGenTool(cfg *config.Config, database *db.DB) *ImageGenTool {
-	return &ImageGenTool{
-		config: cfg,
-		db:     database,
+// errImageQueueTimeout is returned by acquire when no slot freed up within the queue deadline.
+var errImageQueueTimeout = errors.New("image generation queue timeout")
+
+// acquire takes an image-generation slot, waiting up to queueWait (0 = as long as ctx allows).
+// The returned func releases the slot.
+func (ig *ImageGenTool) acquire(ctx context.Context) (func(), error) {
+	release := func() { <-ig.slots }
+	select {
+	case ig.slots <- struct{}{}:
+		return release, nil
+	default:
+	}
+
+	start := time.Now()
+	var timeout <-chan time.Time
+	if ig.queueWait > 0 {
+		timer := time.NewTimer(ig.queueWait)
+		defer timer.Stop()
+		timeout = timer.C
+	}
+	select {
+	case ig.slots <- struct{}{}:
+		slog.Info("image generation slot acquired after queueing", "waited_ms", time.Since(start).Milliseconds())
+		return release, nil
+	case <-timeout:
+		slog.Warn("image generation queue timeout", "waited_ms", time.Since(start).Milliseconds())
+		return nil, errImageQueueTimeout
+	case <-ctx.Done():
+		return nil, ctx.Err()
+	}
+}
+
+// generate runs one image model call under the concurrency limit.
+func (ig *ImageGenTool) generate(ctx context.Context, parts []*genai.Part, genConfig *genai.GenerateContentConfig) (*genai.GenerateContentResponse, error) {
+	release, err := ig.acquire(ctx)
+	if err != nil {
+		return nil, err
+	}
+	defer release()
+
+	client, err := ig.genaiClient(ctx)
+	if err != nil {
+		return nil, err
 	}
+	return client.Models.GenerateContent(ctx, imageModel, []*genai.Content{
+		{Role: "user", Parts: parts},
+	}, genConfig)
 }
 
 // allowedAspectRatios are the values supported by the Gemini image API (including 4:5, 5:4 per flexible ratios).
@@ -54,14 +147,6 @@ func (ig *ImageGenTool) GenerateImage(ctx context.Context, args json.RawMessage)
 		return "Image generation is not configured. Set GEMINI_API_KEY.", nil
 	}
 
-	client, err := genai.NewClient(ctx, &genai.ClientConfig{
-		APIKey:  ig.config.GeminiAPIKey,
-		Backend: genai.BackendGeminiAPI,
-	})
-	if err != nil {
-		return "", fmt.Errorf("genai client: %w", err)
-	}
-
 	genConfig := &genai.GenerateContentConfig{}
 	if params.AspectRatio != "" {
 		if allowedAspectRatios[params.AspectRatio] {
@@ -71,13 +156,10 @@ func (ig *ImageGenTool) GenerateImage(ctx context.Context, args json.RawMessage)
 		}
 	}
 
-	resp, err := client.Models.GenerateContent(ctx, "gemini-3-pro-image-preview", []*genai.Content{
-		{
-			Role:  "user",
-			Parts: []*genai.Part{genai.NewPartFromText(params.Prompt)},
-		},
-	}, genConfig)
-
+	resp, err := ig.generate(ctx, []*genai.Part{genai.NewPartFromText(params.Prompt)}, genConfig)
+	if errors.Is(err, errImageQueueTimeout) {
+		return imageBusyMessage, nil
+	}
 	if err != nil {
 		return "", fmt.Errorf("image gen API call failed: %w", err)
 	}
@@ -101,11 +183,11 @@ func (ig *ImageGenTool) GenerateImage(ctx context.Context, args json.RawMessage)
 // EditImage edits an image: from context (use_context_image) or from media_cache (media_id).
 func (ig *ImageGenTool) EditImage(ctx context.Context, args json.RawMessage) (string, error) {
 	var params struct {
-		MediaID          string `json:"media_id"`
-		UseContextImage  bool   `json:"use_context_image"`
-		Prompt           string `json:"prompt"`
-		AspectRatio      string `json:"aspect_ratio"`
-		AsDocument       bool   `json:"as_document"`
+		MediaID         string `json:"media_id"`
+		UseContextImage bool   `json:"use_context_image"`
+		Prompt          string `json:"prompt"`
+		AspectRatio     string `json:"aspect_ratio"`
+		AsDocument      bool   `json:"as_document"`
 	}
 	if err := json.Unmarshal(args, &params); err != nil {
 		return "", fmt.Errorf("parse args: %w", err)
@@ -113,19 +195,11 @@ func (ig *ImageGenTool) EditImage(ctx context.Context, args json.RawMessage) (st
 
 	var imageData []byte
 	if params.UseContextImage {
-		v := ctx.Value(RequestMediaBase64Key)
-		if v == nil {
+		data, ok := ctx.Value(RequestMediaKey).([]byte)
+		if !ok || len(data) == 0 {
 			return "No image attached to this message. Attach a photo and ask again.", nil
 		}
-		b64, ok := v.(string)
-		if !ok || b64 == "" {
-			return "No image attached to this message. Attach a photo and ask again.", nil
-		}
-		var err error
-		imageData, err = base64.StdEncoding.DecodeString(b64)
-		if err != nil {
-			return "", fmt.Errorf("decode context image: %w", err)
-		}
+		imageData = data
 	} else if params.MediaID != "" && ig.db != nil {
 		entry, err := ig.db.GetMediaCacheByID(ctx, params.MediaID)
 		if err != nil {
@@ -134,7 +208,7 @@ func (ig *ImageGenTool) EditImage(ctx context.Context, args json.RawMessage) (st
 		if entry == nil {
 			return "That image is no longer available for editing (expired or invalid media_id).", nil
 		}
-		imageData, err = os.ReadFile(entry.FilePath)
+		imageData, err = ig.db.ReadMedia(entry)
 		if err != nil {
 			return "", fmt.Errorf("read cached image: %w", err)
 		}
@@ -146,14 +220,6 @@ func (ig *ImageGenTool) EditImage(ctx context.Context, args json.RawMessage) (st
 		return "Image generation is not configured. Set GEMINI_API_KEY.", nil
 	}
 
-	client, err := genai.NewClient(ctx, &genai.ClientConfig{
-		APIKey:  ig.config.GeminiAPIKey,
-		Backend: genai.BackendGeminiAPI,
-	})
-	if err != nil {
-		return "", fmt.Errorf("genai client: %w", err)
-	}
-
 	genConfig := &genai.GenerateContentConfig{}
 	if params.AspectRatio != "" && allowedAspectRatios[params.AspectRatio] {
 		genConfig.ImageConfig = &genai.ImageConfig{AspectRatio: params.AspectRatio}
@@ -164,9 +230,10 @@ func (ig *ImageGenTool) EditImage(ctx context.Context, args json.RawMessage) (st
 		genai.NewPartFromBytes(imageData, "image/png"),
 		genai.NewPartFromText(params.Prompt),
 	}
-	resp, err := client.Models.GenerateContent(ctx, "gemini-3-pro-image-preview", []*genai.Content{
-		{Role: "user", Parts: parts},
-	}, genConfig)
+	resp, err := ig.generate(ctx, parts, genConfig)
+	if errors.Is(err, errImageQueueTimeout) {
+		return imageBusyMessage, nil
+	}
 	if err != nil {
 		return "", fmt.Errorf("image edit API call failed: %w", err)
 	}
@@ -3,7 +3,9 @@ package tools
 import (
 	"context"
 	"encoding/json"
+	"errors"
 	"testing"
+	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/config"
 )
@@ -22,7 +24,7 @@ func TestAllowedAspectRatios(t *testing.T) {
 
 func TestGenerateImage_OptionalAspectRatio(t *testing.T) {
 	cfg := &config.Config{GeminiAPIKey: ""} // no key -> no API call
-	ig := NewImageGenTool(cfg, nil)
+	ig := NewImageGenTool(cfg, nil, nil)
 	ctx := context.Background()
 
 	// With valid aspect_ratio: parsing succeeds, we get "not configured" (no panic)
@@ -68,7 +70,7 @@ func TestGenerateImage_OptionalAspectRatio(t *testing.T) {
 
 func TestEditImage_ParsesAspectRatio(t *testing.T) {
 	cfg := &config.Config{}
-	ig := NewImageGenTool(cfg, nil)
+	ig := NewImageGenTool(cfg, nil, nil)
 	ctx := context.Background()
 
 	// With media_id but no db, we get a message that we need either media_id (with cache) or use_context_image
@@ -81,3 +83,36 @@ func TestEditImage_ParsesAspectRatio(t *testing.T) {
 		t.Errorf("unexpected output: %s", out)
 	}
 }
+
+func TestImageGenTool_ConcurrencyLimit(t *testing.T) {
+	cfg := &config.Config{ImageGenMaxConcurrent: 1, ImageGenQueueTimeoutSec: 0}
+	ig := NewImageGenTool(cfg, nil, nil)
+	ig.queueWait = 20 * time.Millisecond
+	ctx := context.Background()
+
+	release, err := ig.acquire(ctx)
+	if err != nil {
+		t.Fatalf("expected first slot, got %v", err)
+	}
+	if _, err := ig.acquire(ctx); !errors.Is(err, errImageQueueTimeout) {
+		t.Errorf("expected queue timeout while the only slot is taken, got %v", err)
+	}
+
+	// A waiter gets the slot as soon as it is released
+	go func() {
+		time.Sleep(5 * time.Millisecond)
+		release()
+	}()
+	release2, err := ig.acquire(ctx)
+	if err != nil {
+		t.Fatalf("expected slot after release, got %v", err)
+	}
+	release2()
+
+	cancelled, cancel := context.WithCancel(ctx)
+	cancel()
+	ig.slots <- struct{}{}
+	if _, err := ig.acquire(cancelled); !errors.Is(err, context.Canceled) {
+		t.Errorf("expected context error for a cancelled waiter, got %v", err)
+	}
+}
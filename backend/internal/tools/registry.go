@@ -1,6 +1,9 @@
 package tools
 
 import (
+	"sort"
+	"strings"
+
 	"github.com/ThatHunky/gryag/backend/internal/config"
 	"google.golang.org/genai"
 )
@@ -154,14 +157,16 @@ func (r *Registry) register(name string, decl *genai.FunctionDeclaration) {
 }
 
 // GetTools returns all registered tools as a genai.Tool array for the API call.
+// Declarations are ordered by name so the request prefix is identical across calls (prompt caching).
 func (r *Registry) GetTools() []*genai.Tool {
 	if len(r.tools) == 0 {
 		return nil
 	}
 
-	var decls []*genai.FunctionDeclaration
-	for _, d := range r.tools {
-		decls = append(decls, d)
+	names := r.GetToolNames()
+	decls := make([]*genai.FunctionDeclaration, 0, len(names))
+	for _, name := range names {
+		decls = append(decls, r.tools[name])
 	}
 
 	// Only our own function declarations; no proprietary Gemini tools (e.g. Google Search).
@@ -170,23 +175,24 @@ func (r *Registry) GetTools() []*genai.Tool {
 	}
 }
 
-// GetToolNames returns the names of all registered tools (for building the tools block text).
+// GetToolNames returns the names of all registered tools, sorted (for building the tools block text).
 func (r *Registry) GetToolNames() []string {
 	names := make([]string, 0, len(r.tools))
 	for name := range r.tools {
 		names = append(names, name)
 	}
+	sort.Strings(names)
 	return names
 }
 
-// GetToolDescription returns a human-readable description of all tools
-// for injection into the Dynamic Instructions tools block.
+// GetToolDescription returns a human-readable description of all tools (sorted by name)
+// for injection into the static prompt prefix.
 func (r *Registry) GetToolDescription() string {
-	desc := ""
-	for name, decl := range r.tools {
-		desc += "- " + name + ": " + decl.Description + "\n"
+	var b strings.Builder
+	for _, name := range r.GetToolNames() {
+		b.WriteString("- " + name + ": " + r.tools[name].Description + "\n")
 	}
-	return desc
+	return b.String()
 }
 
 // HasTool checks if a specific tool is registered.
@@ -1,13 +1,11 @@
 package tools
 
 import (
-	"bytes"
 	"context"
 	"encoding/json"
+	"errors"
 	"fmt"
 	"log/slog"
-	"os/exec"
-	"strings"
 	"time"
 
 	"github.com/ThatHunky/gryag/backend/internal/config"
@@ -16,11 +14,45 @@ import (
 // SandboxTool handles secure Python code execution in the sandbox container.
 type SandboxTool struct {
 	config *config.Config
+	pool   *sandboxPool // nil = one-shot `docker run --rm` per call
+	docker dockerFunc
 }
 
 // NewSandboxTool creates a new sandbox tool.
 func NewSandboxTool(cfg *config.Config) *SandboxTool {
-	return &SandboxTool{config: cfg}
+	return &SandboxTool{config: cfg, docker: runDocker}
+}
+
+// StartPool starts the warm container pool (SANDBOX_POOL_SIZE > 0). Runs fall back to one-shot
+// containers when no warm worker is free within SANDBOX_POOL_WAIT_MS.
+func (s *SandboxTool) StartPool() {
+	if s.config.SandboxPoolSize <= 0 || s.pool != nil {
+		return
+	}
+	s.pool = newSandboxPool(
+		s.config.SandboxPoolSize,
+		s.config.SandboxPoolMaxRuns,
+		time.Duration(s.config.SandboxPoolWaitMS)*time.Millisecond,
+		sandboxIsolationArgs(s.config.SandboxMaxMemoryMB, s.config.SandboxTimeoutSeconds),
+		s.docker,
+	)
+	s.pool.start()
+}
+
+// Close removes the pool's idle containers.
+func (s *SandboxTool) Close() {
+	if s.pool != nil {
+		s.pool.close()
+	}
+}
+
+// PoolStats returns the warm pool counters, or nil when the pool is disabled.
+func (s *SandboxTool) PoolStats() *SandboxPoolStats {
+	if s.pool == nil {
+		return nil
+	}
+	st := s.pool.stats()
+	return &st
 }
 
 // RunPythonCode executes Python code in the locked-down sandbox container.
@@ -39,44 +71,31 @@ func (s *SandboxTool) RunPythonCode(ctx context.Context, args json.RawMessage) (
 	ctx, cancel := context.WithTimeout(ctx, timeout+5*time.Second)
 	defer cancel()
 
-	// Execute via docker run with the pre-built sandbox image.
-	// --rm: auto-remove container after execution
-	// --network none: zero network access (defense in depth)
-	// --read-only: read-only root filesystem
-	// --tmpfs /tmp:size=64M: writable temp directory with size limit
-	// --memory: RAM limit
-	// --cpus: CPU limit
-	cmd := exec.CommandContext(ctx, "docker", "run",
-		"--rm",
-		"--network", "none",
-		"--read-only",
-		"--tmpfs", "/tmp:size=64M",
-		"--memory", fmt.Sprintf("%dm", s.config.SandboxMaxMemoryMB),
-		"--cpus", "0.5",
-		"-e", fmt.Sprintf("SANDBOX_TIMEOUT_SECONDS=%d", s.config.SandboxTimeoutSeconds),
-		"-i",
-		"gryag-sandbox",
-	)
-
-	cmd.Stdin = strings.NewReader(params.Code)
-
-	var stdout, stderr bytes.Buffer
-	cmd.Stdout = &stdout
-	cmd.Stderr = &stderr
+	var stdout, stderr string
+	var err error
+	if s.pool != nil {
+		stdout, stderr, err = s.pool.run(ctx, params.Code)
+	}
+	if s.pool == nil || errors.Is(err, errSandboxPoolBusy) {
+		// One-shot container with the pre-built sandbox image (--rm: auto-remove after execution)
+		args := append([]string{"run", "--rm"}, sandboxIsolationArgs(s.config.SandboxMaxMemoryMB, s.config.SandboxTimeoutSeconds)...)
+		args = append(args, "-i", sandboxImage)
+		stdout, stderr, err = s.docker(ctx, params.Code, args...)
+	}
 
-	if err := cmd.Run(); err != nil {
+	if err != nil {
 		// Timed out or failed
 		if ctx.Err() != nil {
 			return "Code execution timed out.", nil
 		}
-		errOutput := stderr.String()
+		errOutput := stderr
 		if errOutput == "" {
 			errOutput = err.Error()
 		}
 		return fmt.Sprintf("Execution error:\n%s", errOutput), nil
 	}
 
-	output := stdout.String()
+	output := stdout
 	if output == "" {
 		output = "(no output)"
 	}
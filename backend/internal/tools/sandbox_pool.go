@@ -0,0 +1,336 @@
+package tools
+
+import (
+	"bytes"
+	"context"
+	"errors"
+	"fmt"
+	"log/slog"
+	"os/exec"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+const (
+	sandboxImage = "gryag-sandbox"
+	// sandboxPoolLabel marks pool containers so leftovers of a previous run can be removed at startup.
+	sandboxPoolLabel = "gryag.sandbox=pool"
+)
+
+// sandboxScrubScript runs as root in a worker after every run, before the worker is reused: runs can
+// belong to different users and chats, so nothing of one may be visible to the next. It kills every
+// process of the sandbox user (PID 1, the idle `sleep`, ignores the signal) and empties the writable
+// locations — the root filesystem is read-only, so those are the /tmp tmpfs, /dev/shm and /dev/mqueue.
+// It then checks that no live process or file is left and exits non-zero otherwise (or when pkill or
+// ps are missing from the image), in which case the worker is destroyed instead of reused.
+const sandboxScrubScript = `
+command -v pkill >/dev/null && command -v ps >/dev/null || exit 1
+pkill -KILL -u sandbox
+for i in $(seq 50); do
+	[ -z "$(ps -u sandbox -o pid=,stat= | awk '$1 != 1 && $2 !~ /^Z/')" ] && break
+	sleep 0.02
+done
+find /tmp /dev/shm /dev/mqueue -mindepth 1 -delete 2>/dev/null
+[ -z "$(ps -u sandbox -o pid=,stat= | awk '$1 != 1 && $2 !~ /^Z/')" ] || exit 1
+[ -z "$(find /tmp /dev/shm /dev/mqueue -mindepth 1 2>/dev/null | head -n 1)" ] || exit 1
+`
+
+// errSandboxPoolBusy is returned by sandboxPool.run when no warm worker became free within the wait timeout.
+var errSandboxPoolBusy = errors.New("no warm sandbox worker available")
+
+// dockerFunc runs the docker CLI with args and stdin; swapped out in tests.
+type dockerFunc func(ctx context.Context, stdin string, args ...string) (stdout, stderr string, err error)
+
+func runDocker(ctx context.Context, stdin string, args ...string) (string, string, error) {
+	cmd := exec.CommandContext(ctx, "docker", args...)
+	if stdin != "" {
+		cmd.Stdin = strings.NewReader(stdin)
+	}
+	var stdout, stderr bytes.Buffer
+	cmd.Stdout = &stdout
+	cmd.Stderr = &stderr
+	err := cmd.Run()
+	return stdout.String(), stderr.String(), err
+}
+
+// sandboxWorker is one pre-started sandbox container.
+type sandboxWorker struct {
+	id   string
+	runs int
+}
+
+// sandboxPool keeps pre-started sandbox containers so run_python_code / calculator pay a `docker exec`
+// instead of a full container create/start/destroy. Containers use the same isolation flags as one-shot
+// runs (--network none, --read-only, tmpfs /tmp, memory/cpu limits) and idle on `sleep infinity`; code is
+// fed to the image's entrypoint over stdin via `docker exec -i`.
+//
+// Between runs a worker is scrubbed (sandboxScrubScript: processes killed, tmpfs emptied) before it goes
+// back to the idle set, so one run cannot see another's code, files or output. A worker is destroyed
+// and replaced in the background after maxRuns runs, after any failed run (error, timeout,
+// SANDBOX_ERROR output) and when scrubbing fails. maxRuns = 1 gives every run a fresh container while
+// still hiding the start latency.
+type sandboxPool struct {
+	size        int
+	maxRuns     int
+	waitTimeout time.Duration
+	isolation   []string // docker run flags shared with one-shot runs
+	docker      dockerFunc
+
+	idle   chan *sandboxWorker
+	ctx    context.Context
+	cancel context.CancelFunc
+	wg     sync.WaitGroup
+
+	runs, warmRuns, coldFallbacks, recycled, startFailures atomic.Uint64
+	waitTotalUs, waitMaxUs                                 atomic.Int64
+}
+
+// SandboxPoolStats is a snapshot of the warm pool counters (for the admin stats endpoint).
+type SandboxPoolStats struct {
+	Size          int     `json:"size"`
+	Idle          int     `json:"idle"`
+	MaxRuns       int     `json:"max_runs"`
+	Runs          uint64  `json:"runs"`
+	WarmRuns      uint64  `json:"warm_runs"`
+	ColdFallbacks uint64  `json:"cold_fallbacks"`
+	Recycled      uint64  `json:"recycled"`
+	StartFailures uint64  `json:"start_failures"`
+	WaitAvgMs     float64 `json:"wait_avg_ms"`
+	WaitMaxMs     float64 `json:"wait_max_ms"`
+}
+
+func newSandboxPool(size, maxRuns int, waitTimeout time.Duration, isolation []string, docker dockerFunc) *sandboxPool {
+	if maxRuns <= 0 {
+		maxRuns = 1
+	}
+	ctx, cancel := context.WithCancel(context.Background())
+	return &sandboxPool{
+		size:        size,
+		maxRuns:     maxRuns,
+		waitTimeout: waitTimeout,
+		isolation:   isolation,
+		docker:      docker,
+		idle:        make(chan *sandboxWorker, size),
+		ctx:         ctx,
+		cancel:      cancel,
+	}
+}
+
+// start removes leftover pool containers and starts size workers in the background.
+func (p *sandboxPool) start() {
+	p.removeLeftovers()
+	for i := 0; i < p.size; i++ {
+		p.spawn()
+	}
+	slog.Info("sandbox pool starting", "size", p.size, "max_runs", p.maxRuns, "wait_timeout", p.waitTimeout)
+}
+
+// close stops replacing workers and removes idle containers. Busy workers are removed when released.
+func (p *sandboxPool) close() {
+	p.cancel()
+	p.wg.Wait()
+	for {
+		select {
+		case w := <-p.idle:
+			p.destroy(w)
+		default:
+			return
+		}
+	}
+}
+
+// run executes code on a warm worker. It returns errSandboxPoolBusy when no worker became free in time,
+// so the caller can fall back to a one-shot container.
+func (p *sandboxPool) run(ctx context.Context, code string) (stdout, stderr string, err error) {
+	p.runs.Add(1)
+	start := time.Now()
+	w, err := p.acquire(ctx)
+	p.recordWait(time.Since(start))
+	if err != nil {
+		p.coldFallbacks.Add(1)
+		return "", "", err
+	}
+	p.warmRuns.Add(1)
+
+	stdout, stderr, err = p.docker(ctx, code, "exec", "-i", w.id, "/bin/bash", "/entrypoint.sh")
+	failed := err != nil || ctx.Err() != nil || strings.Contains(stdout, "SANDBOX_ERROR")
+	p.release(w, failed)
+	return stdout, stderr, err
+}
+
+func (p *sandboxPool) acquire(ctx context.Context) (*sandboxWorker, error) {
+	select {
+	case w := <-p.idle:
+		return w, nil
+	default:
+	}
+	timer := time.NewTimer(p.waitTimeout)
+	defer timer.Stop()
+	select {
+	case w := <-p.idle:
+		return w, nil
+	case <-timer.C:
+		return nil, errSandboxPoolBusy
+	case <-ctx.Done():
+		return nil, ctx.Err()
+	}
+}
+
+// release returns a worker to the pool once it is scrubbed, or recycles it after maxRuns, a failed run
+// or a failed scrub. Scrubbing happens in the background so the caller gets its output right away.
+func (p *sandboxPool) release(w *sandboxWorker, failed bool) {
+	w.runs++
+	if failed || w.runs >= p.maxRuns || p.ctx.Err() != nil {
+		p.recycle(w)
+		return
+	}
+	p.wg.Add(1)
+	go func() {
+		defer p.wg.Done()
+		if err := p.scrub(w); err != nil {
+			slog.Warn("sandbox worker scrub failed, recycling it", "container", w.id, "error", err)
+			p.recycle(w)
+			return
+		}
+		if p.ctx.Err() != nil {
+			p.destroy(w)
+			return
+		}
+		p.idle <- w
+	}()
+}
+
+// recycle destroys a worker in the background and starts a replacement.
+func (p *sandboxPool) recycle(w *sandboxWorker) {
+	p.recycled.Add(1)
+	go p.destroy(w)
+	p.spawn()
+}
+
+// scrub removes what a run left in a worker (see sandboxScrubScript).
+func (p *sandboxPool) scrub(w *sandboxWorker) error {
+	ctx, cancel := context.WithTimeout(context.Background(), 10*time.Second)
+	defer cancel()
+	if _, stderr, err := p.docker(ctx, "", "exec", "-u", "root", w.id, "/bin/sh", "-c", sandboxScrubScript); err != nil {
+		return fmt.Errorf("%w: %s", err, strings.TrimSpace(stderr))
+	}
+	return nil
+}
+
+// spawn starts one replacement worker in the background, retrying with backoff until it succeeds or the
+// pool is closed.
+func (p *sandboxPool) spawn() {
+	if p.ctx.Err() != nil {
+		return
+	}
+	p.wg.Add(1)
+	go func() {
+		defer p.wg.Done()
+		backoff := time.Second
+		for {
+			args := append([]string{"run", "-d", "--rm", "--label", sandboxPoolLabel}, p.isolation...)
+			args = append(args, "--entrypoint", "sleep", sandboxImage, "infinity")
+			stdout, stderr, err := p.docker(p.ctx, "", args...)
+			if err == nil {
+				w := &sandboxWorker{id: strings.TrimSpace(stdout)}
+				if p.ctx.Err() != nil {
+					p.destroy(w)
+					return
+				}
+				p.idle <- w
+				return
+			}
+			if p.ctx.Err() != nil {
+				return
+			}
+			p.startFailures.Add(1)
+			slog.Warn("sandbox worker start failed", "error", err, "stderr", strings.TrimSpace(stderr), "retry_in", backoff)
+			select {
+			case <-p.ctx.Done():
+				return
+			case <-time.After(backoff):
+			}
+			if backoff < 30*time.Second {
+				backoff *= 2
+			}
+		}
+	}()
+}
+
+// destroy force-removes a worker container (best effort).
+func (p *sandboxPool) destroy(w *sandboxWorker) {
+	ctx, cancel := context.WithTimeout(context.Background(), 30*time.Second)
+	defer cancel()
+	if _, stderr, err := p.docker(ctx, "", "rm", "-f", w.id); err != nil {
+		slog.Warn("sandbox worker remove failed", "container", w.id, "error", err, "stderr", strings.TrimSpace(stderr))
+	}
+}
+
+// removeLeftovers removes pool containers left running by a previous backend process.
+func (p *sandboxPool) removeLeftovers() {
+	ctx, cancel := context.WithTimeout(p.ctx, 30*time.Second)
+	defer cancel()
+	stdout, _, err := p.docker(ctx, "", "ps", "-aq", "--filter", "label="+sandboxPoolLabel)
+	if err != nil {
+		return
+	}
+	ids := strings.Fields(stdout)
+	if len(ids) == 0 {
+		return
+	}
+	if _, stderr, err := p.docker(ctx, "", append([]string{"rm", "-f"}, ids...)...); err != nil {
+		slog.Warn("sandbox leftover cleanup failed", "error", err, "stderr", strings.TrimSpace(stderr))
+		return
+	}
+	slog.Info("removed leftover sandbox workers", "count", len(ids))
+}
+
+func (p *sandboxPool) recordWait(d time.Duration) {
+	us := d.Microseconds()
+	p.waitTotalUs.Add(us)
+	for {
+		cur := p.waitMaxUs.Load()
+		if us <= cur || p.waitMaxUs.CompareAndSwap(cur, us) {
+			return
+		}
+	}
+}
+
+// stats returns the current counters.
+func (p *sandboxPool) stats() SandboxPoolStats {
+	s := SandboxPoolStats{
+		Size:          p.size,
+		Idle:          len(p.idle),
+		MaxRuns:       p.maxRuns,
+		Runs:          p.runs.Load(),
+		WarmRuns:      p.warmRuns.Load(),
+		ColdFallbacks: p.coldFallbacks.Load(),
+		Recycled:      p.recycled.Load(),
+		StartFailures: p.startFailures.Load(),
+		WaitMaxMs:     float64(p.waitMaxUs.Load()) / 1000,
+	}
+	if s.Runs > 0 {
+		s.WaitAvgMs = float64(p.waitTotalUs.Load()) / 1000 / float64(s.Runs)
+	}
+	return s
+}
+
+// sandboxIsolationArgs are the docker run flags every sandbox container gets, pooled or one-shot.
+//
+//	--network none: zero network access (defense in depth)
+//	--read-only: read-only root filesystem
+//	--tmpfs /tmp:size=64M: writable temp directory with size limit
+//	--memory: RAM limit
+//	--cpus: CPU limit
+func sandboxIsolationArgs(maxMemoryMB, timeoutSeconds int) []string {
+	return []string{
+		"--network", "none",
+		"--read-only",
+		"--tmpfs", "/tmp:size=64M",
+		"--memory", fmt.Sprintf("%dm", maxMemoryMB),
+		"--cpus", "0.5",
+		"-e", fmt.Sprintf("SANDBOX_TIMEOUT_SECONDS=%d", timeoutSeconds),
+	}
+}
@@ -0,0 +1,190 @@
+package tools
+
+import (
+	"context"
+	"fmt"
+	"strings"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/ThatHunky/gryag/backend/internal/config"
+)
+
+// fakeDocker records docker CLI calls and simulates run -d / exec / rm. Each container keeps the files
+// its runs leave behind: code "leave:NAME" creates one and code "ls" lists them; the scrub exec empties
+// them unless scrubFails is set.
+type fakeDocker struct {
+	mu         sync.Mutex
+	started    int
+	removed    []string
+	execs      []string
+	scrubs     int
+	scrubFails bool
+	execOut    string
+	execHang   chan struct{}
+	files      map[string][]string
+}
+
+func (f *fakeDocker) run(ctx context.Context, stdin string, args ...string) (string, string, error) {
+	f.mu.Lock()
+	defer f.mu.Unlock()
+	switch args[0] {
+	case "run":
+		if args[1] == "-d" {
+			f.started++
+			return fmt.Sprintf("c%d\n", f.started), "", nil
+		}
+		return "cold:" + stdin, "", nil
+	case "exec":
+		if args[1] == "-u" { // scrub: exec -u root <id> /bin/sh -c ...
+			f.scrubs++
+			if f.scrubFails {
+				return "", "scrub failed", fmt.Errorf("exit status 1")
+			}
+			delete(f.files, args[3])
+			return "", "", nil
+		}
+		id := args[2]
+		f.execs = append(f.execs, id)
+		switch {
+		case strings.HasPrefix(stdin, "leave:"):
+			if f.files == nil {
+				f.files = make(map[string][]string)
+			}
+			f.files[id] = append(f.files[id], strings.TrimPrefix(stdin, "leave:"))
+		case stdin == "ls":
+			return strings.Join(f.files[id], ","), "", nil
+		}
+		return f.execOut, "", nil
+	case "rm":
+		f.removed = append(f.removed, args[2:]...)
+	}
+	return "", "", nil
+}
+
+func waitIdle(t *testing.T, p *sandboxPool, n int) {
+	t.Helper()
+	deadline := time.Now().Add(time.Second)
+	for len(p.idle) < n {
+		if time.Now().After(deadline) {
+			t.Fatalf("expected %d idle workers, got %d", n, len(p.idle))
+		}
+		time.Sleep(time.Millisecond)
+	}
+}
+
+func TestSandboxPool_ReusesAndRecyclesWorkers(t *testing.T) {
+	fd := &fakeDocker{execOut: "4\n"}
+	p := newSandboxPool(1, 2, time.Second, sandboxIsolationArgs(128, 5), fd.run)
+	p.start()
+	defer p.close()
+	waitIdle(t, p, 1)
+
+	ctx := context.Background()
+	for i := 0; i < 3; i++ {
+		out, _, err := p.run(ctx, "print(2+2)")
+		if err != nil || out != "4\n" {
+			t.Fatalf("run %d: got %q, %v", i, out, err)
+		}
+		waitIdle(t, p, 1)
+	}
+
+	fd.mu.Lock()
+	defer fd.mu.Unlock()
+	// c1 serves runs 1-2 and is recycled after max_runs=2; c2 serves run 3
+	if strings.Join(fd.execs, ",") != "c1,c1,c2" {
+		t.Errorf("unexpected exec targets: %v", fd.execs)
+	}
+	if len(fd.removed) != 1 || fd.removed[0] != "c1" {
+		t.Errorf("expected c1 removed after max runs, got %v", fd.removed)
+	}
+	if st := p.stats(); st.Runs != 3 || st.WarmRuns != 3 || st.Recycled != 1 {
+		t.Errorf("unexpected stats: %+v", st)
+	}
+}
+
+func TestSandboxPool_RecyclesAfterFailedRun(t *testing.T) {
+	fd := &fakeDocker{execOut: "SANDBOX_ERROR: execution failed or timed out\n"}
+	p := newSandboxPool(1, 10, time.Second, nil, fd.run)
+	p.start()
+	defer p.close()
+	waitIdle(t, p, 1)
+
+	if _, _, err := p.run(context.Background(), "while True: pass"); err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+	waitIdle(t, p, 1)
+	fd.mu.Lock()
+	defer fd.mu.Unlock()
+	if fd.started != 2 || len(fd.removed) != 1 {
+		t.Errorf("expected failed worker replaced, started=%d removed=%v", fd.started, fd.removed)
+	}
+}
+
+func TestSandboxPool_ScrubsWorkerBetweenRuns(t *testing.T) {
+	fd := &fakeDocker{}
+	p := newSandboxPool(1, 10, time.Second, nil, fd.run)
+	p.start()
+	defer p.close()
+	waitIdle(t, p, 1)
+
+	ctx := context.Background()
+	if _, _, err := p.run(ctx, "leave:secret.txt"); err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+	waitIdle(t, p, 1)
+	out, _, err := p.run(ctx, "ls")
+	if err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+	if out != "" {
+		t.Errorf("next run on the same worker saw %q left by the previous run", out)
+	}
+
+	fd.mu.Lock()
+	defer fd.mu.Unlock()
+	if strings.Join(fd.execs, ",") != "c1,c1" || fd.scrubs < 1 {
+		t.Errorf("expected both runs on c1 with a scrub in between, execs=%v scrubs=%d", fd.execs, fd.scrubs)
+	}
+}
+
+func TestSandboxPool_RecyclesWhenScrubFails(t *testing.T) {
+	fd := &fakeDocker{scrubFails: true}
+	p := newSandboxPool(1, 10, time.Second, nil, fd.run)
+	p.start()
+	defer p.close()
+	waitIdle(t, p, 1)
+
+	ctx := context.Background()
+	if _, _, err := p.run(ctx, "leave:secret.txt"); err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+	waitIdle(t, p, 1)
+	if out, _, _ := p.run(ctx, "ls"); out != "" {
+		t.Errorf("unscrubbed worker was reused: next run saw %q", out)
+	}
+	fd.mu.Lock()
+	defer fd.mu.Unlock()
+	if len(fd.removed) < 1 || fd.removed[0] != "c1" {
+		t.Errorf("expected c1 destroyed after the failed scrub, removed=%v", fd.removed)
+	}
+}
+
+func TestSandboxTool_FallsBackToOneShotWhenPoolBusy(t *testing.T) {
+	fd := &fakeDocker{}
+	s := NewSandboxTool(&config.Config{SandboxTimeoutSeconds: 5, SandboxMaxMemoryMB: 128})
+	s.docker = fd.run
+	s.pool = newSandboxPool(1, 10, 10*time.Millisecond, nil, fd.run) // never started: no warm workers
+
+	out, err := s.RunPythonCode(context.Background(), []byte(`{"code":"print(1)"}`))
+	if err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+	if out != "cold:print(1)" {
+		t.Errorf("expected one-shot fallback output, got %q", out)
+	}
+	if st := s.PoolStats(); st.ColdFallbacks != 1 {
+		t.Errorf("expected 1 cold fallback, got %+v", st)
+	}
+}
@@ -0,0 +1,24 @@
+package tools
+
+import (
+	"context"
+	"log/slog"
+
+	"github.com/ThatHunky/gryag/backend/internal/db"
+)
+
+// withSemanticMatches adds messages similar in meaning to query (embeddings) to the full-text matches
+// and fuses both rankings. On failure the full-text matches are returned unchanged.
+func (e *Executor) withSemanticMatches(ctx context.Context, chatID int64, query string, limit int, fullText []db.SearchResult) []db.SearchResult {
+	vec, err := e.llmClient.EmbedQuery(ctx, query)
+	if err != nil {
+		slog.Warn("semantic search skipped", "chat_id", chatID, "error", err)
+		return fullText
+	}
+	semantic, err := e.db.SemanticSearchMessages(ctx, chatID, vec, limit)
+	if err != nil {
+		slog.Warn("semantic search skipped", "chat_id", chatID, "error", err)
+		return fullText
+	}
+	return db.FuseSearchResults(limit, fullText, semantic)
+}
@@ -7,9 +7,11 @@ It performs no thinking — it is purely a dumb pipe.
 
 import base64
 import asyncio
+import json
 import logging
 import os
 import uuid
+from datetime import datetime
 
 import aiohttp
 import structlog
@@ -19,6 +21,7 @@ from aiogram.types import BotCommand, BufferedInputFile
 from aiohttp import web
 
 from md_to_tg import md_to_telegram_html
+from media_cache import MediaCache
 
 # ── Structured JSON Logging (Section 15.2) ──────────────────────────────
 structlog.configure(
@@ -38,19 +41,56 @@ BOT_TOKEN = os.getenv("TELEGRAM_BOT_TOKEN", "")
 BACKEND_URL = f"http://{os.getenv('BACKEND_HOST', 'gryag-backend')}:{os.getenv('BACKEND_PORT', '27710')}"
 HEALTH_PORT = int(os.getenv("FRONTEND_HEALTH_PORT", "27711"))
 ENABLE_PROACTIVE_MESSAGING = os.getenv("ENABLE_PROACTIVE_MESSAGING", "false").lower() in ("true", "1", "yes")
+# Receive proactive messages over the /api/v1/proactive/stream SSE stream; false polls /api/v1/proactive.
+PROACTIVE_STREAM = os.getenv("PROACTIVE_STREAM", "true").lower() in ("true", "1", "yes")
 PROACTIVE_POLL_INTERVAL_SEC = int(os.getenv("PROACTIVE_POLL_INTERVAL_SEC", "90"))
+# Stream replies via /api/v1/process/stream and progressively edit the Telegram message as text arrives.
+STREAM_REPLIES = os.getenv("STREAM_REPLIES", "true").lower() in ("true", "1", "yes")
+# Minimum seconds between edit_message_text calls while streaming (Telegram throttles frequent edits).
+STREAM_EDIT_INTERVAL_SEC = float(os.getenv("STREAM_EDIT_INTERVAL_SEC", "1.5"))
+# Backend requests in flight at once; further messages wait for a slot (bounds sockets and backend load).
+BACKEND_MAX_CONCURRENT = int(os.getenv("BACKEND_MAX_CONCURRENT", "32"))
+# Pooled keep-alive connections to the backend (process calls, media fetches, proactive stream).
+BACKEND_MAX_CONNECTIONS = int(os.getenv("BACKEND_MAX_CONNECTIONS", "64"))
 
 
 # ── Bot & Dispatcher ────────────────────────────────────────────────────
 bot = Bot(token=BOT_TOKEN)
 dp = Dispatcher()
 
+# One long-lived HTTP session to the backend (keep-alive pool, DNS cache), created in main().
+_backend_session: aiohttp.ClientSession | None = None
+backend_slots = asyncio.Semaphore(max(BACKEND_MAX_CONCURRENT, 1))
+
+
+def backend_session() -> aiohttp.ClientSession:
+    """The shared backend session; created on first use inside the running event loop."""
+    global _backend_session
+    if _backend_session is None or _backend_session.closed:
+        connector = aiohttp.TCPConnector(
+            limit=BACKEND_MAX_CONNECTIONS,
+            keepalive_timeout=60,  # below the backend's IdleTimeout (120 s)
+            ttl_dns_cache=300,
+        )
+        _backend_session = aiohttp.ClientSession(connector=connector)
+    return _backend_session
+
+
 # Max size (bytes) to send media to backend; larger files are skipped to avoid timeouts (plan: size limits).
 MEDIA_MAX_BYTES = int(os.getenv("MEDIA_MAX_BYTES", str(10 * 1024 * 1024)))  # 10 MB default
 
+# Telegram downloads cached by file_unique_id (repeat stickers, GIFs, forwarded media); empty dir = memory only.
+TG_MEDIA_CACHE_DIR = os.getenv("TG_MEDIA_CACHE_DIR", "/tmp/gryag_tg_media")
+TG_MEDIA_CACHE_MEMORY_MB = int(os.getenv("TG_MEDIA_CACHE_MEMORY_MB", "32"))
+TG_MEDIA_CACHE_DISK_MB = int(os.getenv("TG_MEDIA_CACHE_DISK_MB", "512"))
+# Log cache hit rates every N lookups.
+TG_MEDIA_CACHE_LOG_EVERY = 50
 
-async def download_media_as_base64(file_id: str, mime_type: str | None = None) -> tuple[str, str] | None:
-    """Download file by file_id and return (base64_string, mime_type). Returns None if too large or download fails."""
+media_cache = MediaCache(TG_MEDIA_CACHE_DIR, TG_MEDIA_CACHE_MEMORY_MB << 20, TG_MEDIA_CACHE_DISK_MB << 20)
+
+
+async def download_media(file_id: str, mime_type: str | None = None) -> tuple[bytes, str] | None:
+    """Download file by file_id and return (raw bytes, mime_type). Returns None if too large or download fails."""
     try:
         tg_file = await bot.get_file(file_id)
         if tg_file.file_size and tg_file.file_size > MEDIA_MAX_BYTES:
@@ -64,11 +104,74 @@ async def download_media_as_base64(file_id: str, mime_type: str | None = None) -
         if len(raw) > MEDIA_MAX_BYTES:
             return None
         mime = mime_type or "application/octet-stream"
-        return base64.b64encode(raw).decode("ascii"), mime
+        return raw, mime
     except Exception:
         return None
 
 
+async def get_media(
+    file_id: str, file_unique_id: str | None, mime_type: str | None
+) -> tuple[bytes, str, str | None] | None:
+    """(bytes, mime_type, upload_ref) from the file_unique_id cache, or downloaded from Telegram and cached.
+
+    upload_ref is the backend's Gemini file reference for the same media, when it returned one earlier.
+    """
+    if not file_unique_id:
+        result = await download_media(file_id, mime_type)
+        return (*result, None) if result else None
+    cached = await asyncio.to_thread(media_cache.get, file_unique_id)
+    stats = media_cache.stats()
+    if (stats["hits"] + stats["misses"]) % TG_MEDIA_CACHE_LOG_EVERY == 0:
+        log.info("media_cache_stats", **stats)
+    if cached is not None:
+        return cached.data, mime_type or "application/octet-stream", cached.upload_ref
+    result = await download_media(file_id, mime_type)
+    if result:
+        await asyncio.to_thread(media_cache.put, file_unique_id, result[0])
+        return (*result, None)
+    return None
+
+
+def remember_attachment_ref(file_unique_id: str | None, data: dict) -> None:
+    """Keep the backend's attachment_ref for the message's media, so a repeat is sent by reference."""
+    ref = data.get("attachment_ref")
+    if not file_unique_id or not ref:
+        return
+    expires_at = None
+    try:
+        expires_at = datetime.fromisoformat(data.get("attachment_ref_expires_at") or "").timestamp()
+    except ValueError:
+        pass
+    media_cache.set_upload_ref(file_unique_id, ref, expires_at)
+
+
+def process_request_body(payload: dict, media: bytes | None, mime_type: str | None) -> dict:
+    """Request kwargs for /api/v1/process[/stream]: plain JSON, or multipart with the attachment as raw bytes.
+
+    The backend expects the "payload" part before the "media" part.
+    """
+    if not media:
+        return {"json": payload}
+    form = aiohttp.FormData()
+    form.add_field("payload", json.dumps(payload), content_type="application/json")
+    form.add_field("media", media, filename="media", content_type=mime_type or "application/octet-stream")
+    return {"data": form}
+
+
+async def fetch_backend_media(session: aiohttp.ClientSession, media_id: str, chat_id: int) -> bytes:
+    """Download a generated image from the backend's media cache (GET /api/v1/media/{media_id}).
+
+    The backend only serves an image to the chat it was generated for.
+    """
+    async with session.get(
+        f"{BACKEND_URL}/api/v1/media/{media_id}",
+        params={"chat_id": str(chat_id)},
+        timeout=aiohttp.ClientTimeout(total=30),
+    ) as resp:
+        resp.raise_for_status()
+        return await resp.read()
+
+
 def _mime_for_media_type(media_type: str, document_mime: str | None) -> str:
     if document_mime:
         return document_mime
@@ -93,6 +196,181 @@ async def send_typing_loop(chat_id: int, stop_event: asyncio.Event) -> None:
         await asyncio.sleep(4)
 
 
+async def stream_from_backend(
+    session: aiohttp.ClientSession,
+    message: types.Message,
+    body: dict,
+    request_id: str,
+    logger,
+) -> tuple[int, dict | None, types.Message | None]:
+    """POST to /api/v1/process/stream and show reply text as it is generated.
+
+    Delta events are accumulated into a plain-text draft message that is edited at most every
+    STREAM_EDIT_INTERVAL_SEC (no parse mode: partial Markdown is not safe to render as HTML).
+    Returns (status, final response from the "done" event, draft message or None).
+    """
+    async with session.post(
+        f"{BACKEND_URL}/api/v1/process/stream",
+        **body,
+        headers={"X-Request-ID": request_id},
+        timeout=aiohttp.ClientTimeout(total=120),
+    ) as resp:
+        if resp.status != 200:
+            return resp.status, None, None
+        if resp.content_type != "text/event-stream":
+            return resp.status, await resp.json(), None
+
+        loop = asyncio.get_running_loop()
+        text = ""
+        shown = ""
+        draft: types.Message | None = None
+        last_edit = 0.0
+        buf = b""
+        # Events are split manually: the final "done" event may carry a large base64 image (when the
+        # backend could not cache it), which exceeds aiohttp's readline limit.
+        async for chunk in resp.content.iter_any():
+            buf += chunk
+            while b"\n\n" in buf:
+                raw, buf = buf.split(b"\n\n", 1)
+                event, data = _parse_sse_event(raw)
+                if event == "done":
+                    return resp.status, data, draft
+                if event != "delta" or data is None:
+                    continue
+                text += data.get("text", "")
+                preview = text[:4096]
+                if not preview.strip() or preview == shown or loop.time() - last_edit < STREAM_EDIT_INTERVAL_SEC:
+                    continue
+                try:
+                    if draft is None:
+                        draft = await message.answer(preview)
+                    else:
+                        await draft.edit_text(preview)
+                    shown = preview
+                    last_edit = loop.time()
+                except Exception as e:
+                    logger.warning("stream_edit_failed", error=str(e))
+        logger.warning("stream_ended_without_done")
+        return resp.status, None, draft
+
+
+def _parse_sse_event(raw: bytes) -> tuple[str | None, dict | None]:
+    """Parse one Server-Sent Event block into (event name, JSON data)."""
+    event = None
+    data_lines = []
+    for line in raw.decode("utf-8").split("\n"):
+        if line.startswith("event: "):
+            event = line[len("event: "):]
+        elif line.startswith("data: "):
+            data_lines.append(line[len("data: "):])
+    if not data_lines:
+        return event, None
+    try:
+        return event, json.loads("\n".join(data_lines))
+    except ValueError:
+        return event, None
+
+
+async def send_backend_reply(
+    session: aiohttp.ClientSession,
+    message: types.Message,
+    data: dict,
+    logger,
+    draft: types.Message | None = None,
+) -> None:
+    """Send the backend's final reply (text and/or generated media) to Telegram.
+
+    Generated images come by reference (media_id, fetched from the backend as raw bytes) or, when the
+    backend could not cache them, inline as media_base64.
+    When a streaming draft message exists, text replies replace it in place and media replies
+    delete it before the photo/document is sent.
+    """
+    reply_text = data.get("reply", "")
+    media_url = data.get("media_url", "")
+    media_type = data.get("media_type", "")
+    media_id = data.get("media_id", "")
+    media_base64 = data.get("media_base64", "")
+    media_bytes = None
+    if media_id:
+        try:
+            media_bytes = await fetch_backend_media(session, media_id, message.chat.id)
+        except Exception as e:
+            logger.error("media_fetch_failed", media_id=media_id, error=str(e))
+    elif media_base64:
+        media_bytes = base64.b64decode(media_base64)
+
+    # Convert markdown to Telegram HTML
+    reply_html = md_to_telegram_html(reply_text) if reply_text else ""
+
+    if draft is not None and (media_url or media_bytes):
+        try:
+            await draft.delete()
+        except Exception as e:
+            logger.warning("stream_draft_delete_failed", error=str(e))
+        draft = None
+
+    # Handle media responses (image generation results)
+    if (media_url or media_bytes) and media_type == "photo":
+        try:
+            photo_data = media_url
+            if media_bytes:
+                photo_data = BufferedInputFile(media_bytes, filename="generated.png")
+
+            await message.answer_photo(
+                photo=photo_data,
+                caption=reply_html[:1024] if reply_html else None,
+                parse_mode=ParseMode.HTML,
+            )
+            logger.info("photo_sent", media_id=media_id, has_base64=bool(media_base64), media_url=media_url)
+        except Exception as e:
+            logger.error("photo_send_failed", error=str(e))
+            # Fall back to text with URL
+            if reply_html:
+                await message.answer(
+                    f"{reply_html}\n\n🖼 {media_url if media_url else '<Image generated but upload failed>'}",
+                    parse_mode=ParseMode.HTML,
+                )
+    elif (media_url or media_bytes) and media_type == "document":
+        try:
+            document_data = media_url
+            if media_bytes:
+                document_data = BufferedInputFile(media_bytes, filename="generated.png")
+            await message.answer_document(
+                document=document_data,
+                caption=reply_html[:1024] if reply_html else None,
+                parse_mode=ParseMode.HTML,
+            )
+            logger.info("document_sent", media_id=media_id, has_base64=bool(media_base64), media_url=media_url)
+        except Exception as e:
+            logger.error("document_send_failed", error=str(e))
+            if reply_html:
+                await message.answer(
+                    f"{reply_html}\n\n📎 {media_url if media_url else '<File generated but upload failed>'}",
+                    parse_mode=ParseMode.HTML,
+                )
+    elif reply_html:
+        # Split long messages (Telegram limit: 4096 chars)
+        for i in range(0, len(reply_html), 4096):
+            chunk = reply_html[i : i + 4096]
+            if i == 0 and draft is not None:
+                try:
+                    await draft.edit_text(chunk, parse_mode=ParseMode.HTML)
+                    continue
+                except Exception as e:
+                    # Draft already shows exactly this text; nothing to replace
+                    if "message is not modified" in str(e):
+                        continue
+                    logger.warning("stream_final_edit_failed", error=str(e))
+            await message.answer(chunk, parse_mode=ParseMode.HTML)
+        logger.info("reply_sent", reply_length=len(reply_text), streamed=draft is not None)
+    elif draft is not None:
+        # Model produced only whitespace or the reply was emptied; drop the draft.
+        try:
+            await draft.delete()
+        except Exception:
+            pass
+
+
 @dp.message()
 async def handle_message(message: types.Message) -> None:
     """Forward every incoming message to the Go backend."""
@@ -114,38 +392,44 @@ async def handle_message(message: types.Message) -> None:
     try:
         # Extract file_id from media messages for storage in DB (media recall)
         file_id = None
+        file_unique_id = None
         media_type = None
+        media_obj = None
         if message.photo:
-            file_id = message.photo[-1].file_id  # Highest resolution
+            media_obj = message.photo[-1]  # Highest resolution
             media_type = "photo"
         elif message.video:
-            file_id = message.video.file_id
+            media_obj = message.video
             media_type = "video"
         elif message.document:
-            file_id = message.document.file_id
+            media_obj = message.document
             media_type = "document"
         elif message.voice:
-            file_id = message.voice.file_id
+            media_obj = message.voice
             media_type = "voice"
         elif message.video_note:
-            file_id = message.video_note.file_id
+            media_obj = message.video_note
             media_type = "video_note"
         elif message.sticker:
-            file_id = message.sticker.file_id
+            media_obj = message.sticker
             media_type = "sticker"
         elif message.animation:
-            file_id = message.animation.file_id
+            media_obj = message.animation
             media_type = "animation"
+        if media_obj is not None:
+            file_id = media_obj.file_id
+            file_unique_id = getattr(media_obj, "file_unique_id", None)
 
-        # Download media and send as base64 so the backend/LLM can see it (plan: all media types)
-        media_base64 = None
+        # Download media and send it as a raw multipart part so the backend/LLM can see it (plan: all media types)
+        media = None
         mime_type = None
+        upload_ref = None
         if file_id:
             doc_mime = getattr(message.document, "mime_type", None) if message.document else None
             mime_type = _mime_for_media_type(media_type or "", doc_mime)
-            result = await download_media_as_base64(file_id, mime_type)
+            result = await get_media(file_id, file_unique_id, mime_type)
             if result:
-                media_base64, mime_type = result
+                media, mime_type, upload_ref = result
             else:
                 logger.warning("media_download_failed", file_id=file_id, media_type=media_type)
 
@@ -166,81 +450,44 @@ async def handle_message(message: types.Message) -> None:
             payload["reply_to_text"] = (
                 message.reply_to_message.text or message.reply_to_message.caption or ""
             )
-        if media_base64:
-            payload["media_base64"] = media_base64
+        if upload_ref:
+            # The backend already uploaded this file to Gemini; send the reference instead of the bytes
             payload["mime_type"] = mime_type
-            logger.info("sending_media_to_backend", media_type=media_type, mime_type=mime_type, size_bytes=len(media_base64) * 3 // 4)
-
-        async with aiohttp.ClientSession() as session:
-            async with session.post(
-                f"{BACKEND_URL}/api/v1/process",
-                json=payload,
-                headers={"X-Request-ID": request_id},
-                timeout=aiohttp.ClientTimeout(total=120),
-            ) as resp:
-                if resp.status == 200:
-                    data = await resp.json()
-                    reply_text = data.get("reply", "")
-                    media_url = data.get("media_url", "")
-                    media_type = data.get("media_type", "")
-                    media_base64 = data.get("media_base64", "")
-
-                    # Convert markdown to Telegram HTML
-                    reply_html = md_to_telegram_html(reply_text) if reply_text else ""
-
-                    # Handle media responses (image generation results)
-                    if (media_url or media_base64) and media_type == "photo":
-                        try:
-                            photo_data = media_url
-                            if media_base64:
-                                photo_bytes = base64.b64decode(media_base64)
-                                photo_data = BufferedInputFile(photo_bytes, filename="generated.png")
-
-                            await message.answer_photo(
-                                photo=photo_data,
-                                caption=reply_html[:1024] if reply_html else None,
-                                parse_mode=ParseMode.HTML,
-                            )
-                            logger.info("photo_sent", has_base64=bool(media_base64), media_url=media_url)
-                        except Exception as e:
-                            logger.error("photo_send_failed", error=str(e))
-                            # Fall back to text with URL
-                            if reply_html:
-                                await message.answer(
-                                    f"{reply_html}\n\n🖼 {media_url if media_url else '<Image generated but upload failed>'}",
-                                    parse_mode=ParseMode.HTML,
-                                )
-                    elif (media_url or media_base64) and media_type == "document":
-                        try:
-                            document_data = media_url
-                            if media_base64:
-                                doc_bytes = base64.b64decode(media_base64)
-                                document_data = BufferedInputFile(doc_bytes, filename="generated.png")
-                            await message.answer_document(
-                                document=document_data,
-                                caption=reply_html[:1024] if reply_html else None,
-                                parse_mode=ParseMode.HTML,
-                            )
-                            logger.info("document_sent", has_base64=bool(media_base64), media_url=media_url)
-                        except Exception as e:
-                            logger.error("document_send_failed", error=str(e))
-                            if reply_html:
-                                await message.answer(
-                                    f"{reply_html}\n\n📎 {media_url if media_url else '<File generated but upload failed>'}",
-                                    parse_mode=ParseMode.HTML,
-                                )
-                    elif reply_html:
-                        # Split long messages (Telegram limit: 4096 chars)
-                        for i in range(0, len(reply_html), 4096):
-                            chunk = reply_html[i : i + 4096]
-                            await message.answer(chunk, parse_mode=ParseMode.HTML)
-                        logger.info("reply_sent", reply_length=len(reply_text))
-
-                elif resp.status == 204:
-                    # Rate limited — strict silence (Section 10)
-                    logger.info("throttled_silent", chat_id=message.chat.id)
-                else:
-                    logger.warn("backend_error", status=resp.status)
+            payload["attachment_ref"] = upload_ref
+            logger.info("sending_media_ref_to_backend", media_type=media_type, mime_type=mime_type)
+            media = None
+        elif media:
+            payload["mime_type"] = mime_type
+            logger.info("sending_media_to_backend", media_type=media_type, mime_type=mime_type, size_bytes=len(media))
+        body = process_request_body(payload, media, mime_type)
+
+        session = backend_session()
+        queued_at = asyncio.get_running_loop().time()
+        async with backend_slots:
+            waited = asyncio.get_running_loop().time() - queued_at
+            if waited >= 1:
+                logger.info("backend_slot_wait", waited_sec=round(waited, 2), max_concurrent=BACKEND_MAX_CONCURRENT)
+            if STREAM_REPLIES:
+                status, data, draft = await stream_from_backend(session, message, body, request_id, logger)
+            else:
+                draft = None
+                async with session.post(
+                    f"{BACKEND_URL}/api/v1/process",
+                    **body,
+                    headers={"X-Request-ID": request_id},
+                    timeout=aiohttp.ClientTimeout(total=120),
+                ) as resp:
+                    status = resp.status
+                    data = await resp.json() if status == 200 else None
+
+        if status == 200 and data is not None:
+            remember_attachment_ref(file_unique_id, data)
+            await send_backend_reply(session, message, data, logger, draft)
+        elif status == 204:
+            # Rate limited or coalesced into a newer message's turn — strict silence (Section 10)
+            logger.info("throttled_silent", chat_id=message.chat.id)
+        else:
+            logger.warn("backend_error", status=status)
 
     except asyncio.TimeoutError:
         logger.error("backend_timeout")
@@ -255,31 +502,79 @@ async def handle_message(message: types.Message) -> None:
             pass
 
 
-# ── Proactive messaging poller ───────────────────────────────────────────
+# ── Proactive messaging ──────────────────────────────────────────────────
+async def send_proactive(data: dict, logger) -> None:
+    """Send one proactive message from the backend queue to Telegram."""
+    chat_id = data.get("chat_id")
+    reply = data.get("reply", "")
+    if not reply or chat_id is None:
+        return
+    try:
+        html = md_to_telegram_html(reply)
+        await bot.send_message(chat_id=chat_id, text=html, parse_mode=ParseMode.HTML)
+        logger.info("proactive_sent", chat_id=chat_id, reply_length=len(reply))
+    except Exception as e:
+        logger.error("proactive_send_failed", chat_id=chat_id, error=str(e))
+
+
+async def proactive_stream_loop() -> None:
+    """Hold GET /api/v1/proactive/stream open and send each message as soon as the backend queues it.
+
+    Messages are sent one at a time in stream order (the backend queue is FIFO), so replies for one chat
+    keep their order. Reconnects with backoff; falls back to polling when the backend has no stream.
+    """
+    logger = log.bind(component="proactive_stream")
+    backoff = 1.0
+    while True:
+        try:
+            async with backend_session().get(
+                f"{BACKEND_URL}/api/v1/proactive/stream",
+                # The backend sends a keepalive every 15 s; a silent minute means the connection is gone
+                timeout=aiohttp.ClientTimeout(total=None, sock_connect=10, sock_read=60),
+            ) as resp:
+                if resp.status == 404:
+                    logger.warning("proactive_stream_unavailable", fallback="polling")
+                    await proactive_poller_loop()
+                    return
+                if resp.status != 200:
+                    logger.warning("proactive_stream_bad_status", status=resp.status)
+                else:
+                    logger.info("proactive_stream_connected")
+                    backoff = 1.0
+                    buf = b""
+                    async for chunk in resp.content.iter_any():
+                        buf += chunk
+                        while b"\n\n" in buf:
+                            raw, buf = buf.split(b"\n\n", 1)
+                            event, data = _parse_sse_event(raw)
+                            if event == "proactive" and data is not None:
+                                await send_proactive(data, logger)
+                    logger.info("proactive_stream_closed")
+        except asyncio.CancelledError:
+            break
+        except Exception as e:
+            logger.warning("proactive_stream_error", error=str(e))
+        await asyncio.sleep(backoff)
+        backoff = min(backoff * 2, 30.0)
+
+
 async def proactive_poller_loop() -> None:
-    """Poll backend for queued proactive messages and send them to Telegram."""
+    """Poll backend for queued proactive messages and send them to Telegram (PROACTIVE_STREAM=false)."""
     logger = log.bind(component="proactive_poller")
     while True:
         try:
             await asyncio.sleep(PROACTIVE_POLL_INTERVAL_SEC)
-            async with aiohttp.ClientSession() as session:
-                async with session.get(
-                    f"{BACKEND_URL}/api/v1/proactive",
-                    timeout=aiohttp.ClientTimeout(total=15),
-                ) as resp:
-                    if resp.status == 204:
-                        continue
-                    if resp.status != 200:
-                        logger.warning("proactive_poll_bad_status", status=resp.status)
-                        continue
-                    data = await resp.json()
-                    chat_id = data.get("chat_id")
-                    reply = data.get("reply", "")
-                    if not reply or chat_id is None:
-                        continue
-                    html = md_to_telegram_html(reply)
-                    await bot.send_message(chat_id=chat_id, text=html, parse_mode=ParseMode.HTML)
-                    logger.info("proactive_sent", chat_id=chat_id, reply_length=len(reply))
+            async with backend_session().get(
+                f"{BACKEND_URL}/api/v1/proactive",
+                timeout=aiohttp.ClientTimeout(total=15),
+            ) as resp:
+                if resp.status == 204:
+                    continue
+                if resp.status != 200:
+                    logger.warning("proactive_poll_bad_status", status=resp.status)
+                    continue
+                data = await resp.json()
+            await send_proactive(data, logger)
         except asyncio.CancelledError:
             break
         except Exception as e:
@@ -322,14 +617,22 @@ async def main() -> None:
     # Start health check server
     await start_health_server()
 
-    # Start proactive poller when enabled
+    # Start proactive delivery when enabled
     if ENABLE_PROACTIVE_MESSAGING:
-        asyncio.create_task(proactive_poller_loop())
-        log.info("proactive_poller_started", interval_sec=PROACTIVE_POLL_INTERVAL_SEC)
+        if PROACTIVE_STREAM:
+            asyncio.create_task(proactive_stream_loop())
+            log.info("proactive_stream_started")
+        else:
+            asyncio.create_task(proactive_poller_loop())
+            log.info("proactive_poller_started", interval_sec=PROACTIVE_POLL_INTERVAL_SEC)
 
     # Start polling
-    log.info("starting_polling")
-    await dp.start_polling(bot)
+    log.info("starting_polling", backend_max_concurrent=BACKEND_MAX_CONCURRENT)
+    try:
+        await dp.start_polling(bot)
+    finally:
+        if _backend_session is not None:
+            await _backend_session.close()
 
 
 if __name__ == "__main__":
@@ -0,0 +1,184 @@
+"""
+Bounded cache of Telegram media downloads, keyed by file_unique_id.
+
+Stickers, GIFs and forwarded photos come back again and again; file_unique_id is the same for the same
+file across chats and bots (file_id is not), so a repeat skips the Telegram download. Entries live in
+an in-memory LRU on top of an on-disk LRU, each evicted by total size. An entry can also carry the
+backend's upload handle for the file, so a repeat can skip the upload to Gemini as well.
+"""
+
+import os
+import re
+import threading
+import time
+from collections import OrderedDict
+from dataclasses import dataclass
+
+_SAFE_NAME = re.compile(r"[^A-Za-z0-9_-]")
+
+# An upload handle is only handed out while it stays valid at least this long (a turn and its replies).
+UPLOAD_REF_MARGIN_SEC = 3600
+
+
+@dataclass
+class CachedMedia:
+    data: bytes
+    upload_ref: str | None = None  # backend-side upload handle, when the backend returned one
+
+
+class MediaCache:
+    """In-memory and on-disk LRU of media bytes by file_unique_id. Safe to use from several threads."""
+
+    def __init__(self, directory: str | None, memory_bytes: int, disk_bytes: int):
+        self._dir = directory or None
+        self._memory_max = max(memory_bytes, 0)
+        self._disk_max = max(disk_bytes, 0) if self._dir else 0
+        self._lock = threading.Lock()
+        self._memory: OrderedDict[str, bytes] = OrderedDict()
+        self._memory_size = 0
+        self._disk: OrderedDict[str, int] = OrderedDict()  # key -> file size
+        self._disk_size = 0
+        self._upload_refs: dict[str, tuple[str, float | None]] = {}  # key -> (handle, expires_at)
+        self.hits = 0
+        self.misses = 0
+        if self._dir and self._disk_max:
+            os.makedirs(self._dir, exist_ok=True)
+            self._load_disk_index()
+
+    def _path(self, key: str) -> str:
+        return os.path.join(self._dir, _SAFE_NAME.sub("_", key) + ".bin")
+
+    def _load_disk_index(self) -> None:
+        """Rebuild the disk LRU from the files left by a previous run, oldest access first."""
+        entries = []
+        for name in os.listdir(self._dir):
+            if not name.endswith(".bin"):
+                continue
+            try:
+                st = os.stat(os.path.join(self._dir, name))
+            except OSError:
+                continue
+            entries.append((st.st_mtime, name[: -len(".bin")], st.st_size))
+        for _, key, size in sorted(entries):
+            self._disk[key] = size
+            self._disk_size += size
+        self._evict_disk()
+
+    def get(self, key: str) -> CachedMedia | None:
+        with self._lock:
+            data = self._memory.get(key)
+            if data is not None:
+                self._memory.move_to_end(key)
+                self.hits += 1
+                return CachedMedia(data, self._upload_ref(key))
+            on_disk = key in self._disk
+            if on_disk:
+                self._disk.move_to_end(key)
+        if on_disk:
+            try:
+                with open(self._path(key), "rb") as f:
+                    data = f.read()
+                os.utime(self._path(key))
+            except OSError:
+                data = None
+            if data is not None:
+                with self._lock:
+                    self.hits += 1
+                    self._remember(key, data)
+                    return CachedMedia(data, self._upload_ref(key))
+            with self._lock:
+                self._drop_disk(key)
+        with self._lock:
+            self.misses += 1
+        return None
+
+    def put(self, key: str, data: bytes) -> None:
+        with self._lock:
+            self._remember(key, data)
+            write = 0 < len(data) <= self._disk_max and key not in self._disk
+        if not write:
+            return
+        path = self._path(key)
+        tmp = f"{path}.{threading.get_ident()}.tmp"
+        try:
+            with open(tmp, "wb") as f:
+                f.write(data)
+            os.replace(tmp, path)
+        except OSError:
+            try:
+                os.remove(tmp)
+            except OSError:
+                pass
+            return
+        with self._lock:
+            if key not in self._disk:
+                self._disk[key] = len(data)
+                self._disk_size += len(data)
+            self._evict_disk()
+
+    def set_upload_ref(self, key: str, upload_ref: str | None, expires_at: float | None = None) -> None:
+        """Remember (or, with None, forget) the backend's upload handle for a cached file.
+
+        expires_at is a Unix timestamp; the handle is no longer returned within UPLOAD_REF_MARGIN_SEC of it.
+        """
+        with self._lock:
+            if upload_ref:
+                self._upload_refs[key] = (upload_ref, expires_at)
+            else:
+                self._upload_refs.pop(key, None)
+
+    def stats(self) -> dict:
+        with self._lock:
+            lookups = self.hits + self.misses
+            return {
+                "hits": self.hits,
+                "misses": self.misses,
+                "hit_rate": round(self.hits / lookups, 3) if lookups else 0.0,
+                "memory_bytes": self._memory_size,
+                "memory_files": len(self._memory),
+                "disk_bytes": self._disk_size,
+                "disk_files": len(self._disk),
+            }
+
+    # Callers hold self._lock for the helpers below.
+
+    def _upload_ref(self, key: str) -> str | None:
+        ref = self._upload_refs.get(key)
+        if ref is None:
+            return None
+        handle, expires_at = ref
+        if expires_at is not None and expires_at - UPLOAD_REF_MARGIN_SEC <= time.time():
+            del self._upload_refs[key]
+            return None
+        return handle
+
+    def _remember(self, key: str, data: bytes) -> None:
+        if len(data) > self._memory_max:
+            return
+        if key in self._memory:
+            self._memory.move_to_end(key)
+            return
+        self._memory[key] = data
+        self._memory_size += len(data)
+        while self._memory_size > self._memory_max:
+            old_key, old = self._memory.popitem(last=False)
+            self._memory_size -= len(old)
+            if old_key not in self._disk:
+                self._upload_refs.pop(old_key, None)
+
+    def _evict_disk(self) -> None:
+        while self._disk_size > self._disk_max and self._disk:
+            key = next(iter(self._disk))
+            self._drop_disk(key)
+
+    def _drop_disk(self, key: str) -> None:
+        size = self._disk.pop(key, None)
+        if size is None:
+            return
+        self._disk_size -= size
+        if key not in self._memory:
+            self._upload_refs.pop(key, None)
+        try:
+            os.remove(self._path(key))
+        except OSError:
+            pass
@@ -0,0 +1,58 @@
+"""Tests for the Telegram media cache."""
+
+import os
+import time
+
+from media_cache import MediaCache
+
+
+def test_memory_hit_and_hit_rate(tmp_path):
+    cache = MediaCache(str(tmp_path), memory_bytes=100, disk_bytes=100)
+    assert cache.get("AQADx") is None
+    cache.put("AQADx", b"sticker")
+    hit = cache.get("AQADx")
+    assert hit is not None and hit.data == b"sticker"
+    stats = cache.stats()
+    assert stats["hits"] == 1 and stats["misses"] == 1 and stats["hit_rate"] == 0.5
+
+
+def test_memory_evicts_by_size_and_falls_back_to_disk(tmp_path):
+    cache = MediaCache(str(tmp_path), memory_bytes=10, disk_bytes=100)
+    cache.put("a", b"aaaaaa")
+    cache.put("b", b"bbbbbb")  # evicts "a" from memory, both stay on disk
+    assert cache.stats()["memory_files"] == 1
+    hit = cache.get("a")
+    assert hit is not None and hit.data == b"aaaaaa"
+
+
+def test_disk_evicts_oldest_by_size(tmp_path):
+    cache = MediaCache(str(tmp_path), memory_bytes=0, disk_bytes=10)
+    cache.put("a", b"aaaaaa")
+    cache.put("b", b"bbbbbb")
+    assert cache.get("a") is None
+    assert cache.get("b").data == b"bbbbbb"
+    assert not os.path.exists(tmp_path / "a.bin")
+
+
+def test_disk_index_survives_restart(tmp_path):
+    MediaCache(str(tmp_path), memory_bytes=0, disk_bytes=100).put("gif", b"frames")
+    cache = MediaCache(str(tmp_path), memory_bytes=0, disk_bytes=100)
+    assert cache.get("gif").data == b"frames"
+
+
+def test_upload_ref(tmp_path):
+    cache = MediaCache(None, memory_bytes=100, disk_bytes=0)
+    cache.put("v", b"voice")
+    cache.set_upload_ref("v", "files/abc")
+    assert cache.get("v").upload_ref == "files/abc"
+    cache.set_upload_ref("v", None)
+    assert cache.get("v").upload_ref is None
+
+
+def test_upload_ref_expires(tmp_path):
+    cache = MediaCache(None, memory_bytes=100, disk_bytes=0)
+    cache.put("v", b"voice")
+    cache.set_upload_ref("v", "files/old", time.time() + 60)  # inside the margin
+    assert cache.get("v").upload_ref is None
+    cache.set_upload_ref("v", "files/new", time.time() + 48 * 3600)
+    assert cache.get("v").upload_ref == "files/new"
@@ -0,0 +1,51 @@
+-- Rollback: back to a single unpartitioned messages table (rows are copied back).
+
+ALTER TABLE messages RENAME TO messages_partitioned;
+ALTER TABLE messages_partitioned RENAME CONSTRAINT messages_pkey TO messages_partitioned_pkey;
+ALTER SEQUENCE messages_id_seq OWNED BY NONE;
+DROP INDEX IF EXISTS idx_messages_chat_id;
+DROP INDEX IF EXISTS idx_messages_user_id;
+DROP INDEX IF EXISTS idx_messages_created_at;
+DROP INDEX IF EXISTS idx_messages_chat_created;
+DROP INDEX IF EXISTS idx_messages_search;
+DROP INDEX IF EXISTS idx_messages_file_id;
+DROP INDEX IF EXISTS idx_messages_chat_message;
+
+CREATE TABLE messages (
+    id                  BIGINT PRIMARY KEY DEFAULT nextval('messages_id_seq'),
+    chat_id             BIGINT NOT NULL,
+    user_id             BIGINT,
+    username            TEXT,
+    first_name          TEXT,
+    text                TEXT,
+    message_id          BIGINT,
+    media_type          TEXT,
+    is_bot_reply        BOOLEAN DEFAULT FALSE,
+    request_id          TEXT,
+    was_throttled       BOOLEAN DEFAULT FALSE,
+    created_at          TIMESTAMPTZ NOT NULL DEFAULT NOW(),
+    file_id             TEXT,
+    search_vector       tsvector GENERATED ALWAYS AS (
+        setweight(to_tsvector('simple', COALESCE(text, '')), 'A') ||
+        setweight(to_tsvector('simple', COALESCE(first_name, '')), 'B') ||
+        setweight(to_tsvector('simple', COALESCE(username, '')), 'C')
+    ) STORED,
+    reply_to_message_id BIGINT
+);
+
+INSERT INTO messages (id, chat_id, user_id, username, first_name, text, message_id, media_type, is_bot_reply,
+                      request_id, was_throttled, created_at, file_id, reply_to_message_id)
+SELECT id, chat_id, user_id, username, first_name, text, message_id, media_type, is_bot_reply,
+       request_id, was_throttled, created_at, file_id, reply_to_message_id
+FROM messages_partitioned;
+
+DROP TABLE messages_partitioned;
+ALTER SEQUENCE messages_id_seq OWNED BY messages.id;
+
+CREATE INDEX idx_messages_chat_id ON messages (chat_id);
+CREATE INDEX idx_messages_user_id ON messages (user_id);
+CREATE INDEX idx_messages_created_at ON messages (created_at DESC);
+CREATE INDEX idx_messages_chat_created ON messages (chat_id, created_at DESC);
+CREATE INDEX idx_messages_search ON messages USING GIN (search_vector);
+CREATE INDEX idx_messages_file_id ON messages (file_id) WHERE file_id IS NOT NULL;
+CREATE INDEX idx_messages_chat_message ON messages (chat_id, message_id);
@@ -0,0 +1,77 @@
+-- Range-partition the message log by month (created_at, UTC month boundaries).
+-- Retention drops whole expired partitions instead of deleting rows (see db.RunMessageMaintenance),
+-- and the backend creates upcoming partitions ahead of time. Partitions are named messages_pYYYYMM;
+-- messages_default catches rows outside every partition (normally empty).
+--
+-- Existing rows are copied once into the new table inside this migration.
+
+ALTER TABLE messages RENAME TO messages_unpartitioned;
+ALTER TABLE messages_unpartitioned RENAME CONSTRAINT messages_pkey TO messages_unpartitioned_pkey;
+ALTER SEQUENCE messages_id_seq OWNED BY NONE;
+DROP INDEX IF EXISTS idx_messages_chat_id;
+DROP INDEX IF EXISTS idx_messages_user_id;
+DROP INDEX IF EXISTS idx_messages_created_at;
+DROP INDEX IF EXISTS idx_messages_chat_created;
+DROP INDEX IF EXISTS idx_messages_search;
+DROP INDEX IF EXISTS idx_messages_file_id;
+DROP INDEX IF EXISTS idx_messages_chat_message;
+
+CREATE TABLE messages (
+    id                  BIGINT NOT NULL DEFAULT nextval('messages_id_seq'),
+    chat_id             BIGINT NOT NULL,
+    user_id             BIGINT,
+    username            TEXT,
+    first_name          TEXT,
+    text                TEXT,
+    message_id          BIGINT,
+    media_type          TEXT,
+    is_bot_reply        BOOLEAN DEFAULT FALSE,
+    request_id          TEXT,
+    was_throttled       BOOLEAN DEFAULT FALSE,
+    created_at          TIMESTAMPTZ NOT NULL DEFAULT NOW(),
+    file_id             TEXT,
+    search_vector       tsvector GENERATED ALWAYS AS (
+        setweight(to_tsvector('simple', COALESCE(text, '')), 'A') ||
+        setweight(to_tsvector('simple', COALESCE(first_name, '')), 'B') ||
+        setweight(to_tsvector('simple', COALESCE(username, '')), 'C')
+    ) STORED,
+    reply_to_message_id BIGINT,
+    -- The partition key must be part of every unique constraint
+    PRIMARY KEY (id, created_at)
+) PARTITION BY RANGE (created_at);
+
+-- Monthly partitions from the oldest stored message through two months ahead
+DO $$
+DECLARE
+    m DATE := date_trunc('month', COALESCE((SELECT MIN(created_at) FROM messages_unpartitioned), NOW()) AT TIME ZONE 'UTC')::date;
+    last DATE := (date_trunc('month', NOW() AT TIME ZONE 'UTC') + INTERVAL '2 months')::date;
+BEGIN
+    WHILE m <= last LOOP
+        EXECUTE format(
+            'CREATE TABLE IF NOT EXISTS %I PARTITION OF messages FOR VALUES FROM (%L) TO (%L)',
+            'messages_p' || to_char(m, 'YYYYMM'),
+            m::timestamp AT TIME ZONE 'UTC',
+            (m + INTERVAL '1 month')::timestamp AT TIME ZONE 'UTC');
+        m := (m + INTERVAL '1 month')::date;
+    END LOOP;
+END $$;
+
+CREATE TABLE messages_default PARTITION OF messages DEFAULT;
+
+INSERT INTO messages (id, chat_id, user_id, username, first_name, text, message_id, media_type, is_bot_reply,
+                      request_id, was_throttled, created_at, file_id, reply_to_message_id)
+SELECT id, chat_id, user_id, username, first_name, text, message_id, media_type, is_bot_reply,
+       request_id, was_throttled, created_at, file_id, reply_to_message_id
+FROM messages_unpartitioned;
+
+DROP TABLE messages_unpartitioned;
+ALTER SEQUENCE messages_id_seq OWNED BY messages.id;
+
+-- Same indexes as before, created per partition through the parent
+CREATE INDEX idx_messages_chat_id ON messages (chat_id);
+CREATE INDEX idx_messages_user_id ON messages (user_id);
+CREATE INDEX idx_messages_created_at ON messages (created_at DESC);
+CREATE INDEX idx_messages_chat_created ON messages (chat_id, created_at DESC);
+CREATE INDEX idx_messages_search ON messages USING GIN (search_vector);
+CREATE INDEX idx_messages_file_id ON messages (file_id) WHERE file_id IS NOT NULL;
+CREATE INDEX idx_messages_chat_message ON messages (chat_id, message_id);
@@ -0,0 +1,2 @@
+CREATE INDEX IF NOT EXISTS idx_messages_chat_created ON messages (chat_id, created_at DESC);
+DROP INDEX IF EXISTS idx_messages_chat_created_id;
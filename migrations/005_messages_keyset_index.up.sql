@@ -0,0 +1,4 @@
+-- Keyset pagination over a chat's log walks (chat_id, created_at, id) backwards; id breaks ties
+-- between rows with the same created_at. Supersedes idx_messages_chat_created (its prefix).
+CREATE INDEX IF NOT EXISTS idx_messages_chat_created_id ON messages (chat_id, created_at DESC, id DESC);
+DROP INDEX IF EXISTS idx_messages_chat_created;
@@ -0,0 +1,5 @@
+DROP INDEX IF EXISTS idx_chat_summaries_daily;
+DELETE FROM chat_summaries WHERE summary_type = '1day';
+ALTER TABLE chat_summaries DROP CONSTRAINT IF EXISTS chat_summaries_summary_type_check;
+ALTER TABLE chat_summaries ADD CONSTRAINT chat_summaries_summary_type_check
+    CHECK (summary_type IN ('7day', '30day'));
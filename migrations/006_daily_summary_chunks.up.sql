@@ -0,0 +1,9 @@
+-- Daily summary chunks: each UTC day of a chat is summarized once ('1day') and the 7-day and 30-day
+-- summaries are built from those chunks plus the messages of the current day.
+ALTER TABLE chat_summaries DROP CONSTRAINT IF EXISTS chat_summaries_summary_type_check;
+ALTER TABLE chat_summaries ADD CONSTRAINT chat_summaries_summary_type_check
+    CHECK (summary_type IN ('1day', '7day', '30day'));
+
+-- One chunk per chat and day
+CREATE UNIQUE INDEX IF NOT EXISTS idx_chat_summaries_daily
+    ON chat_summaries (chat_id, period_start) WHERE summary_type = '1day';
@@ -0,0 +1,6 @@
+DROP INDEX IF EXISTS idx_messages_embedding_pending;
+DROP INDEX IF EXISTS idx_messages_embedding;
+DROP INDEX IF EXISTS idx_user_facts_embedding;
+ALTER TABLE messages DROP COLUMN IF EXISTS embedding;
+ALTER TABLE user_facts DROP COLUMN IF EXISTS embedding;
+DROP EXTENSION IF EXISTS vector;
@@ -0,0 +1,26 @@
+-- Semantic memory: embeddings of user facts and messages (pgvector, HNSW, cosine distance).
+-- Filled asynchronously by the backend's embedding indexer; NULL = not embedded yet.
+-- The dimension must match db.EmbeddingDimensions.
+--
+-- Only applied where the pgvector extension is available, so a stock postgres image still works
+-- with ENABLE_EMBEDDINGS=false. The backend refuses to start with embeddings on and no vector columns.
+DO $$
+BEGIN
+    IF NOT EXISTS (SELECT 1 FROM pg_available_extensions WHERE name = 'vector') THEN
+        RAISE NOTICE 'pgvector is not available; skipping the embedding columns';
+        RETURN;
+    END IF;
+
+    CREATE EXTENSION IF NOT EXISTS vector;
+
+    ALTER TABLE user_facts ADD COLUMN IF NOT EXISTS embedding vector(768);
+    ALTER TABLE messages ADD COLUMN IF NOT EXISTS embedding vector(768);
+
+    CREATE INDEX IF NOT EXISTS idx_user_facts_embedding ON user_facts USING hnsw (embedding vector_cosine_ops);
+    CREATE INDEX IF NOT EXISTS idx_messages_embedding ON messages USING hnsw (embedding vector_cosine_ops);
+
+    -- Work queue of the indexer: rows still to embed, newest first (short messages are skipped)
+    CREATE INDEX IF NOT EXISTS idx_messages_embedding_pending ON messages (created_at DESC)
+        WHERE embedding IS NULL AND length(text) >= 16;
+END
+$$;
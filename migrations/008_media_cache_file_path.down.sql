@@ -0,0 +1 @@
+DROP INDEX IF EXISTS idx_media_cache_file_path;
@@ -0,0 +1,3 @@
+-- media_cache files are content-addressed, so several rows can share one file_path. The expiry
+-- sweeper looks paths up to remove a file only when no row references it any more.
+CREATE INDEX IF NOT EXISTS idx_media_cache_file_path ON media_cache (file_path);
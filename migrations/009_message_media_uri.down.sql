@@ -0,0 +1,3 @@
+DROP INDEX IF EXISTS idx_messages_file_id_uri;
+ALTER TABLE messages DROP COLUMN IF EXISTS media_uri_expires_at;
+ALTER TABLE messages DROP COLUMN IF EXISTS media_uri;
@@ -0,0 +1,6 @@
+-- Gemini Files API uploads of large attachments, kept on the message row so a later turn with the
+-- same Telegram file_id references the uploaded file instead of uploading it again. Gemini deletes
+-- files after 48 hours; media_uri_expires_at records when.
+ALTER TABLE messages ADD COLUMN IF NOT EXISTS media_uri TEXT;
+ALTER TABLE messages ADD COLUMN IF NOT EXISTS media_uri_expires_at TIMESTAMPTZ;
+CREATE INDEX IF NOT EXISTS idx_messages_file_id_uri ON messages (file_id, created_at DESC) WHERE media_uri IS NOT NULL;
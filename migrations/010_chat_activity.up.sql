@@ -0,0 +1,28 @@
+-- Per-chat activity, maintained by the message INSERTs themselves (one upsert per chat and batch), so
+-- proactive and summarizer candidate selection read one row per chat instead of grouping a week or a
+-- month of messages.
+--
+-- activity is an exponentially decayed count of user messages (half-life 24 hours) as of
+-- last_message_at: roughly how many messages the chat had in its last active day. Readers decay it
+-- further to the current time. last_message_at includes bot replies.
+CREATE TABLE IF NOT EXISTS chat_activity (
+    chat_id         BIGINT PRIMARY KEY,
+    last_message_at TIMESTAMPTZ NOT NULL,
+    activity        DOUBLE PRECISION NOT NULL DEFAULT 0
+);
+
+CREATE INDEX IF NOT EXISTS idx_chat_activity_last_message ON chat_activity (last_message_at DESC);
+
+-- Backfill from the last 30 days (the longest window any reader looks at).
+INSERT INTO chat_activity (chat_id, last_message_at, activity)
+SELECT chat_id,
+       MAX(created_at),
+       COALESCE(SUM(power(0.5, EXTRACT(EPOCH FROM last_at - created_at) / 86400.0))
+                FILTER (WHERE NOT COALESCE(is_bot_reply, FALSE)), 0)
+FROM (
+    SELECT chat_id, created_at, is_bot_reply, MAX(created_at) OVER (PARTITION BY chat_id) AS last_at
+    FROM messages
+    WHERE created_at > NOW() - INTERVAL '30 days'
+) recent
+GROUP BY chat_id
+ON CONFLICT (chat_id) DO NOTHING;
@@ -0,0 +1,13 @@
+DROP INDEX IF EXISTS idx_messages_embedding_pending;
+DO $$
+BEGIN
+    IF EXISTS (SELECT 1 FROM information_schema.columns
+               WHERE table_schema = current_schema() AND table_name = 'messages' AND column_name = 'embedding') THEN
+        CREATE INDEX IF NOT EXISTS idx_messages_embedding_pending ON messages (created_at DESC)
+            WHERE embedding IS NULL AND length(text) >= 16;
+    END IF;
+END
+$$;
+
+ALTER TABLE messages DROP COLUMN IF EXISTS embedding_attempts;
+ALTER TABLE user_facts DROP COLUMN IF EXISTS embedding_attempts;
@@ -0,0 +1,17 @@
+-- Failed embedding attempts per row. The indexer retries a failed batch one row at a time and counts
+-- the rows that still fail; rows at db.MaxEmbeddingAttempts are skipped (content the API always
+-- rejects would otherwise fail every batch it is in). Reset to 0 to retry them.
+ALTER TABLE user_facts ADD COLUMN IF NOT EXISTS embedding_attempts SMALLINT NOT NULL DEFAULT 0;
+ALTER TABLE messages ADD COLUMN IF NOT EXISTS embedding_attempts SMALLINT NOT NULL DEFAULT 0;
+
+-- The embedding column only exists with pgvector (migration 007)
+DO $$
+BEGIN
+    IF EXISTS (SELECT 1 FROM information_schema.columns
+               WHERE table_schema = current_schema() AND table_name = 'messages' AND column_name = 'embedding') THEN
+        DROP INDEX IF EXISTS idx_messages_embedding_pending;
+        CREATE INDEX IF NOT EXISTS idx_messages_embedding_pending ON messages (created_at DESC)
+            WHERE embedding IS NULL AND length(text) >= 16 AND embedding_attempts < 5;
+    END IF;
+END
+$$;